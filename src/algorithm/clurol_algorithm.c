@@ -211,120 +211,126 @@ center_of_mass_eqwp(const Point2dC *pts,const int count,
 
 
 
-static inline void
+/*!
+ * Select the anchors of lane ii which belong to the largest cluster of
+ * circle intersections.  Returns the number of selected anchors, or -1
+ * if there are less than two intersections, then ancStatus is not set.
+ */
+static inline int
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
-clurol_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
-              size_t no_anchors, int width, int height,
-              VECTOR *restrict resx, VECTOR *restrict resy)
+clurol_select(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+              const int n, const int ii, int *restrict ancStatus)
 {
-if (width==height){};
-
-    // step 1: initialize variables
-
-    const int n = (int)no_anchors;
-    int ancStatus[n];
     // step 2: calculate circle intersections
     int bino = binom(n, 2);
     double intersections_x[bino*2];
     double intersections_y[bino*2];
-    VECTOR rsx,rsy;
-
-    // Devectorized Part
-    for (int ii = 0; ii < VECTOR_OPS; ii++) {
-        int num = 0;
-        int is = 0;
-        int ancStatusTaken = 0;
-        for (int i = 0; i < n-1; i++) {
-            for (int j = i+1; j < n; j++) {
-                // Berechne Schnittpunkte mit aktueller Permutation
-                is += (int)circle_get_intersection_f(vx[i][ii],vy[i][ii],vx[j][ii],vy[j][ii],r[i][ii],r[j][ii],&intersections_x[is],&intersections_y[is]);
-            }
+    int num = 0;
+    int is = 0;
+    int ancStatusTaken = 0;
+    for (int i = 0; i < n-1; i++) {
+        for (int j = i+1; j < n; j++) {
+            // Berechne Schnittpunkte mit aktueller Permutation
+            is += (int)circle_get_intersection_f(vx[i][ii],vy[i][ii],vx[j][ii],vy[j][ii],r[i][ii],r[j][ii],&intersections_x[is],&intersections_y[is]);
         }
-        
-        memset(ancStatus, 0 , no_anchors * sizeof(int));
+    }
 
-        // step 3: copy intersections into one array
-        Point2dC points[is];
-        for (int i = 0; i < is; i++) {
-            points[i] = (Point2dC) {intersections_x[i], intersections_y[i], 0};
-        }
+    memset(ancStatus, 0 , (size_t) n * sizeof(int));
 
-        if (is < 2) {
-            // no sense to do CluRoL, return NLLS here
-            nllsq_run(vx, vy, r, no_anchors, width, height, &rsx, &rsy);
-            (*resx)[ii]=rsx[ii];
-            (*resy)[ii]=rsy[ii];
-            continue;
-        }
+    // step 3: copy intersections into one array
+    Point2dC points[is];
+    for (int i = 0; i < is; i++) {
+        points[i] = (Point2dC) {intersections_x[i], intersections_y[i], 0};
+    }
 
-        // step 4: build all pairwise distance tuples
-        num = 0;
-        int bin;
-        bin = binom(is, 2);
-        PairwiseDistanceTuple D[bin];
-        for (int i = 0; i < is-1; i++) {
-            for (int j = i+1; j < is; j++) {
-                PairwiseDistanceTuple_new(&points[i], &points[j], &D[num]);
-                num++;
-            }
+    if (is < 2) {
+        // no sense to do CluRoL
+        return -1;
+    }
+
+    // step 4: build all pairwise distance tuples
+    int bin;
+    bin = binom(is, 2);
+    PairwiseDistanceTuple D[bin];
+    for (int i = 0; i < is-1; i++) {
+        for (int j = i+1; j < is; j++) {
+            PairwiseDistanceTuple_new(&points[i], &points[j], &D[num]);
+            num++;
         }
+    }
 
-        // step 5: sort D in ascending order of the pairwise distances
-        qsort(D,(size_t)bin,sizeof(PairwiseDistanceTuple),PairwiseDistanceTuple_compareTo);
-
-        // step 6: calculate distance threshold as n-th percentile tuple’s
-        //         pairwise distance value
-        int alpha = binom((int)(ceil((double)n/2.0) + 2), 2);
-        int beta = 2 * binom(n, 2);
-        double nth = (binom(alpha, 2)/(double)binom(beta, 2));
-        int nthPercentile = (int)lround((nth * (double)bin) + 0.5);
-        nthPercentile = min(nthPercentile, bin);
-        double dth = D[nthPercentile-1].d;
-
-        // step 7: call findMaxCluster subroutine
-        int cMax = findMaxCluster(D, bin, dth , points, is);
-
-        // step 8: determine anchors for Minimum Squared Error (MSE) method
-        double dMax = 100;
-        double boundConst = (1 + dMax) * (1 + dMax);
-        for (int cm=0;cm<is;cm++) {
-            if (points[cm].cluster==cMax){
-                for (int i = 0; i < n; i++) {
-                    double ub = r[i][ii] * boundConst;
-                    double lb = r[i][ii] / boundConst;
-                    double dist = distance_sf(points[cm].x,points[cm].y,vx[i][ii],vy[i][ii]);
-                    if (dist <= ub && dist >= lb) {
-                        if (!ancStatus[i]) {
-                            ancStatusTaken++;
-                        }
-                        ancStatus[i] = 1;
+    // step 5: sort D in ascending order of the pairwise distances
+    qsort(D,(size_t)bin,sizeof(PairwiseDistanceTuple),PairwiseDistanceTuple_compareTo);
+
+    // step 6: calculate distance threshold as n-th percentile tuple’s
+    //         pairwise distance value
+    int alpha = binom((int)(ceil((double)n/2.0) + 2), 2);
+    int beta = 2 * binom(n, 2);
+    double nth = (binom(alpha, 2)/(double)binom(beta, 2));
+    int nthPercentile = (int)lround((nth * (double)bin) + 0.5);
+    nthPercentile = min(nthPercentile, bin);
+    double dth = D[nthPercentile-1].d;
+
+    // step 7: call findMaxCluster subroutine
+    int cMax = findMaxCluster(D, bin, dth , points, is);
+
+    // step 8: determine anchors for Minimum Squared Error (MSE) method
+    double dMax = 100;
+    double boundConst = (1 + dMax) * (1 + dMax);
+    for (int cm=0;cm<is;cm++) {
+        if (points[cm].cluster==cMax){
+            for (int i = 0; i < n; i++) {
+                double ub = r[i][ii] * boundConst;
+                double lb = r[i][ii] / boundConst;
+                double dist = distance_sf(points[cm].x,points[cm].y,vx[i][ii],vy[i][ii]);
+                if (dist <= ub && dist >= lb) {
+                    if (!ancStatus[i]) {
+                        ancStatusTaken++;
                     }
+                    ancStatus[i] = 1;
                 }
             }
         }
+    }
+    return ancStatusTaken;
+}
+
+
+/*!
+ * CluRoL of all lanes at once.  The clustering is done lane by lane, but
+ * a single nllsq_run_masked() localises all lanes with their selected
+ * anchors.  Lanes without a cluster take all anchors, as NLLS does.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+clurol_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+              size_t no_anchors,
+              int width __attribute__((__unused__)),
+              int height __attribute__((__unused__)),
+              VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    const int n = (int)no_anchors;
+    int ancStatus[n];
+    VECTOR taken[n];
+    VECTOR undefined = zero;
 
-        // step 9: copy anchors and ranges into new array and localize
-        num = 0;
-        VECTOR anchorsTaken_x[ancStatusTaken],anchorsTaken_y[ancStatusTaken];
-        VECTOR rangesTaken[ancStatusTaken];
-        VECTOR retx, rety;
+    for (int ii = 0; ii < VECTOR_OPS; ii++) {
+        const int ancStatusTaken = clurol_select(vx, vy, r, n, ii, ancStatus);
         for (int i = 0; i < n; i++) {
-            if (ancStatus[i]) {
-                anchorsTaken_x[num][ii] = vx[i][ii];
-                anchorsTaken_y[num][ii] = vy[i][ii];
-                rangesTaken[num][ii] = r[i][ii];
-                num++;
-            }
-        }
-        if (num<3) {
-            (*resx)[ii]=NAN;
-            (*resy)[ii]=NAN;
-        } else {
-            nllsq_run(anchorsTaken_x,anchorsTaken_y,rangesTaken,(size_t)num,width,height,&retx,&rety);
-            (*resx)[ii]=retx[ii];
-            (*resy)[ii]=rety[ii];
+            taken[i][ii] = (ancStatusTaken < 3 || ancStatus[i]) ? 1.0F : 0.0F;
         }
+        undefined[ii] = (ancStatusTaken >= 0 && ancStatusTaken < 3) ? 1.0F : 0.0F;
+    }
+
+    // step 9: localize with the anchors taken
+    VECTOR use[n];
+    for (int i = 0; i < n; i++) {
+        use[i] = VECTOR_EQ(taken[i], one);
     }
+    nllsq_run_masked(vx, vy, r, use, no_anchors, resx, resy);
+    undefined = VECTOR_EQ(undefined, one);
+    *resx = VECTOR_BLENDV(*resx, VECTOR_BROADCASTF(NAN), undefined);
+    *resy = VECTOR_BLENDV(*resy, VECTOR_BROADCASTF(NAN), undefined);
 }
 
 
@@ -34,169 +34,117 @@
 
 /* @algorithm_name: Geolateration */
 
+#include "util/util_vcircle.c"
+#include "util/util_vpoints.c"
+
 /*!
- * \arg \c mcount 
- * \arg \c mx     
- * \arg \c my     
- * \arg \c r
- * \arg \c ptscount Number of circle intersections.
- * \arg \c ptsy     X coordinate of circle intersections.
- * \arg \c ptsy     Y coordinate of circle intersections.
- * \arg \c min
+ * Geolateration of all lanes at once.  Every pair of anchors has two
+ * slots for its intersections, masks tell which slots of a lane hold
+ * points which survive the filters.
  */
-static inline size_t
-circle_minimum_circle_containment(size_t mcount, float *mx, float *my,
-                                  float *r, size_t ptscount, float *ptsx,
-				  float *ptsy, float *ptsw, size_t min)
-{
-    float vx [ptscount];
-    float vy [ptscount];
-    float vw [ptscount];
-    size_t icount = 0;
-    for (size_t i = 0; i < ptscount; i++) {
-        size_t min_c = 0;
-        for (size_t j = 0; j < mcount; j++) {
-            if (distance_s(mx[j],my[j],ptsx[i],ptsy[i]) <= r[j] + 0.01F) {
-                min_c ++;
-            }
-        }
-        if (min_c >= min || ptsw[i] == 0.5F) {
-            vx[icount] = ptsx[i];
-            vy[icount] = ptsy[i];
-            vw[icount] = ptsw[i];
-            icount ++;
-        }
-    }
-    memcpy (ptsx, vx, sizeof(float) * icount);
-    memcpy (ptsy, vy, sizeof(float) * icount);
-    memcpy (ptsw, vw, sizeof(float) * icount);
-    return icount;
-}
-
-
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
 geon_run (const VECTOR* vx, const VECTOR* vy,
           const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy)
 {
-    if (num_anchors < 3) return;
+    if (num_anchors < 3) {
+        *resx = *resy = VECTOR_BROADCASTF(NAN);
+        return;
+    }
 
     // step 1: calculate circle intersections
-    size_t bin = num_anchors * (num_anchors - 1);
-
-    for (int ii = 0 ; ii < VECTOR_OPS; ii++) {
-        float intersectionsx[bin];
-        float intersectionsy[bin];
-        float intersectionsw[bin];
-        size_t icount = 0;
-        size_t tmp = 0;
-        
-        // build all k-permutations
-        for (size_t i = 0; i < num_anchors-1; i++) {
-            for (size_t j = i+1; j < num_anchors; j++) {
-                // set weight for intersection
-                float weight = 1;
-                // Berechne Schnittpunkte mit aktueller Permutation
-                tmp = circle_get_intersection(vx[i][ii], vy[i][ii], vx[j][ii],
-                                              vy[j][ii], r[i][ii], r[j][ii],
-					      &intersectionsx[icount],
-                                              &intersectionsy[icount]);
-                intersectionsw[icount] = weight;
-                intersectionsw[icount+1] = weight;
-                
-                if (tmp == 0) {
-                    // no intersection => try to get approximated intersection
-                    tmp = circle_get_approx_intersection(
-                            vx[i][ii], vy[i][ii], vx[j][ii], vy[j][ii],
-                            r[i][ii], r[j][ii], &intersectionsx[icount],
-                            &intersectionsy[icount]);
-                    weight = 0.5F;
-                    intersectionsw[icount] = weight;
-                }
-                icount += tmp;                
-            }
+    const size_t bin = num_anchors * (num_anchors - 1);
+    VECTOR px[bin], py[bin], pw[bin], valid[bin];
+    const VECTOR approx = VECTOR_BROADCASTF(0.5F);
+    size_t slot = 0;
+
+    for (size_t i = 0; i < num_anchors-1; i++) {
+        for (size_t j = i+1; j < num_anchors; j++) {
+            const VECTOR count =
+                vcircle_intersections(vx[i], vy[i], vx[j], vy[j], r[i], r[j],
+                                      &px[slot], &py[slot]);
+            // no intersection => try to get approximated intersection
+            VECTOR ax, ay;
+            const VECTOR none = VECTOR_EQ(count, zero);
+            const VECTOR found = vcircle_approx_intersection(vx[i], vy[i],
+                                                             vx[j], vy[j],
+                                                             r[i], r[j],
+                                                             &ax, &ay);
+            px[slot] = VECTOR_BLENDV(px[slot], ax, none);
+            py[slot] = VECTOR_BLENDV(py[slot], ay, none);
+            pw[slot] = VECTOR_BLENDV(one, approx, none);
+            valid[slot] = VECTOR_OR(VECTOR_NOT(none), found);
+            pw[slot + 1] = one;
+            valid[slot + 1] = VECTOR_EQ(count, two);
+            slot += 2;
         }
+    }
 
-        // step 2: copy intersections into one array
-
-        // done in step 1
-
-        // step 3: filter intersections points: only keep points which are
-        //         contained in anchor length - 2 circles.
-        float ax[num_anchors];
-        float ay[num_anchors];
-        float ar[num_anchors];
-        for (size_t i = 0; i <num_anchors; i++) {
-            ax[i] = vx[i][ii];   
-            ay[i] = vy[i][ii];   
-            ar[i] = r[i][ii];        
-        }
-        icount = circle_minimum_circle_containment(num_anchors, ax, ay, ar, icount, intersectionsx, intersectionsy, intersectionsw, num_anchors - 2);
-       
-        // step 4: if there are n*(n-1)/2 points which are very close together
-        //          => no ranging error, take one of them as result
-        size_t close_num_anchors = (num_anchors * (num_anchors - 1)) / 2;
-        int wasbreak = 0;
-        for (size_t i = 0; i < icount; i++) {
-            size_t current_close_num_anchors = 1;
-            for (size_t j = 0; j < icount; j++) {
-                if (i != j && distance_s(intersectionsx[i],intersectionsy[i],intersectionsx[j],intersectionsy[j]) < 0.1F) {
-                    current_close_num_anchors++;
-                }
-            }
-            if (current_close_num_anchors >= close_num_anchors) {
-                (*resx)[ii] = intersectionsx[i];
-                (*resy)[ii] = intersectionsy[i];
-                wasbreak = 1;
-                break;
-            }
-        }
-        if (wasbreak) continue;
-
-        // step 5: apply median filter on remaining points
-        float distances[icount];
-        memset(distances, 0, icount * sizeof(float));
-        for (size_t i = 0; i < icount; i++) {
-            for (size_t j = 0; j < icount; j++) {
-                if (i != j) {
-                    distances[i] += distance_s(intersectionsx[i],intersectionsy[i],intersectionsx[j],intersectionsy[j]);
-                }
-            }
-        }
+    // step 3: filter intersections points: only keep points which are
+    //         contained in anchor length - 2 circles.
+    const VECTOR min = VECTOR_BROADCASTF((float) (num_anchors - 2));
+    const VECTOR slack = VECTOR_BROADCASTF(0.01F);
+    for (size_t i = 0; i < bin; i++) {
+        VECTOR min_c = zero;
+        for (size_t j = 0; j < num_anchors; j++)
+            min_c += VECTOR_AND(one, VECTOR_LE(distance(vx[j], vy[j], px[i], py[i]),
+                                               r[j] + slack));
+        valid[i] = VECTOR_AND(valid[i], VECTOR_OR(VECTOR_GE(min_c, min),
+                                                  VECTOR_EQ(pw[i], approx)));
+    }
 
-        const float median = fmedian_s(icount, distances);
-        
-        float vvx[icount];
-        float vvy[icount];
-        float vvw[icount];
-        int vvcount = 0;
-        
-        for (size_t i = 0; i < icount; i++) {
-	    if (icount >=3) {
-		    if (distances[i] <= median * 1.0F) { // Median factor
-		        vvx[vvcount] = intersectionsx[i];
-		        vvy[vvcount] = intersectionsy[i];
-		        vvw[vvcount] = intersectionsw[i];
-		        vvcount++;
-		    } 
-	    } else {
-		    vvx[vvcount] = intersectionsx[i];
-		    vvy[vvcount] = intersectionsy[i];
-		    vvw[vvcount] = intersectionsw[i];
-		    vvcount++;
-	    }
-		
+    // step 4: if there are n*(n-1)/2 points which are very close together
+    //          => no ranging error, take one of them as result
+    const VECTOR close_num_anchors =
+        VECTOR_BROADCASTF((float) ((num_anchors * (num_anchors - 1)) / 2));
+    const VECTOR close = VECTOR_BROADCASTF(0.1F);
+    VECTOR done = zero, hx = zero, hy = zero;
+    for (size_t i = 0; i < bin; i++) {
+        VECTOR current_close_num_anchors = one;
+        for (size_t j = 0; j < bin; j++) {
+            if (i != j)
+                current_close_num_anchors +=
+                    VECTOR_AND(one, VECTOR_AND(valid[j],
+                                               VECTOR_LT(distance(px[i], py[i], px[j], py[j]), close)));
         }
+        const VECTOR hit = VECTOR_ANDNOT(done, VECTOR_AND(valid[i],
+                                         VECTOR_GE(current_close_num_anchors, close_num_anchors)));
+        hx = VECTOR_BLENDV(hx, px[i], hit);
+        hy = VECTOR_BLENDV(hy, py[i], hit);
+        done = VECTOR_OR(done, hit);
+    }
+    if (VECTOR_TEST_ALL_ONES(done)) {
+        *resx = hx;
+        *resy = hy;
+        return;
+    }
 
-        
-        // step 6: calculate final position estimation with given algorithm
-        float masses[vvcount];
-        for (int i = 0; i < vvcount; i++) {
-            if (vvw[i] == 1.0F) {
-                masses[i] = 3.0F * vvw[i];
-            } else {
-                masses[i] = 1.0F;
-            }
+    // step 5: apply median filter on remaining points
+    VECTOR distances[bin];
+    VECTOR icount = zero;
+    for (size_t i = 0; i < bin; i++) {
+        distances[i] = zero;
+        for (size_t j = 0; j < bin; j++) {
+            if (i != j)
+                distances[i] += VECTOR_AND(distance(px[i], py[i], px[j], py[j]),
+                                           valid[j]);
         }
-        center_of_mass(vvcount, vvx, vvy, masses, &((*resx)[ii]), &((*resy)[ii]))    ;    
-     }
+        icount += VECTOR_AND(one, valid[i]);
+    }
+    const VECTOR median = vmedian(distances, valid, bin);
+    const VECTOR three = VECTOR_BROADCASTF(3.0F);
+    const VECTOR filter = VECTOR_GE(icount, three);
+
+    // step 6: calculate final position estimation with given algorithm
+    VECTOR masses[bin];
+    for (size_t i = 0; i < bin; i++) {
+        const VECTOR keep = VECTOR_AND(valid[i],
+                                       VECTOR_OR(VECTOR_NOT(filter),
+                                                 VECTOR_LE(distances[i], median)));
+        masses[i] = VECTOR_AND(VECTOR_BLENDV(one, three * pw[i],
+                                             VECTOR_EQ(pw[i], one)), keep);
+    }
+    VECTOR cx, cy;
+    vcenter_of_mass(bin, px, py, masses, &cx, &cy);
+    *resx = VECTOR_BLENDV(cx, hx, done);
+    *resy = VECTOR_BLENDV(cy, hy, done);
 }
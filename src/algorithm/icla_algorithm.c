@@ -98,7 +98,7 @@ static inline void icmp_move(double step, IcmPoint *this) {
             this->currentLocation.y = this->currentLocation.y + (step / dirLength) * dir.y;
         }
 
-static inline void icmp_merge(IcmPoint *p, IcmPoint *this) {
+static void __attribute__((__unused__)) icmp_merge(IcmPoint *p, IcmPoint *this) {
             p->merged = 1;
             this->mergeList[this->ml_fill] = p;
             this->ml_fill++;
@@ -128,7 +128,7 @@ static inline void computeInitialAttractingBoundary(IcmPoint *points, int count)
     }
 
 // compute moving direction of each point
-static inline void computeMovingDirection(IcmPoint *points, int count) {
+static void __attribute__((__unused__)) computeMovingDirection(IcmPoint *points, int count) {
         for (int i = 0; i < count; i++) {
             if (points[i].merged) continue;
             int forceVector[9]; // initial to 0's
@@ -214,7 +214,11 @@ icla_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
             }
         }
 
-        if (icount == 0) continue;
+        if (icount == 0) {
+            // no intersection to cluster, the localisation failed
+            (*resx)[ii] = (*resy)[ii] = NAN;
+            continue;
+        }
         IcmPoint points[icount];
         for (int i = 0; i < icount; i++) {
                 icmp_new(intersections_x[i], intersections_y[i], i, &points[i]);
@@ -42,6 +42,59 @@
 #include "util/util_matrix.c"
 #include "util/util_triangle.c"
  
+/*!
+ * The linear least squares of the anchors selected by use, for every lane
+ * separately, or of all anchors if use is NULL.  The last selected anchor
+ * of a lane is the reference, so a lane gets the same result as llsq_run()
+ * of its selected anchors alone.
+ */
+static inline void __attribute__((__always_inline__,__gnu_inline__,__artificial__))
+llsq_run_masked(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+                const VECTOR *restrict use, size_t num_anchors,
+                VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    // Solve equation of form A*x = b with the closed form solution
+    // x = (A^T*A)^-1 * A^T * b, accumulating A^T*A and A^T*b row by row.
+    assert(num_anchors > 0);
+    size_t m = num_anchors-1U;
+    VECTOR sxx = zero, sxy = zero, syy = zero, bx = zero, by = zero;
+    VECTOR row[use != NULL ? num_anchors : 1U];
+    VECTOR refx = vx[m], refy = vy[m], refr = r[m];
+
+    if (use != NULL) {
+        // The rows are the selected anchors before the reference.
+        VECTOR seen = zero;
+        for (size_t i = num_anchors; i-- > 0; ) {
+            row[i] = VECTOR_AND(use[i], seen);
+            const VECTOR ref = VECTOR_ANDNOT(seen, use[i]);
+            refx = VECTOR_BLENDV(refx, vx[i], ref);
+            refy = VECTOR_BLENDV(refy, vy[i], ref);
+            refr = VECTOR_BLENDV(refr, r[i], ref);
+            seen = VECTOR_OR(seen, use[i]);
+        }
+        m = num_anchors;
+    }
+    for (size_t i = 0; i < m; i++) {
+        VECTOR ax = vx[i] - refx;
+        VECTOR ay = vy[i] - refy;
+        const VECTOR b = half * (vx[i] * vx[i] - refx * refx +
+                                 vy[i] * vy[i] - refy * refy +
+                                 refr * refr - r[i] * r[i]);
+        if (use != NULL) {
+            // A zero row adds nothing.
+            ax = VECTOR_AND(ax, row[i]);
+            ay = VECTOR_AND(ay, row[i]);
+        }
+        sxx += ax * ax;
+        sxy += ax * ay;
+        syy += ay * ay;
+        bx += ax * b;
+        by += ay * b;
+    }
+    solve_normal_2x2(sxx, sxy, syy, bx, by, resx, resy);
+}
+
+
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
 llsq_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
          size_t num_anchors,
@@ -50,33 +103,6 @@ llsq_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
          VECTOR *restrict resx,
          VECTOR *restrict resy)
 {
-    // Solve equation of form W*A*x = W*b
-    assert(num_anchors > 0);
-    const size_t m = num_anchors-1U;
-    VECTOR b[m*1];
-    VECTOR a[m*2];
-    VECTOR mAT[2*m];
-    VECTOR tmp[2*m];
-    VECTOR tmp2[2*2];
-    VECTOR tmp3[2*2];
-    VECTOR tmp4[2*1];    
-
-    for (size_t i = 0; i < m; i++) {
-        a[i*2+0] = (vx[i] - vx[m]);
-        a[i*2+1] = (vy[i] - vy[m]);
-        b[i*1+0] = half * (vx[i] * vx[i] - vx[m] * vx[m] +
-                    vy[i] * vy[i] - vy[m] * vy[m] +
-                    r[m] * r[m] - r[i] * r[i]);
-    }
-    
-    // Solve with closed form solution: x = (A^T*A)^-1 * A^T * b
-        transpose(a,mAT,m,2);       
-        times(mAT,2,m,a,2,tmp2);
-        invert_2x2(tmp2,tmp3);
-        times(tmp3,2,2,mAT,m,tmp);        
-        times(tmp,2,m,b,1,tmp4);
-        
-        *resx = tmp4[0];
-        *resy = tmp4[1];
+    llsq_run_masked(vx, vy, r, NULL, num_anchors, resx, resy);
 }
 #endif
@@ -47,13 +47,111 @@
 
 #include <assert.h>
 //#include "algorithm/llsq_algorithm.c"
+#include "util/util_math.c"
+#include "util/util_random.c"
 #include "util/util_sort.c"
+#include "util/util_vpoints.c"
 #include <stdlib.h>
 
 
 
 
 
+typedef struct lms_params_t {
+    /*! The subsets of lms_setup(). */
+    ls2_subsets_t subsets;
+} lms_params_t;
+
+static lms_params_t lms_defaults;
+
+static __thread lms_params_t *lms_params = &lms_defaults;
+
+
+/*! Release the subsets of lms_setup(). */
+static void __attribute__((__unused__))
+lms_params_free(lms_params_t *params)
+{
+    ls2_subsets_free(&params->subsets);
+}
+
+
+/*!
+ * Build the table of the subsets of the anchors, which LMS draws from.
+ */
+static void
+lms_setup(const vector2 *anchors __attribute__((__unused__)), size_t nanchors)
+{
+    ls2_subsets_init(&lms_params->subsets, nanchors, 4, 4);
+}
+
+/* ls2_context_setup() of a STAND_ALONE build calls lms_setup(). */
+#define ALGORITHM_HAS_SETUP 1
+
+
+/*!
+ * A seed for the draws of lms_draw(), which is a hash of the ranges.
+ * The same ranges thus give the same draws, no matter which thread
+ * computes them.
+ */
+static inline uint64_t
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+lms_seed(const VECTOR *restrict r, const size_t N)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;         // FNV-1a
+    for (size_t i = 0; i < N; i++) {
+        uint32_t u[VECTOR_OPS];
+        memcpy(u, &r[i], sizeof(u));
+        for (int ii = 0; ii < VECTOR_OPS; ii++)
+            h = (h ^ u[ii]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+
+/*!
+ * Draw M of the bino subsets of lms_subsets at random for every lane, or
+ * take all of them if there are at most M.  ran[j] holds the index of the
+ * j-th subset of each lane.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+lms_draw(const VECTOR *restrict r, const size_t N, const int bino,
+         const int M, VECTOR ran[M])
+{
+    if (bino <= M) {
+        // select all available permutations
+        for (int i = 0; i < M; i++) {
+            ran[i] = VECTOR_BROADCASTF((float) i);
+        }
+        return;
+    }
+
+    // select M permutations randomly, drawing again in the lanes which
+    // got one of their previous ones
+    ls2_rng_t rng;
+    ls2_rng_init(&rng, lms_seed(r, N));
+    const VECTOR scale = VECTOR_BROADCASTF((float) bino - 1.0f);
+    for (int i = 0; i < M; i++) {
+        VECTOR again = VECTOR_ONES();
+        ran[i] = zero;
+        do {
+            const VECTOR rn = VECTOR_TRUNCATE(rnd(&rng) * scale);
+            VECTOR drawn = zero;
+            for (int j = 0; j < i; j++) {
+                drawn = VECTOR_OR(drawn, VECTOR_EQ(ran[j], rn));
+            }
+            ran[i] = VECTOR_BLENDV(ran[i], rn, again);
+            again = VECTOR_AND(again, drawn);
+        } while (!VECTOR_TEST_ALL_ONES(VECTOR_NOT(again)));
+    }
+}
+
+
+/*!
+ * LMS of all lanes at once.  Every lane draws its own subsets, the same
+ * ones as the scalar version in tests/test-lanes.c does; the estimates of
+ * a subset are computed for all lanes by a single llsq_run().
+ */
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
 lms_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
@@ -64,147 +162,87 @@ lms_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
     int k = 4;
     int N = (int)no_anchors;
     int M = N > 6 ? 20 : binom(N, k);
-    float threshold = 2.5f;
+    const VECTOR threshold = VECTOR_BROADCASTF(2.5f);
 
     if (N < k) {
         llsq_run(vx, vy, r, no_anchors, width, height, resx, resy);
         return;
     }
 
-    for (int ii = 0; ii < VECTOR_OPS; ii++) {
-        // 2. Randomly draw M k-permutations
-        int rpi = 0;
-        int ran[M];
-        int bino = binom(N, k);
-        int permutations[k];
-        int randPermutations[M][k];
-
-        if (bino <= M) {
-            // select all available permutations
-            for (int i = 0; i < M; i++) {
-                ran[i] = i;
-            }
-        } else {
-            // select M permutations randomly
-            for (int i = 0; i < M; i++) {
-                ran[i] = -1;
-                do {
-                    int j;
-		    float randZeroOne = ((float) rand() / (float)RAND_MAX);
-                    int rn = (int) (randZeroOne * ((float) bino - 1));
-                    for (j = 0; j < i; j++) {
-                        if (ran[j] == rn) break;
-                    }
-                    if (j == i) {
-                        ran[i] = rn;
-                    }
-                } while (ran[i] == -1);
-            }
-            isort(ran, (size_t) M);
-        }
-
-        // initialisation for calculating k-permutations
+    // The subsets are built by lms_setup() before the workers start.
+    assert(lms_params->subsets.n == no_anchors);
+
+    // 2. Randomly draw M k-permutations for every lane, unless all lanes
+    //    take all of them.
+    const int shared = binom(N, k) <= M;
+    VECTOR ran[M];
+    lms_draw(r, no_anchors, binom(N, k), M, ran);
+
+    // calculate intermediate position and median of residues
+    const VECTOR undefined = VECTOR_BROADCASTF(FLT_MAX);
+    const VECTOR all = VECTOR_ONES();
+    VECTOR iPos_x[M];
+    VECTOR iPos_y[M];
+    VECTOR medians[M];
+    VECTOR tmpAnchors_x[k];
+    VECTOR tmpAnchors_y[k];
+    VECTOR tmpRanges[k];
+    VECTOR tmpMedian[N];
+    VECTOR use[N];
+
+    for (int j = 0; j < M; j++) {
         for (int i = 0; i < k; i++) {
-            permutations[i] = i;
-        }
-
-        // build all k-permutations
-        for (int i = 0; i < bino; i++) {
-
-            // add current permutation if choosen
-            if (i == ran[rpi]) {
-                memcpy(randPermutations[rpi], permutations, (size_t) k*sizeof(int));
-                rpi++;
-                if (rpi == M) break;
+            if (shared) {
+                const int a = lms_params->subsets.anchor[j][i];
+                tmpAnchors_x[i] = vx[a];
+                tmpAnchors_y[i] = vy[a];
+                tmpRanges[i] = r[a];
+                continue;
             }
-
-            // build next permutation
-            if (i == bino - 1) break;
-            int j = k - 1;
-            while (j >= 0) {
-                if (!incCounter(permutations, j, N, k)) break;
-                j--;
-            }
-            for (int l = j+1; l < k; l++) {
-                permutations[l] = permutations[l-1] + 1;
+            for (int ii = 0; ii < VECTOR_OPS; ii++) {
+                const int a = lms_params->subsets.anchor[(int) ran[j][ii]][i];
+                tmpAnchors_x[i][ii] = vx[a][ii];
+                tmpAnchors_y[i][ii] = vy[a][ii];
+                tmpRanges[i][ii] = r[a][ii];
             }
         }
-               
-        // calculate intermediate position and median of residues
-        float iPos_x[M];
-        float iPos_y[M];
-        float medians[M];
-        VECTOR tmpAnchors_x[k];
-        VECTOR tmpAnchors_y[k];
-        VECTOR tmpRanges[k];
-        float tmpMedian[N];
-                                
-        for (int j = 0; j < M; j++) {
-	    for (int i = 0; i < k; i++) {               
-		tmpAnchors_x[i] = vx[randPermutations[j][i]];
-                tmpAnchors_y[i] = vy[randPermutations[j][i]];
-                tmpRanges[i] = r[randPermutations[j][i]];
-            }
-            VECTOR pex, pey;
-            llsq_run(tmpAnchors_x, tmpAnchors_y, tmpRanges, (size_t) k,
-                     width, height, &pex, &pey);
-            
-            iPos_x[j] = (!isnan(pex[ii])) ? pex[ii] : FLT_MAX;
-            iPos_y[j] = (!isnan(pey[ii])) ? pey[ii] : FLT_MAX;
-
-            // calculate residue for all points and find median
-            for (int i = 0; i < N; i++) {
-                float residue = distance_s(iPos_x[j], iPos_y[j], vx[i][ii], vy[i][ii]) - r[i][ii];
-                tmpMedian[i] = residue * residue;
-            }
-            medians[j] = fmedian_s((size_t) N, tmpMedian);
-        }
+        VECTOR pex, pey;
+        llsq_run(tmpAnchors_x, tmpAnchors_y, tmpRanges, (size_t) k,
+                 width, height, &pex, &pey);
+        iPos_x[j] = VECTOR_BLENDV(undefined, pex, VECTOR_EQ(pex, pex));
+        iPos_y[j] = VECTOR_BLENDV(undefined, pey, VECTOR_EQ(pey, pey));
 
-        // 3. Find index of least median
-        int m = 0;
-        for (int i = 1; i < M; i++) {
-            if (medians[i] < medians[m]) {
-                m = i;
-            }
-        }
-        
-        // 4. Calculate s0
-        float s0 = 1.4826f * (1.0f + 5.0f / ((float)N - 2.0f)) * sqrtf(medians[m]);
-        // 5. Assign weights to samples
-        int wei[N];
-        int count = 0;
+        // calculate residue for all points and find median
         for (int i = 0; i < N; i++) {
-            float ri = distance_s(iPos_x[m], iPos_y[m], vx[i][ii], vy[i][ii]) - r[i][ii];
-            if (fabs(ri/s0) <= threshold) {
-                wei[i] = 1;
-                count++;
-            } else {
-                wei[i] = 0;
-            }
+            const VECTOR residue =
+                distance(iPos_x[j], iPos_y[j], vx[i], vy[i]) - r[i];
+            tmpMedian[i] = residue * residue;
+            use[i] = all;
         }
+        medians[j] = vmedian(tmpMedian, use, (size_t) N);
+    }
 
-        assert(count > 0);
-        VECTOR anchors_x[count], anchors_y[count], ranges[count];
-        int c=0;
-        for (int i=0; i < N; i++) {
-            if (wei[i]==1) {
-                anchors_x[c] = vx[i];
-                anchors_y[c] = vy[i];
-                ranges[c] = r[i];
-                c++;
-            }
-        }
-        
-        // 6. Calculate weighted LS and return result as final position
-        VECTOR pex, pey;
-        llsq_run(anchors_x, anchors_y, ranges, (size_t)count,
-                 width, height, &pex, &pey);
-        
-        (*resx)[ii] = pex[ii];
-        (*resy)[ii] = pey[ii];
+    // 3. Find least median, the first one on ties
+    VECTOR median = medians[0], mx = iPos_x[0], my = iPos_y[0];
+    for (int i = 1; i < M; i++) {
+        const VECTOR less = VECTOR_LT(medians[i], median);
+        median = VECTOR_BLENDV(median, medians[i], less);
+        mx = VECTOR_BLENDV(mx, iPos_x[i], less);
+        my = VECTOR_BLENDV(my, iPos_y[i], less);
     }
 
+    // 4. Calculate s0
+    const float c = 1.4826f * (1.0f + 5.0f / ((float)N - 2.0f));
+    const VECTOR s0 = VECTOR_BROADCASTF(c) * VECTOR_SQRT(median);
+
+    // 5. Assign weights to samples
+    for (int i = 0; i < N; i++) {
+        const VECTOR ri = distance(mx, my, vx[i], vy[i]) - r[i];
+        use[i] = VECTOR_LE(VECTOR_ABS(ri / s0), threshold);
+    }
 
+    // 6. Calculate weighted LS and return result as final position
+    llsq_run_masked(vx, vy, r, use, no_anchors, resx, resy);
 }
 
 #endif
@@ -51,24 +51,35 @@ static float md_minmax_abs_middle_right = 1.6362*(50.0/5.0);
 static float md_minmax_abs_right        = 16.0428*(50.0/5.0);
 */
 
-static float md_minmax_abs_left         = -50.0f;
-static float md_minmax_abs_middle_left  = 50.0f;
-static float md_minmax_abs_middle_right = 50.0f;
-static float md_minmax_abs_right        = 150.0f;
+typedef struct md_minmax_abs_params_t {
+    float left;
+    float middle_left;
+    float middle_right;
+    float right;
+} md_minmax_abs_params_t;
+
+static md_minmax_abs_params_t md_minmax_abs_defaults = {
+    .left = -50.0f,
+    .middle_left = 50.0f,
+    .middle_right = 50.0f,
+    .right = 150.0f
+};
+
+static __thread md_minmax_abs_params_t *md_minmax_abs_params = &md_minmax_abs_defaults;
 
 #if HAVE_POPT_H
 struct poptOption md_minmax_abs_arguments[] = {
         { "mf-left", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_abs_left, 0,
+          &md_minmax_abs_defaults.left, 0,
           "left value of the membership function", NULL },
         { "mf-middle-left", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_abs_middle_left, 0,
+          &md_minmax_abs_defaults.middle_left, 0,
           "middle left value of the membership function", NULL },
         { "mf-middle-right", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_abs_middle_right, 0,
+          &md_minmax_abs_defaults.middle_right, 0,
           "middle right value of the membership function", NULL },
         { "mf-right", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_abs_right, 0,
+          &md_minmax_abs_defaults.right, 0,
           "right value of the membership function", NULL },
         POPT_TABLEEND
 };
@@ -78,14 +89,15 @@ struct poptOption md_minmax_abs_arguments[] = {
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
 md_minmax_abs_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy) {
 
+    const md_minmax_abs_params_t *p = md_minmax_abs_params;
     const float left_rate      =
-        (1.00F - 0.00F) / (md_minmax_abs_middle_left - md_minmax_abs_left);
+        (1.00F - 0.00F) / (p->middle_left - p->left);
     const float left_const     =
-        -1.00F * left_rate * md_minmax_abs_left;
+        -1.00F * left_rate * p->left;
     const float right_rate     =
-        (0.00F - 1.00F) / (md_minmax_abs_right - md_minmax_abs_middle_right);
+        (0.00F - 1.00F) / (p->right - p->middle_right);
     const float right_const    =
-        -1.00F * right_rate * md_minmax_abs_right;
+        -1.00F * right_rate * p->right;
 
     const VECTOR v_left_rate   = VECTOR_BROADCASTF(left_rate);
     const VECTOR v_left_const  = VECTOR_BROADCASTF(left_const);
@@ -34,29 +34,13 @@
 
 /* @algorithm_name: Minimise residuals (norm 1, brute force) */
 
+#include "util/util_minres.c"
+
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__)) __attribute__((__always_inline__,__artificial__,__nonnull__))
 min_res1_bf_run(const VECTOR* ax, const VECTOR* ay, const VECTOR *restrict r,
                 const size_t num_anchors, const int width, const int height,
                 VECTOR *restrict resx, VECTOR *restrict resy)
 {
-    VECTOR min_res = VECTOR_BROADCASTF(FLT_MAX),
-           rx = VECTOR_BROADCASTF(0.0f),
-           ry = VECTOR_BROADCASTF(0.0f);
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            VECTOR res = VECTOR_ZERO();
-            const VECTOR vx = VECTOR_BROADCASTF((float) x),
-                         vy = VECTOR_BROADCASTF((float) y);
-            for (size_t a = 0; a < num_anchors; a++) {
-                const VECTOR d =  distance(vx, vy, ax[a], ay[a]) - r[a];
-                res += VECTOR_ABS(d);
-            }
-            const VECTOR m = VECTOR_GT(min_res, res);
-            rx = VECTOR_BLENDV(rx, vx, m);
-            ry = VECTOR_BLENDV(ry, vy, m);
-            min_res = VECTOR_MIN(min_res, res);
-        }
-    }
-    *resx = rx;
-    *resy = ry;
+    // Finds the same point as scanning every point of the grid.
+    minres_search(ax, ay, r, num_anchors, width, height, 1, resx, resy);
 }
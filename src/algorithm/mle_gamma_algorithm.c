@@ -47,9 +47,8 @@
 
 #include <assert.h>
 
-#include <gsl/gsl_multimin.h>
-
 #include "algorithm/nllsq_algorithm.c"
+#include "util/util_lm.c"
 
 #ifndef MLE_GAMMA_DEFAULT_SHAPE
 #define MLE_GAMMA_DEFAULT_SHAPE 3.0
@@ -71,125 +70,97 @@
 #define MLE_GAMMA_DEFAULT_ITERATIONS 100
 #endif
 
-static double mle_gamma_shape      = MLE_GAMMA_DEFAULT_SHAPE;
-static double mle_gamma_rate       = MLE_GAMMA_DEFAULT_RATE;
-static double mle_gamma_offset     = MLE_GAMMA_DEFAULT_OFFSET;
-static double mle_gamma_epsilon    = MLE_GAMMA_DEFAULT_EPSILON;
-static    int mle_gamma_iterations = MLE_GAMMA_DEFAULT_ITERATIONS;
+typedef struct mle_gamma_params_t {
+    double shape;
+    double rate;
+    double offset;
+    double epsilon;
+    int iterations;
+} mle_gamma_params_t;
+
+static mle_gamma_params_t mle_gamma_defaults = {
+    .shape = MLE_GAMMA_DEFAULT_SHAPE,
+    .rate = MLE_GAMMA_DEFAULT_RATE,
+    .offset = MLE_GAMMA_DEFAULT_OFFSET,
+    .epsilon = MLE_GAMMA_DEFAULT_EPSILON,
+    .iterations = MLE_GAMMA_DEFAULT_ITERATIONS
+};
+
+static __thread mle_gamma_params_t *mle_gamma_params = &mle_gamma_defaults;
 
 
 #if HAVE_POPT_H
 struct poptOption mle_gamma_arguments[] = {
         { "mle-gamma-rate", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gamma_rate, 0,
+          &mle_gamma_defaults.rate, 0,
           "rate of the gamma distribution", NULL },
         { "mle-gamma-shape", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gamma_shape, 0,
+          &mle_gamma_defaults.shape, 0,
           "shape of the gamma distribution", NULL },
         { "mle-gamma-offset", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gamma_offset, 0,
+          &mle_gamma_defaults.offset, 0,
           "offset to the gamma distribution", NULL },
         { "mle-gamma-epsilon", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gamma_epsilon, 0,
-          "maximum size of the simplex for termination", NULL },
+          &mle_gamma_defaults.epsilon, 0,
+          "norm of the gradient for termination", NULL },
         { "mle-gamma-iterations", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gamma_iterations, 0,
+          &mle_gamma_defaults.iterations, 0,
           "maximum number of iterations before termination", NULL },
         POPT_TABLEEND
 };
 #endif
 
 
-struct mle_gamma_point2d {
-    double x;
-    double y;
-};
-
 /* This structure holds the parameters to the likelihood function. */
-struct mle_gamma_params {
-    struct mle_gamma_point2d *anchors;
-    double *ranges;
+struct mle_gamma_problem {
+    const VECTOR *anchor_x, *anchor_y, *ranges;
     size_t no_anchors;
-    double gammaval;
-    double factor;
+    VECTOR shape, rate, offset;
 };
 
 
-static double
-__attribute__((__nonnull__,__flatten__))
-mle_gamma_likelihood_function(const gsl_vector *restrict X, void *restrict params)
-{
-    double result = 0.0;
-    const struct mle_gamma_params *const p = params;
-    const double thetaX = gsl_vector_get(X, 0);
-    const double thetaY = gsl_vector_get(X, 1);
-
-    for (size_t j = 0; j < p->no_anchors; j++) {
-        const double d = distance_sf(thetaX, thetaY, p->anchors[j].x, p->anchors[j].y);
-        const double Z = p->ranges[j] + mle_gamma_offset - d;
-        if (__builtin_expect(Z <= 0.0, 0)) {
-            result = INFINITY; // If a measurement is too short, return this.
-            break;
-        }
-        const double likelihood =
-            log(p->factor * pow(Z, mle_gamma_shape - 1.0)) - mle_gamma_rate * Z;
-        result -= likelihood;
-    }
-#if !defined(NDEBUG)
-    fprintf(stderr, "f(%f, %f) = %f\n", thetaX, thetaY, result);
-#endif
-    return result;
-}
-
-
-
-static void
-__attribute__((__nonnull__,__flatten__))
-mle_gamma_likelihood_gradient(const gsl_vector *restrict X, void *restrict params,
-                              gsl_vector *restrict g)
+/*
+ * The negative log-likelihood without its constant terms.  With the
+ * unit vector u from an anchor to theta and Z = z + offset - d for a
+ * range z, every anchor contributes rate Z - (shape - 1) log Z to it,
+ * c u to its gradient with c = (shape - 1) / Z - rate, and
+ * (shape - 1) / Z^2 u u' + c (I - u u') / d to its Hessian.  It is not
+ * defined if any Z is not positive.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+mle_gamma_likelihood(const VECTOR x, const VECTOR y,
+                     const void *restrict params, struct lm2_point *restrict p)
 {
-    const struct mle_gamma_params *const p = params;
-    const double thetaX = gsl_vector_get(X, 0);
-    const double thetaY = gsl_vector_get(X, 1);
-    double gradX = 0.0, gradY = 0.0;
-
-    for (size_t j = 0; j < p->no_anchors; j++) {
-        if (thetaX != p->anchors[j].x && thetaY != p->anchors[j].y) {
-            const double d2 = distance_squared_sf(thetaX, thetaY, p->anchors[j].x, p->anchors[j].y);
-            const double d = sqrt(d2);
-            const double Z = p->ranges[j] + mle_gamma_offset - d;
-
-            if (__builtin_expect(Z <= 0, 0)) {
-                /* If this is the case, the initial guess does not have
-                   a likelihood associated to it. */
-                gradX = NAN;
-                gradY = NAN;
-                break;
-            }
-            const double t =
-                (mle_gamma_rate * (d - Z - mle_gamma_offset) + mle_gamma_shape - 1.0) /
-                (d * (d - Z - mle_gamma_offset));
-            gradX -= (thetaX -  p->anchors[j].x) * t;
-            gradY -= (thetaY -  p->anchors[j].y) * t;
-        } // TODO: Otherwise the value of the gradient component is 0?
+    const struct mle_gamma_problem *const mp = params;
+    const VECTOR nearest = VECTOR_BROADCASTF(1e-6f);
+    const VECTOR k = mp->shape - one;
+    VECTOR f = zero, gx = zero, gy = zero;
+    VECTOR hxx = zero, hxy = zero, hyy = zero, undefined = zero;
+
+    for (size_t j = 0; j < mp->no_anchors; j++) {
+        const VECTOR dx = x - mp->anchor_x[j], dy = y - mp->anchor_y[j];
+        const VECTOR d = VECTOR_MAX(VECTOR_SQRT(dx * dx + dy * dy), nearest);
+        const VECTOR ux = dx / d, uy = dy / d;
+        const VECTOR Z = mp->ranges[j] + mp->offset - d;
+        undefined = VECTOR_OR(undefined, VECTOR_LE(Z, zero));
+        const VECTOR z = VECTOR_MAX(Z, nearest);
+        const VECTOR c = k / z - mp->rate;
+        const VECTOR w = c / d;
+        const VECTOR v = k / (z * z) - w;
+        f += mp->rate * z - k * VECTOR_LOG(z);
+        gx += c * ux;
+        gy += c * uy;
+        hxx += v * ux * ux + w;
+        hxy += v * ux * uy;
+        hyy += v * uy * uy + w;
     }
-#if !defined(NDEBUG)
-    fprintf(stderr, "df(%f, %f) = (%f, %f)\n", thetaX, thetaY, gradX, gradY);
-#endif
-    gsl_vector_set(g, 0, gradX);
-    gsl_vector_set(g, 1, gradY);
-}
-
-
-
-
-static void
-__attribute__((__nonnull__,__flatten__,__hot__,__used__))
-mle_gamma_likelihood_fdf(const gsl_vector *X, void *restrict params,
-                         double *restrict y, gsl_vector *restrict g)
-{
-    *y = mle_gamma_likelihood_function(X, params);
-    mle_gamma_likelihood_gradient(X, params, g);
+    p->f = VECTOR_BLENDV(f, VECTOR_BROADCASTF(FLT_MAX), undefined);
+    p->gx = gx;
+    p->gy = gy;
+    p->hxx = hxx;
+    p->hxy = hxy;
+    p->hyy = hyy;
 }
 
 
@@ -202,96 +173,29 @@ mle_gamma_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
               int height __attribute__((__unused__)),
               VECTOR *restrict resx, VECTOR *restrict resy)
 {
-    /* Step 0: Set up the likelihood function. */
-    struct mle_gamma_params p;
-    struct mle_gamma_point2d anchors[no_anchors];
-    double ranges[no_anchors];
-    p.no_anchors = no_anchors;
-    p.anchors = anchors;
-    for (size_t i = 0; i < no_anchors; i++) {
-        p.anchors[i].x = vx[i][0];
-        p.anchors[i].y = vy[i][0];
-    }
-    p.ranges = ranges;
-    p.gammaval = tgamma(mle_gamma_shape);
-    p.factor = pow(mle_gamma_rate, mle_gamma_shape) / p.gammaval;
-
-    gsl_multimin_function_fdf fdf;
-    fdf.n = 2u;
-    fdf.f = &mle_gamma_likelihood_function;
-    fdf.df = &mle_gamma_likelihood_gradient;
-    fdf.fdf = &mle_gamma_likelihood_fdf;
-    fdf.params = &p;
-
-    
-
-    /* Step: Call the optimiser. */
-    const gsl_multimin_fdfminimizer_type *T =
-        gsl_multimin_fdfminimizer_vector_bfgs2;
-    gsl_multimin_fdfminimizer *s = gsl_multimin_fdfminimizer_alloc(T, 2);
+    const mle_gamma_params_t *o = mle_gamma_params;
 
-    gsl_vector *x = gsl_vector_alloc(2);
-
-    VECTOR sx, sy;
-
-    // Calculate the initial guess.
-    nllsq_run(vx, vy, r, no_anchors, width, height, &sx, &sy);
-
-    for (int i = 0; i < VECTOR_OPS; i++) {
-        /* Step 2a: Check whether the initial guess can be used. */
-        if (__builtin_expect(isnan(sx[i]) || isnan(sy[i]), 0)) {
-#if !defined(NDEBUG)
-            fprintf(stderr, "initial guess is (%f, %f)\n", sx[i], sy[i]);
-#endif
-            (*resx)[i] = NAN;
-            (*resy)[i] = NAN;
-            continue;
-        }
-
-        /* Step 2b: Initialize the parameters. */
-        for (size_t j = 0; j < no_anchors; j++) {
-            p.ranges[j] = r[j][i];
-        }
-            
-        gsl_vector_set(x, 0, sx[i]);
-        gsl_vector_set(x, 1, sy[i]);
-
-        /* Step 2c: Check for the validity of the likelihood value. */
-        double likelihood = mle_gamma_likelihood_function(x, &p);
-#if !defined(NDEBUG)
-        fprintf(stderr, "likelihood = %f\n", likelihood);
-#endif
-        if (__builtin_expect(isinf(likelihood), 0)) {
-            /* If this is the case, the initial guess does not have
-               a likelihood associated to it. We set the estimated coordinate
-               to an undefined value and continue. */
-            (*resx)[i] = NAN;
-            (*resy)[i] = NAN;
-            continue;
-        }
-
-        /* Step 2d: Iterate the minimization algorithm. */
-        int iter = 0;
-        int status;
-        gsl_multimin_fdfminimizer_set(s, &fdf, x, 1e-2, 1e-4);
-
-        do {
-            iter++;
-            status = gsl_multimin_fdfminimizer_iterate(s);
-            if (__builtin_expect(status, 0)) // Not zero if there was an error.
-                break;
-            status =
-                gsl_multimin_test_gradient (s->gradient, mle_gamma_epsilon);
-        } while (status == GSL_CONTINUE && iter < mle_gamma_iterations);
-
-        /* Step 2c: Store the result. */
-        (*resx)[i] = (float) gsl_vector_get(s->x, 0);
-        (*resy)[i] = (float) gsl_vector_get(s->x, 1);
-    }
-
-    /* Step 3: Clean up. */
-    gsl_multimin_fdfminimizer_free(s);
-    gsl_vector_free(x);
+    /* Step 0: Set up the likelihood function. */
+    const struct mle_gamma_problem p = {
+        .anchor_x = vx, .anchor_y = vy, .ranges = r,
+        .no_anchors = no_anchors,
+        .shape = VECTOR_BROADCASTF((float) o->shape),
+        .rate = VECTOR_BROADCASTF((float) o->rate),
+        .offset = VECTOR_BROADCASTF((float) o->offset)
+    };
+
+    /* Step 1: Calculate the initial guess. */
+    nllsq_run(vx, vy, r, no_anchors, width, height, resx, resy);
+
+    /* Step 2: Call the optimiser on all lanes at once.  Lanes whose
+       initial guess is undefined or has no likelihood associated to it
+       get an undefined estimate. */
+    const VECTOR f = lm2_minimise(mle_gamma_likelihood, &p, resx, resy,
+                                  VECTOR_ONES(), (float) o->epsilon,
+                                  o->iterations);
+    const VECTOR defined = VECTOR_LT(f, VECTOR_BROADCASTF(FLT_MAX));
+    *resx = VECTOR_BLENDV(VECTOR_BROADCASTF(NAN), *resx, defined);
+    *resy = VECTOR_BLENDV(VECTOR_BROADCASTF(NAN), *resy, defined);
 }
 
 #endif
@@ -46,9 +46,9 @@
 #endif
 
 #include <assert.h>
-#include <gsl/gsl_multimin.h>
 
 #include "algorithm/nllsq_algorithm.c"
+#include "util/util_lm.c"
 
 #ifndef MLE_GAUSS_DEFAULT_MEAN
 #define MLE_GAUSS_DEFAULT_MEAN 50.0
@@ -66,116 +66,85 @@
 #define MLE_GAUSS_DEFAULT_ITERATIONS 100
 #endif
 
-static double mle_gauss_mean       = MLE_GAUSS_DEFAULT_MEAN;
-static double mle_gauss_deviation  = MLE_GAUSS_DEFAULT_DEVIATION;
-static double mle_gauss_epsilon    = MLE_GAUSS_DEFAULT_EPSILON;
-static    int mle_gauss_iterations = MLE_GAUSS_DEFAULT_ITERATIONS;
+typedef struct mle_gauss_params_t {
+    double mean;
+    double deviation;
+    double epsilon;
+    int iterations;
+} mle_gauss_params_t;
+
+static mle_gauss_params_t mle_gauss_defaults = {
+    .mean = MLE_GAUSS_DEFAULT_MEAN,
+    .deviation = MLE_GAUSS_DEFAULT_DEVIATION,
+    .epsilon = MLE_GAUSS_DEFAULT_EPSILON,
+    .iterations = MLE_GAUSS_DEFAULT_ITERATIONS
+};
+
+static __thread mle_gauss_params_t *mle_gauss_params = &mle_gauss_defaults;
 
 #if HAVE_POPT_H
 struct poptOption mle_gauss_arguments[] = {
         { "mle-gauss-deviation", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gauss_deviation, 0,
+          &mle_gauss_defaults.deviation, 0,
           "deviation of the gauss distribution", NULL },
         { "mle-gauss-mean", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gauss_mean, 0,
+          &mle_gauss_defaults.mean, 0,
           "mean of the gauss distribution", NULL },
         { "mle-gauss-epsilon", 0, POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gauss_epsilon, 0,
-          "maximum size of the simplex for termination", NULL },
+          &mle_gauss_defaults.epsilon, 0,
+          "norm of the gradient for termination", NULL },
         { "mle-gauss-iterations", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &mle_gauss_iterations, 0,
+          &mle_gauss_defaults.iterations, 0,
           "maximum number of iterations before termination", NULL },
         POPT_TABLEEND
 };
 #endif
 
 
-struct mle_gauss_point2d {
-    double x;
-    double y;
-};
-
 /* This structure holds the parameters to the likelihood function. */
-struct mle_gauss_params {
-    struct mle_gauss_point2d *anchors;
-    double *ranges;
+struct mle_gauss_problem {
+    const VECTOR *anchor_x, *anchor_y, *ranges;
     size_t no_anchors;
+    VECTOR mean, variance;
 };
 
 
-static double
-__attribute__((__nonnull__,__flatten__))
-mle_gauss_likelihood_function(const gsl_vector *X, void *restrict params)
-{
-    double result = 0.0;
-    const struct mle_gauss_params *const p = params;
-    const double mean2 = mle_gauss_mean * mle_gauss_mean;
-    const double variance = mle_gauss_deviation * mle_gauss_deviation;
-    const double thetaX = gsl_vector_get(X, 0);
-    const double thetaY = gsl_vector_get(X, 1);
-
-    for (size_t j = 0; j < p->no_anchors; j++) {
-        const double d2 =
-            distance_squared_sf(thetaX, thetaY, p->anchors[j].x, p->anchors[j].y);
-        const double d = sqrt(d2);
-        const double z = p->ranges[j];
-        double logProbability = z * z ;
-        logProbability += (-2 * mle_gauss_mean - 2 * d) * z;
-        logProbability += variance * log(M_PI);
-        logProbability += mean2;
-        logProbability += 2 * d * mle_gauss_mean;
-        logProbability += 2 * variance * log(mle_gauss_deviation); 
-        logProbability += log(2) * mle_gauss_deviation;
-        logProbability += d2; 
-        logProbability /= 2 * variance;
-        result += logProbability;
-    }
-    return result;
-}
-
-
-
-
-
-static void
-__attribute__((__nonnull__,__flatten__))
-mle_gauss_likelihood_gradient(const gsl_vector *X, void *restrict params,
-                              gsl_vector *restrict g)
+/*
+ * The negative log-likelihood without its constant terms.  With the
+ * unit vector u from an anchor to theta and the error e = d + mean - z
+ * of a range z, every anchor contributes e^2 / (2 var) to it, e u / var
+ * to its gradient, and (u u' + e (I - u u') / d) / var to its Hessian.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+mle_gauss_likelihood(const VECTOR x, const VECTOR y,
+                     const void *restrict params, struct lm2_point *restrict p)
 {
-    const struct mle_gauss_params *const p = params;
-    const double variance = mle_gauss_deviation * mle_gauss_deviation;
-    const double thetaX = gsl_vector_get(X, 0);
-    const double thetaY = gsl_vector_get(X, 1);
-    double gradX = 0.0, gradY = 0.0;
-
-    for (size_t j = 0; j < p->no_anchors; j++) {
-        const double d2 =
-            distance_squared_sf(thetaX, thetaY, p->anchors[j].x, p->anchors[j].y);
-        const double d = sqrt(d2);
-        const double z = p->ranges[j];
-        double x = ((2 * mle_gauss_mean * (thetaX - p->anchors[j].x) -
-                     2 * z * (thetaX - p->anchors[j].x)) / d +
-                    2 * (thetaX - p->anchors[j].x)) / (2 * variance);
-        double y = ((2 * mle_gauss_mean * (thetaY - p->anchors[j].y) -
-                     2 * z * (thetaY - p->anchors[j].y)) / d +
-                    2 * (thetaY - p->anchors[j].y)) / (2 * variance);
-        gradX += x;
-        gradY += y;
+    const struct mle_gauss_problem *const mp = params;
+    const VECTOR nearest = VECTOR_BROADCASTF(1e-6f);
+    VECTOR f = VECTOR_ZERO(), gx = VECTOR_ZERO(), gy = VECTOR_ZERO();
+    VECTOR hxx = VECTOR_ZERO(), hxy = VECTOR_ZERO(), hyy = VECTOR_ZERO();
+
+    for (size_t j = 0; j < mp->no_anchors; j++) {
+        const VECTOR dx = x - mp->anchor_x[j], dy = y - mp->anchor_y[j];
+        const VECTOR d = VECTOR_MAX(VECTOR_SQRT(dx * dx + dy * dy), nearest);
+        const VECTOR ux = dx / d, uy = dy / d;
+        const VECTOR e = d + mp->mean - mp->ranges[j];
+        const VECTOR w = e / d;
+        f += e * e;
+        gx += e * ux;
+        gy += e * uy;
+        hxx += ux * ux + w * (one - ux * ux);
+        hxy += ux * uy * (one - w);
+        hyy += uy * uy + w * (one - uy * uy);
     }
-    gsl_vector_set(g, 0, gradX);
-    gsl_vector_set(g, 1, gradY);
-}
-
-
-
-
-static void
-__attribute__((__nonnull__,__flatten__,__hot__))
-mle_gauss_likelihood_fdf(const gsl_vector *X, void *restrict params,
-                         double *restrict y, gsl_vector *restrict g)
-{
-    *y = mle_gauss_likelihood_function(X, params);
-    mle_gauss_likelihood_gradient(X, params, g);
+    const VECTOR s = one / mp->variance;
+    p->f = f * s * VECTOR_BROADCASTF(0.5f);
+    p->gx = gx * s;
+    p->gy = gy * s;
+    p->hxx = hxx * s;
+    p->hxy = hxy * s;
+    p->hyy = hyy * s;
 }
 
 
@@ -187,66 +156,22 @@ mle_gauss_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
               size_t no_anchors, int width, int height,
               VECTOR *restrict resx, VECTOR *restrict resy)
 {
-    /* Step 0: Set up the likelihood function. */
-    struct mle_gauss_params p;
-    struct mle_gauss_point2d anchors[no_anchors];
-    double ranges[no_anchors];
-    p.no_anchors = no_anchors;
-    p.anchors = anchors;
-    for (size_t i = 0; i < no_anchors; i++) {
-        p.anchors[i].x = vx[i][0];
-        p.anchors[i].y = vy[i][0];
-    }
-    p.ranges = ranges;
+    const mle_gauss_params_t *o = mle_gauss_params;
 
-    gsl_multimin_function_fdf fdf;
-    fdf.n = 2u;
-    fdf.f = &mle_gauss_likelihood_function;
-    fdf.df = &mle_gauss_likelihood_gradient;
-    fdf.fdf = &mle_gauss_likelihood_fdf;
-    fdf.params = (void*) &p;
+    /* Step 0: Set up the likelihood function. */
+    const struct mle_gauss_problem p = {
+        .anchor_x = vx, .anchor_y = vy, .ranges = r,
+        .no_anchors = no_anchors,
+        .mean = VECTOR_BROADCASTF((float) o->mean),
+        .variance = VECTOR_BROADCASTF((float) (o->deviation * o->deviation))
+    };
 
     /* Step 1: Calculate an initial estimate. */
-    VECTOR sx, sy;
-    nllsq_run(vx, vy, r, no_anchors, width, height, &sx, &sy);
-
-    /* Step 2: Call the optimiser. */
-    const gsl_multimin_fdfminimizer_type *T = gsl_multimin_fdfminimizer_vector_bfgs2;
-    gsl_multimin_fdfminimizer *s = gsl_multimin_fdfminimizer_alloc(T, 2);
-    gsl_vector *x;
-    x = gsl_vector_alloc(2);
-    
-    for (int i = 0; i < VECTOR_OPS; i++) {
-        /* Step 2a: Initialize the parameters. */
-        for (size_t j = 0; j < no_anchors; j++) {
-            p.ranges[j] = r[j][i];
-        }
-        gsl_vector_set(x, 0, sx[i]);
-        gsl_vector_set(x, 1, sy[i]);
-
-        int iter = 0;
-        int status;
-
-        gsl_multimin_fdfminimizer_set(s, &fdf, x, 1e-2, 1e-4);
-
-        /* Step 2b: Iterate the minimization algorithm. */
-        do {
-            iter++;
-            status = gsl_multimin_fdfminimizer_iterate(s);
-            if (__builtin_expect(status, 0))
-                break;
-            status =
-                gsl_multimin_test_gradient (s->gradient, mle_gauss_epsilon);
-        } while (status == GSL_CONTINUE && iter < mle_gauss_iterations);
-
-        /* Step 2c: Store the result. */
-        (*resx)[i] = (float) gsl_vector_get(s->x, 0);
-        (*resy)[i] = (float) gsl_vector_get(s->x, 1);
-    }
+    nllsq_run(vx, vy, r, no_anchors, width, height, resx, resy);
 
-    /* Step 3: Clean up. */
-    gsl_multimin_fdfminimizer_free(s);
-    gsl_vector_free(x);
+    /* Step 2: Call the optimiser on all lanes at once. */
+    (void) lm2_minimise(mle_gauss_likelihood, &p, resx, resy, VECTOR_ONES(),
+                        (float) o->epsilon, o->iterations);
 }
 
 #endif
@@ -40,84 +40,104 @@
 
 #include "llsq_algorithm.c"
 
-static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-nllsq_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors,
-          int width, int height, VECTOR *restrict resx, VECTOR *restrict resy)
+/*! The squared error of the anchors selected by use. */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+nllsq_error(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+            const VECTOR *restrict use, size_t num_anchors,
+            const VECTOR ex, const VECTOR ey)
 {
-        float load = -1.0F;
-        *resx = VECTOR_BROADCAST(&load);
-        *resy = VECTOR_BROADCAST(&load);
+    VECTOR error = zero;
+    for (size_t i = 0; i < num_anchors; i++) {
+        const VECTOR residual =
+            VECTOR_AND(distance(vx[i], vy[i], ex, ey) - r[i], use[i]);
+        error += residual * residual;
+    }
+    return error;
+}
+
+
+/*!
+ * The nonlinear least squares of the anchors selected by use, for every
+ * lane separately.  A lane gets the same result as nllsq_run() of its
+ * selected anchors alone: the rows which are not selected add exact
+ * zeros, and nllsq_run() selects all rows, so that both do the same
+ * arithmetic.  Otherwise -ffast-math may round them differently, and the
+ * iteration of an ill-conditioned lane, which stops once its error
+ * decreases by less than epsilon, may stop elsewhere.
+ */
+static inline void __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+nllsq_run_masked(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+                 const VECTOR *restrict use, size_t num_anchors,
+                 VECTOR *restrict resx, VECTOR *restrict resy)
+{
+        const VECTOR epsilon = VECTOR_BROADCASTF(0.000001F);
         // Starting point of optimization
         VECTOR s0x;
         VECTOR s0y;
+        // Lanes which have converged, their result is in resx, resy.
+        VECTOR done = zero;
 
         // 1a. Set starting point of optimization to linear least squares result
-        llsq_run (vx, vy, r, num_anchors, width, height, &s0x, &s0y);
-        
-        VECTOR e0, e1;
-        int iterations = 0;
-        float epsilon = 0.000001F;
-        VECTOR r0x;
-        VECTOR r0y;
-
-        do {
-            // initial squared error
-            e0 = calculate_residual_error(num_anchors, vx,vy,r,s0x,s0y);
-
-            // 2. Solve equation of form A*x = b, A is A.length x 2
-            VECTOR b[num_anchors*1];
-            VECTOR a[num_anchors*2];
+        llsq_run_masked(vx, vy, r, use, num_anchors, &s0x, &s0y);
+
+        // initial squared error
+        VECTOR e0 = nllsq_error(vx, vy, r, use, num_anchors, s0x, s0y);
+        *resx = s0x;
+        *resy = s0y;
+
+        for (int iterations = 0; iterations <= 100; iterations++) {
+            // 2. Solve equation of form A*x = b, A is num_anchors x 2,
+            // with the closed form solution x = (A^T*A)^-1 * A^T * b,
+            // accumulating A^T*A and A^T*b row by row.
+            VECTOR sxx = zero, sxy = zero, syy = zero, bx = zero, by = zero;
             for (size_t i = 0; i < num_anchors; i++) {
-                VECTOR dist = distance(s0x,s0y,vx[i],vy[i]);
-                a[i*2+0] = (s0x - vx[i]) / dist;
-                a[i*2+1] = (s0y - vy[i]) / dist;
-                b[i*1+0] = (r[i] - dist) + (a[i*2+0] * s0x + a[i*2+1] * s0y);
+                const VECTOR dist = distance(s0x, s0y, vx[i], vy[i]);
+                // A zero row adds nothing.
+                const VECTOR ax = VECTOR_AND((s0x - vx[i]) / dist, use[i]);
+                const VECTOR ay = VECTOR_AND((s0y - vy[i]) / dist, use[i]);
+                const VECTOR b = (r[i] - dist) + (ax * s0x + ay * s0y);
+                sxx += ax * ax;
+                sxy += ax * ay;
+                syy += ay * ay;
+                bx += ax * b;
+                by += ay * b;
             }
-
-            // Solve with closed form solution: x = (A^T*A)^-1 * A^T * b
-            VECTOR mAT[2*num_anchors];
-            VECTOR tmp[2*num_anchors];
-            VECTOR tmp2[2*2];
-            VECTOR tmp3[2*2];
-            VECTOR tmp4[2*1];
-     
-            transpose(a,mAT,num_anchors,2);       
-            times(mAT,2,num_anchors,a,2,tmp2);
-            invert_2x2(tmp2,tmp3);
-            times(tmp3,2,2,mAT,num_anchors,tmp);        
-            times(tmp,2,num_anchors,b,1,tmp4);
-
-            r0x = tmp4[0];
-            r0y = tmp4[1];
+            VECTOR r0x, r0y;
+            solve_normal_2x2(sxx, sxy, syy, bx, by, &r0x, &r0y);
 
             // new squared error
-            e1 = calculate_residual_error(num_anchors, vx,vy,r,r0x,r0y);
-            VECTOR temp = e0 - e1;
-
-            int br=1;
-            for (int i=0; i < VECTOR_OPS; i++){
-                if ((*resx)[i] == -1.0f) {
-                    br = 0;
-                    if (temp[i] < epsilon){
-                        (*resx)[i] = r0x[i];
-                        (*resy)[i] = r0y[i];
-                    }        
-                }
-            }
-            if (br) break;
-            
+            const VECTOR e1 =
+                nllsq_error(vx, vy, r, use, num_anchors, r0x, r0y);
+
+            // Lanes whose error decreases by less than epsilon are done.
+            const VECTOR stop = VECTOR_ANDNOT(done, VECTOR_LT(e0 - e1, epsilon));
+            *resx = VECTOR_BLENDV(*resx, r0x, stop);
+            *resy = VECTOR_BLENDV(*resy, r0y, stop);
+            done = VECTOR_OR(done, stop);
+            if (VECTOR_TEST_ALL_ONES(done))
+                return;
+
             // Set refined position for next step
             s0x = r0x;
             s0y = r0y;
-            iterations++;
-
-        } while (iterations <= 100);
-        for (int i=0; i < VECTOR_OPS; i++){
-            if ((*resx)[i] == -1.0F) {
-                 (*resx)[i] = s0x[i];
-                 (*resy)[i] = s0y[i];      
-            }           
+            e0 = e1;
         }
+        *resx = VECTOR_BLENDV(s0x, *resx, done);
+        *resy = VECTOR_BLENDV(s0y, *resy, done);
+}
+
+
+static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+nllsq_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors,
+          int width __attribute__((__unused__)),
+          int height __attribute__((__unused__)),
+          VECTOR *restrict resx, VECTOR *restrict resy)
+{
+        VECTOR use[num_anchors];
+        for (size_t i = 0; i < num_anchors; i++)
+            use[i] = VECTOR_ONES();
+        nllsq_run_masked(vx, vy, r, use, num_anchors, resx, resy);
 }
 
 #endif
@@ -35,29 +35,60 @@
 /* @algorithm_name: Residual-Bruteforce*/
 
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-res_bruteforce_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy) {
-    float min_res;
-    int minres_x = 0.0,minres_y = 0.0;
-   
-    int x,y,a,i;
-    for (i=0;i<VECTOR_OPS;i++) {
-        min_res = FLT_MAX;
-        for (y=0;y<250;y++){
-            for (x=0;x<250;x++){
-                float res = 0;
-                float d = 0;
-                for (a=0; a < (int)num_anchors; a++) {
-                    d =  sqrtf(((float)x-vx[a][i])*((float)x-vx[a][i])+((float)y-vy[a][i])*((float)y-vy[a][i])) - r[a][i];
-                    res += d*d;
-                } 
-                if (res < min_res) {
-                    min_res = res;
-                    minres_x = x;
-                    minres_y = y;
+res_bruteforce_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width, int height, VECTOR *restrict resx, VECTOR *restrict resy) {
+    // The grid is swept once, VECTOR_OPS candidates at a time, and every
+    // lane keeps its best candidate per slot of the vector.
+    VECTOR ax[VECTOR_OPS][num_anchors], ay[VECTOR_OPS][num_anchors],
+           ar[VECTOR_OPS][num_anchors];
+    VECTOR min_res[VECTOR_OPS], min_x[VECTOR_OPS], min_y[VECTOR_OPS];
+    VECTOR offset = VECTOR_ZERO();
+    const VECTOR right = VECTOR_BROADCASTF((float) width);
+    const VECTOR none = VECTOR_BROADCASTF(FLT_MAX);
+
+    for (int i = 0; i < VECTOR_OPS; i++) {
+        for (size_t a = 0; a < num_anchors; a++) {
+            ax[i][a] = VECTOR_BROADCASTF(vx[a][i]);
+            ay[i][a] = VECTOR_BROADCASTF(vy[a][i]);
+            ar[i][a] = VECTOR_BROADCASTF(r[a][i]);
+        }
+        min_res[i] = none;
+        min_x[i] = VECTOR_ZERO();
+        min_y[i] = VECTOR_ZERO();
+        offset[i] = (float) i;
+    }
+    for (int y = 0; y < height; y++) {
+        const VECTOR cy = VECTOR_BROADCASTF((float) y);
+        for (int x = 0; x < width; x += VECTOR_OPS) {
+            const VECTOR cx = VECTOR_BROADCASTF((float) x) + offset;
+            const VECTOR inside = VECTOR_LT(cx, right);
+            for (int i = 0; i < VECTOR_OPS; i++) {
+                VECTOR res = VECTOR_ZERO();
+                for (size_t a = 0; a < num_anchors; a++) {
+                    const VECTOR d = distance(cx, cy, ax[i][a], ay[i][a]) -
+                        ar[i][a];
+                    res += d * d;
                 }
+                res = VECTOR_BLENDV(none, res, inside);
+                const VECTOR m = VECTOR_GT(min_res[i], res);
+                min_x[i] = VECTOR_BLENDV(min_x[i], cx, m);
+                min_y[i] = VECTOR_BLENDV(min_y[i], cy, m);
+                min_res[i] = VECTOR_MIN(min_res[i], res);
+            }
+        }
+    }
+    // Pick the best slot; on equal residuals the one scanned first.
+    for (int i = 0; i < VECTOR_OPS; i++) {
+        float best = FLT_MAX, bx = 0.0f, by = 0.0f;
+        for (int j = 0; j < VECTOR_OPS; j++) {
+            if (min_res[i][j] < best ||
+                (min_res[i][j] == best && best < FLT_MAX &&
+                 (min_y[i][j] < by || (min_y[i][j] == by && min_x[i][j] < bx)))) {
+                best = min_res[i][j];
+                bx = min_x[i][j];
+                by = min_y[i][j];
             }
         }
-        (*resx)[i] = (float)minres_x;
-        (*resy)[i] = (float)minres_y;   
+        (*resx)[i] = bx;
+        (*resy)[i] = by;
     }
 }
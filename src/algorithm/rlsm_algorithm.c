@@ -45,165 +45,128 @@
 #  include <popt.h>
 #endif
 
+#include <assert.h>
 #include "util/util_math.c"
 #include "util/util_median.c"
 #include "util/util_points.c"
+#include "util/util_vpoints.c"
 #include "algorithm/nllsq_algorithm.c"
 
 
-static inline int
-__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
-toIndex(int row, int col, size_t N)
+typedef struct rlsm_params_t {
+    /*! The subsets of rlsm_setup(). */
+    ls2_subsets_t subsets;
+} rlsm_params_t;
+
+static rlsm_params_t rlsm_defaults;
+
+static __thread rlsm_params_t *rlsm_params = &rlsm_defaults;
+
+
+/*! Release the subsets of rlsm_setup(). */
+static void __attribute__((__unused__))
+rlsm_params_free(rlsm_params_t *params)
 {
-    assert(row != col);
-    int idx = -1;
-    if (row < col) {
-        idx = row * ((int)N-1) - (row-1) * ((row-1) + 1)/2 + col - row - 1;
-    } else if (col < row) {
-        idx = col * ((int)N-1) - (col-1) * ((col-1) + 1)/2 + row - col - 1;
-    }
-    return idx;
+    ls2_subsets_free(&params->subsets);
 }
 
-static inline size_t
-__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
-robust_filter(size_t const count ,float *restrict resx,float *restrict resy)
+
+/*!
+ * Build the table of the subsets of at least three anchors, of which RLSM
+ * computes the intermediate positions.
+ */
+static void
+rlsm_setup(const vector2 *anchors __attribute__((__unused__)), size_t nanchors)
 {
-    assert (count > 1);
-    const size_t N = count * (count - 1) / 2;
-    assert (N < INT_MAX);
-    float v[N];
-    for (int i = 0; i < (int)count - 1; i++) {
-        for (int j = i+1; j < (int)count; j++) {
-            const int idx = toIndex(i, j, count);
-            v[idx] = distance_s(resx[i], resy[i], resx[j], resy[j]);
-        }
-    }
+    ls2_subsets_init(&rlsm_params->subsets, nanchors, 3, (int) nanchors);
+}
 
-    const float MEDV = 2.0f * fmedian_s(N, v);
-    float filtered_x[count];
-    float filtered_y[count];
-    size_t filtered_count = 0;
-    for (int i = 0; i < (int) count; i++) {
-        size_t dropCounter = 0;
-        for (int j = 0; j < (int) count; j++) {
-            if (i == j) {
-                continue;
-            }
-            float const dist = v[toIndex(i, j, count)];
-            if (dist >= MEDV) {
-                dropCounter++;
-            }
-        }
-        if (dropCounter <= count/2) {
-            filtered_x[filtered_count] = resx[i];
-            filtered_y[filtered_count] = resy[i];
-            filtered_count++;
-        }
-    }
-    assert(filtered_count > 0);
-    memcpy(resx,filtered_x,sizeof(float) * filtered_count);
-    memcpy(resy,filtered_y,sizeof(float) * filtered_count);
-    return filtered_count;
-}    
+/* ls2_context_setup() of a STAND_ALONE build calls rlsm_setup(). */
+#define ALGORITHM_HAS_SETUP 1
 
 
+/*!
+ * RLSM of all lanes at once.  The intermediate positions of a combination
+ * of anchors in rlsm_subsets are computed for all lanes by a single
+ * llsq_run(), the undefined ones are masked out.
+ */
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
 rlsm_run(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
-         size_t no_anchors,
+         size_t no_anchors __attribute__((__unused__)),
          int width __attribute__((__unused__)),
          int height __attribute__((__unused__)),
          VECTOR *restrict resx, VECTOR *restrict resy)
 {
-    const int s = 3;
-    const int M = (int)no_anchors;
-    
-    for (int ii = 0; ii < VECTOR_OPS; ii++) {
-        // calculate all k-permutations for k = s to 
-        size_t int_count = 0;
-        int ccount = 0;
-        for (int k = s; k <= M; k++) {
-            ccount += binom(M, k);
-        }
-
-        float intermediatePositions_x[ccount];
-        float intermediatePositions_y[ccount];
-   
-        for (int k = s; k <= M; k++) {
-            int bino = binom(M, k);
-            int permutations[k];
-            VECTOR tmpRanges[k];
-            VECTOR tmpAnchors_x[k];
-            VECTOR tmpAnchors_y[k];
-            VECTOR tresx, tresy;
-            // initialisation for calculating k-permutations
-            for (int i = 0; i < k; i++) {
-                permutations[i] = i;
-            }
+    // The subsets are built by rlsm_setup() before the workers start.
+    assert(rlsm_params->subsets.n == no_anchors);
+    const size_t ccount = rlsm_params->subsets.count;
+    if (ccount == 0) {
+        *resx = *resy = VECTOR_BROADCASTF(NAN);
+        return;
+    }
 
-            // build all k-permutations
-            for (int i = 0; i < bino; i++) {
-
-                // calculate intermediate position estimate using non-linear
-                // least squares multilateration
-                for (int h = 0; h < k; h++) {
-                    tmpAnchors_x[h][i%VECTOR_OPS] = vx[permutations[h]][ii];
-                    tmpAnchors_y[h][i%VECTOR_OPS] = vy[permutations[h]][ii];
-                    tmpRanges[h][i%VECTOR_OPS] = r[permutations[h]][ii];
-                }
-
-                if (((i+1)%VECTOR_OPS)==VECTOR_OPS-1 || i == bino - 1){
-                    llsq_run(tmpAnchors_x, tmpAnchors_y, tmpRanges, (size_t)k, width, height, &tresx, &tresy);
-                    for (int jj=0; jj <= i%VECTOR_OPS; jj++){
-                        if (!isnan(tresy[jj]) && !isnan(tresx[jj])){
-                            intermediatePositions_x[int_count] = tresx[jj];
-                            intermediatePositions_y[int_count] = tresy[jj];
-                            int_count++;
-                        }
-                    }
-                }                
-
-                
-                // build next permutation
-                if (i == bino - 1) {
-                    break;
-                }
-                int j = k - 1;
-                while (j >= 0) {
-                    if (!incCounter(permutations, j, M, k)) {
-                        break;
-                    }
-                    j--;
-                }
-                for (int l = j+1; l < k; l++) {
-                    permutations[l] = permutations[l-1] + 1;
-                }
-            }
+    VECTOR intermediatePositions_x[ccount];
+    VECTOR intermediatePositions_y[ccount];
+    VECTOR weights[ccount];
+    VECTOR int_count = zero;
+
+    for (size_t c = 0; c < ccount; c++) {
+        const size_t k = rlsm_params->subsets.size[c];
+        VECTOR tmpRanges[k];
+        VECTOR tmpAnchors_x[k];
+        VECTOR tmpAnchors_y[k];
+
+        // calculate intermediate position estimate using linear
+        // least squares multilateration
+        for (size_t h = 0; h < k; h++) {
+            const int a = rlsm_params->subsets.anchor[c][h];
+            tmpAnchors_x[h] = vx[a];
+            tmpAnchors_y[h] = vy[a];
+            tmpRanges[h] = r[a];
         }
+        VECTOR tresx, tresy;
+        llsq_run(tmpAnchors_x, tmpAnchors_y, tmpRanges, k, width, height, &tresx, &tresy);
+        const VECTOR defined = VECTOR_AND(VECTOR_EQ(tresx, tresx),
+                                          VECTOR_EQ(tresy, tresy));
+        intermediatePositions_x[c] = tresx;
+        intermediatePositions_y[c] = tresy;
+        weights[c] = VECTOR_AND(one, defined);
+        int_count += weights[c];
+    }
 
-        float x_x = NAN;
-        float x_y = NAN;
-
-        // apply robust median filter to this array of intermediate
-        // position estimates
-        if (int_count > 1u) {
-            int_count = robust_filter(int_count, intermediatePositions_x, intermediatePositions_y);
+    // apply robust median filter to this array of intermediate
+    // position estimates, in lanes with more than one of them
+    VECTOR defined[ccount];
+    for (size_t i = 0; i < ccount; i++) {
+        defined[i] = VECTOR_GT(weights[i], zero);
+    }
+    const VECTOR MEDV = two * vmedian_pair_distance(intermediatePositions_x,
+                                                    intermediatePositions_y,
+                                                    defined, ccount);
+    const VECTOR filter = VECTOR_GT(int_count, one);
+    // dropCounter > count/2 of the integer division, for integral counts
+    const VECTOR limit = (int_count + one) * half;
+    for (size_t i = 0; i < ccount; i++) {
+        VECTOR dropCounter = zero;
+        for (size_t j = 0; j < ccount; j++) {
+            if (i == j) {
+                continue;
+            }
+            const VECTOR dist = distance(intermediatePositions_x[i],
+                                         intermediatePositions_y[i],
+                                         intermediatePositions_x[j],
+                                         intermediatePositions_y[j]);
+            dropCounter += VECTOR_AND(one, VECTOR_AND(defined[j],
+                                                     VECTOR_GE(dist, MEDV)));
         }
-        
-        float weights[int_count];
-        for (size_t jj = 0; jj < int_count; jj++) {
-	    weights[jj] = 1.0f;
-	}
-        // return geometric median as result
-        point_geometric_median((int) int_count, intermediatePositions_x,
-                       intermediatePositions_y,
-                       weights,
-                       &x_x, &x_y);
-     
-        (*resx)[ii] = x_x;
-        (*resy)[ii] = x_y;
+        const VECTOR drop = VECTOR_AND(filter, VECTOR_GE(dropCounter, limit));
+        weights[i] = VECTOR_ANDNOT(drop, weights[i]);
     }
+
+    // return geometric median as result
+    vgeometric_median(ccount, intermediatePositions_x,
+                      intermediatePositions_y, weights, resx, resy);
 }
 
 #endif
@@ -34,6 +34,52 @@
 
  /* @algorithm_name: Optimized Voting Based Location Estimation */
 
+/*
+ * The scores of the cells of the grid.  Every thread keeps its own array,
+ * which grows to the largest grid it has seen, instead of allocating one
+ * in every iteration of multilaterate().
+ */
+typedef struct vble_opt_state_t {
+    char *scores;
+    size_t size;
+} vble_opt_state_t;
+
+
+static void *
+vble_opt_thread_init(const vector2 *anchors __attribute__((__unused__)),
+                     size_t nanchors __attribute__((__unused__)))
+{
+    return calloc(1, sizeof(vble_opt_state_t));
+}
+
+
+static void
+vble_opt_thread_free(void *state)
+{
+    vble_opt_state_t *s = (vble_opt_state_t *) state;
+    if (s != NULL)
+        free(s->scores);
+    free(s);
+}
+
+
+/*! The scores of size cells, all zero, or NULL if out of memory. */
+static inline char *
+__attribute__((__nonnull__))
+vble_opt_scores(vble_opt_state_t *state, size_t size)
+{
+    if (size > state->size) {
+        char *scores = realloc(state->scores, size);
+        if (scores == NULL)
+            return NULL;
+        state->scores = scores;
+        state->size = size;
+    }
+    memset(state->scores, 0, size);
+    return state->scores;
+}
+
+
 /*
  * ivector_u is currently only available to SSE4.1 builds.
  */
@@ -271,8 +317,8 @@ multilaterate(anchor_info_t *anchors, size_t num_anchors,
 }
 
 
-static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-vble_opt_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy) {
+static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__(1,2,3,7,8),__artificial__))
+vble_opt_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy, void *state __attribute__((__unused__))) {
     if (num_anchors<3) {
         (*resx) = VECTOR_BROADCASTF(NAN);
         (*resy) = VECTOR_BROADCASTF(NAN);
@@ -342,7 +388,8 @@ vble_opt_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size
 }
 #else
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-multilaterate(const float* anchorsx, const float* anchorsy, const float* ranges,
+multilaterate(vble_opt_state_t *state,
+              const float* anchorsx, const float* anchorsy, const float* ranges,
               size_t num_anchors, float L, float last_L,
               float errorThreshold, float minX, float maxX,
               float minY, float maxY, float iterMinX, float iterMaxX,
@@ -362,7 +409,12 @@ multilaterate(const float* anchorsx, const float* anchorsy, const float* ranges,
 	    int yLength = (int) ((maxY - minY)/L + 1.0F);
             float x, y;
             int xMin, xMax, yMin, yMax;
-            char *scores = calloc((size_t)((yLength+1)*(xLength+1)), sizeof(char));
+            char *scores = vble_opt_scores(state, (size_t)((yLength+1)*(xLength+1)));
+            if (scores == NULL) {
+                *resx = NAN;
+                *resy = NAN;
+                return;
+            }
             float minXNew = FLT_MAX, maxXNew = FLT_MIN, minYNew = FLT_MAX, maxYNew = FLT_MIN;
             for (size_t i = 0; i < num_anchors; i++) {
                 // calculate candidate ring with given error threshold in
@@ -542,19 +594,21 @@ multilaterate(const float* anchorsx, const float* anchorsy, const float* ranges,
             iterMinY = minYNew;
             iterMaxY = maxYNew+L;
             L /= 2;
-            free(scores);
          }
     *resx = finalX / (float) maxScoreIndex;
     *resy = finalY / (float) maxScoreIndex;   
 }
 
 
-static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-vble_opt_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy) {
+static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__(1,2,3,7,8),__artificial__))
+vble_opt_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy, void *state) {
     int ii;
     float l, last_l;
     const float error_threshold = 85.0F;
     if (num_anchors<3) return;
+    // Callers without a state of vble_opt_thread_init() get one for this call.
+    vble_opt_state_t local = { NULL, 0 };
+    vble_opt_state_t *s = (state != NULL) ? (vble_opt_state_t *) state : &local;
     for (ii = 0; ii < VECTOR_OPS; ii++) {
         float anchorsx[num_anchors];
         float anchorsy[num_anchors];
@@ -598,8 +652,9 @@ vble_opt_run (const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r, size
         l = 0.4F * min_side;
 	last_l = 0.05F * min_side;
 
-        multilaterate(anchorsx, anchorsy, ranges, num_anchors, l, last_l, error_threshold, minX, maxX, minY, maxY, minX, maxX, minY, maxY, &((*resx)[ii]),&((*resy)[ii]));
+        multilaterate(s, anchorsx, anchorsy, ranges, num_anchors, l, last_l, error_threshold, minX, maxX, minY, maxY, minX, maxX, minY, maxY, &((*resx)[ii]),&((*resy)[ii]));
     }
+    free(local.scores);
 }
 
 #endif
@@ -42,24 +42,35 @@
 
 /* @algorithm_name: Weighted MinMax */
 
-static float md_minmax_rel_left         = -25;
-static float md_minmax_rel_middle_left  = 50;
-static float md_minmax_rel_middle_right = 50;
-static float md_minmax_rel_right        = 125;
+typedef struct weighted_minmax_params_t {
+    float left;
+    float middle_left;
+    float middle_right;
+    float right;
+} weighted_minmax_params_t;
+
+static weighted_minmax_params_t weighted_minmax_defaults = {
+    .left = -25,
+    .middle_left = 50,
+    .middle_right = 50,
+    .right = 125
+};
+
+static __thread weighted_minmax_params_t *weighted_minmax_params = &weighted_minmax_defaults;
 
 #if HAVE_POPT_H
 struct poptOption md_minmax_rel_arguments[] = {
         { "mf-left", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_rel_left, 0,
+          &weighted_minmax_defaults.left, 0,
           "left value of the membership function", NULL },
         { "mf-middle-left", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_rel_middle_left, 0,
+          &weighted_minmax_defaults.middle_left, 0,
           "middle left value of the membership function", NULL },
         { "mf-middle-right", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_rel_middle_right, 0,
+          &weighted_minmax_defaults.middle_right, 0,
           "middle right value of the membership function", NULL },
         { "mf-right", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &md_minmax_rel_right, 0,
+          &weighted_minmax_defaults.right, 0,
           "middle right value of the membership function", NULL },
         POPT_TABLEEND
 };
@@ -70,14 +81,15 @@ static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,_
 weighted_minmax_run (const VECTOR* vx, const VECTOR* vy,
                      const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy)
 {
+    const weighted_minmax_params_t *p = weighted_minmax_params;
     const float left_rate      =
-        (1.00F - 0.00F) / (md_minmax_rel_middle_left - md_minmax_rel_left);
+        (1.00F - 0.00F) / (p->middle_left - p->left);
     const float left_const     =
-        -1.00F * left_rate * md_minmax_rel_left;
+        -1.00F * left_rate * p->left;
     const float right_rate     =
-        (0.00F - 1.00F) / (md_minmax_rel_right - md_minmax_rel_middle_right);
+        (0.00F - 1.00F) / (p->right - p->middle_right);
     const float right_const    =
-        -1.00F * right_rate * md_minmax_rel_right;
+        -1.00F * right_rate * p->right;
 
     const VECTOR v_left_rate   = VECTOR_BROADCASTF(left_rate);
     const VECTOR v_left_const  = VECTOR_BROADCASTF(left_const);
@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <cairo.h>
 #include <cairo/cairo-pdf.h>
@@ -40,12 +41,215 @@
 #include "ls2/library.h"
 #include "vector_shooter.h"
 #include "ls2/backend.h"
+#include "ls2/util.h"
 
 #include "backend/colors.c"
 #include "util/util_colors.c"
 
 
 
+/*******************************************************************
+ ***
+ *** Rendering results into pixel buffers.
+ ***
+ *******************************************************************/
+
+/*
+ * Results are not drawn as one rectangle per pixel.  Instead, the
+ * colors are written as packed RGB24 values into the data of an image
+ * surface, row by row and by several threads.  Other surfaces, like
+ * PDF, receive that image as a single raster source.  Cairo is only
+ * used to draw the anchors and labels on top of it.
+ */
+
+/* Number of entries of the color maps, covering the range of the
+ * samples that are not saturated.  A multiple of 100 puts the steps of
+ * the hue of densities on the edges of the entries. */
+#ifndef LS2_COLOR_MAP_SIZE
+#  define LS2_COLOR_MAP_SIZE 4000
+#endif
+
+/* Images with fewer pixels than this are rendered by one thread. */
+#ifndef LS2_RASTER_MIN_PARALLEL
+#  define LS2_RASTER_MIN_PARALLEL (256 * 256)
+#endif
+
+/* Samples of the location based results at or above this value are
+ * saturated, see ls2_pick_color_locbased(). */
+#define LS2_LOCBASED_RANGE 250.0F
+
+
+/*!
+ * Convert a color to a pixel of a CAIRO_FORMAT_RGB24 image, rounding
+ * like cairo_set_source_rgb() does.
+ */
+static inline uint32_t __attribute__((__const__,__always_inline__))
+ls2_rgb24(double r, double g, double b)
+{
+    r = (r < 0.0) ? 0.0 : ((r > 1.0) ? 1.0 : r);
+    g = (g < 0.0) ? 0.0 : ((g > 1.0) ? 1.0 : g);
+    b = (b < 0.0) ? 0.0 : ((b > 1.0) ? 1.0 : b);
+    return (((uint32_t) (r * 65535.0 + 0.5) >> 8) << 16) |
+           (((uint32_t) (g * 65535.0 + 0.5) >> 8) << 8) |
+           ((uint32_t) (b * 65535.0 + 0.5) >> 8);
+}
+
+
+/*!
+ * Describes how to compute the pixels of one row of an image.
+ */
+typedef struct ls2_raster_t {
+    const void *result;         /* The samples, one per pixel.         */
+    const uint32_t *map;        /* A color map, if the painter uses one. */
+    double similar, dynamic;    /* Parameters of diff images.          */
+    uint16_t width;
+    uint16_t height;
+    void (*paint_row)(const struct ls2_raster_t *restrict raster,
+                      uint32_t *restrict row, const uint16_t y);
+} ls2_raster_t;
+
+
+/*! The rows one thread renders. */
+typedef struct ls2_raster_job_t {
+    const ls2_raster_t *raster;
+    unsigned char *data;
+    int stride;
+    uint16_t first, last;
+} ls2_raster_job_t;
+
+
+static void *
+ls2_raster_rows(void *arg)
+{
+    const ls2_raster_job_t *job = (const ls2_raster_job_t *) arg;
+    for (uint16_t y = job->first; y < job->last; y++) {
+        uint32_t *row = (uint32_t *) (void *)
+            (job->data + (size_t) y * (size_t) job->stride);
+        job->raster->paint_row(job->raster, row, y);
+    }
+    return NULL;
+}
+
+
+/*!
+ * Render a raster into a surface.  Image surfaces are written
+ * directly; all other surfaces get a single image painted onto them.
+ */
+static void
+ls2_paint_raster(cairo_surface_t *surface, const ls2_raster_t *raster)
+{
+    cairo_surface_t *image = surface;
+
+    if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+        cairo_image_surface_get_format(surface) != CAIRO_FORMAT_RGB24) {
+        image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, raster->width,
+                                           raster->height);
+    }
+    cairo_surface_flush(image);
+    unsigned char *data = cairo_image_surface_get_data(image);
+    if (data == NULL) {
+        fprintf(stderr, "cairo_image_surface_get_data(): %s\n",
+                cairo_status_to_string(cairo_surface_status(image)));
+        exit(EXIT_FAILURE);
+    }
+    const int stride = cairo_image_surface_get_stride(image);
+
+    // Split the rows between the threads.
+    long num_threads = 1;
+    if ((size_t) raster->width * raster->height >= LS2_RASTER_MIN_PARALLEL) {
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = MAX(1L, MIN(num_threads, MIN(64L, (long) raster->height)));
+    }
+    pthread_t threads[num_threads];
+    ls2_raster_job_t jobs[num_threads];
+    for (long t = 0; t < num_threads; t++) {
+        jobs[t].raster = raster;
+        jobs[t].data = data;
+        jobs[t].stride = stride;
+        jobs[t].first = (uint16_t) (t * raster->height / num_threads);
+        jobs[t].last = (uint16_t) ((t + 1) * raster->height / num_threads);
+    }
+    for (long t = 1; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, ls2_raster_rows, &jobs[t])) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ls2_raster_rows(&jobs[0]);
+    for (long t = 1; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    cairo_surface_mark_dirty(image);
+
+    if (image != surface) {
+        cairo_t *cr = cairo_create(surface);
+        cairo_set_source_surface(cr, image, 0.0, 0.0);
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_NEAREST);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        cairo_surface_destroy(image);
+    }
+    cairo_surface_flush(surface);
+}
+
+
+
+/*!
+ * Look up the color of a sample in a color map covering [0, range).
+ * Samples below the range use the first entry, samples at or above it
+ * the last entry, like all samples that compare false.
+ */
+static inline uint32_t __attribute__((__pure__,__always_inline__))
+ls2_color_map_lookup(const uint32_t *restrict map, const float scale,
+                     const float sample)
+{
+    const float i = sample * scale;
+    if (0.0F <= i && i < (float) LS2_COLOR_MAP_SIZE)
+        return map[(size_t) i];
+    else if (i < 0.0F)
+        return map[0];
+    else
+        return map[LS2_COLOR_MAP_SIZE];
+}
+
+
+
+/*!
+ * Fill the color map of the location based results.  Entry i is the
+ * color of the center of the i-th interval, the last entry the color
+ * of saturated samples.
+ */
+static void
+ls2_color_map_locbased(uint32_t map[LS2_COLOR_MAP_SIZE + 1])
+{
+    for (size_t i = 0; i <= LS2_COLOR_MAP_SIZE; i++) {
+        const float sample = (i < LS2_COLOR_MAP_SIZE) ?
+            ((float) i + 0.5F) * (LS2_LOCBASED_RANGE / LS2_COLOR_MAP_SIZE) :
+            LS2_LOCBASED_RANGE;
+        double r, g, b, a;
+        ls2_pick_color_locbased(sample, &r, &g, &b, &a);
+        map[i] = ls2_rgb24(r, g, b);
+    }
+}
+
+
+static void __attribute__((__nonnull__,__hot__))
+ls2_paint_row_locbased(const ls2_raster_t *restrict raster,
+                       uint32_t *restrict row, const uint16_t y)
+{
+    const float *restrict result =
+        (const float *) raster->result + (size_t) y * raster->width;
+    const float scale = LS2_COLOR_MAP_SIZE / LS2_LOCBASED_RANGE;
+    const uint32_t magenta = ls2_rgb24(1.0, 0.0, 1.0);
+
+    for (uint16_t x = 0; x < raster->width; x++) {
+        const float sample = result[x];
+        row[x] = ls2_isnan(sample) ? magenta :
+            ls2_color_map_lookup(raster->map, scale, sample);
+    }
+}
+
+
 /*!
  * Draw a result image to a surface.
  */
@@ -54,30 +258,14 @@ ls2_draw_result_to_cairo(cairo_surface_t *surface,
 		         const float *result, const uint16_t width,
 			 const uint16_t height)
 {
-    cairo_t *cr;
-
-    // Create a drawing buffer.
-    cr = cairo_create(surface);
-    
-    // Fill the background
-    cairo_set_source_rgb(cr, 0.0, 0.0, 1.0);
-    cairo_rectangle(cr, 0, 0, width, height);
-    cairo_fill(cr);
+    uint32_t map[LS2_COLOR_MAP_SIZE + 1];
+    ls2_raster_t raster = {
+        .result = result, .map = map, .width = width, .height = height,
+        .paint_row = ls2_paint_row_locbased
+    };
 
-    // Color each location by the average or maximum error
-    for (uint16_t y = 0; y < height; y++) {
-	for (uint16_t x = 0; x < width; x++) {
-	    const float sample = result[y * width + x];
-            double r, g, b, a;
-            ls2_pick_color_locbased(sample, &r, &g, &b, &a);
-	    cairo_set_source_rgb(cr, r, g, b);
-	    cairo_rectangle(cr, x, y, 1.0, 1.0);
-	    cairo_fill(cr);
-	}
-    }
-
-    cairo_destroy(cr);
-    cairo_surface_flush(surface);
+    ls2_color_map_locbased(map);
+    ls2_paint_raster(surface, &raster);
 
     return surface;
 }
@@ -168,6 +356,41 @@ ls2_cairo_write_png_locbased(const char* filename,
 
 
 
+/*!
+ * Fill the color map of densities in [0, 1].  The last entry is the
+ * color of a density of 1.
+ */
+static void
+ls2_color_map_density(uint32_t map[LS2_COLOR_MAP_SIZE + 1])
+{
+    for (size_t i = 0; i <= LS2_COLOR_MAP_SIZE; i++) {
+        const float sample = (i < LS2_COLOR_MAP_SIZE) ?
+            ((float) i + 0.5F) / LS2_COLOR_MAP_SIZE : 1.0F;
+        double hue, lightness, saturation, r, g, b;
+        ls2_pick_color_density(sample, &hue, &saturation, &lightness);
+        hsl_to_rgb(hue, saturation, lightness, &r, &g, &b);
+        map[i] = ls2_rgb24(r, g, b);
+    }
+}
+
+
+static void __attribute__((__nonnull__,__hot__))
+ls2_paint_row_density(const ls2_raster_t *restrict raster,
+                      uint32_t *restrict row, const uint16_t y)
+{
+    const float *restrict result =
+        (const float *) raster->result + (size_t) y * raster->width;
+    const uint32_t magenta = ls2_rgb24(1.0, 0.0, 1.0);
+
+    for (uint16_t x = 0; x < raster->width; x++) {
+        const float sample = result[x];
+        assert(ls2_isnan(sample) || (0.0F <= sample && sample <= 1.0F));
+        row[x] = ls2_isnan(sample) ? magenta :
+            ls2_color_map_lookup(raster->map, LS2_COLOR_MAP_SIZE, sample);
+    }
+}
+
+
 /*!
  * Draw a result image to a surface.
  */
@@ -176,31 +399,14 @@ ls2_draw_density_to_cairo(cairo_surface_t *surface,
 		         const float *result, const uint16_t width,
 			 const uint16_t height)
 {
-    cairo_t *cr;
+    uint32_t map[LS2_COLOR_MAP_SIZE + 1];
+    ls2_raster_t raster = {
+        .result = result, .map = map, .width = width, .height = height,
+        .paint_row = ls2_paint_row_density
+    };
 
-    // Create a drawing buffer.
-    cr = cairo_create(surface);
-    
-    // Fill the background
-    cairo_set_source_rgb(cr, 0.0, 0.0, 1.0);
-    cairo_rectangle(cr, 0, 0, width, height);
-    cairo_fill(cr);
-
-    // Color each location
-    for (uint16_t y = 0; y < height; y++) {
-	for (uint16_t x = 0; x < width; x++) {
-	    const float sample = result[y * width + x];
-            double hue, lightness, saturation, r, g, b;
-            ls2_pick_color_density(sample, &hue, &saturation, &lightness);
-            hsl_to_rgb(hue, saturation, lightness, &r, &g, &b);
-	    cairo_set_source_rgb(cr, r, g, b);
-	    cairo_rectangle(cr, x, y, 1.0, 1.0);
-	    cairo_fill(cr);
-	}
-    }
-
-    cairo_destroy(cr);
-    cairo_surface_flush(surface);
+    ls2_color_map_density(map);
+    ls2_paint_raster(surface, &raster);
 
     return surface;
 }
@@ -406,6 +612,25 @@ ls2_cairo_write_pdf_phase_portrait(const char* filename,
 
 
 
+/* The colors of differences depend on two parameters and have a sharp
+ * edge at the similarity threshold, so they are computed per pixel. */
+static void __attribute__((__nonnull__))
+ls2_paint_row_diff(const ls2_raster_t *restrict raster,
+                   uint32_t *restrict row, const uint16_t y)
+{
+    const float *restrict result =
+        (const float *) raster->result + (size_t) y * raster->width;
+
+    for (uint16_t x = 0; x < raster->width; x++) {
+        double r, g, b, lightness, saturation, hue;
+        ls2_pick_color_diff(result[x], raster->similar, raster->dynamic,
+                            &hue, &saturation, &lightness);
+        hsl_to_rgb(hue, saturation, lightness, &r, &g, &b);
+        row[x] = ls2_rgb24(r, g, b);
+    }
+}
+
+
 static void
 ls2_cairo_draw_diff(cairo_surface_t *surface,
 		    const vector2 *anchors, const size_t no_anchors,
@@ -413,31 +638,12 @@ ls2_cairo_draw_diff(cairo_surface_t *surface,
 		    const uint16_t height, const double similar,
                     const double dynamic)
 {
-    cairo_t *cr;
-
-    // Create a drawing buffer.
-    cr = cairo_create(surface);
-    
-    // Fill the background
-    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-    cairo_rectangle(cr, 0, 0, width, height);
-    cairo_fill(cr);
+    ls2_raster_t raster = {
+        .result = result, .similar = similar, .dynamic = dynamic,
+        .width = width, .height = height, .paint_row = ls2_paint_row_diff
+    };
 
-    for (uint16_t y = 0; y < height; y++) {
-	for (uint16_t x = 0; x < width; x++) {
-            double r, g, b, lightness, saturation, hue;
-	    const float sample = result[y * width + x];
-	    ls2_pick_color_diff(sample, similar, dynamic,
-				&hue, &saturation, &lightness);
-            hsl_to_rgb(hue, saturation, lightness, &r, &g, &b);
-	    cairo_set_source_rgb(cr, r, g, b);
-	    cairo_rectangle(cr, x, y, 1.0, 1.0);
-	    cairo_fill(cr);
-	}
-    }
-
-    cairo_destroy(cr);
-    cairo_surface_flush(surface);
+    ls2_paint_raster(surface, &raster);
 
     const double fn_size = (double) ((width < height) ? width : height) / 50.0;
     ls2_draw_anchors_to_cairo(surface, anchors, no_anchors, 0, fn_size);
@@ -461,42 +667,42 @@ ls2_cairo_write_png_diff(const char* filename,
 
 
 
+static void __attribute__((__nonnull__,__flatten__))
+ls2_paint_row_inverted(const ls2_raster_t *restrict raster,
+                       uint32_t *restrict row, const uint16_t y)
+{
+    const double *restrict result =
+        (const double *) raster->result + (size_t) y * raster->width;
+    const uint32_t white = ls2_rgb24(1.0, 1.0, 1.0);
+
+    for (uint16_t x = 0; x < raster->width; x++) {
+        double h, s, l, r, g, b;
+        const double sample = result[x];
+        if (sample > 0.0) {
+            ls2_pick_color_inverted(sample, &h, &s, &l);
+            hsl_to_rgb(h, s, l, &r, &g, &b);
+            row[x] = ls2_rgb24(r, g, b);
+        } else {
+            row[x] = white;
+        }
+    }
+}
+
+
 /*!
  * Draw a result image of an inverted computation to a surface.
  */
-static void __attribute__((__nonnull__,__flatten__))
+static void __attribute__((__nonnull__))
 ls2_draw_inverted_result_to_cairo(cairo_surface_t *surface,
 				  const double *restrict result,
 				  const uint16_t width, const uint16_t height)
 {
-    cairo_t *cr;
+    ls2_raster_t raster = {
+        .result = result, .width = width, .height = height,
+        .paint_row = ls2_paint_row_inverted
+    };
 
-    // Create a drawing buffer.
-    cr = cairo_create(surface);
-    
-    // Fill the background
-    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-    cairo_rectangle(cr, 0, 0, width, height);
-    cairo_fill(cr);
-
-    // Color each location by the average or maximum error
-    for (uint16_t y = 0; y < height; y++) {
-	for (uint16_t x = 0; x < width; x++) {
-            double h, s, l, r, g, b;
-	    const double sample = result[y * width + x];
-            if (sample > 0.0) {
-                ls2_pick_color_inverted(sample, &h, &s, &l);
-                hsl_to_rgb(h, s, l, &r, &g, &b);
-		cairo_set_source_rgb(cr, r, g, b);
-	        cairo_rectangle(cr, (double) x, (double) y, 1.0, 1.0);
-	        cairo_fill(cr);
-            }
-	}
-    }
-
-    // We finished writing the image.
-    cairo_destroy(cr);
-    cairo_surface_flush(surface);
+    ls2_paint_raster(surface, &raster);
 }
 
 
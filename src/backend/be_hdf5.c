@@ -32,6 +32,11 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
 
 /* By defining the macro H5_NO_DEPRECATED_SYMBOLS, we force the use of
  * the version 1.8 API regardless of the configuration of hdf5
@@ -43,6 +48,27 @@
 #include "ls2/ls2.h"
 #include "ls2/backend.h"
 
+#if HAVE_LIBZ && HAVE_ZLIB_H
+#  include <zlib.h>
+#  define LS2_HAVE_ZLIB 1
+#else
+#  define LS2_HAVE_ZLIB 0
+#endif
+
+#if HAVE_LIBLZ4 && HAVE_LZ4_H
+#  include <lz4.h>
+#  define LS2_HAVE_LZ4 1
+#else
+#  define LS2_HAVE_LZ4 0
+#endif
+
+#if HAVE_LIBZSTD && HAVE_ZSTD_H
+#  include <zstd.h>
+#  define LS2_HAVE_ZSTD 1
+#else
+#  define LS2_HAVE_ZSTD 0
+#endif
+
 
 static const char *ls2_hdf5_variant[] = {
 #undef  LS2OUT_VARIANT
@@ -66,13 +92,14 @@ ls2_hdf5_variant_name(ls2_output_variant variant)
 
 
 static void
-ls2_hdf_write_anchors(hid_t file_id, const vector2 *anchors, size_t no_anchors)
+ls2_hdf_write_anchors(hid_t file_id, const char *name,
+                      const vector2 *anchors, size_t no_anchors)
 {
     hid_t dataset, dataspace;
     hsize_t dims[2] = { no_anchors, 2 };
     
     dataspace = H5Screate_simple(2, dims, NULL);
-    dataset = H5Dcreate(file_id, "/Anchors", H5T_NATIVE_FLOAT,
+    dataset = H5Dcreate(file_id, name, H5T_NATIVE_FLOAT,
                         dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
     H5Dwrite(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
              anchors);
@@ -82,38 +109,541 @@ ls2_hdf_write_anchors(hid_t file_id, const vector2 *anchors, size_t no_anchors)
 
 
 
+/*******************************************************************
+ ***
+ *** Chunked and compressed datasets.
+ ***
+ *******************************************************************/
+
+/*
+ * The two dimensional datasets are stored in square chunks.  If the
+ * HDF5 library supports H5Dwrite_chunk() and we can run the selected
+ * filter ourselves, the chunks are filtered by several threads and
+ * written directly.  Otherwise, H5Dwrite() lets HDF5 apply its own
+ * filters, one chunk after the other.  The files are the same, readers
+ * only need the filter (or its plugin) to decompress the chunks.
+ */
+
+#ifndef LS2_HDF5_DEFAULT_CHUNK
+#  define LS2_HDF5_DEFAULT_CHUNK 256
+#endif
+
+/* The registered identifiers of the filter plugins. */
+#define LS2_H5Z_FILTER_LZ4  32004
+#define LS2_H5Z_FILTER_ZSTD 32015
+
+ls2_hdf5_filter_t ls2_hdf5_filter = LS2_HDF5_DEFLATE;
+int ls2_hdf5_level = 9;
+int ls2_hdf5_chunk_size = LS2_HDF5_DEFAULT_CHUNK;
+
+
+
+int
+ls2_hdf5_set_filter(const char *spec)
+{
+    static const struct {
+        const char *name;
+        ls2_hdf5_filter_t filter;
+        int level, min_level, max_level;
+    } filters[] = {
+        { "none",            LS2_HDF5_NONE,            0, 0,  0 },
+        { "deflate",         LS2_HDF5_DEFLATE,         9, 0,  9 },
+        { "shuffle+deflate", LS2_HDF5_SHUFFLE_DEFLATE, 6, 0,  9 },
+        { "lz4",             LS2_HDF5_LZ4,             0, 0,  0 },
+        { "zstd",            LS2_HDF5_ZSTD,            3, 1, 22 }
+    };
+    const char *eq = strchr(spec, '=');
+    const size_t len = (eq != NULL) ? (size_t) (eq - spec) : strlen(spec);
+
+    for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+        if (strlen(filters[i].name) != len ||
+            strncasecmp(spec, filters[i].name, len) != 0)
+            continue;
+        int level = filters[i].level;
+        if (eq != NULL) {
+            char *end;
+            const long l = strtol(eq + 1, &end, 10);
+            if (end == eq + 1 || *end != '\0' ||
+                l < filters[i].min_level || l > filters[i].max_level)
+                return -1;
+            level = (int) l;
+        }
+        ls2_hdf5_filter = filters[i].filter;
+        ls2_hdf5_level = level;
+        return 0;
+    }
+    return -1;
+}
+
+
+
+/*! Dataset creation properties: the chunks and the filter pipeline. */
+static hid_t
+ls2_hdf5_dataset_properties(const hsize_t chunk_dims[2])
+{
+    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(plist_id, 2, chunk_dims);
+    switch (ls2_hdf5_filter) {
+    case LS2_HDF5_NONE:
+        break;
+    case LS2_HDF5_SHUFFLE_DEFLATE:
+        H5Pset_shuffle(plist_id);
+        /* Fall through. */
+    case LS2_HDF5_DEFLATE:
+        H5Pset_deflate(plist_id, (unsigned int) ls2_hdf5_level);
+        break;
+    case LS2_HDF5_LZ4:
+        H5Pset_filter(plist_id, LS2_H5Z_FILTER_LZ4, H5Z_FLAG_OPTIONAL,
+                      0, NULL);
+        break;
+    case LS2_HDF5_ZSTD: {
+        const unsigned int level = (unsigned int) ls2_hdf5_level;
+        H5Pset_filter(plist_id, LS2_H5Z_FILTER_ZSTD, H5Z_FLAG_OPTIONAL,
+                      1, &level);
+        break;
+    }
+    }
+    return plist_id;
+}
+
+
+
+#if HAVE_H5DWRITE_CHUNK
+
+/*! Whether we can filter the chunks ourselves. */
+static int __attribute__((__pure__))
+ls2_hdf5_direct_write(void)
+{
+    switch (ls2_hdf5_filter) {
+    case LS2_HDF5_NONE:
+        return 1;
+    case LS2_HDF5_DEFLATE:
+    case LS2_HDF5_SHUFFLE_DEFLATE:
+        return LS2_HAVE_ZLIB;
+    case LS2_HDF5_LZ4:
+        return LS2_HAVE_LZ4;
+    case LS2_HDF5_ZSTD:
+        return LS2_HAVE_ZSTD;
+    }
+    return 0;
+}
+
+
+/*! A chunk of a dataset, after filtering. */
+typedef struct ls2_hdf5_chunk_t {
+    hsize_t offset[2];          /* Position of the chunk in the dataset. */
+    void *data;
+    size_t size;                /* Size of data in bytes.                */
+    uint32_t mask;              /* The filters that were skipped.        */
+} ls2_hdf5_chunk_t;
+
+
+/*! The chunks of one dataset, shared by the threads filtering them. */
+typedef struct ls2_hdf5_job_t {
+    const unsigned char *data;  /* The dataset in memory.                */
+    size_t element_size;
+    uint16_t width, height;
+    hsize_t chunk_dims[2];
+    ls2_hdf5_chunk_t *chunks;
+    size_t no_chunks;
+    size_t next;                /* The next chunk to filter.             */
+} ls2_hdf5_job_t;
+
+
+static void * __attribute__((__malloc__))
+ls2_hdf5_malloc(size_t size)
+{
+    void *p = malloc(size);
+    if (p == NULL) {
+        perror("malloc()");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+
+#if LS2_HAVE_ZLIB
+/* Same output as the deflate filter of HDF5. */
+static void *
+ls2_hdf5_deflate(const void *in, const size_t n, size_t *out_size)
+{
+    uLongf size = compressBound((uLong) n);
+    unsigned char *out = ls2_hdf5_malloc(size);
+    if (compress2(out, &size, in, (uLong) n, ls2_hdf5_level) != Z_OK) {
+        free(out);
+        return NULL;
+    }
+    *out_size = size;
+    return out;
+}
+#endif
+
+
+#if LS2_HAVE_LZ4
+/* Same output as the LZ4 filter plugin: the size of the data and of
+ * the block as big endian numbers, followed by one block. */
+static void *
+ls2_hdf5_lz4(const void *in, const size_t n, size_t *out_size)
+{
+    const int bound = LZ4_compressBound((int) n);
+    unsigned char *out = ls2_hdf5_malloc(16 + (size_t) bound);
+    const int size = LZ4_compress_default(in, (char *) out + 16, (int) n,
+                                          bound);
+    if (size <= 0) {
+        free(out);
+        return NULL;
+    }
+    for (int i = 0; i < 8; i++)
+        out[i] = (unsigned char) ((uint64_t) n >> (56 - 8 * i));
+    for (int i = 0; i < 4; i++) {
+        out[8 + i] = (unsigned char) ((uint32_t) n >> (24 - 8 * i));
+        out[12 + i] = (unsigned char) ((uint32_t) size >> (24 - 8 * i));
+    }
+    *out_size = 16 + (size_t) size;
+    return out;
+}
+#endif
+
+
+#if LS2_HAVE_ZSTD
+/* Same output as the Zstandard filter plugin: a single frame. */
+static void *
+ls2_hdf5_zstd(const void *in, const size_t n, size_t *out_size)
+{
+    const size_t bound = ZSTD_compressBound(n);
+    void *out = ls2_hdf5_malloc(bound);
+    const size_t size = ZSTD_compress(out, bound, in, n, ls2_hdf5_level);
+    if (ZSTD_isError(size)) {
+        free(out);
+        return NULL;
+    }
+    *out_size = size;
+    return out;
+}
+#endif
+
+
+/* The shuffle filter of HDF5: first all first bytes of the elements,
+ * then all second bytes, and so on. */
+static void
+ls2_hdf5_shuffle(const unsigned char *restrict in, unsigned char *restrict out,
+                 const size_t n, const size_t element_size)
+{
+    for (size_t j = 0; j < element_size; j++)
+        for (size_t i = 0; i < n; i++)
+            out[j * n + i] = in[i * element_size + j];
+}
+
+
+/*!
+ * Copy a chunk out of the dataset, padding it with zeros at the borders,
+ * and run the filter on it.  A chunk that does not get smaller is
+ * stored unfiltered, like HDF5 does for optional filters.
+ */
+static void
+ls2_hdf5_filter_chunk(const ls2_hdf5_job_t *job, ls2_hdf5_chunk_t *chunk)
+{
+    const size_t rows = (size_t) job->chunk_dims[0];
+    const size_t cols = (size_t) job->chunk_dims[1];
+    const size_t es = job->element_size;
+    const size_t raw_size = rows * cols * es;
+    const size_t y0 = (size_t) chunk->offset[0];
+    const size_t x0 = (size_t) chunk->offset[1];
+    const size_t h = MIN(rows, job->height - y0);
+    const size_t w = MIN(cols, job->width - x0);
+
+    unsigned char *raw = calloc(raw_size, 1);
+    if (raw == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t y = 0; y < h; y++) {
+        memcpy(raw + y * cols * es,
+               job->data + ((y0 + y) * job->width + x0) * es, w * es);
+    }
+
+    void *out = NULL;
+    size_t out_size = raw_size;
+    switch (ls2_hdf5_filter) {
+    case LS2_HDF5_NONE:
+        break;
+    case LS2_HDF5_DEFLATE:
+#if LS2_HAVE_ZLIB
+        out = ls2_hdf5_deflate(raw, raw_size, &out_size);
+#endif
+        break;
+    case LS2_HDF5_SHUFFLE_DEFLATE: {
+#if LS2_HAVE_ZLIB
+        unsigned char *shuffled = ls2_hdf5_malloc(raw_size);
+        ls2_hdf5_shuffle(raw, shuffled, rows * cols, es);
+        out = ls2_hdf5_deflate(shuffled, raw_size, &out_size);
+        free(shuffled);
+#endif
+        break;
+    }
+    case LS2_HDF5_LZ4:
+#if LS2_HAVE_LZ4
+        out = ls2_hdf5_lz4(raw, raw_size, &out_size);
+#endif
+        break;
+    case LS2_HDF5_ZSTD:
+#if LS2_HAVE_ZSTD
+        out = ls2_hdf5_zstd(raw, raw_size, &out_size);
+#endif
+        break;
+    }
+
+    if (out != NULL && out_size < raw_size) {
+        free(raw);
+        chunk->data = out;
+        chunk->size = out_size;
+        chunk->mask = 0;
+    } else {
+        free(out);
+        chunk->data = raw;
+        chunk->size = raw_size;
+        chunk->mask = (ls2_hdf5_filter == LS2_HDF5_NONE) ? 0 : UINT32_MAX;
+    }
+}
+
+
+static void *
+ls2_hdf5_filter_chunks(void *arg)
+{
+    ls2_hdf5_job_t *job = (ls2_hdf5_job_t *) arg;
+    size_t k;
+
+    while ((k = __atomic_fetch_add(&(job->next), 1, __ATOMIC_RELAXED)) <
+           job->no_chunks) {
+        ls2_hdf5_filter_chunk(job, &(job->chunks[k]));
+    }
+    return NULL;
+}
+
+
+/*!
+ * Filter all chunks of a dataset on several threads and write them
+ * directly, in the order of their position.
+ */
+static void
+ls2_hdf5_write_chunks(hid_t dataset, const void *data,
+                      const size_t element_size,
+                      const uint16_t width, const uint16_t height,
+                      const hsize_t chunk_dims[2])
+{
+    const size_t chunks_y = (size_t) ((height + chunk_dims[0] - 1) / chunk_dims[0]);
+    const size_t chunks_x = (size_t) ((width + chunk_dims[1] - 1) / chunk_dims[1]);
+    ls2_hdf5_job_t job = {
+        .data = data, .element_size = element_size,
+        .width = width, .height = height,
+        .chunk_dims = { chunk_dims[0], chunk_dims[1] },
+        .no_chunks = chunks_x * chunks_y, .next = 0
+    };
+
+    job.chunks = calloc(job.no_chunks, sizeof(ls2_hdf5_chunk_t));
+    if (job.chunks == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t k = 0; k < job.no_chunks; k++) {
+        job.chunks[k].offset[0] = (hsize_t) (k / chunks_x) * chunk_dims[0];
+        job.chunks[k].offset[1] = (hsize_t) (k % chunks_x) * chunk_dims[1];
+    }
+
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = MAX(1L, MIN(num_threads, MIN(64L, (long) job.no_chunks)));
+    pthread_t threads[num_threads];
+    for (long t = 1; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, ls2_hdf5_filter_chunks, &job)) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ls2_hdf5_filter_chunks(&job);
+    for (long t = 1; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (size_t k = 0; k < job.no_chunks; k++) {
+        H5Dwrite_chunk(dataset, H5P_DEFAULT, job.chunks[k].mask,
+                       job.chunks[k].offset, job.chunks[k].size,
+                       job.chunks[k].data);
+        free(job.chunks[k].data);
+    }
+    free(job.chunks);
+}
+
+#endif
+
+
+
+/*!
+ * Write a two dimensional dataset of height rows and width columns.
+ * type is the type of the elements in memory and in the file.
+ */
+static void
+ls2_hdf5_write_dataset(hid_t file_id, const char *name, hid_t type,
+                       const void *data, const size_t element_size,
+                       const uint16_t width, const uint16_t height)
+{
+    const hsize_t dims[2] = { height, width };
+    const hsize_t edge = (hsize_t) ((ls2_hdf5_chunk_size > 0) ?
+                                    ls2_hdf5_chunk_size :
+                                    LS2_HDF5_DEFAULT_CHUNK);
+    const hsize_t chunk_dims[2] = { MIN(edge, dims[0]), MIN(edge, dims[1]) };
+
+    hid_t dataspace = H5Screate_simple(2, dims, NULL);
+    hid_t plist_id = ls2_hdf5_dataset_properties(chunk_dims);
+    hid_t dataset = H5Dcreate(file_id, name, type, dataspace, H5P_DEFAULT,
+                              plist_id, H5P_DEFAULT);
+#if HAVE_H5DWRITE_CHUNK
+    if (ls2_hdf5_direct_write()) {
+        ls2_hdf5_write_chunks(dataset, data, element_size, width, height,
+                              chunk_dims);
+    } else
+#else
+    (void) element_size;
+#endif
+    {
+        H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    }
+    H5Pclose(plist_id);
+    H5Sclose(dataspace);
+    H5Dclose(dataset);
+}
+
+
+
+/* Write the variants in results to the group called path. */
+static void
+ls2_hdf5_write_variants(hid_t file_id, const char *path, float **results,
+                        const uint16_t width, const uint16_t height)
+{
+    for (ls2_output_variant k = 0; k < NUM_VARIANTS; k++) {
+        if (results[k] == NULL)
+            continue;
+        char name[256];
+        snprintf(name, 256, "%s/%s", path, ls2_hdf5_variant_name(k));
+        ls2_hdf5_write_dataset(file_id, name, H5T_NATIVE_FLOAT, results[k],
+                               sizeof(float), width, height);
+    }
+}
+
+
+
+/* Write the variants of each algorithm to the group path/algorithm. */
+static void
+ls2_hdf5_write_algorithms(hid_t file_id, const char *path,
+                          const char *const *algorithms,
+                          float **const results[],
+                          const size_t num_algorithms,
+                          const uint16_t width, const uint16_t height)
+{
+    for (size_t a = 0; a < num_algorithms; a++) {
+        char name[256];
+        snprintf(name, 256, "%s/%s", path, algorithms[a]);
+        hid_t alg = H5Gcreate(file_id, name, H5P_DEFAULT, H5P_DEFAULT,
+                              H5P_DEFAULT);
+        ls2_hdf5_write_variants(file_id, name, results[a], width, height);
+        H5Gclose(alg);
+    }
+}
+
+
+
 void
 ls2_hdf5_write_locbased(const char *filename, const vector2 *anchors,
                         const size_t no_anchors, float **results,
                         const uint16_t width, const uint16_t height)
 {
-    hid_t file_id, grp, dataset, dataspace, plist_id;
-    hsize_t dims[2];
-    hsize_t chunk_dims[2] = { width, height };
+    hid_t file_id, grp;
 
     file_id = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
     grp = H5Gcreate(file_id, "/Result", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 
-    ls2_hdf_write_anchors(file_id, anchors, no_anchors);
+    ls2_hdf_write_anchors(file_id, "/Anchors", anchors, no_anchors);
+    ls2_hdf5_write_variants(file_id, "/Result", results, width, height);
 
-    dims[0] = height;
-    dims[1] = width;
-    for (ls2_output_variant k = 0; k < NUM_VARIANTS; k++) {
-        if (results[k] == NULL)
-            continue;
-        char name[256];
-        dataspace = H5Screate_simple(2, dims, NULL);
-	plist_id = H5Pcreate(H5P_DATASET_CREATE);
-	H5Pset_chunk(plist_id, 2, chunk_dims);
-	H5Pset_deflate (plist_id, 9);
-        snprintf(name, 256, "/Result/%s", ls2_hdf5_variant_name(k));
-        dataset = H5Dcreate(file_id, name, H5T_NATIVE_FLOAT,
-                            dataspace, H5P_DEFAULT, plist_id, H5P_DEFAULT);
-        H5Dwrite(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                 results[k]);
-        H5Sclose(dataspace);
-        H5Dclose(dataset);
-    }
+    H5Gclose(grp);
+    H5Fclose(file_id);
+}
+
+
+
+void
+ls2_hdf5_write_locbased_algorithms(const char *filename,
+                                   const vector2 *anchors,
+                                   const size_t no_anchors,
+                                   const char *const *algorithms,
+                                   float **const results[],
+                                   const size_t num_algorithms,
+                                   const uint16_t width, const uint16_t height)
+{
+    hid_t file_id, grp;
+
+    file_id = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    grp = H5Gcreate(file_id, "/Result", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    ls2_hdf_write_anchors(file_id, "/Anchors", anchors, no_anchors);
+    ls2_hdf5_write_algorithms(file_id, "/Result", algorithms, results,
+                              num_algorithms, width, height);
+
+    H5Gclose(grp);
+    H5Fclose(file_id);
+}
+
+
+
+void
+ls2_hdf5_create_batch(const char *filename)
+{
+    hid_t file_id, grp;
+
+    file_id = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    grp = H5Gcreate(file_id, "/Scenario", H5P_DEFAULT, H5P_DEFAULT,
+                    H5P_DEFAULT);
+    H5Gclose(grp);
+    H5Fclose(file_id);
+}
+
+
+
+void
+ls2_hdf5_write_scenario(const char *filename, const size_t scenario,
+                        const char *description,
+                        const vector2 *anchors, const size_t no_anchors,
+                        const char *const *algorithms,
+                        float **const results[], const size_t num_algorithms,
+                        const uint16_t width, const uint16_t height)
+{
+    hid_t file_id, grp, res, type, space, attr;
+    char path[64], name[128];
+
+    file_id = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT);
+    snprintf(path, sizeof(path), "/Scenario/%zu", scenario);
+    grp = H5Gcreate(file_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    // The scenario as given, to tell the groups apart.
+    type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, strlen(description) + 1);
+    space = H5Screate(H5S_SCALAR);
+    attr = H5Acreate2(grp, "Scenario", type, space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, type, description);
+    H5Aclose(attr);
+    H5Sclose(space);
+    H5Tclose(type);
+
+    snprintf(name, sizeof(name), "%s/Anchors", path);
+    ls2_hdf_write_anchors(file_id, name, anchors, no_anchors);
+    snprintf(name, sizeof(name), "%s/Result", path);
+    res = H5Gcreate(file_id, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (num_algorithms == 1)
+        ls2_hdf5_write_variants(file_id, name, results[0], width, height);
+    else
+        ls2_hdf5_write_algorithms(file_id, name, algorithms, results,
+                                  num_algorithms, width, height);
+
+    H5Gclose(res);
     H5Gclose(grp);
     H5Fclose(file_id);
 }
@@ -161,6 +691,20 @@ int __attribute__((__nonnull__(1,5,6,7)))
 ls2_hdf5_read_locbased(const char *filename, ls2_output_variant variant,
                        vector2 **anchors, size_t *no_anchors,
                        float **results, uint16_t *width, uint16_t *height)
+{
+    return ls2_hdf5_read_locbased_algorithm(filename, NULL, variant, anchors,
+                                            no_anchors, results, width,
+                                            height);
+}
+
+
+
+int __attribute__((__nonnull__(1,6,7,8)))
+ls2_hdf5_read_locbased_algorithm(const char *filename, const char *algorithm,
+                                 ls2_output_variant variant,
+                                 vector2 **anchors, size_t *no_anchors,
+                                 float **results, uint16_t *width,
+                                 uint16_t *height)
 {
     hid_t file, dataset, dataspace, memspace;
     hsize_t dims[2];
@@ -177,7 +721,11 @@ ls2_hdf5_read_locbased(const char *filename, ls2_output_variant variant,
 
     // Read the errors.
     char name[256];
-    snprintf(name, 256, "/Result/%s", ls2_hdf5_variant_name(variant));
+    if (algorithm != NULL)
+        snprintf(name, 256, "/Result/%s/%s", algorithm,
+                 ls2_hdf5_variant_name(variant));
+    else
+        snprintf(name, 256, "/Result/%s", ls2_hdf5_variant_name(variant));
     dataset = H5Dopen2(file, name, H5P_DEFAULT);
     dataspace = H5Dget_space(dataset);
     rank = H5Sget_simple_extent_ndims(dataspace);
@@ -203,6 +751,24 @@ ls2_hdf5_read_locbased(const char *filename, ls2_output_variant variant,
 
 
 
+/*! Write a pair of values of type, like a position, as a 2x1 dataset. */
+static void __attribute__((__nonnull__))
+ls2_hdf5_write_pair(hid_t file_id, const char *name, hid_t type,
+                    const void *pair)
+{
+    hid_t dataset, dataspace;
+    hsize_t dims[2] = { 2, 1 };
+
+    dataspace = H5Screate_simple(2, dims, NULL);
+    dataset = H5Dcreate(file_id, name, type, dataspace, H5P_DEFAULT,
+                        H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, pair);
+    H5Sclose(dataspace);
+    H5Dclose(dataset);
+}
+
+
+
 void
 ls2_hdf5_write_inverted(const char *filename,
 			const float tag_x, const float tag_y,
@@ -211,48 +777,70 @@ ls2_hdf5_write_inverted(const char *filename,
 			const uint16_t width, const uint16_t height,
 			const double center_x, const double center_y)
 {
-    hid_t file_id, grp, dataset, dataspace, plist_id;
-    hsize_t dims[2];
-    hsize_t chunk_dims[2] = { width, height };
+    hid_t file_id, grp;
 
     file_id = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
     grp = H5Gcreate(file_id, "/Result", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 
-    ls2_hdf_write_anchors(file_id, anchors, no_anchors);
+    ls2_hdf_write_anchors(file_id, "/Anchors", anchors, no_anchors);
 
-    dims[0] = 2;
-    dims[1] = 1;
-    dataspace = H5Screate_simple(2, dims, NULL);
-    dataset = H5Dcreate(file_id, "/Tag", H5T_NATIVE_FLOAT,
-                        dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
     float tag[2] = {tag_x, tag_y};
-    H5Dwrite(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, tag);
-    H5Sclose(dataspace);
-    H5Dclose(dataset);
-
-    dims[0] = 2;
-    dims[1] = 1;
-    dataspace = H5Screate_simple(2, dims, NULL);
-    dataset = H5Dcreate(file_id, "/Result/Center", H5T_NATIVE_DOUBLE,
-                        dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    ls2_hdf5_write_pair(file_id, "/Tag", H5T_NATIVE_FLOAT, tag);
     double center[2] = { center_x, center_y};
-    H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, center);
-    H5Sclose(dataspace);
-    H5Dclose(dataset);
+    ls2_hdf5_write_pair(file_id, "/Result/Center", H5T_NATIVE_DOUBLE, center);
 
-    dims[0] = height;
-    dims[1] = width;
-    dataspace = H5Screate_simple(2, dims, NULL);
-    plist_id = H5Pcreate(H5P_DATASET_CREATE);
-    H5Pset_chunk(plist_id, 2, chunk_dims);
-    H5Pset_deflate (plist_id, 9);
     // BUG: should be a native type, but what is uint64_t?
-    dataset = H5Dcreate(file_id, "/Result/Frequencies", H5T_STD_U64LE,
-			dataspace, H5P_DEFAULT, plist_id, H5P_DEFAULT);
-    H5Dwrite(dataset, H5T_STD_U64LE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-	     result);
-    H5Sclose(dataspace);
-    H5Dclose(dataset);
+    ls2_hdf5_write_dataset(file_id, "/Result/Frequencies", H5T_STD_U64LE,
+                           result, sizeof(uint64_t), width, height);
+    H5Gclose(grp);
+    H5Fclose(file_id);
+}
+
+
+
+void
+ls2_hdf5_create_inverted_tags(const char *filename, const vector2 *anchors,
+                              const size_t no_anchors)
+{
+    hid_t file_id, grp;
+
+    file_id = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    ls2_hdf_write_anchors(file_id, "/Anchors", anchors, no_anchors);
+    grp = H5Gcreate(file_id, "/Tags", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Gclose(grp);
+    H5Fclose(file_id);
+}
+
+
+
+void
+ls2_hdf5_write_inverted_tag(const char *filename, const size_t k,
+                            const float tag_x, const float tag_y,
+                            const uint64_t *restrict result,
+                            const uint16_t width, const uint16_t height,
+                            const double center_x, const double center_y,
+                            const double sdev_x, const double sdev_y)
+{
+    hid_t file_id, grp;
+    char path[64], name[128];
+
+    file_id = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT);
+    snprintf(path, sizeof(path), "/Tags/%zu", k);
+    grp = H5Gcreate(file_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    float tag[2] = { tag_x, tag_y };
+    snprintf(name, sizeof(name), "%s/Tag", path);
+    ls2_hdf5_write_pair(file_id, name, H5T_NATIVE_FLOAT, tag);
+    double center[2] = { center_x, center_y };
+    snprintf(name, sizeof(name), "%s/Center", path);
+    ls2_hdf5_write_pair(file_id, name, H5T_NATIVE_DOUBLE, center);
+    double sdev[2] = { sdev_x, sdev_y };
+    snprintf(name, sizeof(name), "%s/Sdev", path);
+    ls2_hdf5_write_pair(file_id, name, H5T_NATIVE_DOUBLE, sdev);
+    snprintf(name, sizeof(name), "%s/Frequencies", path);
+    ls2_hdf5_write_dataset(file_id, name, H5T_STD_U64LE, result,
+                           sizeof(uint64_t), width, height);
+
     H5Gclose(grp);
     H5Fclose(file_id);
 }
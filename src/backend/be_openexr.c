@@ -39,6 +39,7 @@
 #include "ls2/ls2.h"
 #include "vector_shooter.h"
 #include "ls2/backend.h"
+#include "ls2/util.h"
 
 #include "backend/colors.c"
 #include "util/util_colors.c"
@@ -43,7 +43,7 @@ ls2_pick_color_locbased(const float sample, double *r, double *g,
 {
     const float good_color = 50.0F;
     const float bad_color = 250.0F;
-    if (isnan(sample)) {
+    if (ls2_isnan(sample)) {
         // Mark not-a-number in magenta.
         *r = 1.0; *g = 0.0; *b = 1.0;
     } else if (sample < good_color) {
@@ -71,7 +71,7 @@ __attribute__((__nonnull__,__gnu_inline__,__always_inline__,__const__))
 ls2_pick_color_density(const float sample, double *restrict hue,
                        double *restrict saturation, double *restrict lightness)
 {
-    if (isnan(sample)) {
+    if (ls2_isnan(sample)) {
         // Mark not-a-number in magenta.
         *hue = 300.0;
         *saturation = 1.0;
@@ -145,7 +145,7 @@ ls2_pick_color_diff(const double sample, const double similar,
 	assert(0.5 <= *saturation && *saturation <= max_saturation);
 	*lightness = MIN(0.5 + sample / dynamic, 1.0);
 	assert(0.5 <= *lightness && *lightness <= 1.0);
-    } else if (isnan(sample) != 0) {
+    } else if (ls2_isnan((float) sample)) {
         // Mark not-a-number in magenta.
         *hue = 300.0;
         *saturation = 1.0;
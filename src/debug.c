@@ -70,6 +70,6 @@ int main(int argc __attribute__((__unused__)),
     }
 
     srand((unsigned int)time(NULL));
-    algorithm(alg, vx, vy, r, 8, 1000, 1000, &resx, &resy);
+    algorithm(alg, vx, vy, r, 8, 1000, 1000, &resx, &resy, NULL);
     printf ("\nResult x=%f y=%f\n",resx[1],resy[1]);
 }
@@ -24,33 +24,46 @@
 #include "../util/util_random.c"
 #include "ab_nlos_em.h"
 
-static float ab_nlos_mean   = 50.0F;
-static float ab_nlos_sdev   = 15.0F;
-static int ab_nlos_count    = 3;
-static float ab_nlos_rate   = 2.0F;
-static float ab_nlos_scale  = 100.0F;
-static VECTOR ab_nlos_oscale;
-static int ab_nlos_norm = 1;
+typedef struct ab_nlos_params_t {
+    float mean;
+    float sdev;
+    int count;
+    float rate;
+    float scale;
+    VECTOR oscale;              /* Set by ab_nlos_setup(). */
+    int norm;
+} ab_nlos_params_t;
+
+static ab_nlos_params_t ab_nlos_defaults = {
+    .mean = 50.0F,
+    .sdev = 15.0F,
+    .count = 3,
+    .rate = 2.0F,
+    .scale = 100.0F,
+    .norm = 1
+};
+
+static __thread ab_nlos_params_t *ab_nlos_params = &ab_nlos_defaults;
 
 #if defined(HAVE_POPT_H)
 struct poptOption ab_nlos_arguments[] = {
   { "ab_nlos-nd-mean", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &ab_nlos_mean, 0,
+    &ab_nlos_defaults.mean, 0,
     "mean value of the error", NULL },
   { "ab_nlos-nd-sdev", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &ab_nlos_sdev, 0,
+    &ab_nlos_defaults.sdev, 0,
     "standard deviation of the error", NULL },
   { "ab_nlos-count", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &ab_nlos_count, 0,
+    &ab_nlos_defaults.count, 0,
     "First n anchors with NLOS ERROR", NULL },
   { "ab_nlos-norm", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &ab_nlos_norm, 0,
+    &ab_nlos_defaults.norm, 0,
     "Normalize error?", NULL },
   { "ab_nlos-rate", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &ab_nlos_rate, 0,
+    &ab_nlos_defaults.rate, 0,
     "Rate of exponential NLOS error", NULL },
   { "ab_nlos-scale", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &ab_nlos_scale, 0,
+    &ab_nlos_defaults.scale, 0,
     "Scale of exponential NLOS error", NULL },
   POPT_TABLEEND
 };
@@ -58,7 +71,7 @@ struct poptOption ab_nlos_arguments[] = {
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,3,8)))
-ab_nlos_error(__m128i *restrict seed,
+ab_nlos_error(ls2_rng_t *restrict seed,
             const size_t anchors,
             const VECTOR *restrict distances,
             const VECTOR *restrict vx __attribute__((__unused__)),
@@ -69,14 +82,15 @@ ab_nlos_error(__m128i *restrict seed,
 {
     VECTOR rn;
     for (size_t k=0; k < anchors ; k++) {
-        if (k < (size_t)ab_nlos_count) {
-            rn = gaussrand(seed, ab_nlos_mean, ab_nlos_sdev);
-            VECTOR nlos = exp_rand(seed, VECTOR_BROADCASTF(ab_nlos_rate)) * VECTOR_BROADCASTF(ab_nlos_scale);
+        if (k < (size_t)ab_nlos_params->count) {
+            rn = gaussrand(seed, ab_nlos_params->mean, ab_nlos_params->sdev);
+            VECTOR nlos = exp_rand(seed, VECTOR_BROADCASTF(ab_nlos_params->rate)) *
+                VECTOR_BROADCASTF(ab_nlos_params->scale);
 	        rn += nlos;               
         } else {
-            rn = gaussrand(seed, ab_nlos_mean, ab_nlos_sdev);
+            rn = gaussrand(seed, ab_nlos_params->mean, ab_nlos_params->sdev);
 	    }
-        result[k] = distances[k] + (rn*ab_nlos_oscale);
+        result[k] = distances[k] + (rn*ab_nlos_params->oscale);
     }
 }
 
@@ -86,20 +100,16 @@ ab_nlos_setup(const vector2 *anchors __attribute__((__unused__)), size_t nanchor
     #define TESTRUNS 10000.0f
     const VECTOR d;
     VECTOR test[nanchors];
-    ab_nlos_oscale = one;
-    if (!ab_nlos_norm) return;
+    ab_nlos_params->oscale = one;
+    if (!ab_nlos_params->norm) return;
     
     for (int i = 0; i < (int)nanchors; i++)
         test[i]=zero;
-    unsigned int _seed = (unsigned int)time(NULL);
     double mean=0.0;
-    __m128i seed;
+    ls2_rng_t seed;
 
-    int seed0 = rand_r(&_seed);
-    int seed1 = rand_r(&_seed);
-    int seed2 = rand_r(&_seed);
-    int seed3 = rand_r(&_seed);
-    seed = _mm_set_epi32(seed0, seed1, seed2, seed3);
+    // A fixed seed, such that the scale does not change between runs.
+    ls2_rng_init(&seed, 0);
 
     for (int i=0; i < TESTRUNS; i++){
         ab_nlos_error(&seed,nanchors,test,&d,&d,d,d,test);
@@ -112,5 +122,5 @@ ab_nlos_setup(const vector2 *anchors __attribute__((__unused__)), size_t nanchor
         }
     }
     float scale = (float)(50.0 / mean);
-    ab_nlos_oscale = VECTOR_BROADCASTF(scale);    
+    ab_nlos_params->oscale = VECTOR_BROADCASTF(scale);    
 }
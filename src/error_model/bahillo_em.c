@@ -49,7 +49,7 @@ static float bahillo_ub = 3.0f;
  */
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,3,8)))
-bahillo_error(__m128i *restrict seed,
+bahillo_error(ls2_rng_t *restrict seed,
               const size_t no_anchors,
               const VECTOR *restrict distances,
               const VECTOR *restrict vx __attribute__((__unused__)),
@@ -23,32 +23,38 @@
 
 #include "const_em.h"
 
-static float const_error_value = 50.0F;
+typedef struct const_params_t {
+    float error_value;
+    VECTOR error_v;
+} const_params_t;
+
+static const_params_t const_defaults = {
+    .error_value = 50.0F
+};
+
+static __thread const_params_t *const_params = &const_defaults;
 
 #ifdef HAVE_POPT_H
 struct poptOption const_arguments[] = {
         { "const-error", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &const_error_value, 0,
+          &const_defaults.error_value, 0,
           "constant error", NULL },
         POPT_TABLEEND
 };
 #endif
 
 
-static VECTOR error_v;
-
-
 void
 const_setup(const vector2 *anchors __attribute__((__unused__)),
             size_t nanchors __attribute__((__unused__)))
 {
-    error_v = VECTOR_BROADCASTF(const_error_value);
+    const_params->error_v = VECTOR_BROADCASTF(const_params->error_value);
 }
 
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,8)))
-const_error(__m128i *restrict seed __attribute__((__unused__)),
+const_error(ls2_rng_t *restrict seed __attribute__((__unused__)),
             const size_t anchors,
             const VECTOR *restrict distances,
             const VECTOR *restrict vx __attribute__((__unused__)),
@@ -58,6 +64,6 @@ const_error(__m128i *restrict seed __attribute__((__unused__)),
             VECTOR *restrict result)
 {
     for (size_t k = 0; k < anchors ; k++) {
-      	result[k] = distances[k] + error_v;
+      	result[k] = distances[k] + const_params->error_v;
     }
 }
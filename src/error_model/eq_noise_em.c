@@ -23,16 +23,27 @@
 
 #include "eq_noise_em.h"
 
-float eq_error_min = 0.0F;
-float eq_error_max = 100.0F;
+typedef struct eq_noise_params_t {
+    float min;
+    float max;
+    VECTOR min_v;
+    VECTOR rng_v;
+} eq_noise_params_t;
+
+static eq_noise_params_t eq_noise_defaults = {
+    .min = 0.0F,
+    .max = 100.0F
+};
+
+static __thread eq_noise_params_t *eq_noise_params = &eq_noise_defaults;
 
 #ifdef HAVE_POPT_H
 struct poptOption eq_arguments[] = {
         { "eq-error-min", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &eq_error_min, 0,
+          &eq_noise_defaults.min, 0,
           "minimum value of error", NULL },
         { "eq-error-max", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &eq_error_max, 0,
+          &eq_noise_defaults.max, 0,
           "maximum value of error", NULL },
         POPT_TABLEEND
 };
@@ -43,21 +54,19 @@ struct poptOption eq_arguments[] = {
 #  include "../util/util_random.c"
 #endif
 
-VECTOR eq_error_min_v;
-VECTOR eq_error_rng_v;
-
 void
 eq_noise_setup(const vector2 *anchors __attribute__((__unused__)),
                size_t nanchors __attribute__((__unused__)))
 {
-    eq_error_min_v = VECTOR_BROADCASTF(eq_error_min);
-    eq_error_rng_v = VECTOR_BROADCASTF(eq_error_max - eq_error_min);
+    eq_noise_params->min_v = VECTOR_BROADCASTF(eq_noise_params->min);
+    eq_noise_params->rng_v =
+        VECTOR_BROADCASTF(eq_noise_params->max - eq_noise_params->min);
 }
 
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,3,8)))
-eq_noise_error(__m128i *restrict seed,
+eq_noise_error(ls2_rng_t *restrict seed,
                const size_t anchors,
 	       const VECTOR *restrict  const distances,
 	       const VECTOR __attribute__((unused)) vx[MAX_ANCHORS],
@@ -68,8 +77,8 @@ eq_noise_error(__m128i *restrict seed,
 {
     for (size_t k = 0; k < anchors ; k++) {
         VECTOR rn = rnd(seed);
-	rn *= eq_error_rng_v;
-	rn += eq_error_min_v;
+	rn *= eq_noise_params->rng_v;
+	rn += eq_noise_params->min_v;
         result[k] = distances[k] + rn;
     }
 }
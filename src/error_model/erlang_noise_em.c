@@ -34,24 +34,35 @@
 // Errormodels have to include all utils themselves
 #include "../util/util_random.c"
 
-static int erlang_shape = 3;
-static float erlang_rate = 0.5228819579F;
-static float erlang_offset = 3.31060119642765F;
-static float erlang_scale = 50.0f / 2.85f;
+typedef struct erlang_noise_params_t {
+    int shape;
+    float rate;
+    float offset;
+    float scale;
+} erlang_noise_params_t;
+
+static erlang_noise_params_t erlang_noise_defaults = {
+    .shape = 3,
+    .rate = 0.5228819579F,
+    .offset = 3.31060119642765F,
+    .scale = 50.0f / 2.85f
+};
+
+static __thread erlang_noise_params_t *erlang_noise_params = &erlang_noise_defaults;
 
 #if defined(HAVE_POPT_H)
 struct poptOption erlang_noise_arguments[] = {
     { "erlang-shape", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &erlang_shape, 0,
+      &erlang_noise_defaults.shape, 0,
       "shape of the erlang distribution", NULL },
     { "erlang-rate", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &erlang_rate, 0,
+      &erlang_noise_defaults.rate, 0,
       "rate of the erlang distribution", NULL },
     { "erlang-offset", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &erlang_offset, 0,
+      &erlang_noise_defaults.offset, 0,
       "additive offset to the erlang distribution", NULL },
     { "erlang-scale", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &erlang_scale, 0,
+      &erlang_noise_defaults.scale, 0,
       "multiplier to scale the erlang distribution", NULL },
     POPT_TABLEEND
 };
@@ -66,7 +77,7 @@ erlang_noise_setup(const vector2 *anchors __attribute__((__unused__)),
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,3,8)))
-erlang_noise_error(__m128i *restrict seed,
+erlang_noise_error(ls2_rng_t *restrict seed,
                    const size_t anchors,
                    const VECTOR *restrict distances,
                    const VECTOR *restrict vx __attribute__((__unused__)),
@@ -77,13 +88,13 @@ erlang_noise_error(__m128i *restrict seed,
 {
     for (size_t k=0; k < anchors ; k++) {
 	VECTOR x = VECTOR_BROADCASTF(1.0F);
-	for (int i = 0; i < erlang_shape; i++)
+	for (int i = 0; i < erlang_noise_params->shape; i++)
 	    x *= rnd(seed);
-        x = VECTOR_LOG(x) / VECTOR_BROADCASTF(-erlang_rate);
-        x -= VECTOR_BROADCASTF(erlang_offset);
+        x = VECTOR_LOG(x) / VECTOR_BROADCASTF(-erlang_noise_params->rate);
+        x -= VECTOR_BROADCASTF(erlang_noise_params->offset);
 
 	// HACK: Scale it to an expected value of 50.
-        x *= VECTOR_BROADCASTF(erlang_scale);
+        x *= VECTOR_BROADCASTF(erlang_noise_params->scale);
       	result[k] = distances[k] + x;
     }
 }
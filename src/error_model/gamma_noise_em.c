@@ -39,21 +39,31 @@
  *
  * The defaults result in mean = 50.0f and sigma = 28.867
  */
-static float gamma_shape = 3.0f;
-static float gamma_rate = 3.0f / 50.0f;   // mean = shape / rate
-static float gamma_offset = 0.0f;
+typedef struct gamma_noise_params_t {
+    float shape;
+    float rate;
+    float offset;
+} gamma_noise_params_t;
+
+static gamma_noise_params_t gamma_noise_defaults = {
+    .shape = 3.0f,
+    .rate = 3.0f / 50.0f,   // mean = shape / rate
+    .offset = 0.0f
+};
+
+static __thread gamma_noise_params_t *gamma_noise_params = &gamma_noise_defaults;
 
 
 #if defined(HAVE_POPT_H)
 struct poptOption gamma_noise_arguments[] = {
     { "gamma-shape", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &gamma_shape, 0,
+      &gamma_noise_defaults.shape, 0,
       "shape of the gamma distribution", NULL },
     { "gamma-rate", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &gamma_rate, 0,
+      &gamma_noise_defaults.rate, 0,
       "rate of the gamma distribution", NULL },
     { "gamma-offset", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-      &gamma_offset, 0,
+      &gamma_noise_defaults.offset, 0,
       "additive offset to the gamma distribution", NULL },
     POPT_TABLEEND
 };
@@ -69,7 +79,7 @@ gamma_noise_setup(const vector2 *anchors __attribute__((__unused__)),
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,3,8)))
-gamma_noise_error(__m128i *restrict seed,
+gamma_noise_error(ls2_rng_t *restrict seed,
                   const size_t anchors,
                   const VECTOR *restrict distances,
                   const VECTOR *restrict vx __attribute__((__unused__)),
@@ -81,7 +91,7 @@ gamma_noise_error(__m128i *restrict seed,
     for (size_t k=0; k < anchors ; k++) {
         VECTOR x = VECTOR_BROADCASTF(1.0F);
         float alpha;
-	for (alpha = gamma_shape; alpha >= 1.0F; alpha -= 1.0F) {
+	for (alpha = gamma_noise_params->shape; alpha >= 1.0F; alpha -= 1.0F) {
             x *= rnd(seed);
         }
         if (alpha > 0.0F) {
@@ -106,8 +116,8 @@ gamma_noise_error(__m128i *restrict seed,
             } while (VECTOR_TEST_ALL_ONES(VECTOR_NE(mask, VECTOR_ZERO())));
             x *= xi;
         }
-        x = (VECTOR_LOG(x) / VECTOR_BROADCASTF(-gamma_rate)) -
-              VECTOR_BROADCASTF(gamma_offset);
+        x = (VECTOR_LOG(x) / VECTOR_BROADCASTF(-gamma_noise_params->rate)) -
+              VECTOR_BROADCASTF(gamma_noise_params->offset);
 
       	result[k] = distances[k] + x;
     }
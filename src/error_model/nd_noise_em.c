@@ -35,16 +35,25 @@
 // Errormodels have to include all utils themselves
 #include "../util/util_random.c"
 
-static float nd_noise_mean = 50.0F;
-static float nd_noise_sdev = 25.0F;
+typedef struct nd_noise_params_t {
+    float mean;
+    float sdev;
+} nd_noise_params_t;
+
+static nd_noise_params_t nd_noise_defaults = {
+    .mean = 50.0F,
+    .sdev = 25.0F
+};
+
+static __thread nd_noise_params_t *nd_noise_params = &nd_noise_defaults;
 
 #if defined(HAVE_POPT_H)
 struct poptOption nd_noise_arguments[] = {
         { "nd-mean", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &nd_noise_mean, 0,
+          &nd_noise_defaults.mean, 0,
           "mean value of the error", NULL },
         { "nd-sdev", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &nd_noise_sdev, 0,
+          &nd_noise_defaults.sdev, 0,
           "standard deviation of the error", NULL },
         POPT_TABLEEND
 };
@@ -60,7 +69,7 @@ nd_noise_setup(const vector2 *anchors __attribute__((__unused__)),
 
 
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-nd_noise_error(__m128i *restrict seed,
+nd_noise_error(ls2_rng_t *restrict seed,
                const size_t anchors, 
                const VECTOR *restrict distances,
                const VECTOR *restrict vx __attribute__((__unused__)),
@@ -70,7 +79,7 @@ nd_noise_error(__m128i *restrict seed,
                VECTOR *restrict result)
 {
     for (size_t k=0; k < anchors ; k++) {
-        VECTOR rn = gaussrand(seed, nd_noise_mean, nd_noise_sdev);
+        VECTOR rn = gaussrand(seed, nd_noise_params->mean, nd_noise_params->sdev);
         //if negative Values are not acceptable, use this (about 10% slower, half a sec)
         /*
         while(rn[0]<0||rn[1]<0||rn[2]<0||rn[3]<0){
@@ -37,28 +37,40 @@
 
 #include "nlosp_em.h"
 
-static float nlosp_mean   = 50.0F;
-static float nlosp_sdev   = 15.0F;
-static float nlosp_nlos_p = 0.1F;
-static float nlosp_rate   = 2.0F;
-static float nlosp_scale  = 100.0F;
+typedef struct nlosp_params_t {
+    float mean;
+    float sdev;
+    float nlos_p;
+    float rate;
+    float scale;
+} nlosp_params_t;
+
+static nlosp_params_t nlosp_defaults = {
+    .mean = 50.0F,
+    .sdev = 15.0F,
+    .nlos_p = 0.1F,
+    .rate = 2.0F,
+    .scale = 100.0F
+};
+
+static __thread nlosp_params_t *nlosp_params = &nlosp_defaults;
 
 #if defined(HAVE_POPT_H)
 struct poptOption nlosp_arguments[] = {
   { "nlosp-nd-mean", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &nlosp_mean, 0,
+    &nlosp_defaults.mean, 0,
     "mean value of the error", NULL },
   { "nlosp-nd-sdev", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &nlosp_sdev, 0,
+    &nlosp_defaults.sdev, 0,
     "standard deviation of the error", NULL },
   { "nlosp-prob", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &nlosp_nlos_p, 0,
+    &nlosp_defaults.nlos_p, 0,
     "Probability of an NLOS error", NULL },
   { "nlosp-rate", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &nlosp_rate, 0,
+    &nlosp_defaults.rate, 0,
     "Rate of exponential NLOS error", NULL },
   { "nlosp-scale", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-    &nlosp_scale, 0,
+    &nlosp_defaults.scale, 0,
     "Scale of exponential NLOS error", NULL },
   POPT_TABLEEND
 };
@@ -74,7 +86,7 @@ nlosp_setup(const vector2 *anchors __attribute__((__unused__)),
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,3,8)))
-nlosp_error(__m128i *restrict seed,
+nlosp_error(ls2_rng_t *restrict seed,
             const size_t anchors,
             const VECTOR *restrict distances,
             const VECTOR *restrict vx __attribute__((__unused__)),
@@ -84,10 +96,11 @@ nlosp_error(__m128i *restrict seed,
             VECTOR *restrict result)
 {
     for (size_t k=0; k < anchors ; k++) {
-        VECTOR rn = gaussrand(seed, nlosp_mean, nlosp_sdev);
-        VECTOR help = VECTOR_LT(rnd(seed), VECTOR_BROADCASTF(nlosp_nlos_p));
-        VECTOR nlos = exp_rand(seed, VECTOR_BROADCASTF(nlosp_rate)) *
-                          VECTOR_BROADCASTF(nlosp_scale);
+        VECTOR rn = gaussrand(seed, nlosp_params->mean, nlosp_params->sdev);
+        VECTOR help = VECTOR_LT(rnd(seed),
+                                VECTOR_BROADCASTF(nlosp_params->nlos_p));
+        VECTOR nlos = exp_rand(seed, VECTOR_BROADCASTF(nlosp_params->rate)) *
+                          VECTOR_BROADCASTF(nlosp_params->scale);
 	rn += VECTOR_AND(nlos, help);  // Mask out members without nlos error
         result[k] = distances[k] + rn;
     }
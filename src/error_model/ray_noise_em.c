@@ -24,6 +24,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <float.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "util/util_random.c"
 
@@ -64,34 +73,256 @@
 
 
 
-/*! The name of the wall file. */
-static char const * ls2_ray_noise_walls = "wall_txt/2r_walls.txt";
+/*! The uniform grid over the walls, see wall_grid_build(). */
+typedef struct ray_wall_grid_t {
+    float x0, y0;               /* The lower left corner. */
+    float cell, inv_cell;       /* The edge length of a cell. */
+    int nx, ny;
+    int *start;                 /* nx * ny + 1 offsets into walls. */
+    int *walls;                 /* Even indices into wall_x, wall_y. */
+} ray_wall_grid_t;
+
+
+typedef struct ray_noise_params_t {
+    /*! The name of the wall file. */
+    char const *walls;
+    /*! The directory of the cache of ray traced fields.  The empty
+     *  string selects the user's cache directory, "none" disables the
+     *  cache. */
+    char const *cache;
+    /*! The walls read by ray_noise_setup().  Wall i / 2 runs from point
+     *  i to point i + 1 for the even i < wall_number, wall_width[i] and
+     *  wall_kind[i] are its width and kind. */
+    VECTOR *wall_x;
+    VECTOR *wall_y;
+    float *wall_width;
+    int *wall_kind;
+    int wall_number;
+    /*! SIZE * SIZE cells, 10 for the cells on a wall. */
+    int *wall_array;
+    ray_wall_grid_t grid;
+    /*! The number of traced rays and whether the debugging output of
+     *  ray_noise_error() was printed. */
+    int rays;
+    int printed;
+    /*! The ray traced fields of ray_noise_setup(), SIZE * SIZE floats
+     *  per anchor each.  They are either allocated or mapped from the
+     *  cache, with map_size bytes at map. */
+    float *length;
+    float *strength;
+    void *map;
+    size_t map_size;
+} ray_noise_params_t;
+
+static ray_noise_params_t ray_noise_defaults = {
+    .walls = "wall_txt/2r_walls.txt",
+    .cache = ""
+};
+
+static __thread ray_noise_params_t *ray_noise_params = &ray_noise_defaults;
 
 #if HAVE_POPT_H
 struct poptOption ray_noise_arguments[] = {
         { "walls", 0, POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
-          &ls2_ray_noise_walls, 0,
+          &ray_noise_defaults.walls, 0,
           "files describing the walls", NULL },
+        { "ray-cache", 0, POPT_ARG_STRING,
+          &ray_noise_defaults.cache, 0,
+          "directory caching the ray traced fields (default: "
+          "$XDG_CACHE_HOME/ls2, none disables the cache)", "directory" },
         POPT_TABLEEND
 };
 #endif
 
-VECTOR fzero;
-VECTOR minus_one;
-VECTOR plus_one;
-VECTOR *restrict  wall_x;
-VECTOR *restrict  wall_y;
-float *wall_width;
-int *wall_kind;
-VECTOR wall_number;
-float *length_array;
-float *strength_array;
-int *wall_array;
-int printhelper;
-int counter;
-int counter2;
-int counter3;
-float rz;
+static const VECTOR fzero = VECTOR_CONST_BROADCAST(0.0F);
+static const VECTOR minus_one = VECTOR_CONST_BROADCAST(-1.0F);
+static const VECTOR plus_one = VECTOR_CONST_BROADCAST(1.0F);
+static const float rz = 0.0001F;
+
+
+
+/*******************************************************************
+ ***
+ *** Cache of the ray traced fields.
+ ***
+ *******************************************************************/
+
+/*
+ * Tracing the rays takes long, but the fields only depend on the walls,
+ * the anchors and the constants above.  They are stored in a binary
+ * file named by an FNV-1a hash of these inputs.  Later runs map that
+ * file read-only instead of tracing the rays again.
+ */
+
+/* Increment whenever the ray tracing computes different fields. */
+#define RAY_CACHE_VERSION 1
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/*! The header of a cache file, followed by the length and the strength
+ *  fields, SIZE * SIZE floats per anchor each. */
+struct ray_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint64_t key;
+    uint64_t anchors;
+    char padding[32];
+};
+
+
+static uint64_t __attribute__((__pure__))
+fnv1a(uint64_t hash, const void *data, size_t n)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    for (size_t i = 0; i < n; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+
+/*! Hash everything the ray traced fields depend on. */
+static uint64_t
+ray_cache_key(const void *walls, size_t walls_size, const vector2 *vv,
+              size_t num)
+{
+    const double constants[] = {
+        RAY_CACHE_VERSION, SIZE, sizeof(VECTOR), DEGREE, THRESHOLD,
+        FREQUENCY, WALLREDUCTION1, WALLREDUCTION2, WALLREDUCTION3,
+        REFLECTIONCOEFFICIENT1, REFLECTIONCOEFFICIENT2,
+        REFLECTIONCOEFFICIENT3, LENGTHREDUCTION, WALLTHICKNESS,
+        WALLCROSSBLOCK, MAX_DEPTH, SCALE, TRANSMITPOWER
+    };
+    const uint64_t n = (uint64_t) num;
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    hash = fnv1a(hash, constants, sizeof(constants));
+    hash = fnv1a(hash, &n, sizeof(n));
+    hash = fnv1a(hash, vv, num * sizeof(vector2));
+    return fnv1a(hash, walls, walls_size);
+}
+
+
+/*!
+ * Write the name of the cache file to path, creating the cache
+ * directory if needed.  Returns -1 if the cache is disabled.
+ */
+static int
+ray_cache_path(char *path, size_t n, uint64_t key)
+{
+    char dir[4096];
+
+    if (strcmp(ray_noise_params->cache, "none") == 0) {
+        return -1;
+    } else if (*ray_noise_params->cache != '\0') {
+        snprintf(dir, sizeof(dir), "%s", ray_noise_params->cache);
+    } else {
+        const char *xdg = getenv("XDG_CACHE_HOME");
+        const char *home = getenv("HOME");
+        if (xdg != NULL && *xdg != '\0') {
+            snprintf(dir, sizeof(dir), "%s", xdg);
+            mkdir(dir, 0777);
+        } else if (home != NULL && *home != '\0') {
+            snprintf(dir, sizeof(dir), "%s/.cache", home);
+            mkdir(dir, 0777);
+        } else {
+            return -1;
+        }
+        strncat(dir, "/ls2", sizeof(dir) - strlen(dir) - 1);
+    }
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Warning: cannot create %s: %s\n", dir,
+                strerror(errno));
+        return -1;
+    }
+    snprintf(path, n, "%s/rays-%016" PRIx64 ".bin", dir, key);
+    return 0;
+}
+
+
+/*! Map the fields of a previous run, returns 0 on success. */
+static int
+ray_cache_load(uint64_t key, size_t num)
+{
+    char path[4200];
+    struct stat st;
+    const size_t field = (size_t) SIZE * SIZE * num * sizeof(float);
+    const size_t expected = sizeof(struct ray_cache_header) + 2 * field;
+
+    if (ray_cache_path(path, sizeof(path), key) != 0)
+        return -1;
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size != expected) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    const struct ray_cache_header *header = map;
+    if (memcmp(header->magic, "LS2RAYS", 8) != 0 ||
+        header->version != RAY_CACHE_VERSION || header->size != SIZE ||
+        header->key != key || header->anchors != (uint64_t) num) {
+        munmap(map, expected);
+        return -1;
+    }
+
+    // The fields are only read from now on, so they may stay read-only.
+    ray_noise_params->map = map;
+    ray_noise_params->map_size = expected;
+    ray_noise_params->length =
+        (float *) (void *) ((char *) map + sizeof(*header));
+    ray_noise_params->strength =
+        ray_noise_params->length + (size_t) SIZE * SIZE * num;
+    printf("Ray traced fields mapped from %s\n", path);
+    return 0;
+}
+
+
+/*! Store the fields for later runs.  Failing to do so is not fatal. */
+static void
+ray_cache_store(uint64_t key, size_t num)
+{
+    char path[4200], tmp[4220];
+    const size_t field = (size_t) SIZE * SIZE * num * sizeof(float);
+    struct ray_cache_header header;
+
+    if (ray_cache_path(path, sizeof(path), key) != 0)
+        return;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LS2RAYS", 8);
+    header.version = RAY_CACHE_VERSION;
+    header.size = SIZE;
+    header.key = key;
+    header.anchors = (uint64_t) num;
+
+    // Write to a temporary file and rename it, so that concurrent runs
+    // never see a partial file.
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    const int fd = mkstemp(tmp);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: cannot create %s: %s\n", tmp,
+                strerror(errno));
+        return;
+    }
+    FILE *fp = fdopen(fd, "wb");
+    if (fp == NULL ||
+        fwrite(&header, sizeof(header), 1, fp) != 1 ||
+        fwrite(ray_noise_params->length, 1, field, fp) != field ||
+        fwrite(ray_noise_params->strength, 1, field, fp) != field ||
+        fclose(fp) != 0 || rename(tmp, path) != 0) {
+        fprintf(stderr, "Warning: cannot write %s: %s\n", path,
+                strerror(errno));
+        unlink(tmp);
+    }
+}
 
 
 //Calculate the Path Loss
@@ -117,11 +348,11 @@ strength_on_hit(const VECTOR length, VECTOR strength, VECTOR *restrict sleft,
 {
     float wr = 0.0F;
     float rc = 0.0F;
-    float inside = wall_width[wnum]/VECTOR_SIN(angle)[0];
+    float inside = ray_noise_params->wall_width[wnum]/VECTOR_SIN(angle)[0];
     VECTOR ploss;
     //For debugging
     //inside = 1;
-    switch(wall_kind[wnum]){
+    switch(ray_noise_params->wall_kind[wnum]){
         case 1: wr = WALLREDUCTION1*inside;
                 rc = REFLECTIONCOEFFICIENT1;
                 break;
@@ -162,6 +393,22 @@ get(int x, int y, int a)
     return res;
 }
 
+/*!
+ * The share of one thread in tracing the rays of an anchor: the angles
+ * first to last - 1, tagged into its own length and strength fields of
+ * SIZE * SIZE cells.
+ */
+struct ray_trace {
+    ray_noise_params_t *params; /* The walls, bound in the thread. */
+    float *length;
+    float *strength;
+    float x, y;                 /* The position of the anchor. */
+    float anchor;
+    int first, last;
+    int rays;                   /* Tagged rays, for debugging. */
+    pthread_t thread;
+};
+
 //tags every Point by rewriting the length and strength arrays if neccesary
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
@@ -170,13 +417,15 @@ tag(const VECTOR ax, const VECTOR ay, const VECTOR dx, const VECTOR dy,
     const VECTOR cy __attribute__((unused)),
     int status __attribute__((__unused__)),
     const VECTOR dist,
-    VECTOR *restrict length, VECTOR *restrict strength2, const VECTOR a)
+    VECTOR *restrict length, VECTOR *restrict strength2,
+    struct ray_trace *restrict trace)
 {
-    //counter2: how many rays are created, print in the end
-    counter2++; 
+    //how many rays are created, print in the end
+    trace->rays++;
+    float *restrict length_field = trace->length;
+    float *restrict strength_field = trace->strength;
     int x;
     int y;
-    int b = (int) a[0];
     float r = 0.0F;
     VECTOR strength = *strength2;
     VECTOR ploss;
@@ -195,11 +444,11 @@ tag(const VECTOR ax, const VECTOR ay, const VECTOR dx, const VECTOR dy,
             break;
         }
         //rewrite if strength of ray is greater than saved strength and if length is smaller
-        if(strength_array[get(x,y,b)] < strength[0]) {
+        if(strength_field[get(x,y,0)] < strength[0]) {
         //Or rewrite if length is smaller, ignore strength for rewrite
-        //if(length_array[get(x,y,b)] >= (*length)[0]) {
-            length_array[get(x,y,b)] = (*length)[0];
-            strength_array[get(x,y,b)] = strength[0];
+        //if(length_field[get(x,y,0)] >= (*length)[0]) {
+            length_field[get(x,y,0)] = (*length)[0];
+            strength_field[get(x,y,0)] = strength[0];
         }
     }
 }
@@ -338,7 +587,145 @@ ray_wall(const VECTOR ax, const VECTOR ay, const VECTOR dx, const VECTOR dy,
 }
 
 
-//calls ray_walls for all walls and ray_reflection
+/*******************************************************************
+ ***
+ *** Uniform grid over the walls.
+ ***
+ *******************************************************************/
+
+/*
+ * Every cell of the grid lists the walls passing within GRID_SLACK
+ * pixels of it.  A ray walks through the cells it crosses (2D DDA) and
+ * only tests their walls, stopping as soon as no wall in a later cell
+ * can be closer than the nearest hit.  Ties are broken by the index of
+ * the wall, so the result is the same as testing every wall in order.
+ */
+
+#define GRID_SLACK 2.0F
+#define GRID_MIN_CELL 4.0F
+#define GRID_MAX_CELLS 1024
+
+/*! Whether the wall starting at point i passes within GRID_SLACK of the
+ *  cell (x, y), which lies inside the bounding box of the wall. */
+static inline int
+__attribute__((__always_inline__,__gnu_inline__,__artificial__))
+wall_grid_touches(int i, int x, int y)
+{
+    const ray_wall_grid_t wall_grid = ray_noise_params->grid;
+    const VECTOR *wall_x = ray_noise_params->wall_x;
+    const VECTOR *wall_y = ray_noise_params->wall_y;
+    const float extent = 0.5F * wall_grid.cell + GRID_SLACK;
+    const float mx = wall_grid.x0 + ((float) x + 0.5F) * wall_grid.cell;
+    const float my = wall_grid.y0 + ((float) y + 0.5F) * wall_grid.cell;
+    const float px = wall_x[i][0], py = wall_y[i][0];
+    const float nx = wall_y[i+1][0] - py, ny = px - wall_x[i+1][0];
+    return fabsf(nx * (mx - px) + ny * (my - py)) <=
+        extent * (fabsf(nx) + fabsf(ny));
+}
+
+
+/*! The cells covered by the bounding box of the wall at point i. */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+wall_grid_box(int i, int *restrict x0, int *restrict y0, int *restrict x1,
+              int *restrict y1)
+{
+    const ray_wall_grid_t wall_grid = ray_noise_params->grid;
+    const VECTOR *wall_x = ray_noise_params->wall_x;
+    const VECTOR *wall_y = ray_noise_params->wall_y;
+    const float inv = wall_grid.inv_cell;
+    *x0 = (int) ((fminf(wall_x[i][0], wall_x[i+1][0]) - GRID_SLACK - wall_grid.x0) * inv);
+    *y0 = (int) ((fminf(wall_y[i][0], wall_y[i+1][0]) - GRID_SLACK - wall_grid.y0) * inv);
+    *x1 = (int) ((fmaxf(wall_x[i][0], wall_x[i+1][0]) + GRID_SLACK - wall_grid.x0) * inv);
+    *y1 = (int) ((fmaxf(wall_y[i][0], wall_y[i+1][0]) + GRID_SLACK - wall_grid.y0) * inv);
+    *x0 = MAX(*x0, 0);
+    *y0 = MAX(*y0, 0);
+    *x1 = MIN(*x1, wall_grid.nx - 1);
+    *y1 = MIN(*y1, wall_grid.ny - 1);
+}
+
+
+/*!
+ * Build the grid over the walls.  With a cell size of 0, the cells are
+ * chosen such that there are about as many cells as wall ends.
+ */
+static void
+wall_grid_build(float cell)
+{
+    ray_wall_grid_t *const wall_grid = &ray_noise_params->grid;
+    const VECTOR *wall_x = ray_noise_params->wall_x;
+    const VECTOR *wall_y = ray_noise_params->wall_y;
+    const int n = ray_noise_params->wall_number;
+    float minx = 0.0F, miny = 0.0F, maxx = SIZE, maxy = SIZE;
+
+    if (n > 0) {
+        minx = miny = FLT_MAX;
+        maxx = maxy = -FLT_MAX;
+        for (int i = 0; i < n; i++) {
+            minx = fminf(minx, wall_x[i][0]);
+            miny = fminf(miny, wall_y[i][0]);
+            maxx = fmaxf(maxx, wall_x[i][0]);
+            maxy = fmaxf(maxy, wall_y[i][0]);
+        }
+    }
+    minx -= 2 * GRID_SLACK;
+    miny -= 2 * GRID_SLACK;
+    maxx += 2 * GRID_SLACK;
+    maxy += 2 * GRID_SLACK;
+    if (cell <= 0.0F)
+        cell = sqrtf((maxx - minx) * (maxy - miny) / (float) MAX(n, 1));
+    cell = fmaxf(cell, GRID_MIN_CELL);
+    cell = fmaxf(cell, (maxx - minx) / GRID_MAX_CELLS);
+    cell = fmaxf(cell, (maxy - miny) / GRID_MAX_CELLS);
+
+    wall_grid->x0 = minx;
+    wall_grid->y0 = miny;
+    wall_grid->cell = cell;
+    wall_grid->inv_cell = 1.0F / cell;
+    wall_grid->nx = MAX(1, (int) ceilf((maxx - minx) / cell));
+    wall_grid->ny = MAX(1, (int) ceilf((maxy - miny) / cell));
+
+    const size_t cells = (size_t) wall_grid->nx * (size_t) wall_grid->ny;
+    free(wall_grid->start);
+    free(wall_grid->walls);
+    wall_grid->start = (int *) calloc(cells + 1, sizeof(int));
+    if (wall_grid->start == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+    // Count the walls of every cell, then fill them in.
+    for (int i = 0; i < n; i += 2) {
+        int x0, y0, x1, y1;
+        wall_grid_box(i, &x0, &y0, &x1, &y1);
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                if (wall_grid_touches(i, x, y))
+                    wall_grid->start[x + wall_grid->nx * y + 1]++;
+    }
+    for (size_t c = 0; c < cells; c++)
+        wall_grid->start[c + 1] += wall_grid->start[c];
+    wall_grid->walls = (int *) malloc(MAX((size_t) wall_grid->start[cells], 1) *
+                                     sizeof(int));
+    if (wall_grid->walls == NULL) {
+        perror("malloc()");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i += 2) {
+        int x0, y0, x1, y1;
+        wall_grid_box(i, &x0, &y0, &x1, &y1);
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                if (wall_grid_touches(i, x, y))
+                    wall_grid->walls[wall_grid->start[x + wall_grid->nx * y]++] = i;
+    }
+    // Filling advanced every offset to the next cell, shift them back.
+    for (size_t c = cells; c > 0; c--)
+        wall_grid->start[c] = wall_grid->start[c - 1];
+    wall_grid->start[0] = 0;
+}
+
+
+//calls ray_walls for the walls along the ray and ray_reflection
 static inline int
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
 ray_cross(const VECTOR ax, const VECTOR ay, const VECTOR dx, const VECTOR dy,
@@ -351,39 +738,93 @@ ray_cross(const VECTOR ax, const VECTOR ay, const VECTOR dx, const VECTOR dy,
     VECTOR dcx;
     VECTOR dcy;
     VECTOR dist;
+    const ray_wall_grid_t wall_grid = ray_noise_params->grid;
+    const VECTOR *wall_x = ray_noise_params->wall_x;
+    const VECTOR *wall_y = ray_noise_params->wall_y;
     float helper = SIZE*SIZE;
     *distance2 = VECTOR_BROADCAST(&helper);
     int status = 0;
-    int status2 = 0;    
-    for(int i = 0; i < wall_number[0]; i += 2) {
-        cx = wall_x[i];
-        cy = wall_y[i];
-        dcx =  wall_x[i+1] - wall_x[i];
-        dcy =  wall_y[i+1] - wall_y[i];
-        //round for convinience
-        if((dcx[0]+rz)>0&&(dcx[0]-rz)<0) {
-            float help = 0.0F;
-            dcx = VECTOR_BROADCAST(&help);
+    int status2 = 0;
+    //Clip the ray to the grid
+    const float ox = ax[0], oy = ay[0], rx = dx[0], ry = dy[0];
+    const float gx1 = wall_grid.x0 + (float) wall_grid.nx * wall_grid.cell;
+    const float gy1 = wall_grid.y0 + (float) wall_grid.ny * wall_grid.cell;
+    float t0 = 0.0F, t1 = FLT_MAX;
+    if (rx != 0) {
+        const float ta = (wall_grid.x0 - ox) / rx, tb = (gx1 - ox) / rx;
+        t0 = fmaxf(t0, fminf(ta, tb));
+        t1 = fminf(t1, fmaxf(ta, tb));
+    } else if (ox < wall_grid.x0 || ox > gx1) {
+        return 0;
+    }
+    if (ry != 0) {
+        const float ta = (wall_grid.y0 - oy) / ry, tb = (gy1 - oy) / ry;
+        t0 = fmaxf(t0, fminf(ta, tb));
+        t1 = fminf(t1, fmaxf(ta, tb));
+    } else if (oy < wall_grid.y0 || oy > gy1) {
+        return 0;
+    }
+    if (t0 > t1) return 0;
+    //Walk through the cells
+    int x = (int) ((ox + t0 * rx - wall_grid.x0) * wall_grid.inv_cell);
+    int y = (int) ((oy + t0 * ry - wall_grid.y0) * wall_grid.inv_cell);
+    x = MAX(0, MIN(x, wall_grid.nx - 1));
+    y = MAX(0, MIN(y, wall_grid.ny - 1));
+    const int stepx = (rx > 0) ? 1 : -1, stepy = (ry > 0) ? 1 : -1;
+    const float deltax = (rx != 0) ? wall_grid.cell / fabsf(rx) : FLT_MAX;
+    const float deltay = (ry != 0) ? wall_grid.cell / fabsf(ry) : FLT_MAX;
+    float tx = FLT_MAX, ty = FLT_MAX;
+    if (rx != 0)
+        tx = (wall_grid.x0 + (float) (x + (rx > 0)) * wall_grid.cell - ox) / rx;
+    if (ry != 0)
+        ty = (wall_grid.y0 + (float) (y + (ry > 0)) * wall_grid.cell - oy) / ry;
+    for (;;) {
+        const int c = x + wall_grid.nx * y;
+        for (int k = wall_grid.start[c]; k < wall_grid.start[c + 1]; k++) {
+            const int i = wall_grid.walls[k];
+            cx = wall_x[i];
+            cy = wall_y[i];
+            dcx =  wall_x[i+1] - wall_x[i];
+            dcy =  wall_y[i+1] - wall_y[i];
+            //round for convinience
+            if((dcx[0]+rz)>0&&(dcx[0]-rz)<0) {
+                float help = 0.0F;
+                dcx = VECTOR_BROADCAST(&help);
+            }
+            if((dcy[0]+rz)>0&&(dcy[0]-rz)<0) {
+                float help = 0.0F;
+                dcy = VECTOR_BROADCAST(&help);
+            }
+            status2 = ray_wall(ax,ay,dx,dy,&cx,&cy,&dcx,&dcy,&dist);
+            //if wall is hit
+            if (status2 != 0) {
+                //and wall is closer to point, or as close and first
+                if(dist[0]<(*distance2)[0] ||
+                   (status != 0 && dist[0]==(*distance2)[0] && i < *wnum)) {
+                    *distance2 = dist;
+                    status = status2;
+                    *cx2 = cx;
+                    *cy2 = cy;
+                    ray_reflect(dx,dy,&dcx,&dcy, &(*angle));
+                    *dcx2 = dcx;
+                    *dcy2 = dcy;
+                    *wnum = i;
+                }
+            }
         }
-        if((dcy[0]+rz)>0&&(dcy[0]-rz)<0) {
-            float help = 0.0F;
-            dcy = VECTOR_BROADCAST(&help);
+        //No wall in a later cell can be closer
+        const float leave = fminf(tx, ty);
+        if (leave >= t1 || (status != 0 && (*distance2)[0] + GRID_SLACK <= leave))
+            break;
+        if (tx < ty) {
+            x += stepx;
+            tx += deltax;
+        } else {
+            y += stepy;
+            ty += deltay;
         }
-        status2 = ray_wall(ax,ay,dx,dy,&cx,&cy,&dcx,&dcy,&dist);
-        //if wall is hit
-        if (status2 != 0) {
-            //and wall is closer to point
-            if(dist[0]<(*distance2)[0]) {
-                *distance2 = dist;
-                status = status2;
-                *cx2 = cx;
-                *cy2 = cy;
-                ray_reflect(dx,dy,&dcx,&dcy, &(*angle));
-                *dcx2 = dcx;
-                *dcy2 = dcy;
-                *wnum = i;
-            }
-        } 
+        if (x < 0 || x >= wall_grid.nx || y < 0 || y >= wall_grid.ny)
+            break;
     }
     return status;
 }
@@ -393,12 +834,27 @@ static inline int
 __attribute__((__always_inline__,__gnu_inline__,__pure__,__artificial__))
 wall_cross_check(const VECTOR cx, const VECTOR cy)
 {
-    for(int i = 0; i < wall_number[0]; i++) {
-        if (   wall_x[i][0] <= cx[0] + WALLCROSSBLOCK 
-            && wall_x[i][0] >= cx[0] - WALLCROSSBLOCK
-            && wall_y[i][0] <= cy[0] + WALLCROSSBLOCK
-            && wall_y[i][0] >= cy[0] - WALLCROSSBLOCK) {
-            return 1;
+    //The ends within WALLCROSSBLOCK are in this or the neighbouring cells
+    const ray_wall_grid_t wall_grid = ray_noise_params->grid;
+    const VECTOR *wall_x = ray_noise_params->wall_x;
+    const VECTOR *wall_y = ray_noise_params->wall_y;
+    const float fx = (cx[0] - wall_grid.x0) * wall_grid.inv_cell;
+    const float fy = (cy[0] - wall_grid.y0) * wall_grid.inv_cell;
+    const int x = (int) fmaxf(-2.0F, fminf(fx, (float) wall_grid.nx + 1));
+    const int y = (int) fmaxf(-2.0F, fminf(fy, (float) wall_grid.ny + 1));
+    for (int gy = MAX(y - 1, 0); gy <= MIN(y + 1, wall_grid.ny - 1); gy++) {
+        for (int gx = MAX(x - 1, 0); gx <= MIN(x + 1, wall_grid.nx - 1); gx++) {
+            const int c = gx + wall_grid.nx * gy;
+            for (int k = wall_grid.start[c]; k < wall_grid.start[c + 1]; k++) {
+                for (int i = wall_grid.walls[k]; i <= wall_grid.walls[k] + 1; i++) {
+                    if (   wall_x[i][0] <= cx[0] + WALLCROSSBLOCK
+                        && wall_x[i][0] >= cx[0] - WALLCROSSBLOCK
+                        && wall_y[i][0] <= cy[0] + WALLCROSSBLOCK
+                        && wall_y[i][0] >= cy[0] - WALLCROSSBLOCK) {
+                        return 1;
+                    }
+                }
+            }
         }
     }
     return 0;
@@ -411,7 +867,8 @@ __attribute__((__nonnull__))
 ray(VECTOR coord[],
     int max __attribute__((__unused__)),
     int depth,
-    int *restrict space2)
+    int *restrict space2,
+    struct ray_trace *restrict trace)
 {
     //kill Ray if not Strong enough
     if((coord[depth+5][0])<THRESHOLD) return 0;
@@ -453,7 +910,7 @@ ray(VECTOR coord[],
        printf("dx = 0 Bug, wird in tag gefangen \n");
     }
     //start tag
-    tag(ax,ay,dx,dy,cx,cy,status,dist,&length,&strength, a);
+    tag(ax,ay,dx,dy,cx,cy,status,dist,&length,&strength,trace);
     //If no wall hit or strong wall hit no further rays are created 
     if(status!=1) return 0;
     //if nor==1, meaning no reflection because of egde
@@ -521,18 +978,14 @@ ray(VECTOR coord[],
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__))
 ray_create(const VECTOR ax, const VECTOR ay, VECTOR dx, VECTOR dy,
-           VECTOR length, VECTOR strength, const VECTOR a)
+           VECTOR length, VECTOR strength, const VECTOR a,
+           struct ray_trace *restrict trace)
 {
     int go = 1;
     int depth = 0;
     int space = 7;
     //Stores new rays
-    VECTOR *restrict coord;
-    coord = (VECTOR*) malloc(MAX_DEPTH*7 * sizeof(VECTOR));
-    if (coord == NULL) {
-        //error!
-        printf("ERROR malloc coord ray_create \n");
-    }
+    VECTOR coord[MAX_DEPTH*7];
     //Write ray in array
     coord[depth] = ax;
     coord[depth+1] = ay;
@@ -545,31 +998,71 @@ ray_create(const VECTOR ax, const VECTOR ay, VECTOR dx, VECTOR dy,
     //Realizes the Recursion
     while(go != 0) {
         if(depth > MAX_DEPTH*7) break;
-        go += ray(&coord[0], MAX_DEPTH*7, depth, &space);
+        go += ray(&coord[0], MAX_DEPTH*7, depth, &space, trace);
         depth += 7;
         go--;
     }
-    free(coord);
 }
 
-//called by setup, starts n = DEGREE Rays for every anchor
-static inline void
-__attribute__((__always_inline__,__gnu_inline__,__artificial__))
-ray_start(const VECTOR ax, const VECTOR ay, VECTOR a)
+//called by ray_noise_anchors in a thread, initializes the fields of the
+//trace and starts its share of the n = DEGREE Rays of an anchor
+static void *
+ray_start(void *arg)
 {
+    struct ray_trace *restrict trace = (struct ray_trace *) arg;
+    ray_noise_params = trace->params;
+    for(size_t i = 0; i<SIZE*SIZE;i++) {
+        trace->length[i] = SIZE*SIZE;
+        trace->strength[i] = THRESHOLD-2;
+    }
+    const VECTOR ax = VECTOR_BROADCAST(&trace->x);
+    const VECTOR ay = VECTOR_BROADCAST(&trace->y);
+    const VECTOR a = VECTOR_BROADCAST(&trace->anchor);
     float helper = 0.0F;
     VECTOR length = VECTOR_BROADCAST(&helper);
     helper = TRANSMITPOWER;
     VECTOR strength = VECTOR_BROADCAST(&helper);
     VECTOR dx;
     VECTOR dy;
-    for (int i = 0; i<DEGREE;i++) {
+    for (int i = trace->first; i < trace->last; i++) {
         helper = cosf((float) i * PI / (DEGREE/2.0F));
         dx = VECTOR_BROADCAST(&helper);
         helper = sinf((float) i* PI / (DEGREE/2.0F));
         dy = VECTOR_BROADCAST(&helper);
-        ray_create(ax,ay,dx,dy,length,strength,a);    
+        ray_create(ax,ay,dx,dy,length,strength,a,trace);
+    }
+    return NULL;
+}
+
+
+/*! Cells first to last - 1 of the merge of the traces of an anchor. */
+struct ray_merge {
+    const struct ray_trace *traces;
+    long num_traces;
+    size_t first, last;
+    pthread_t thread;
+};
+
+//Merges the fields of all traces into those of the first one. The
+//traces are taken in the order of their angles and a cell only takes a
+//stronger ray, just like the serial tracing does.
+static void *
+ray_merge(void *arg)
+{
+    const struct ray_merge *merge = (const struct ray_merge *) arg;
+    float *restrict length = merge->traces[0].length;
+    float *restrict strength = merge->traces[0].strength;
+    for (long t = 1; t < merge->num_traces; t++) {
+        const float *restrict l = merge->traces[t].length;
+        const float *restrict s = merge->traces[t].strength;
+        for (size_t i = merge->first; i < merge->last; i++) {
+            if (strength[i] < s[i]) {
+                length[i] = l[i];
+                strength[i] = s[i];
+            }
+        }
     }
+    return NULL;
 }
 
 
@@ -585,7 +1078,9 @@ tag_wall(void)
     int x;
     int y;
     int r = 0;
-    for(int i = 0; i < wall_number[0]; i += 2) {
+    const VECTOR *wall_x = ray_noise_params->wall_x;
+    const VECTOR *wall_y = ray_noise_params->wall_y;
+    for(int i = 0; i < ray_noise_params->wall_number; i += 2) {
         r = 0;
         ax = wall_x[i];
         ay = wall_y[i];
@@ -597,7 +1092,7 @@ tag_wall(void)
         while(r < norm[0]+1) {
             x = (int) (ax[0] + (float) r *dx[0]);
             y = (int) (ay[0] + (float) r *dy[0]);
-            wall_array[get(x,y,0)] = 10;
+            ray_noise_params->wall_array[get(x,y,0)] = 10;
             r++;
         }
     }
@@ -606,63 +1101,146 @@ tag_wall(void)
 //called from vector_shooter, initialize lenght and strength arrays, starts ray calculation for every anchor
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
-ray_noise_anchors(const vector2 vv[], size_t num)
+ray_noise_anchors(const vector2 vv[], size_t num, uint64_t key)
 {
-    VECTOR anchornumber;
-    VECTOR anchorx; 
-    VECTOR anchory; 
-    float x;
-    length_array = (float *) malloc(SIZE*SIZE*num*sizeof(float *));
-    if (length_array == NULL) printf("malloc length fehlgeschlagen");
-    strength_array = (float *) malloc(SIZE*SIZE*num*sizeof(float *));
-    if (strength_array == NULL) printf("malloc strength fehlgeschlagen");
-    wall_array = (int *) malloc(SIZE*SIZE*sizeof(int *));
-    if (wall_array == NULL) printf("malloc wall fehlgeschlagen");
-    //initialize array
-    for(size_t i = 0; i<SIZE*SIZE*num;i++) {
-        length_array[i] = SIZE*SIZE;
-        strength_array[i] = THRESHOLD-2;
-    } 
-    for(size_t i = 0; i<SIZE*SIZE;i++) {
-        wall_array[i] = 0;
-    }
-    //Mark all Points which are part of a wall
-    tag_wall();
-    
     for(size_t i = 0; i<num;i++) {
-        x = (float) i;
-        anchornumber = VECTOR_BROADCAST(&x);
-        anchorx = VECTOR_BROADCAST(&vv[i].x);
-        anchory = VECTOR_BROADCAST(&vv[i].y);
         printf("%zd. Anchor at (%.0f,%.0f)\n", i+1, vv[i].x, vv[i].y);
-        ray_start(anchorx, anchory, anchornumber);
     }
+    //Use the fields of an earlier run, if there are any
+    if (ray_cache_load(key, num) == 0) return;
+
+    ray_noise_params->length = (float *) malloc(SIZE*SIZE*num*sizeof(float *));
+    if (ray_noise_params->length == NULL) printf("malloc length fehlgeschlagen");
+    ray_noise_params->strength = (float *) malloc(SIZE*SIZE*num*sizeof(float *));
+    if (ray_noise_params->strength == NULL) printf("malloc strength fehlgeschlagen");
+
+    //Split the angles of every anchor between the threads. The first
+    //thread traces into the fields of the anchor, every other one into
+    //fields of its own, 8 MB each, which are merged afterwards.
+    const int degrees = (int) DEGREE;
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = MAX(1L, MIN(num_threads, MIN(64L, (long) degrees)));
+    struct ray_trace traces[num_threads];
+    struct ray_merge merges[num_threads];
+    for (long t = 1; t < num_threads; t++) {
+        traces[t].length = (float *) malloc(2 * SIZE * SIZE * sizeof(float));
+        if (traces[t].length == NULL) {
+            perror("malloc()");
+            exit(EXIT_FAILURE);
+        }
+        traces[t].strength = traces[t].length + SIZE * SIZE;
+    }
+    for (size_t i = 0; i < num; i++) {
+        for (long t = 0; t < num_threads; t++) {
+            traces[t].x = vv[i].x;
+            traces[t].y = vv[i].y;
+            traces[t].anchor = (float) i;
+            traces[t].first = (int) (t * degrees / num_threads);
+            traces[t].last = (int) ((t + 1) * degrees / num_threads);
+            traces[t].params = ray_noise_params;
+            traces[t].rays = 0;
+            merges[t].traces = traces;
+            merges[t].num_traces = num_threads;
+            merges[t].first = (size_t) t * SIZE * SIZE / (size_t) num_threads;
+            merges[t].last = (size_t) (t + 1) * SIZE * SIZE / (size_t) num_threads;
+        }
+        traces[0].length = ray_noise_params->length + i * SIZE * SIZE;
+        traces[0].strength = ray_noise_params->strength + i * SIZE * SIZE;
+
+        for (long t = 1; t < num_threads; t++) {
+            if (pthread_create(&traces[t].thread, NULL, ray_start, &traces[t])) {
+                perror("pthread_create()");
+                exit(EXIT_FAILURE);
+            }
+        }
+        ray_start(&traces[0]);
+        for (long t = 1; t < num_threads; t++) {
+            pthread_join(traces[t].thread, NULL);
+        }
+
+        for (long t = 1; t < num_threads; t++) {
+            if (pthread_create(&merges[t].thread, NULL, ray_merge, &merges[t])) {
+                perror("pthread_create()");
+                exit(EXIT_FAILURE);
+            }
+        }
+        ray_merge(&merges[0]);
+        for (long t = 1; t < num_threads; t++) {
+            pthread_join(merges[t].thread, NULL);
+        }
+        for (long t = 0; t < num_threads; t++) {
+            ray_noise_params->rays += traces[t].rays;
+        }
+    }
+    for (long t = 1; t < num_threads; t++) {
+        free(traces[t].length);
+    }
+    ray_cache_store(key, num);
+}
+
+/*! Release the walls and the ray traced fields of ray_noise_setup(). */
+static void __attribute__((__unused__))
+ray_noise_params_free(ray_noise_params_t *params)
+{
+    if (params->map != NULL) {
+        munmap(params->map, params->map_size);
+    } else {
+        free(params->length);
+        free(params->strength);
+    }
+    params->map = NULL;
+    params->length = NULL;
+    params->strength = NULL;
+    free(params->wall_x);
+    free(params->wall_y);
+    free(params->wall_width);
+    free(params->wall_kind);
+    free(params->wall_array);
+    free(params->grid.start);
+    free(params->grid.walls);
+    params->wall_x = params->wall_y = NULL;
+    params->wall_width = NULL;
+    params->wall_kind = params->wall_array = NULL;
+    params->grid.start = params->grid.walls = NULL;
+    params->wall_number = 0;
 }
 
+
 void
-ray_noise_setup(const vector2 *vv __attribute__((__unused__)),
-                size_t num __attribute__((__unused__)))
+ray_noise_setup(const vector2 *vv, size_t num)
 {
-    
-    printhelper = 0;
-    counter = 0;
-    counter2 = 0;
-    counter3 = 0;
-    rz = 0.0001F;
-    fzero = VECTOR_BROADCASTF(0.0F);
-    minus_one = VECTOR_BROADCASTF(-1.0F);
-    plus_one = VECTOR_BROADCASTF(1.0F);   
+    ray_noise_params_t *const params = ray_noise_params;
+    params->printed = 0;
+    params->rays = 0;
     float fhelper;
     
     FILE* fp;
-    fp = fopen (ls2_ray_noise_walls, "r");
+    fp = fopen (ray_noise_params->walls, "r");
     if (fp == NULL) {
         perror("Erroro opening walls file.\n");
         exit(EXIT_FAILURE);
     }
+    //The ray traced fields depend on the contents of the walls file
+    uint64_t key;
+    {
+        char *buffer = NULL;
+        size_t length = 0, n;
+        do {
+            char *b = realloc(buffer, length + 65536);
+            if (b == NULL) {
+                perror("realloc()");
+                exit(EXIT_FAILURE);
+            }
+            buffer = b;
+            n = fread(buffer + length, 1, 65536, fp);
+            length += n;
+        } while (n > 0);
+        key = ray_cache_key(buffer, length, vv, num);
+        free(buffer);
+        rewind(fp);
+    }
     int scan_error = 0;
     VECTOR number_of_walls = fzero;
-    wall_number = fzero;
     while (fscanf(fp, "%i;", &scan_error) != EOF) {
         number_of_walls += plus_one;
     }
@@ -677,25 +1255,36 @@ ray_noise_setup(const vector2 *vv __attribute__((__unused__)),
         number_of_walls -= vhelp;
         printf("Eingabe war %i zu lang\n", now);
     }
-    //set global variable wall_number
-    fhelper = 6;
-    vhelp = VECTOR_BROADCAST(&fhelper);
-    number_of_walls /= vhelp;
-    fhelper = 2;
-    vhelp = VECTOR_BROADCAST(&fhelper);    
-	wall_number = number_of_walls*vhelp;
-	//set walls
-    wall_x = (VECTOR*) malloc((size_t) wall_number[0] * sizeof(VECTOR));
-    if (wall_x == NULL) printf("ERROR malloc wall_x ray_noise \n");
-    
-    wall_y = (VECTOR*) malloc((size_t) wall_number[0] * sizeof(VECTOR));
-    if (wall_y == NULL) printf("ERROR malloc wall_y ray_noise \n");
+    //set wall_number; divide in integers, because with -ffast-math the
+    //vector division may round below the exact quotient.
+    now = (int) number_of_walls[0] / 6;
+    fhelper = (float) now;
+    number_of_walls = VECTOR_BROADCAST(&fhelper);
+    const int wall_number = 2 * now;
+	//set walls, freeing those of an earlier setup of params
+    ray_noise_params_free(params);
+    params->wall_number = wall_number;
+    //malloc() does not align VECTORs, the stores below need it
+    if (posix_memalign((void **) &params->wall_x, ALIGNMENT,
+                       (size_t) wall_number * sizeof(VECTOR)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    if (posix_memalign((void **) &params->wall_y, ALIGNMENT,
+                       (size_t) wall_number * sizeof(VECTOR)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    VECTOR *restrict wall_x = params->wall_x;
+    VECTOR *restrict wall_y = params->wall_y;
     
-    wall_width = (float *) malloc((size_t) wall_number[0] *sizeof(float *));
+    float *wall_width = (float *) malloc((size_t) wall_number * sizeof(float));
     if (wall_width == NULL) printf("malloc  wall_width fehlgeschlagen \n");
+    params->wall_width = wall_width;
     
-    wall_kind = (int *) malloc((size_t) wall_number[0] * sizeof(int *));
+    int *wall_kind = (int *) malloc((size_t) wall_number * sizeof(int));
     if (wall_kind == NULL) printf("malloc wall_kind fehlgeschlagen \n");
+    params->wall_kind = wall_kind;
     
     int j = 0, ihelper;
     for(int i = 0; i < number_of_walls[0]*4; i += 4) {
@@ -731,12 +1320,17 @@ ray_noise_setup(const vector2 *vv __attribute__((__unused__)),
     }
     fclose(fp);
     //Print out Walls, for debugging    
-    for(int i = 0; i <wall_number[0]; i += 2)  {
+    for(int i = 0; i <wall_number; i += 2)  {
         printf("%i. Wall is (%0.0f,%0.0f) (%0.0f,%0.0f) width = %.2f kind = %i \n", 
         (i/2+1), wall_x[i][0], wall_y[i][0], wall_x[i+1][0], wall_y[i+1][0], wall_width[i], wall_kind[i]);
     }
     printf("Number of walls %.0f \n", number_of_walls[0]);
-    ray_noise_anchors(vv,num);
+    params->wall_array = (int *) calloc(SIZE*SIZE, sizeof(int));
+    if (params->wall_array == NULL) printf("malloc wall fehlgeschlagen");
+    //Mark all Points which are part of a wall
+    tag_wall();
+    wall_grid_build(0.0F);
+    ray_noise_anchors(vv,num,key);
 }
 
 
@@ -745,7 +1339,7 @@ __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
 ray_noise_isWall(int wall[][SIZE], int zahl) {
     for (int i = 0; i<zahl; i++) {
    	    for(int j = 0; j<zahl;j++) {
-       	    wall[i][j] = wall_array[i+SIZE*j];
+       	    wall[i][j] = ray_noise_params->wall_array[i+SIZE*j];
    	    }
    	}
 }
@@ -754,7 +1348,7 @@ ray_noise_isWall(int wall[][SIZE], int zahl) {
 
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(1,8)))
-ray_noise_error(__m128i *restrict seed,
+ray_noise_error(ls2_rng_t *restrict seed,
                 const size_t anchors,
                 const VECTOR *restrict distances __attribute__((__unused__)),
                 const VECTOR *restrict  vx __attribute__((__unused__)),
@@ -775,28 +1369,27 @@ ray_noise_error(__m128i *restrict seed,
         
         int x = (int) tagx[0];
         int y = (int) tagy[0];           
-        float lhelp = length_array[get(x,y, (int)k)];
+        float lhelp = ray_noise_params->length[get(x,y, (int)k)];
         VECTOR l = VECTOR_BROADCAST(&lhelp);
         result[k] = l + rn;
     } 
     //For debugging
-    if (tagx[0]==999 && tagy[0]==999 && printhelper == 0){
+    if (tagx[0]==999 && tagy[0]==999 && ray_noise_params->printed == 0){
         
-        printf("Rays created n =  %i \n", counter2);
-        printf("counter3 =  %i \n", counter3);
+        printf("Rays created n =  %i \n", ray_noise_params->rays);
         
         int x = 800;
         int y = 490;       
         
-        printf("length anker 1 x = %i y = %i %f \n",x,y, length_array[get(x,y,0)] );
-        printf("length anker 2 x = %i y = %i %f \n",x,y, length_array[get(x,y,1)] );
-        printf("length anker 3 x = %i y = %i %f \n",x,y, length_array[get(x,y,2)] );
-        printf("strength anker 1 x = %i y = %i %f \n",x,y, strength_array[get(x,y,0)] );
-        printf("strength anker 2 x = %i y = %i %f \n",x,y, strength_array[get(x,y,1)] );
-        printf("strength anker 3 x = %i y = %i %f \n",x,y, strength_array[get(x,y,2)] );
+        printf("length anker 1 x = %i y = %i %f \n",x,y, ray_noise_params->length[get(x,y,0)] );
+        printf("length anker 2 x = %i y = %i %f \n",x,y, ray_noise_params->length[get(x,y,1)] );
+        printf("length anker 3 x = %i y = %i %f \n",x,y, ray_noise_params->length[get(x,y,2)] );
+        printf("strength anker 1 x = %i y = %i %f \n",x,y, ray_noise_params->strength[get(x,y,0)] );
+        printf("strength anker 2 x = %i y = %i %f \n",x,y, ray_noise_params->strength[get(x,y,1)] );
+        printf("strength anker 3 x = %i y = %i %f \n",x,y, ray_noise_params->strength[get(x,y,2)] );
         
         //printf("return 1 =  %i \n", counter);
         //printf("who often is wall_cross_check called =  %i \n", counter3);
-        printhelper++;
+        ray_noise_params->printed++;
     }
 }
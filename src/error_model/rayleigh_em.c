@@ -38,14 +38,21 @@
 #include "../util/util_random.c"
 
 /* Mean value is scale * sqrtf(M_PI / 2.0f). */
-static float rayleigh_scale = 39.8942280401f;
+typedef struct rayleigh_params_t {
+    float scale;
+    VECTOR scale_vector;
+} rayleigh_params_t;
 
-static VECTOR rayleigh_scale_vector;
+static rayleigh_params_t rayleigh_defaults = {
+    .scale = 39.8942280401f
+};
+
+static __thread rayleigh_params_t *rayleigh_params = &rayleigh_defaults;
 
 #if defined(HAVE_POPT_H)
 struct poptOption rayleigh_arguments[] = {
         { "rayleigh-scale", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &rayleigh_scale, 0,
+          &rayleigh_defaults.scale, 0,
           "scale parameter of the Rayleigh noise", NULL },
         POPT_TABLEEND
 };
@@ -55,13 +62,13 @@ void
 rayleigh_setup(const vector2 *anchors __attribute__((__unused__)),
                size_t nanchors __attribute__((__unused__)))
 {
-    VECTOR t = VECTOR_CONST_BROADCAST(rayleigh_scale);
-    rayleigh_scale_vector = t;
+    VECTOR t = VECTOR_CONST_BROADCAST(rayleigh_params->scale);
+    rayleigh_params->scale_vector = t;
 }
 
 
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-rayleigh_error(__m128i *restrict seed,
+rayleigh_error(ls2_rng_t *restrict seed,
                const size_t anchors, 
                const VECTOR *restrict distances,
                const VECTOR *restrict vx __attribute__((__unused__)),
@@ -80,7 +87,7 @@ rayleigh_error(__m128i *restrict seed,
         t = VECTOR_LOG(t);
         t *= minus_two;
         t = VECTOR_SQRT(t);
-        t *= rayleigh_scale_vector;
+        t *= rayleigh_params->scale_vector;
       	result[k] = distances[k] + t;
     }
 }
@@ -38,19 +38,27 @@
 #include "../util/util_random.c"
 
 /* Mean value is scale * sqrtf(M_PI / 2.0f). */
-static float weibull_scale = 55.571f;
-static float weibull_shape = 3.5f;
+typedef struct weibull_params_t {
+    float scale;
+    float shape;
+    VECTOR scale_vector;
+    VECTOR shape_vector;
+} weibull_params_t;
+
+static weibull_params_t weibull_defaults = {
+    .scale = 55.571f,
+    .shape = 3.5f
+};
 
-static VECTOR weibull_scale_vector;
-static VECTOR weibull_shape_vector;
+static __thread weibull_params_t *weibull_params = &weibull_defaults;
 
 #if defined(HAVE_POPT_H)
 struct poptOption weibull_arguments[] = {
         { "weibull-scale", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &weibull_scale, 0,
+          &weibull_defaults.scale, 0,
           "scale parameter of the Weibull noise", NULL },
         { "weibull-shape", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &weibull_shape, 0,
+          &weibull_defaults.shape, 0,
           "shape parameter of the Weibull noise", NULL },
         POPT_TABLEEND
 };
@@ -60,15 +68,15 @@ void
 weibull_setup(const vector2 *anchors __attribute__((__unused__)),
                size_t nanchors __attribute__((__unused__)))
 {
-    VECTOR t = VECTOR_CONST_BROADCAST(weibull_scale);
-    weibull_scale_vector = t;
-    VECTOR u = VECTOR_CONST_BROADCAST(weibull_shape);
-    weibull_shape_vector = u;
+    VECTOR t = VECTOR_CONST_BROADCAST(weibull_params->scale);
+    weibull_params->scale_vector = t;
+    VECTOR u = VECTOR_CONST_BROADCAST(weibull_params->shape);
+    weibull_params->shape_vector = u;
 }
 
 
 static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
-weibull_error(__m128i *restrict seed,
+weibull_error(ls2_rng_t *restrict seed,
                const size_t anchors, 
                const VECTOR *restrict distances,
                const VECTOR *restrict vx __attribute__((__unused__)),
@@ -86,8 +94,8 @@ weibull_error(__m128i *restrict seed,
         t = one - t;
         t = VECTOR_LOG(t);
         t = zero - t;
-        t = VECTOR_POW(t, one / weibull_shape_vector);
-        t *= weibull_scale_vector;
+        t = VECTOR_POW(t, one / weibull_params->shape_vector);
+        t *= weibull_params->scale_vector;
       	result[k] = distances[k] + t;
     }
 }
@@ -34,25 +34,33 @@
 
 /* @algorithm_name: CRLB (Qi & Kobayashi) */
 
-static float crlb_malaney_sigma = 3.0f;
-
-static float crlb_malaney_pathloss = 2.0f;
+typedef struct crlb_malaney_params_t {
+    float sigma;
+    float pathloss;
+    float scale;
+} crlb_malaney_params_t;
+
+static crlb_malaney_params_t crlb_malaney_defaults = {
+    .sigma = 3.0f,
+    .pathloss = 2.0f,
+    .scale = 1.0f
+};
 
-static float crlb_malaney_scale = 1.0f;
+static __thread crlb_malaney_params_t *crlb_malaney_params = &crlb_malaney_defaults;
 
 #if HAVE_POPT_H
 struct poptOption crlb_malaney_arguments[] = {
         { "crlb-malaney-noise", 'S',
           POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_malaney_sigma, 0,
+          &crlb_malaney_defaults.sigma, 0,
           "noise variable", NULL },
 	{ "crlb-malaney-exponent", 'n',
           POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_malaney_pathloss, 0,
+          &crlb_malaney_defaults.pathloss, 0,
           "path loss exponent", NULL },
 	{ "crlb-malaney-scale", 'Z',
           POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_malaney_scale, 0,
+          &crlb_malaney_defaults.scale, 0,
           "scale factor for root mean square error", NULL },
         POPT_TABLEEND
 };
@@ -73,7 +81,8 @@ crlb_malaney_run (const vector2 *anchor, const size_t num_anchors,
 	          const vector2 *location)
 {
     const float alpha =
-        (10 * crlb_malaney_pathloss) / (crlb_malaney_sigma * logf(10.0f));
+        (10 * crlb_malaney_params->pathloss) /
+        (crlb_malaney_params->sigma * logf(10.0f));
 
     // Calculate the CRLB
     float numer = 0.0f;
@@ -89,5 +98,5 @@ crlb_malaney_run (const vector2 *anchor, const size_t num_anchors,
 	    denom += a * a / (d * d * e * e);
 	}
     }
-    return crlb_malaney_scale * numer / (alpha * alpha * denom);
+    return crlb_malaney_params->scale * numer / (alpha * alpha * denom);
 }
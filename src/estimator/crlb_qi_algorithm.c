@@ -36,24 +36,32 @@
 
 
 
-// That is 5 million divided by square root of 3, as found in Qi's
-// thesis (p. 18, eq. 2.29)
-static float crlb_qi_beta = 2886751.345948129f;
-
-static float crlb_qi_su = 0.1f;
+typedef struct crlb_qi_params_t {
+    float beta;
+    float su;
+    float scale;
+} crlb_qi_params_t;
+
+static crlb_qi_params_t crlb_qi_defaults = {
+    // That is 5 million divided by square root of 3, as found in Qi's
+    // thesis (p. 18, eq. 2.29)
+    .beta = 2886751.345948129f,
+    .su = 0.1f,
+    .scale = 1.0f
+};
 
-static float crlb_qi_scale = 1.0f;
+static __thread crlb_qi_params_t *crlb_qi_params = &crlb_qi_defaults;
 
 #if HAVE_POPT_H
 struct poptOption crlb_qi_arguments[] = {
         { "bandwidth", 'b', POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_qi_beta, 0,
+          &crlb_qi_defaults.beta, 0,
           "effective bandwidth of the signal waveform", NULL },
 	{ "scale", 's', POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_qi_scale, 0,
+          &crlb_qi_defaults.scale, 0,
           "scale factor for root mean square error", NULL },
 	{ "unit", 'u', POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_qi_su, 0,
+          &crlb_qi_defaults.su, 0,
           "length of a simulation unit in meters", NULL },
         POPT_TABLEEND
 };
@@ -82,10 +90,11 @@ crlb_qi_run(const vector2 *anchor, const size_t count, const vector2 *location)
 {
     const float pi = (float) M_PI;
     // speed of light in su / s, assumes su = 1dm
-    const float c = 299792458.0f / crlb_qi_su;
+    const float c = 299792458.0f / crlb_qi_params->su;
     // Constant alpha of the paper
     const float alpha =
-         (c * c) / (8.0f * pi * pi * crlb_qi_beta * crlb_qi_beta);
+         (c * c) / (8.0f * pi * pi * crlb_qi_params->beta *
+                    crlb_qi_params->beta);
 
     // Calculate the CRLB
     float numer = 0.0f;
@@ -100,5 +109,5 @@ crlb_qi_run(const vector2 *anchor, const size_t count, const vector2 *location)
                        distance_v(location, &(anchor[j])) * a * a;
 	}
     }
-    return crlb_qi_scale * alpha * numer / denom;
+    return crlb_qi_params->scale * alpha * numer / denom;
 }
@@ -34,12 +34,20 @@
 
 /* @algorithm_name: CRLB (H.C. So) */
 
-static float crlb_so_sdev = 30.0f;
+typedef struct crlb_so_params_t {
+    float sdev;
+} crlb_so_params_t;
+
+static crlb_so_params_t crlb_so_defaults = {
+    .sdev = 30.0f
+};
+
+static __thread crlb_so_params_t *crlb_so_params = &crlb_so_defaults;
 
 #if HAVE_POPT_H
 struct poptOption crlb_so_arguments[] = {
 	{ "crlb-so-sdev", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_so_sdev, 0,
+          &crlb_so_defaults.sdev, 0,
           "Standard deviation of the error model", NULL },
         POPT_TABLEEND
 };
@@ -60,7 +68,7 @@ struct poptOption crlb_so_arguments[] = {
 
 /* Compute the Cramer Rao lower bound for TOA based algorithms
  * assuming a normal distribution with standard deviation
- * crlb_so_sdev.
+ * sdev.
  *
  * The formula is given by H.C. So in Chapter 2 of ...
  */
@@ -70,7 +78,7 @@ crlb_so_run(const vector2 *anchor, const size_t num_anchors,
 {
     int s;
     float crlb;
-    const float v = crlb_so_sdev * crlb_so_sdev;
+    const float v = crlb_so_params->sdev * crlb_so_params->sdev;
     gsl_matrix *A = gsl_matrix_calloc(2, 2);
     gsl_matrix *Ai = gsl_matrix_alloc(2, 2);
     gsl_permutation *p = gsl_permutation_alloc(2);
@@ -34,12 +34,20 @@
 
 /* @algorithm_name: CRLB (Zhao Yubin) */
 
-static float crlb_zhao_variance = 25.0f * 25.0f;
+typedef struct crlb_zhao_params_t {
+    float variance;
+} crlb_zhao_params_t;
+
+static crlb_zhao_params_t crlb_zhao_defaults = {
+    .variance = 25.0f * 25.0f
+};
+
+static __thread crlb_zhao_params_t *crlb_zhao_params = &crlb_zhao_defaults;
 
 #if HAVE_POPT_H
 struct poptOption crlb_zhao_arguments[] = {
 	{ "crlb-zhao-variance", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
-          &crlb_zhao_variance, 0,
+          &crlb_zhao_defaults.variance, 0,
           "Variance of the error model", NULL },
         POPT_TABLEEND
 };
@@ -65,13 +73,13 @@ crlb_zhao_run(const vector2 *anchor, const size_t num_anchors,
     for (size_t i = 0; i < num_anchors; i++) {
 	const float X_i = location->x - anchor[i].x;
 	const float Y_i = location->y - anchor[i].y;
-	numer += 1 / crlb_zhao_variance;
+	numer += 1 / crlb_zhao_params->variance;
 	for (size_t j = 0; j < num_anchors; j++) {
 	    const float X_j = location->x - anchor[j].x;
 	    const float Y_j = location->y - anchor[j].y;
 	    denom += (X_i * X_i * Y_j * Y_j - X_i * X_j * Y_i * Y_j) /
                 ((X_i * X_i + Y_i * Y_i) * (X_j * X_j + Y_j * Y_j) *
-		 (crlb_zhao_variance * crlb_zhao_variance));
+		 (crlb_zhao_params->variance * crlb_zhao_params->variance));
 	}
     }
     float crlb = numer / denom;
@@ -97,6 +97,24 @@ def find_error_model_name(em):
     return em
 
 
+def defines_function(f, name):
+    """Checks whether the file f defines the function name."""
+    expr = re.compile("^" + name + "\s*\(")
+    for line in open(f):
+        if expr.match(line):
+            return True
+    return False
+
+
+def defines_type(f, name):
+    """Checks whether the file f defines the type name by a typedef."""
+    expr = re.compile("^}\s*" + name + "\s*;")
+    for line in open(f):
+        if expr.match(line):
+            return True
+    return False
+
+
 def find_command_line_arguments(f):
     """Checks whether an algorithm, estimator, or error model defines command
     line parameters."""
@@ -113,11 +131,14 @@ ests = find_estimators()
 
 lib = open("library.c", "w")
 head = open("ls2/library.h", "w")
+kern = open("kernels.c", "w")
 
 head.writelines([ '/* This file was automatically generated. Do not edit! */\n',
                  '\n',
                 ])
 lib.writelines([ '/* This file was automatically generated. Do not edit! */\n',
+                 '\n',
+                 '#include <stddef.h>\n',
                  '\n'
                ])
 
@@ -162,20 +183,81 @@ lib.writelines([ "    NULL\n",
                  "}\n",
                  "\n" ])
 
-lib.writelines([ 'static inline void __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))\n',
+# An algorithm may keep a state per thread, which it allocates in
+# <alg>_thread_init(anchors, nanchors) and frees in <alg>_thread_free(state).
+# Such an algorithm takes the state as last argument of its run function.
+# The state is NULL if the caller has none, so the algorithm has to cope
+# with that, too.
+stateful = []
+for alg in algs:
+    init = defines_function(algorithm_file(alg), alg + '_thread_init')
+    fini = defines_function(algorithm_file(alg), alg + '_thread_free')
+    if init != fini:
+        sys.exit(algorithm_file(alg) + ': define both ' + alg + '_thread_init and ' + alg + '_thread_free, or neither')
+    if init:
+        stateful.append(alg)
+
+def run_arguments(alg):
+    """The arguments of the run function of an algorithm."""
+    if alg in stateful:
+        return '(vx, vy, r, no_anchors, width, height, resx, resy, state)'
+    return '(vx, vy, r, no_anchors, width, height, resx, resy)'
+
+lib.writelines([ 'static inline void __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(2,3,4,8,9)))\n',
                  'algorithm(algorithm_t alg,\n',
                  '          const VECTOR *restrict vx, const VECTOR *restrict vy, const VECTOR *restrict r,\n',
                  '          size_t no_anchors, int width, int height,\n',
-                 '          VECTOR *restrict resx, VECTOR *restrict resy)\n',
+                 '          VECTOR *restrict resx, VECTOR *restrict resy, void *state)\n',
                  '{\n',
                  '    switch (alg) {\n',
                 ])
-lib.writelines([ '    case ALG_' + alg.upper() + ':\n        ' + alg + '_run(vx, vy, r, no_anchors, width, height, resx, resy);\n        break;\n' for alg in algs ])
+lib.writelines([ '    case ALG_' + alg.upper() + ':\n        ' + alg + '_run' + run_arguments(alg) + ';\n        break;\n' for alg in algs ])
 lib.writelines([ "    }\n",
                  "}\n",
                  "\n",
                ])
 
+lib.writelines([ 'static inline void *\n',
+                 'algorithm_thread_init(algorithm_t alg, const vector2 *anchors, size_t nanchors)\n',
+                 '{\n',
+                 '    switch (alg) {\n',
+                ])
+lib.writelines([ '    case ALG_' + alg.upper() + ':\n        return ' + alg + '_thread_init(anchors, nanchors);\n' for alg in stateful ])
+lib.writelines([ "    default:\n",
+                 "        return NULL;\n",
+                 "    }\n",
+                 "}\n",
+                 "\n",
+               ])
+
+lib.writelines([ 'static inline void\n',
+                 'algorithm_thread_free(algorithm_t alg, void *state)\n',
+                 '{\n',
+                 '    switch (alg) {\n',
+                ])
+lib.writelines([ '    case ALG_' + alg.upper() + ':\n        ' + alg + '_thread_free(state);\n        break;\n' for alg in stateful ])
+lib.writelines([ "    default:\n",
+                 "        break;\n",
+                 "    }\n",
+                 "}\n",
+                 "\n",
+               ])
+
+# An algorithm may define a setup function, which is called once per
+# simulation before the threads are started.
+lib.writelines([ 'static inline void\n',
+                 'algorithm_setup(algorithm_t alg, const vector2 *anchors, size_t nanchors)\n',
+                 '{\n',
+                 '    switch (alg) {\n',
+                ])
+lib.writelines([ '    case ALG_' + alg.upper() + ':\n        ' + alg + '_setup(anchors, nanchors);\n        break;\n' for alg in algs if defines_function(algorithm_file(alg), alg + '_setup') ])
+lib.writelines([ "    default:\n",
+                 "        break;\n",
+                 "    }\n",
+                 "}\n",
+                 "\n",
+               ])
+
 
 head.writelines([ 'typedef enum estimator_t {\n' ])
 head.writelines([ '    EST_' + est.upper() + ',\n' for est in ests ])
@@ -271,7 +353,7 @@ lib.writelines([ "    }\n",
                ])
 
 lib.writelines([ 'static inline void __attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__(2,3,9)))\n',
-                 'error_model(error_model_t model, __m128i *restrict seed, const VECTOR *restrict dist,\n',
+                 'error_model(error_model_t model, ls2_rng_t *restrict seed, const VECTOR *restrict dist,\n',
                  '            const VECTOR *restrict vx, const VECTOR *restrict vy, size_t no_anchors,\n'
                  '            const VECTOR tagx, const VECTOR tagy, VECTOR *restrict result)\n',
                  '{\n',
@@ -283,6 +365,57 @@ lib.writelines([ "    }\n",
                  "\n",
                ])
 
+# A model with options, or with a state built by its setup, defines them
+# in a struct <model>_params_t.  The command line options are stored in
+# <model>_defaults, and the model reads its parameters through the thread
+# local pointer <model>_params, which points to the defaults unless it is
+# bound to the copy of a context.  ls2_model_t holds the parameters of all
+# models, so every context has a copy of its own, and <model>_params_free()
+# releases the state of such a copy if the model defines one.
+models = [ (m, f) for (m, f) in [ (alg, algorithm_file(alg)) for alg in algs ] +
+                                [ (em, error_model_file(em)) for em in ems ] +
+                                [ (est, estimator_file(est)) for est in ests ]
+           if defines_type(f, m + '_params_t') ]
+
+lib.write('typedef struct ls2_model_t {\n')
+lib.writelines([ '    ' + m + '_params_t ' + m + '_params;\n' for (m, f) in models ])
+lib.writelines([ '} ls2_model_t;\n',
+                 '\n',
+                 '/* The defaults of the parameters and their places in an ls2_model_t. */\n',
+                 'static const struct {\n',
+                 '    void *defaults;\n',
+                 '    size_t size;\n',
+                 '    size_t offset;\n',
+                 '} ls2_model_parameters[] __attribute__((__unused__)) = {\n',
+               ])
+lib.writelines([ '    { &' + m + '_defaults, sizeof(' + m + '_params_t), offsetof(ls2_model_t, ' + m + '_params) },\n' for (m, f) in models ])
+lib.writelines([ '    { NULL, 0, 0 }\n',
+                 '};\n',
+                 '\n',
+                 '/* Let the models in the calling thread use the parameters in model,\n',
+                 '   or their defaults if model is NULL. */\n',
+                 'static inline void\n',
+                 'ls2_model_bind(ls2_model_t *model)\n',
+                 '{\n',
+                 '    if (model == NULL) {\n',
+               ])
+lib.writelines([ '        ' + m + '_params = &' + m + '_defaults;\n' for (m, f) in models ])
+lib.writelines([ '    } else {\n' ])
+lib.writelines([ '        ' + m + '_params = &(model->' + m + '_params);\n' for (m, f) in models ])
+lib.writelines([ '    }\n',
+                 '}\n',
+                 '\n',
+                 '/* Release the states the setups of the models built in model. */\n',
+                 'static inline void\n',
+                 'ls2_model_free(ls2_model_t *model)\n',
+                 '{\n',
+               ])
+lib.writelines([ '    ' + m + '_params_free(&(model->' + m + '_params));\n' for (m, f) in models if defines_function(f, m + '_params_free') ])
+lib.writelines([ '    (void) model;\n',
+                 '}\n',
+                 '\n',
+               ])
+
 # Collect and write out the command line parameter tables if each file
 # defines one.
 lib.write("#if HAVE_POPT_H\nstruct poptOption algorithm_arguments[] = {\n")
@@ -308,7 +441,55 @@ for est in ests:
 lib.write("    POPT_TABLEEND\n};\n#endif\n")
 
 
+# Instantiate the kernel of the location based simulation for the hot
+# pairs of algorithm and error model, see shooter_kernel.c.  Inlining
+# only pays off when the algorithm is cheap next to the error model:
+# bench-kernels measures 1.2x to 3.5x for the pairs below and nothing
+# beyond noise for the others.  Instantiating every pair made
+# shooter_run.c take minutes to compile, so all other pairs use the
+# generic kernel, which ls2_shooter_kernel() signals by NULL.
+cheap_algs = [ 'const', 'centroid', 'trilateration', 'minmax', 'llsq',
+               'eminmax_w2', 'eminmax_w4', 'weighted_minmax', 'md_minmax_abs' ]
+hot_kernels = [ (alg, em) for alg in algs for em in ems
+                if alg == 'const' or (alg in cheap_algs and em == 'ab_nlos') ]
+
+def kernel_name(alg, em):
+    if (alg, em) in hot_kernels:
+        return 'ls2_shooter_run_' + alg + '_' + em
+    return 'NULL'
+
+kern.writelines([ '/* This file was automatically generated. Do not edit! */\n',
+                  '\n'
+                ])
+for (alg, em) in hot_kernels:
+    kern.writelines([ '#define LS2_KERNEL_NAME ' + kernel_name(alg, em) + '\n',
+                      '#define LS2_KERNEL_ERROR ' + em + '_error\n',
+                      '#define LS2_KERNEL_ALGORITHM(alg, vx, vy, r, no_anchors, width, height, resx, resy, state) \\\n',
+                      '    ' + alg + '_run' + run_arguments(alg) + '\n',
+                      '#define LS2_KERNEL_ALGORITHMS 1\n',
+                      '#include "shooter_kernel.c"\n',
+                      '\n'
+                    ])
+kern.write('static const ls2_kernel_t ls2_shooter_kernels[][' + str(len(ems)) + '] = {\n')
+for alg in algs:
+    kern.write('    { ' + string.join([ kernel_name(alg, em) for em in ems ], ',\n      ') + ' },\n')
+kern.writelines([ '};\n',
+                  '\n',
+                  '/*\n',
+                  ' * Returns the specialised kernel of alg and em, or NULL if the pair\n',
+                  ' * has none and must use the generic kernel ls2_shooter_run.\n',
+                  ' */\n',
+                  'static inline ls2_kernel_t __attribute__((__const__))\n',
+                  'ls2_shooter_kernel(algorithm_t alg, error_model_t em)\n',
+                  '{\n',
+                  '    return ls2_shooter_kernels[alg][em];\n',
+                  '}\n'
+                ])
+
+
 head.flush()
 head.close()
 lib.flush()
 lib.close()
+kern.flush()
+kern.close()
@@ -46,6 +46,7 @@
 
 
 static char *file[2];
+static char *algorithm[2];
 static char *compare[NUM_VARIANTS];
 static double similarity = 3.0;
 static double dynamic = 200.0;
@@ -60,6 +61,10 @@ static struct poptOption cli_options[] = {
        &similarity, 0, "similarity threshold", NULL },
      { "dynamic", 'D', POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT,
        &dynamic, 0, "dynamic range", NULL },
+     { "algorithm1", 0, POPT_ARG_STRING, &algorithm[0], 0,
+       "algorithm to read from the first file", "name" },
+     { "algorithm2", 0, POPT_ARG_STRING, &algorithm[1], 0,
+       "algorithm to read from the second file", "name" },
      { "average", 'o', POPT_ARG_STRING, &(compare[AVERAGE_ERROR]), 0,
        "compare average values.", NULL },
      { "maximum", 'M', POPT_ARG_STRING, &(compare[MAXIMUM_ERROR]), 0,
@@ -136,11 +141,13 @@ main(int argc, const char **argv)
      for (ls2_output_variant var = AVERAGE_ERROR; var < NUM_VARIANTS; var++) {
           if (compare[var] == NULL)
               continue;
-	  ls2_hdf5_read_locbased(file[0], var, &a_anchors, &a_no_anchors,
-				 &a_results, &a_width, &a_height);
+	  ls2_hdf5_read_locbased_algorithm(file[0], algorithm[0], var,
+					   &a_anchors, &a_no_anchors,
+					   &a_results, &a_width, &a_height);
 
-	  ls2_hdf5_read_locbased(file[1], var, &b_anchors, &b_no_anchors,
-				 &b_results, &b_width, &b_height);
+	  ls2_hdf5_read_locbased_algorithm(file[1], algorithm[1], var,
+					   &b_anchors, &b_no_anchors,
+					   &b_results, &b_width, &b_height);
 	  if (a_width != b_width || a_height != b_height) {
 	       fprintf(stderr, "Sizes differ. Cannot continue.\n");
 	       exit(EXIT_FAILURE);
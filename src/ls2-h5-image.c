@@ -47,6 +47,7 @@
 static char const *output_format;           /* Format of the output files. */ 
 static char const *output[NUM_VARIANTS];    /* Names of output files.      */
 static char const *input_hdf5;              /* Name of raw input files.    */
+static char const *algorithm;     /* Algorithm of a file of several ones. */
 static char const *inverted;      /* Name of inverted density output file. */
 
 static int stride = 10;
@@ -88,6 +89,30 @@ int main(int argc, const char* argv[])
           POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &(output[FAILURES]), 0,
           "name of the failure rate output image file", "file name" },
+        { "output-median", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[MEDIAN_ERROR]), 0,
+          "name of the median error output image file", "file name" },
+        { "output-p90", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[ERROR_P90]), 0,
+          "name of the output image file of the 90th percentile of the error",
+          "file name" },
+        { "output-p95", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[ERROR_P95]), 0,
+          "name of the output image file of the 95th percentile of the error",
+          "file name" },
+        { "output-p99", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[ERROR_P99]), 0,
+          "name of the output image file of the 99th percentile of the error",
+          "file name" },
+        { "output-quantile", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[QUANTILE_ERROR]), 0,
+          "name of the output image file of the quantile of the error",
+          "file name" },
         { "output-phase", 'z',
           POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &(output[AVERAGE_X_ERROR]), 0,
@@ -96,6 +121,8 @@ int main(int argc, const char* argv[])
           POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
           &stride, 0,
           "stride of the phase portrait", "steps" },
+        { "algorithm", 'a', POPT_ARG_STRING, &algorithm, 0,
+          "algorithm to read from a file of several algorithms", "name" },
         { "inverted", 'i', POPT_ARG_STRING, &inverted, 0,
           "name of the inverted density file", "file name" },
         { "maximum", 0,
@@ -158,10 +185,10 @@ int main(int argc, const char* argv[])
                     continue;
                 if (var == AVERAGE_X_ERROR) {
                     float *dx, *dy;
-                    ls2_hdf5_read_locbased(input_hdf5, AVERAGE_X_ERROR,
+                    ls2_hdf5_read_locbased_algorithm(input_hdf5, algorithm, AVERAGE_X_ERROR,
                                            &anchors, &no_anchors, &dx,
                                            &width, &height);
-                    ls2_hdf5_read_locbased(input_hdf5, AVERAGE_Y_ERROR,
+                    ls2_hdf5_read_locbased_algorithm(input_hdf5, algorithm, AVERAGE_Y_ERROR,
                                            NULL, NULL, &dy,
                                            &width, &height);
                     ls2_cairo_write_pdf_phase_portrait(output[var], anchors,
@@ -172,7 +199,7 @@ int main(int argc, const char* argv[])
                 } else {
                     float *results;
 
-	            ls2_hdf5_read_locbased(input_hdf5, var, &anchors, &no_anchors,
+	            ls2_hdf5_read_locbased_algorithm(input_hdf5, algorithm, var, &anchors, &no_anchors,
 				           &results, &width, &height);
 	            float mu, sigma, min, max;
 	            ls2_statistics(results, (size_t) width * height,
@@ -30,6 +30,9 @@
 
 #include <immintrin.h>
 
+#include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -89,12 +92,25 @@ static char const *estimator;
 #else
 static char const *algorithm;
 static char const *error_model;
+static char const *normal_sampler;
 static int inverted;
 static int relative;
 static float tag_x;
 static float tag_y;
+static char const *tag_list;
+static int tag_grid;
 static long seed;
 static long runs;
+static char const *batch;
+static char const *batch_variants;
+static char const *roi;
+static ls2_region_t region;                     /* The parsed --roi.      */
+static int stride;
+static int tile_size;
+static float adaptive_tolerance;
+static int min_runs;
+static float quantile;
+static ls2_normal_sampler_t sampler;            /* The --normal-sampler. */
 #endif
 static int arg_width;
 static int arg_height;
@@ -106,10 +122,673 @@ static int ls2_progress;
 static char const *output_format;             /* Format of the output files. */ 
 static char const *output[NUM_VARIANTS];      /* Names of output files.      */
 static char const *output_hdf5;               /* Names of raw output files.  */
+static char const *hdf5_filter;               /* Compression of HDF5 files.  */
 
 double ls2_backend_steps;
 
 
+#if !defined(ESTIMATOR)
+/*!
+ * Split the comma separated list of algorithms into names and algs.
+ * Returns the number of algorithms, or -1 if one is unknown or there
+ * are too many.  The names point into the returned copy of list.
+ */
+static int __attribute__((__nonnull__))
+parse_algorithms(const char *list, char **copy,
+                 const char *names[LS2_MAX_ALGORITHMS],
+                 algorithm_t algs[LS2_MAX_ALGORITHMS])
+{
+    char *save = NULL;
+    int n = 0;
+
+    *copy = strdup(list);
+    if (*copy == NULL) {
+        perror("strdup()");
+        exit(EXIT_FAILURE);
+    }
+    for (char *name = strtok_r(*copy, ",", &save); name != NULL;
+         name = strtok_r(NULL, ",", &save)) {
+        if (n == LS2_MAX_ALGORITHMS) {
+            fprintf(stderr, "Too many algorithms, at most %d are supported\n",
+                    LS2_MAX_ALGORITHMS);
+            return -1;
+        }
+        const int alg = get_algorithm_by_name(name);
+        if (alg < 0) {
+            fprintf(stderr, "Algorithm \"%s\" unknown, choose one of "
+                    ALGORITHMS "\n", name);
+            return -1;
+        }
+        names[n] = name;
+        algs[n] = (algorithm_t) alg;
+        n++;
+    }
+    if (n == 0)
+        fprintf(stderr, "No algorithm given, choose one of " ALGORITHMS "\n");
+    return (n > 0) ? n : -1;
+}
+
+
+
+/*!
+ * The name of the output file of the algorithm alg if there are several
+ * ones, which is name with "-alg" inserted before the extension.
+ */
+static const char * __attribute__((__nonnull__))
+output_name(char *buffer, const size_t size, const char *name,
+            const char *alg, const int num_algs)
+{
+    if (num_algs == 1)
+        return name;
+    const char *slash = strrchr(name, '/');
+    const char *dot = strrchr(name, '.');
+    if (dot == NULL || (slash != NULL && dot < slash))
+        dot = name + strlen(name);
+    snprintf(buffer, size, "%.*s-%s%s", (int) (dot - name), name, alg, dot);
+    return buffer;
+}
+
+
+
+/*!
+ * Select the algorithms, the error model and the normal sampler named by
+ * the options.  Returns the number of algorithms, or -1 if a name is
+ * unknown.  The names of the algorithms point into *algorithm_list.
+ */
+static int __attribute__((__nonnull__))
+select_models(char **algorithm_list, const char *names[LS2_MAX_ALGORITHMS],
+              algorithm_t algs[LS2_MAX_ALGORITHMS], int *em)
+{
+    const int num_algs = parse_algorithms(algorithm, algorithm_list, names,
+                                          algs);
+    if (num_algs < 0)
+        return -1;
+    *em = get_error_model_by_name(error_model);
+    if (*em < 0) {
+        fprintf(stderr, "Error model \"%s\" unknown, choose one of "
+                ERROR_MODELS "\n", error_model);
+        return -1;
+    }
+    sampler = ls2_get_normal_sampler_by_name(normal_sampler);
+    if ((int) sampler < 0) {
+        fprintf(stderr, "Normal sampler \"%s\" unknown, choose one of "
+                "ziggurat, box-muller\n", normal_sampler);
+        return -1;
+    }
+    return num_algs;
+}
+
+
+
+/*!
+ * Set region to the region x0,y0,x1,y1 of the option --roi, or to the
+ * whole field without it.  Returns -1 if the region is malformed.
+ */
+static int
+select_region(void)
+{
+    const ls2_region_t all = { 0, 0, INT_MAX, INT_MAX };
+    ls2_region_t r;
+    char end;
+
+    region = all;
+    if (roi == NULL)
+        return 0;
+    if (sscanf(roi, "%d,%d,%d,%d %c", &r.x0, &r.y0, &r.x1, &r.y1,
+               &end) != 4 || r.x0 < 0 || r.y0 < 0 || r.x1 <= r.x0 ||
+        r.y1 <= r.y0) {
+        fprintf(stderr, "Region \"%s\" is not of the form x0,y0,x1,y1 "
+                "with x0 < x1 and y0 < y1.\n", roi);
+        return -1;
+    }
+    region = r;
+    return 0;
+}
+
+
+
+/*! Pass the settings of the command line to ctx. */
+static void __attribute__((__nonnull__))
+configure_context(ls2_context_t *ctx)
+{
+    ls2_context_set_tile_size(ctx, tile_size);
+    ls2_context_set_roi(ctx, region);
+    ls2_context_set_stride(ctx, stride);
+    ls2_context_set_adaptive_tolerance(ctx, adaptive_tolerance);
+    ls2_context_set_min_runs(ctx, min_runs);
+    ls2_context_set_quantile(ctx, quantile);
+    ls2_context_set_normal_sampler(ctx, sampler);
+    ls2_context_set_seed(ctx, seed);
+}
+
+
+
+/*! Print the mean errors, and the runs if sampling is adaptive. */
+static void __attribute__((__nonnull__))
+print_statistics(float *results[][NUM_VARIANTS], const char *const *names,
+                 const int num_algs, const uint16_t width,
+                 const uint16_t height)
+{
+    for (int a = 0; a < num_algs; a++) {
+        float mu, sigma, min, max;
+        if (num_algs > 1)
+            fprintf(stdout, "%s: ", names[a]);
+        if (results[a][AVERAGE_ERROR] != NULL) {
+            ls2_statistics(results[a][AVERAGE_ERROR], (size_t) width * height,
+                           &mu, &sigma, &min, &max);
+            fprintf(stdout, "MAE = %f, sdev = %f, min = %f, max = %f\n",
+                    mu, sigma, min, max);
+            fflush(stderr);
+        }
+        if (results[a][RUNS_USED] != NULL && adaptive_tolerance > 0.0F) {
+            ls2_statistics(results[a][RUNS_USED], (size_t) width * height,
+                           &mu, &sigma, &min, &max);
+            fprintf(stdout, "runs per pixel: mean = %f, min = %f, max = %f\n",
+                    mu, min, max);
+        }
+    }
+}
+
+
+
+/*!
+ * The tags of the inverted simulation of several tags: the positions in
+ * tag_list, separated by semicolons, with the coordinates of a position
+ * separated by a comma, or the centres of the cells of a grid of tag_grid
+ * pixels on the playing field.  Returns the number of tags, or 0 if the
+ * list is malformed.
+ */
+static size_t __attribute__((__nonnull__))
+get_tags(vector2 **tags, const int width, const int height)
+{
+    size_t n = 0;
+
+    if (tag_list != NULL) {
+        char *copy = strdup(tag_list), *save = NULL;
+        *tags = calloc(strlen(tag_list) / 3 + 1, sizeof(vector2));
+        if (copy == NULL || *tags == NULL) {
+            perror("get_tags()");
+            exit(EXIT_FAILURE);
+        }
+        for (char *tag = strtok_r(copy, ";", &save); tag != NULL;
+             tag = strtok_r(NULL, ";", &save)) {
+            char end;
+            if (sscanf(tag, "%f,%f %c", &(*tags)[n].x, &(*tags)[n].y,
+                       &end) != 2) {
+                fprintf(stderr, "Tag \"%s\" is not of the form x,y.\n", tag);
+                n = 0;
+                break;
+            }
+            n++;
+        }
+        free(copy);
+    } else {
+        const int nx = (width + tag_grid - 1) / tag_grid;
+        const int ny = (height + tag_grid - 1) / tag_grid;
+        *tags = calloc((size_t) nx * (size_t) ny, sizeof(vector2));
+        if (*tags == NULL) {
+            perror("get_tags()");
+            exit(EXIT_FAILURE);
+        }
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++, n++) {
+                (*tags)[n].x = (float) (x * tag_grid + tag_grid / 2);
+                (*tags)[n].y = (float) (y * tag_grid + tag_grid / 2);
+            }
+        }
+    }
+    return n;
+}
+
+
+
+/* Where the results of the tags go. */
+typedef struct tags_output_t {
+    const vector2 *tags;
+    const char *filename;
+    uint16_t width, height;
+} tags_output_t;
+
+
+/*! Print the results of tag k and add them to the hdf output file. */
+static void
+store_tag(void *arg, const size_t k, const uint64_t *result,
+          const float center_x, const float sdev_x, const float center_y,
+          const float sdev_y)
+{
+    const tags_output_t *out = (const tags_output_t *) arg;
+    const vector2 *tag = &(out->tags[k]);
+
+    fprintf(stdout, "Tag %zu (%f, %f): centroid (%f, %f), standard "
+            "deviations (%f, %f), mean average error %f\n", k, tag->x,
+            tag->y, center_x, center_y, sdev_x, sdev_y,
+            distance_s(tag->x, tag->y, center_x, center_y));
+    ls2_hdf5_write_inverted_tag(out->filename, k, tag->x, tag->y, result,
+                                out->width, out->height, center_x, center_y,
+                                sdev_x, sdev_y);
+}
+#endif
+
+
+
+/*! Print the wall-clock time since start and the CPU time used. */
+static void __attribute__((__nonnull__))
+print_times(const struct timeval *start, const struct timeval *end)
+{
+    struct rusage resources;
+    getrusage(RUSAGE_SELF, &resources);
+    fprintf(stdout, "real %.6f s, user %lu.%06lu s, sys %lu.%06lu s\n",
+            (double) (end->tv_sec - start->tv_sec) +
+              (double) (end->tv_usec - start->tv_usec) / 1000000.0,
+            resources.ru_utime.tv_sec, resources.ru_utime.tv_usec,
+            resources.ru_stime.tv_sec, resources.ru_stime.tv_usec);
+    fflush(stdout);
+}
+
+
+
+#if HAVE_POPT_H
+/*!
+ * Read the coordinates of the anchors left over in con.  Returns the
+ * number of anchors, or 0 if there are too few or too many.
+ */
+static size_t __attribute__((__nonnull__))
+get_anchors(poptContext con, vector2 anchors[MAX_ANCHORS])
+{
+    char const* anchor[MAX_ANCHORS*2+1];/* anchor parameters                */
+    uint16_t no_anchor_args = 0; /* number of anchor parameters seen.       */
+
+    while (no_anchor_args < 2 * MAX_ANCHORS && poptPeekArg(con) != NULL) {
+        anchor[no_anchor_args] = poptGetArg(con);
+        no_anchor_args++;
+    }
+
+    if (no_anchor_args < 6) {
+        fprintf(stderr, "insufficient number of anchor coordinates.\n");
+        return 0;
+    }
+
+    if (no_anchor_args % 2 != 0) {
+        fprintf(stderr, "missing anchor coordinate.\n");
+        return 0;
+    }
+
+    if (no_anchor_args == 2 * MAX_ANCHORS && poptPeekArg(con) != NULL) {
+        fprintf(stderr, "too many anchors.\n");
+        return 0;
+    }
+
+    // parse and normalize anchor coordinates
+    for (int i = 0, j = 0; i < no_anchor_args; i += 2, j++) {
+	    anchors[j].x = (float) strtoul(anchor[i],   NULL, 10);
+	    anchors[j].y = (float) strtoul(anchor[i+1], NULL, 10);
+    }
+    return no_anchor_args / 2;
+}
+#endif
+
+
+
+#if HAVE_POPT_H && !defined(ESTIMATOR)
+/*
+ * Batch mode.  The options of a scenario are restored to those of the
+ * command line before its line is parsed.  The values of the options
+ * are saved to a buffer in the order of a walk through the tables.
+ */
+
+/* The options the setup of the error model and the algorithms uses. */
+static struct poptOption setup_options[] = {
+    { NULL, '\0', POPT_ARG_INCLUDE_TABLE, algorithm_arguments, 0, NULL, NULL },
+    { NULL, '\0', POPT_ARG_INCLUDE_TABLE, error_model_arguments, 0, NULL,
+      NULL },
+    { "normal-sampler", 0, POPT_ARG_STRING, &normal_sampler, 0, NULL, NULL },
+    POPT_TABLEEND
+};
+
+
+
+/*! The size of the value of opt, 0 if it has none. */
+static size_t __attribute__((__nonnull__,__pure__))
+option_size(const struct poptOption *opt)
+{
+    if (opt->arg == NULL)
+        return 0;
+    switch (opt->argInfo & POPT_ARG_MASK) {
+    case POPT_ARG_NONE:
+    case POPT_ARG_INT:
+    case POPT_ARG_VAL:
+        return sizeof(int);
+    case POPT_ARG_LONG:
+        return sizeof(long);
+    case POPT_ARG_STRING:
+        return sizeof(char *);
+    case POPT_ARG_FLOAT:
+        return sizeof(float);
+    case POPT_ARG_DOUBLE:
+        return sizeof(double);
+    default:
+        return 0;
+    }
+}
+
+
+
+/*!
+ * Save the values of the options in table and in the tables it includes
+ * to values at *offset, or restore them from there.  values may be NULL
+ * to compute the size only.  Returns the offset after the values.
+ */
+static size_t __attribute__((__nonnull__(1)))
+options_copy(const struct poptOption *table, unsigned char *values,
+             size_t offset, const bool restore)
+{
+    for (const struct poptOption *opt = table;
+         opt->longName != NULL || opt->shortName != '\0' || opt->arg != NULL;
+         opt++) {
+        if ((opt->argInfo & POPT_ARG_MASK) == POPT_ARG_INCLUDE_TABLE) {
+            if (opt->arg != NULL)
+                offset = options_copy(opt->arg, values, offset, restore);
+            continue;
+        }
+        const size_t n = option_size(opt);
+        if (values != NULL && n > 0) {
+            if (restore)
+                memcpy(opt->arg, values + offset, n);
+            else
+                memcpy(values + offset, opt->arg, n);
+        }
+        offset += n;
+    }
+    return offset;
+}
+
+
+
+/*!
+ * Whether the values of the options in table differ in a and b, both
+ * saved by options_copy() at *offset.  Strings are compared by content.
+ */
+static bool __attribute__((__nonnull__))
+options_differ(const struct poptOption *table, const unsigned char *a,
+               const unsigned char *b, size_t *offset)
+{
+    bool differ = false;
+
+    for (const struct poptOption *opt = table;
+         opt->longName != NULL || opt->shortName != '\0' || opt->arg != NULL;
+         opt++) {
+        if ((opt->argInfo & POPT_ARG_MASK) == POPT_ARG_INCLUDE_TABLE) {
+            if (opt->arg != NULL)
+                differ |= options_differ(opt->arg, a, b, offset);
+            continue;
+        }
+        const size_t n = option_size(opt);
+        if (n == 0)
+            continue;
+        if ((opt->argInfo & POPT_ARG_MASK) == POPT_ARG_STRING) {
+            const char *s, *t;
+            memcpy(&s, a + *offset, n);
+            memcpy(&t, b + *offset, n);
+            differ |= (s == NULL || t == NULL) ? s != t : strcmp(s, t) != 0;
+        } else {
+            differ |= memcmp(a + *offset, b + *offset, n) != 0;
+        }
+        *offset += n;
+    }
+    return differ;
+}
+
+
+
+/*!
+ * Select the variants named in the comma separated list, by their names
+ * in the hdf output file, or all of them for "all".  Returns -1 if a
+ * name is unknown.
+ */
+static int __attribute__((__nonnull__))
+parse_variants(const char *list, bool wanted[NUM_VARIANTS])
+{
+    static const char *const names[NUM_VARIANTS] = {
+#undef  LS2OUT_VARIANT
+#define LS2OUT_VARIANT(tag, name, h5name) h5name,
+#include "ls2/output-variants.h"
+    };
+    const bool all = strcasecmp(list, "all") == 0;
+    char *save = NULL;
+    int rc = 0;
+
+    for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++)
+        wanted[var] = all;
+    if (all)
+        return 0;
+    char *copy = strdup(list);
+    if (copy == NULL) {
+        perror("strdup()");
+        exit(EXIT_FAILURE);
+    }
+    for (char *name = strtok_r(copy, ",", &save); name != NULL && rc == 0;
+         name = strtok_r(NULL, ",", &save)) {
+        ls2_output_variant var = 0;
+        while (var < NUM_VARIANTS && strcasecmp(name, names[var]) != 0)
+            var++;
+        if (var == NUM_VARIANTS) {
+            fprintf(stderr, "Variant \"%s\" unknown\n", name);
+            rc = -1;
+        } else {
+            wanted[var] = true;
+        }
+    }
+    free(copy);
+    return rc;
+}
+
+
+
+/*!
+ * Make results hold the wanted variants of num_algs algorithms for
+ * pixels pixels, and NULL for all others, so that the simulation only
+ * computes those.  The results point into buffers, which only grow and
+ * hold *capacity pixels each.
+ */
+static void __attribute__((__nonnull__))
+reserve_results(float *buffers[][NUM_VARIANTS],
+                float *results[][NUM_VARIANTS], size_t *capacity,
+                const int num_algs, const size_t pixels,
+                const bool wanted[NUM_VARIANTS])
+{
+    if (pixels > *capacity) {
+        for (int a = 0; a < LS2_MAX_ALGORITHMS; a++) {
+            for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
+                free(buffers[a][var]);
+                buffers[a][var] = NULL;
+            }
+        }
+        *capacity = pixels;
+    }
+    for (int a = 0; a < LS2_MAX_ALGORITHMS; a++) {
+        for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
+            results[a][var] = NULL;
+            if (a >= num_algs || !wanted[var])
+                continue;
+            if (buffers[a][var] == NULL &&
+                posix_memalign((void**)&(buffers[a][var]), ALIGNMENT,
+                               *capacity * sizeof(float)) != 0) {
+                perror("posix_memalign()");
+                exit(EXIT_FAILURE);
+            }
+            results[a][var] = buffers[a][var];
+        }
+    }
+}
+
+
+
+/*!
+ * Run the scenarios of the file name, one per line, and write the results
+ * of each one to its own group of the hdf output file.  A line has the
+ * syntax of the command line: options, which override those of the
+ * command line for this scenario, and the coordinates of the anchors.
+ * Empty lines and lines starting with # are skipped.  The scenarios share
+ * the threads and the result buffers, and the error model and the
+ * algorithms are set up again only if their inputs change.  Returns the
+ * number of scenarios which could not be run.
+ */
+static int __attribute__((__nonnull__))
+run_batch(ls2_context_t *ctx, const char *name, const char *program,
+          const struct poptOption *options)
+{
+    const char *hdf5 = output_hdf5;
+    float *buffers[LS2_MAX_ALGORITHMS][NUM_VARIANTS];
+    float *results[LS2_MAX_ALGORITHMS][NUM_VARIANTS];
+    float **result_ptrs[LS2_MAX_ALGORITHMS];
+    size_t capacity = 0;        /* Pixels of the result buffers.       */
+    size_t line_no = 0, scenario = 0;
+    int failed = 0;
+
+    FILE *file = fopen(name, "r");
+    if (file == NULL) {
+        perror(name);
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t size = options_copy(options, NULL, 0, false);
+    const size_t setup_size = options_copy(setup_options, NULL, 0, false);
+    unsigned char *defaults = malloc(size);
+    unsigned char *setup = malloc(2 * setup_size);
+    if (defaults == NULL || setup == NULL) {
+        perror("malloc()");
+        exit(EXIT_FAILURE);
+    }
+    options_copy(options, defaults, 0, false);
+    unsigned char *previous = setup, *current = setup + setup_size;
+
+    memset(buffers, 0, sizeof(buffers));
+    memset(results, 0, sizeof(results));
+    for (int a = 0; a < LS2_MAX_ALGORITHMS; a++)
+        result_ptrs[a] = results[a];
+
+    ls2_hdf5_create_batch(hdf5);
+
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_size, file)) >= 0) {
+        line_no++;
+        while (length > 0 && isspace((unsigned char) line[length - 1]))
+            line[--length] = '\0';
+        const char *text = line + strspn(line, " \t");
+        if (*text == '\0' || *text == '#')
+            continue;
+
+        int argc, rc;
+        const char **argv;
+        options_copy(options, defaults, 0, true);
+        if ((rc = poptParseArgvString(text, &argc, &argv)) < 0) {
+            fprintf(stderr, "%s:%zu: %s\n", name, line_no, poptStrerror(rc));
+            failed++;
+            continue;
+        }
+        const char *args[argc + 1];
+        args[0] = program;
+        memcpy(&args[1], argv, (size_t) argc * sizeof(args[0]));
+        poptContext con = poptGetContext(program, argc + 1, args, options, 0);
+        while ((rc = poptGetNextOpt(con)) >= 0)
+            ;
+
+        vector2 anchors[MAX_ANCHORS];
+        size_t no_anchors = 0;
+        char *algorithm_list = NULL;
+        const char *alg_names[LS2_MAX_ALGORITHMS];
+        algorithm_t algs[LS2_MAX_ALGORITHMS];
+        bool wanted[NUM_VARIANTS];
+        int num_algs = -1, em = 0;
+        if (rc < -1) {
+            fprintf(stderr, "%s: %s\n",
+                    poptBadOption(con, POPT_BADOPTION_NOALIAS),
+                    poptStrerror(rc));
+        } else if (inverted != 0) {
+            fprintf(stderr, "The batch mode runs no inverted simulations.\n");
+        } else if ((no_anchors = get_anchors(con, anchors)) > 0 &&
+                   ls2_hdf5_set_filter(hdf5_filter) == 0) {
+            num_algs = select_models(&algorithm_list, alg_names, algs, &em);
+            if (num_algs >= 0 && (select_region() < 0 ||
+                                  parse_variants(batch_variants, wanted) < 0))
+                num_algs = -1;
+        } else if (no_anchors > 0) {
+            fprintf(stderr, "HDF5 filter \"%s\" unknown, choose one of "
+                    LS2_HDF5_FILTERS "\n", hdf5_filter);
+        }
+
+        if (num_algs < 0) {
+            fprintf(stderr, "%s:%zu: scenario skipped\n", name, line_no);
+            failed++;
+        } else {
+            const uint16_t width = (uint16_t) arg_width;
+            const uint16_t height = (uint16_t) arg_height;
+            reserve_results(buffers, results, &capacity, num_algs,
+                            (size_t) width * height, wanted);
+
+            const long t = iceil((long) runs, (long) VECTOR_OPS);
+            if (t != runs) {
+                runs = t;
+                fprintf(stderr, "warning: number of runs rounded to %ld\n",
+                        runs);
+            }
+
+            // The context compares strings by address, keep those of the
+            // previous scenario if they have the same contents.
+            size_t offset = 0;
+            options_copy(setup_options, current, 0, false);
+            if (scenario > 0 &&
+                !options_differ(setup_options, previous, current, &offset)) {
+                options_copy(setup_options, previous, 0, true);
+            } else {
+                unsigned char *swap = previous;
+                previous = current;
+                current = swap;
+            }
+            ls2_context_load_options(ctx);
+            configure_context(ctx);
+
+            if (ls2_progress != 0) {
+                ls2_initialize_progress_bar(ctx, (size_t) runs *
+                                            ls2_context_pixels(ctx, width,
+                                                               height),
+                                            algorithm);
+            }
+            ls2_distribute_work_shooter_multi(ctx, algs, (size_t) num_algs,
+                                              (error_model_t) em, runs,
+                                              anchors, no_anchors,
+                                              result_ptrs, width, height);
+            if (ls2_progress != 0) {
+                ls2_stop_progress_bar(ctx);
+            }
+
+            ls2_hdf5_write_scenario(hdf5, scenario, text, anchors, no_anchors,
+                                    alg_names, result_ptrs, (size_t) num_algs,
+                                    width, height);
+            fprintf(stdout, "Scenario %zu: ", scenario);
+            print_statistics(results, alg_names, num_algs, width, height);
+            fflush(stdout);
+            scenario++;
+        }
+        free(algorithm_list);
+        poptFreeContext(con);
+        free(argv);
+    }
+
+    free(line);
+    fclose(file);
+    free(setup);
+    free(defaults);
+    for (int a = 0; a < LS2_MAX_ALGORITHMS; a++)
+        for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++)
+            free(buffers[a][var]);
+    return failed;
+}
+#endif
+
+
 
 int
 main(int argc, const char* argv[])
@@ -119,12 +798,14 @@ main(int argc, const char* argv[])
     poptContext opt_con;        /* context for parsing command-line options */
     int rc;
 #endif
-    char const* anchor[MAX_ANCHORS*2+1];/* anchor parameters                */
-    float *results[NUM_VARIANTS]; /* Array holding the results. */
+    float *results[LS2_MAX_ALGORITHMS][NUM_VARIANTS]; /* The results of each algorithm. */
+#if !defined(ESTIMATOR)
+    float **result_ptrs[LS2_MAX_ALGORITHMS];
+#endif
 #if !defined(ESITMATOR)
     uint64_t *result = NULL;  /* Array holding the result of inverted calculation. */
 #endif
-    uint16_t no_anchor_args = 0; /* number of anchor parameters seen.       */
+    size_t no_anchors = 0;       /* number of anchors.                     */
 #if !defined(ESTIMATOR)
     /* Center of mass of estimations (inverted only) */
     float center_x, sdev_x, center_y, sdev_y;
@@ -141,6 +822,12 @@ main(int argc, const char* argv[])
         { "y", 'y', POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
           &tag_y, 0,
           "Y coordinate of the tag.", NULL },
+        { "tags", 0, POPT_ARG_STRING, &tag_list, 0,
+          "positions of several tags, separated by semicolons, whose "
+          "results are written to the hdf output file", "x,y;x,y;..." },
+        { "tag-grid", 0, POPT_ARG_INT, &tag_grid, 0,
+          "place a tag in the centre of each cell of a grid with this "
+          "spacing, like --tags", "pixels" },
         POPT_TABLEEND
     };
 #  endif
@@ -151,10 +838,15 @@ main(int argc, const char* argv[])
 #    if !defined(ESTIMATOR)
        { "algorithm", 'a', POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &algorithm, 0,
-          "selects the algorithm (one of: " ALGORITHMS ")", NULL },
+          "selects the algorithm (one of: " ALGORITHMS "), or a comma "
+          "separated list of algorithms run on the same ranges", NULL },
         { "error-model", 'e', POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &error_model, 0,
           "selects the error model (one of: " ERROR_MODELS ")", NULL },
+        { "normal-sampler", 0, POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &normal_sampler, 0,
+          "sampler of the normal distribution (one of: ziggurat, "
+          "box-muller)", NULL },
         { "inverted", 'i', POPT_ARG_NONE,
           &inverted, 0,
           "run the inverted version of the algorithm", NULL },
@@ -163,6 +855,16 @@ main(int argc, const char* argv[])
           "Use a relative density representation", NULL },
         { "progress", 'P', POPT_ARG_NONE, &ls2_progress, 0,
           "Periodically report progress", NULL },
+        { "tile-size", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+          &tile_size, 0,
+          "edge length of the tiles distributed to the threads", "pixels" },
+        { "roi", 0, POPT_ARG_STRING, &roi, 0,
+          "simulate only the pixels x0 <= x < x1 and y0 <= y < y1, the "
+          "others are NaN", "x0,y0,x1,y1" },
+        { "stride", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+          &stride, 0,
+          "simulate every stride-th pixel of every stride-th row, the "
+          "others are NaN", "pixels" },
 #    else
         { "estimator", 'e', POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &estimator, 0,
@@ -201,6 +903,35 @@ main(int argc, const char* argv[])
           POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &(output[ROOT_MEAN_SQUARED_ERROR]), 0,
           "name of the root mean squared error output image", "file name" },
+        { "output-runs", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[RUNS_USED]), 0,
+          "name of the output image file of the runs used per pixel",
+          "file name" },
+        { "output-median", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[MEDIAN_ERROR]), 0,
+          "name of the median error output image file", "file name" },
+        { "output-p90", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[ERROR_P90]), 0,
+          "name of the output image file of the 90th percentile of the error",
+          "file name" },
+        { "output-p95", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[ERROR_P95]), 0,
+          "name of the output image file of the 95th percentile of the error",
+          "file name" },
+        { "output-p99", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[ERROR_P99]), 0,
+          "name of the output image file of the 99th percentile of the error",
+          "file name" },
+        { "output-quantile", 0,
+          POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &(output[QUANTILE_ERROR]), 0,
+          "name of the output image file of the quantile of the error "
+          "given by --quantile", "file name" },
 #  else
         { "output", 'o',
           POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
@@ -211,6 +942,23 @@ main(int argc, const char* argv[])
           POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
           &output_hdf5, 0,
           "name of the hdf output file for raw result data", "file name" },
+#  if !defined(ESTIMATOR)
+        { "batch", 'b', POPT_ARG_STRING, &batch, 0,
+          "run the scenarios of the file, one per line of options and "
+          "anchor coordinates, into the hdf output file", "file name" },
+        { "batch-variants", 0, POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &batch_variants, 0,
+          "comma separated names of the variants the batch mode computes "
+          "and writes to the hdf output file, or all", "names" },
+#  endif
+        { "hdf5-filter", 0, POPT_ARG_STRING | POPT_ARGFLAG_SHOW_DEFAULT,
+          &hdf5_filter, 0,
+          "compression of the hdf output file (one of: " LS2_HDF5_FILTERS ")",
+          "filter" },
+        { "hdf5-chunk", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+          &ls2_hdf5_chunk_size, 0,
+          "edge length of the square chunks of the hdf output file",
+          "pixels" },
 #  if !defined(ESTIMATOR)
         { "seed", 0, POPT_ARG_LONG, &seed, 0,
           "seed to use for the pseudo random number generators. Default"
@@ -218,8 +966,22 @@ main(int argc, const char* argv[])
           "seed" },
         { "runs", 'r', POPT_ARG_LONG | POPT_ARGFLAG_SHOW_DEFAULT,
           &runs, 0,
-          "number of runs per pixel (must be divisible by 8)",
+          "number of runs per pixel (must be divisible by 8), the maximum "
+          "if adaptive sampling is enabled",
           "number of runs" },
+        { "adaptive-tolerance", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
+          &adaptive_tolerance, 0,
+          "stop sampling a pixel once the standard error of its average "
+          "error is below this value, 0 disables adaptive sampling",
+          "distance" },
+        { "min-runs", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+          &min_runs, 0,
+          "number of runs per pixel before adaptive sampling may stop",
+          "number of runs" },
+        { "quantile", 0, POPT_ARG_FLOAT | POPT_ARGFLAG_SHOW_DEFAULT,
+          &quantile, 0,
+          "quantile of the error written by --output-quantile, between 0 "
+          "and 1", "fraction" },
 #  endif
         { "threads", 't', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
           &num_threads, 0,
@@ -254,14 +1016,22 @@ main(int argc, const char* argv[])
     num_threads = NUM_THREADS;
 #endif
     output_format = "png";
+    hdf5_filter = "deflate=9";
 #if !defined(ESTIMATOR)
     algorithm = ALGORITHM_DEFAULT;
     error_model = ERROR_MODEL_DEFAULT;
+    normal_sampler = "ziggurat";
+    batch_variants = "Average_Error,Standard_Deviation,Maximum_Error,"
+        "Minimum_Error,Failures,Runs_Used";
     tag_x = (float) arg_width / 2.0F;
     tag_y = (float) arg_height / 2.0F;
     output[AVERAGE_ERROR] = OUTPUT_DEFAULT;
     runs = RUNS;
     seed = time(NULL);
+    stride = 1;
+    tile_size = DEFAULT_TILE_SIZE;
+    min_runs = DEFAULT_MIN_RUNS;
+    quantile = DEFAULT_QUANTILE;
 #else
     estimator = ESTIMATOR_DEFAULT;
     output[ROOT_MEAN_SQUARED_ERROR] = OUTPUT_DEFAULT;
@@ -295,53 +1065,60 @@ main(int argc, const char* argv[])
         exit(EXIT_FAILURE);
     }
 
-    // Handle the left-over arguments.
-    while (no_anchor_args < 2 * MAX_ANCHORS && poptPeekArg(opt_con) != NULL) {
-        anchor[no_anchor_args] = poptGetArg(opt_con);
-        no_anchor_args++;
-    }
-
-    if (no_anchor_args < 6) {
-        fprintf(stderr, "insufficient number of anchor coordinates.\n");
-        poptFreeContext(opt_con);
-        exit(EXIT_FAILURE);
-    }
-
-    if (no_anchor_args % 2 != 0) {
-        fprintf(stderr, "missing anchor coordinate.\n");
+#  if !defined(ESTIMATOR)
+    if (batch != NULL) {
+        if (output_hdf5 == NULL || *output_hdf5 == '\0') {
+            fprintf(stderr, "The batch mode needs an hdf output file.\n");
+            poptFreeContext(opt_con);
+            exit(EXIT_FAILURE);
+        }
+        ls2_context_t *ctx = ls2_context_new(MAX(num_threads, 1));
+        gettimeofday(&start_tv, NULL);
+        const int failed = run_batch(ctx, batch, argv[0], cli_options);
+        gettimeofday(&end_tv, NULL);
+        print_times(&start_tv, &end_tv);
+        ls2_context_free(ctx);
         poptFreeContext(opt_con);
-        exit(EXIT_FAILURE);
+        exit(failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
     }
+#  endif
 
-    if (no_anchor_args == 2 * MAX_ANCHORS && poptPeekArg(opt_con) != NULL) {
-        fprintf(stderr, "too many anchors.\n");
+    // Handle the left-over arguments.
+    anchors = calloc(MAX_ANCHORS, sizeof(vector2));
+    no_anchors = get_anchors(opt_con, anchors);
+    if (no_anchors == 0) {
         poptFreeContext(opt_con);
         exit(EXIT_FAILURE);
     }
+#else
+    anchors = calloc(MAX_ANCHORS, sizeof(vector2));
 #endif
 
-    // parse and normalize anchor coordinates
-    const size_t no_anchors = no_anchor_args / 2;
-
-    anchors = calloc(no_anchors, sizeof(vector2));
-    for (int i = 0, j = 0; i < no_anchor_args; i += 2, j++) {
-	    anchors[j].x = (float) strtoul(anchor[i],   NULL, 10);
-	    anchors[j].y = (float) strtoul(anchor[i+1], NULL, 10);
-    }
-
 #if !defined(ESTIMATOR)
-    int alg = get_algorithm_by_name(algorithm);
-    if (alg < 0) {
-        fprintf(stderr, "Algorithm \"%s\" unknown, choose one of " ALGORITHMS
-                "\n", algorithm);
+    char *algorithm_list;
+    const char *alg_names[LS2_MAX_ALGORITHMS];
+    algorithm_t algs[LS2_MAX_ALGORITHMS];
+    int em;
+    const int num_algs = select_models(&algorithm_list, alg_names, algs, &em);
+    if (num_algs < 0 || select_region() < 0) {
         exit(EXIT_FAILURE);
     }
-    int em = get_error_model_by_name(error_model);
-    if (em < 0) {
-        fprintf(stderr, "Error model \"%s\" unknown, choose one of "
-                ERROR_MODELS "\n", error_model);
+    if (inverted != 0 && num_algs > 1) {
+        fprintf(stderr, "The inverted simulation runs one algorithm only.\n");
         exit(EXIT_FAILURE);
     }
+    vector2 *tags = NULL;       /* The tags of an inverted simulation of   */
+    size_t no_tags = 0;         /* several ones, if requested.             */
+    if (inverted != 0 && (tag_list != NULL || tag_grid > 0)) {
+        if (output_hdf5 == NULL || *output_hdf5 == '\0') {
+            fprintf(stderr, "Several tags need an hdf output file.\n");
+            exit(EXIT_FAILURE);
+        }
+        no_tags = get_tags(&tags, arg_width, arg_height);
+        if (no_tags == 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
 #else
     int est = get_estimator_by_name(estimator);
     if (est < 0) {
@@ -350,6 +1127,11 @@ main(int argc, const char* argv[])
         exit(EXIT_FAILURE);
     }    
 #endif
+    if (ls2_hdf5_set_filter(hdf5_filter) < 0) {
+        fprintf(stderr, "HDF5 filter \"%s\" unknown, choose one of "
+                LS2_HDF5_FILTERS "\n", hdf5_filter);
+        exit(EXIT_FAILURE);
+    }
 
     if (ls2_verbose >= 1) {
 #if !defined(ESTIMATOR)
@@ -381,17 +1163,22 @@ main(int argc, const char* argv[])
     const size_t sz = ((size_t) width) * ((size_t) height) * sizeof(float);
     memset(results, 0, sizeof(results));
 #if !defined(ESTIMATOR)
+    for (int a = 0; a < LS2_MAX_ALGORITHMS; a++)
+        result_ptrs[a] = results[a];
     if (inverted == 0) {
-        for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
-            if ((output[var] != NULL && *output[var] != '\0') ||
-                (output_hdf5 != NULL && *output_hdf5 != '\0')) {
-                if (posix_memalign((void**)&(results[var]), ALIGNMENT, sz) != 0) {
-	            perror("posix_memalign()");
-	            exit(EXIT_FAILURE);
+        for (int a = 0; a < num_algs; a++) {
+            for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
+                if ((output[var] != NULL && *output[var] != '\0') ||
+                    (output_hdf5 != NULL && *output_hdf5 != '\0')) {
+                    if (posix_memalign((void**)&(results[a][var]), ALIGNMENT,
+                                       sz) != 0) {
+                        perror("posix_memalign()");
+                        exit(EXIT_FAILURE);
+                    }
                 }
             }
         }
-    } else {
+    } else if (no_tags == 0) {
         const size_t s = (size_t) width * (size_t) height * sizeof(uint64_t);
         if (posix_memalign((void**)&(result), ALIGNMENT, s) != 0) {
 	    perror("posix_memalign()");
@@ -399,21 +1186,21 @@ main(int argc, const char* argv[])
         }
     }
 #else
-    if (posix_memalign((void**)&(results[ROOT_MEAN_SQUARED_ERROR]), ALIGNMENT, sz) != 0) {
+    if (posix_memalign((void**)&(results[0][ROOT_MEAN_SQUARED_ERROR]), ALIGNMENT, sz) != 0) {
       perror("posix_memalign()");
       exit(EXIT_FAILURE);
     }
+#endif
+    ls2_context_t *ctx = ls2_context_new(num_threads);
+#if !defined(ESTIMATOR)
+    configure_context(ctx);
 #endif
     gettimeofday(&start_tv, NULL);
 
 #if !defined(ESTIMATOR)
     /* Sanitize the number of runs. */
     do {
-        long t;
-        if (inverted == 0)
-            t = iceil((long) runs, (long) VECTOR_OPS);
-        else
-            t = iceil((long) runs, (long) num_threads * VECTOR_OPS);
+        const long t = iceil((long) runs, (long) VECTOR_OPS);
         if (t != runs) {
     	    runs = t;
     	    fprintf(stderr, "warning: number of runs rounded to %ld\n", runs);
@@ -422,46 +1209,52 @@ main(int argc, const char* argv[])
 
     if (inverted == 0) {
 	if (ls2_progress != 0) {
-	    ls2_initialize_progress_bar((size_t) (runs * height * width),
+	    ls2_initialize_progress_bar(ctx, (size_t) runs *
+                                        ls2_context_pixels(ctx, width, height),
                                         algorithm);
 	}
-	ls2_distribute_work_shooter(alg, em, num_threads, runs, seed, anchors,
-				    no_anchors, results, width, height);
+	ls2_distribute_work_shooter_multi(ctx, algs, (size_t) num_algs, em,
+                                          runs, anchors, no_anchors,
+                                          result_ptrs, width, height);
+    } else if (no_tags > 0) {
+	if (ls2_progress != 0) {
+	    char buffer[32];
+	    snprintf(buffer, 31, "inverted %s", algorithm);
+	    ls2_initialize_progress_bar(ctx, (size_t) runs * no_tags, buffer);
+	}
+        tags_output_t out = { .tags = tags, .filename = output_hdf5,
+                              .width = width, .height = height };
+        ls2_hdf5_create_inverted_tags(output_hdf5, anchors, no_anchors);
+        ls2_distribute_work_inverted_tags(ctx, algs[0], em, runs, tags,
+                                          no_tags, anchors, no_anchors,
+                                          width, height, store_tag, &out);
     } else {
 	if (ls2_progress != 0) {
 	    char buffer[32];
 	    snprintf(buffer, 31, "inverted %s", algorithm);
-	    ls2_initialize_progress_bar((size_t) runs, buffer);
+	    ls2_initialize_progress_bar(ctx, (size_t) runs, buffer);
 	}
-	ls2_distribute_work_inverted(alg, em, num_threads, runs, seed,
-                                     tag_x, tag_y,
+	ls2_distribute_work_inverted(ctx, algs[0], em, runs, tag_x, tag_y,
 				     anchors, no_anchors, result, width,
 				     height, &center_x, &sdev_x,
                                      &center_y, &sdev_y);
     }
 #else
-    ls2_distribute_work_estimator(est, num_threads, anchors, no_anchors,
-				  results, width, height);
+    ls2_distribute_work_estimator(ctx, est, anchors, no_anchors,
+				  results[0], width, height);
 #endif
 
     gettimeofday(&end_tv, NULL);
 
 #if !defined(ESTIMATOR)
     if (ls2_progress != 0) {
-        ls2_stop_progress_bar();
+        ls2_stop_progress_bar(ctx);
     }
 
     // calculate average
     if (inverted == 0) {
-	float mu, sigma, min, max;
-        if (results[AVERAGE_ERROR] != NULL) {
-	    ls2_statistics(results[AVERAGE_ERROR], (size_t) width * height,
-		           &mu, &sigma, &min, &max);
-	    fprintf(stdout, "MAE = %f, sdev = %f, min = %f, max = %f\n",
-		    mu, sigma, min, max);
-            fflush(stderr);
-        }
-    } else {
+        print_statistics(results, alg_names, num_algs, width, height);
+    } else if (no_tags == 0) {
 	fprintf(stdout, "Centroid of location estimations: (%f, %f)"
                         "\n    standard deviations: (%f, %f)\n"
                         "    mean average error: %f\n",
@@ -470,31 +1263,35 @@ main(int argc, const char* argv[])
     }
 #endif
 
-    struct rusage resources;
-    getrusage(RUSAGE_SELF, &resources);
-    fprintf(stdout, "real %.6f s, user %lu.%06lu s, sys %lu.%06lu s\n",
-            (double) (end_tv.tv_sec - start_tv.tv_sec) +
-              (double) (end_tv.tv_usec - start_tv.tv_usec) / 1000000.0,
-            resources.ru_utime.tv_sec, resources.ru_utime.tv_usec,
-            resources.ru_stime.tv_sec, resources.ru_stime.tv_usec);
-    fflush(stdout);
+    print_times(&start_tv, &end_tv);
 
 #if !defined(ESTIMATOR)
     if (inverted == 0) {
-#endif
-        for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
-            if (output[var] != NULL && *(output[var]) != '\0') {
-	      ls2_write_locbased(get_output_format(output_format), output[var],
-				 anchors, no_anchors,
-				 results[var], width, height);
+        for (int a = 0; a < num_algs; a++) {
+            for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
+                if (output[var] != NULL && *(output[var]) != '\0') {
+                    char name[FILENAME_MAX];
+                    ls2_write_locbased(get_output_format(output_format),
+                                       output_name(name, sizeof(name),
+                                                   output[var], alg_names[a],
+                                                   num_algs),
+                                       anchors, no_anchors,
+                                       results[a][var], width, height);
+                }
             }
         }
         if (output_hdf5 != NULL && *output_hdf5 != '\0') {
-	    ls2_hdf5_write_locbased(output_hdf5, anchors, no_anchors, results,
-                                    width, height);
+            if (num_algs == 1)
+                ls2_hdf5_write_locbased(output_hdf5, anchors, no_anchors,
+                                        results[0], width, height);
+            else
+                ls2_hdf5_write_locbased_algorithms(output_hdf5, anchors,
+                                                   no_anchors, alg_names,
+                                                   result_ptrs,
+                                                   (size_t) num_algs,
+                                                   width, height);
         }
-#if !defined(ESTIMATOR)
-    } else {
+    } else if (no_tags == 0) {
         if (relative) {
 	    ls2_write_inverted(get_output_format(output_format), output[0],
 			       0, tag_x, tag_y, anchors, no_anchors,
@@ -510,11 +1307,27 @@ main(int argc, const char* argv[])
                                     center_x, center_y);
         }
     }
+    free(tags);
+    free(algorithm_list);
+#else
+    for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
+        if (output[var] != NULL && *(output[var]) != '\0') {
+	  ls2_write_locbased(get_output_format(output_format), output[var],
+			     anchors, no_anchors,
+			     results[0][var], width, height);
+        }
+    }
+    if (output_hdf5 != NULL && *output_hdf5 != '\0') {
+	ls2_hdf5_write_locbased(output_hdf5, anchors, no_anchors, results[0],
+                                width, height);
+    }
 #endif
     // clean-ups.
+    ls2_context_free(ctx);
     free(anchors);
-    for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++)
-        free(results[var]);
+    for (int a = 0; a < LS2_MAX_ALGORITHMS; a++)
+        for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++)
+            free(results[a][var]);
     free(result);
 #if HAVE_POPT_H
     poptFreeContext(opt_con);
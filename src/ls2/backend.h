@@ -152,11 +152,65 @@ ls2_openexr_write_diff(const char *filename, const vector2 *anchors,
                        const size_t no_anchors, const float *results,
                        const uint16_t width, const uint16_t height);
 
+/*! The compression of the datasets written to HDF5 files. */
+typedef enum ls2_hdf5_filter_t {
+    LS2_HDF5_NONE,              /*!< Store the chunks uncompressed.    */
+    LS2_HDF5_DEFLATE,           /*!< zlib, level 0 to 9 (default 9).   */
+    LS2_HDF5_SHUFFLE_DEFLATE,   /*!< Byte shuffling followed by zlib.  */
+    LS2_HDF5_LZ4,               /*!< LZ4 filter plugin (id 32004).     */
+    LS2_HDF5_ZSTD               /*!< Zstandard filter plugin (id 32015). */
+} ls2_hdf5_filter_t;
+
+#define LS2_HDF5_FILTERS "none, deflate[=level], shuffle+deflate[=level], " \
+    "lz4, zstd[=level]"
+
+/*! The filter and its level used by the HDF5 writers. */
+extern ls2_hdf5_filter_t ls2_hdf5_filter;
+extern int ls2_hdf5_level;
+
+/*! Edge length of the square chunks of the HDF5 datasets. */
+extern int ls2_hdf5_chunk_size;
+
+/*! Select the filter of the HDF5 writers by a name of LS2_HDF5_FILTERS,
+ *  returns -1 if the name or the level is invalid. */
+extern int
+ls2_hdf5_set_filter(const char *spec);
+
 extern void
 ls2_hdf5_write_locbased(const char *filename, const vector2 *anchors,
                         const size_t no_anchors, float **results,
                         const uint16_t width, const uint16_t height);
 
+/*! Write the results of several algorithms, run on the same ranges, to
+ *  one file.  The variants of algorithms[a] are in /Result/algorithms[a]. */
+extern void
+ls2_hdf5_write_locbased_algorithms(const char *filename,
+                                   const vector2 *anchors,
+                                   const size_t no_anchors,
+                                   const char *const *algorithms,
+                                   float **const results[],
+                                   const size_t num_algorithms,
+                                   const uint16_t width, const uint16_t height);
+
+/*! Create the file of the scenarios of a batch, with an empty group
+ *  /Scenario. */
+extern void
+ls2_hdf5_create_batch(const char *filename);
+
+/*! Add the results of a scenario of a batch to the file of
+ *  ls2_hdf5_create_batch().  The group /Scenario/<scenario> holds the
+ *  anchors and results, laid out like the files of
+ *  ls2_hdf5_write_locbased() for one algorithm and those of
+ *  ls2_hdf5_write_locbased_algorithms() for several ones, and the
+ *  description in its attribute "Scenario". */
+extern void
+ls2_hdf5_write_scenario(const char *filename, const size_t scenario,
+                        const char *description,
+                        const vector2 *anchors, const size_t no_anchors,
+                        const char *const *algorithms,
+                        float **const results[], const size_t num_algorithms,
+                        const uint16_t width, const uint16_t height);
+
 extern void 
 ls2_hdf5_write_inverted(const char* filename,
                         const float tag_x, const float tag_y,
@@ -165,6 +219,24 @@ ls2_hdf5_write_inverted(const char* filename,
                         const uint16_t width, const uint16_t height,
     			const double center_x, const double center_y);
 
+/*! Create the file of an inverted simulation of several tags, with the
+ *  anchors and an empty group /Tags. */
+extern void
+ls2_hdf5_create_inverted_tags(const char *filename, const vector2 *anchors,
+                              const size_t no_anchors);
+
+/*! Add the results of tag k to the file of
+ *  ls2_hdf5_create_inverted_tags().  The group /Tags/<k> holds the
+ *  position of the tag in Tag, the centroid and the standard deviations
+ *  of the estimates in Center and Sdev, and their Frequencies. */
+extern void
+ls2_hdf5_write_inverted_tag(const char *filename, const size_t k,
+                            const float tag_x, const float tag_y,
+                            const uint64_t *restrict result,
+                            const uint16_t width, const uint16_t height,
+                            const double center_x, const double center_y,
+                            const double sdev_x, const double sdev_y);
+
 extern int
 ls2_hdf5_write_diff(const char *filename, const vector2 *anchors,
                     const size_t no_anchors, const float *results[],
@@ -175,6 +247,16 @@ ls2_hdf5_read_locbased(const char *filename, ls2_output_variant variant,
                        vector2 **anchors, size_t *no_anchors,
                        float **results, uint16_t *width, uint16_t *height);
 
+/*! Read a variant of algorithm from a file of
+ *  ls2_hdf5_write_locbased_algorithms(), or of ls2_hdf5_write_locbased()
+ *  if algorithm is NULL. */
+extern int
+ls2_hdf5_read_locbased_algorithm(const char *filename, const char *algorithm,
+                                 ls2_output_variant variant,
+                                 vector2 **anchors, size_t *no_anchors,
+                                 float **results, uint16_t *width,
+                                 uint16_t *height);
+
 extern int __attribute__((__nonnull__))
 ls2_hdf5_read_inverted(const char *filename, float *tag_x, float *tag_y,
                        vector2 **anchors, size_t *no_anchors,
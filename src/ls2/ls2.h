@@ -27,6 +27,24 @@
 #  define MAX_ANCHORS 16
 #endif
 
+// The number of algorithms which can be run on the same ranges.
+#ifndef LS2_MAX_ALGORITHMS
+#  define LS2_MAX_ALGORITHMS 16
+#endif
+
+// The defaults of the settings of a context, see ls2_context_set_*().
+#ifndef DEFAULT_TILE_SIZE
+#  define DEFAULT_TILE_SIZE 16
+#endif
+
+#ifndef DEFAULT_MIN_RUNS
+#  define DEFAULT_MIN_RUNS 64
+#endif
+
+#ifndef DEFAULT_QUANTILE
+#  define DEFAULT_QUANTILE 0.999F
+#endif
+
 #ifndef MIN
 #  define MIN(a,b) ((a) < (b) ? (a) : (b))
 #endif
@@ -57,6 +75,25 @@ typedef struct vector2 {
 /*! Whether to collect statistics about this thread */
 extern int ls2_verbose;
 
+/*! A rectangle [x0, x1) x [y0, y1) of the playing field. */
+typedef struct ls2_region_t {
+    int x0, y0, x1, y1;
+} ls2_region_t;
+
+/*! The methods to sample the normal distribution. */
+typedef enum ls2_normal_sampler_t {
+    LS2_NORMAL_ZIGGURAT,    /*!< Vectorised Ziggurat method (default). */
+    LS2_NORMAL_BOX_MULLER   /*!< Box-Muller transform. */
+} ls2_normal_sampler_t;
+
+/*! The method the error models use to sample normal distributions in
+ *  threads outside of a context, see ls2_context_set_normal_sampler(). */
+extern ls2_normal_sampler_t ls2_normal_sampler;
+
+/*! Returns the sampler called name, or -1 if there is none. */
+extern ls2_normal_sampler_t
+ls2_get_normal_sampler_by_name(const char *name);
+
 
 extern algorithm_t
 get_algorithm_by_name(const char *)  __attribute__((__const__));
@@ -87,25 +124,119 @@ ls2_get_view_by_name(const char *name);
 
 
 
-void ls2_initialize_progress_bar(size_t __total, const char *__algorithm);
-void ls2_stop_progress_bar(void);
+/*!
+ * A context of simulations.  It owns the worker threads, the progress, the
+ * seed and the parameters of the models of the simulations run with it.
+ * Simulations with different contexts may run at the same time, one
+ * context runs one simulation at a time.
+ */
+typedef struct ls2_context_t ls2_context_t;
+
+/*!
+ * Create a context with num_threads worker threads.  It takes the options
+ * of the models and ls2_verbose from their current values, seeds with the
+ * current time and has the default settings: the whole field, every
+ * pixel, tiles of DEFAULT_TILE_SIZE, no adaptive sampling, the quantile
+ * DEFAULT_QUANTILE and the Ziggurat sampler.
+ */
+extern ls2_context_t *
+ls2_context_new(const int num_threads);
+
+/*! Stop the threads of ctx and free it. */
+extern void
+ls2_context_free(ls2_context_t *ctx);
+
+/*! Seed the random numbers of the simulations of ctx. */
+extern void __attribute__((__nonnull__))
+ls2_context_set_seed(ls2_context_t *ctx, const long seed);
+
+/*! Edge length of the square tiles the worker threads of ctx take from
+ *  their queues, a value <= 0 selects DEFAULT_TILE_SIZE. */
+extern void __attribute__((__nonnull__))
+ls2_context_set_tile_size(ls2_context_t *ctx, const int tile_size);
+
+/*! The location based simulations of ctx evaluate the pixels of roi,
+ *  clipped to the field, on the grid with spacing stride starting at its
+ *  corner (x0, y0).  The results of the other pixels are NaN. */
+extern void __attribute__((__nonnull__))
+ls2_context_set_roi(ls2_context_t *ctx, const ls2_region_t roi);
+
+extern void __attribute__((__nonnull__))
+ls2_context_set_stride(ls2_context_t *ctx, const int stride);
+
+/*! Stop sampling a pixel once the standard error of its average error is
+ *  below tolerance, but not before min_runs runs.  A tolerance of 0
+ *  disables adaptive sampling. */
+extern void __attribute__((__nonnull__))
+ls2_context_set_adaptive_tolerance(ls2_context_t *ctx, const float tolerance);
+
+extern void __attribute__((__nonnull__))
+ls2_context_set_min_runs(ls2_context_t *ctx, const int min_runs);
+
+/*! The quantile of the distance error in QUANTILE_ERROR, from 0 to 1. */
+extern void __attribute__((__nonnull__))
+ls2_context_set_quantile(ls2_context_t *ctx, const float quantile);
+
+/*! The method the error models use to sample normal distributions in the
+ *  simulations of ctx. */
+extern void __attribute__((__nonnull__))
+ls2_context_set_normal_sampler(ls2_context_t *ctx,
+                               const ls2_normal_sampler_t sampler);
+
+/*!
+ * Take the options of the models and ls2_verbose from their current
+ * values again, as ls2_context_new() does.  The error model and the
+ * algorithms are set up again if one of their options changed.
+ */
+extern void __attribute__((__nonnull__))
+ls2_context_load_options(ls2_context_t *ctx);
+
+/*!
+ * Set the option of a model called name, as on the command line, to value
+ * in ctx only.  A string value has to live as long as ctx.  If several
+ * models have an option called name, the first one gets it.
+ *
+ * \return 0 on success, -1 if there is no such option or value is invalid.
+ */
+extern int __attribute__((__nonnull__))
+ls2_context_set_option(ls2_context_t *ctx, const char *name,
+                       const char *value);
+
+/*! The number of pixels a location based simulation of a width x height
+ *  field with ctx evaluates, for the total of the progress bar. */
+extern size_t __attribute__((__nonnull__))
+ls2_context_pixels(ls2_context_t *ctx, const int width, const int height);
+
+/*! Cancel the computation running with ctx, returns 1 if there is one. */
+extern int __attribute__((__nonnull__))
+ls2_context_cancel(ls2_context_t *ctx);
 
 /*!
- * Returns the progress information.
+ * Returns the progress information of ctx.
  *
  * \param[out] threads  The number of currently active threads.
  * \return     Fraction of progress between 0 and 1.
  */
-double get_progress(int *threads);
+extern double __attribute__((__nonnull__(1)))
+ls2_context_progress(ls2_context_t *ctx, int *threads);
+
+
+/*!
+ * Draw a progress bar of the next simulation of ctx to stderr, from a
+ * thread of its own, until ls2_stop_progress_bar() is called.
+ */
+void ls2_initialize_progress_bar(ls2_context_t *__ctx, size_t __total,
+                                 const char *__algorithm);
+void ls2_stop_progress_bar(ls2_context_t *__ctx);
 
 
 /*!
  * \brief Estimates the position for each place on the playing field.
  *
+ * \param[in] ctx        The context to run the simulation with.
  * \param[in] alg        A number that indicates the position estimation
  *                       algorithm.
  * \param[in] em         A number that indicates the error model.
- * \param[in] num_threads  Number of threads to use.
  * \param[in] runs      Number of runs per location on the discrete grid.
  * \param[in] anchors    Array of anchors nodes of length [no_anchors].
  * \param[in] no_anchors The number of anchor nodes to use.
@@ -116,21 +247,47 @@ double get_progress(int *threads);
  *                       values.
  * \param[in] width      Width of the playing field.
  * \param[in] height     Height of the playing field.
+ *
+ * The error model and the algorithms are set up unless the previous
+ * simulation of ctx used the same ones with the same anchors.
  */
 extern void __attribute__((__nonnull__))
-ls2_distribute_work_shooter(const algorithm_t alg, const error_model_t em,
-                            const int num_threads, const int64_t runs,
-                            const long seed,
+ls2_distribute_work_shooter(ls2_context_t *ctx,
+                            const algorithm_t alg, const error_model_t em,
+                            const int64_t runs,
                             const vector2* anchors, const size_t no_anchors,
 			    float *results[NUM_VARIANTS],
                             const int width, const int height);
 
+/*!
+ * \brief Estimates the position for each place on the playing field with
+ * several algorithms on the same ranges (common random numbers).
+ *
+ * \param[in] algs       The algorithms, at most LS2_MAX_ALGORITHMS.
+ * \param[in] num_algs   The number of algorithms.
+ * \param[out] results   results[a] are the result arrays of algs[a], as
+ *                       for ls2_distribute_work_shooter().  All algorithms
+ *                       have to collect the same variants.
+ *
+ * The other parameters are those of ls2_distribute_work_shooter().
+ */
+extern void __attribute__((__nonnull__))
+ls2_distribute_work_shooter_multi(ls2_context_t *ctx,
+                                  const algorithm_t *algs,
+                                  const size_t num_algs,
+                                  const error_model_t em,
+                                  const int64_t runs,
+                                  const vector2* anchors,
+                                  const size_t no_anchors,
+                                  float **const results[],
+                                  const int width, const int height);
+
 /*!
  * Perform a simulation based on locations.
  *
+ * \param[in] ctx  The context to run the simulation with.
  * \param[in] alg  The algorithm to use. Use any value of algorithm_t.
  * \param[in] em   The error model to use. Use any value of error_model_t.
- * \param[in] num_threads  Number of threads to use.
  * \param[in] runs      Number of runs per location on the discrete grid.
  * \param[in] anchor_x  Array of X coordinates of the anchors.
  * \param[in] anchor_y  Array of Y coordinates of the anchors.
@@ -144,29 +301,64 @@ ls2_distribute_work_shooter(const algorithm_t alg, const error_model_t em,
  * \param[in] height Height of the playing field.
  */
 extern int __attribute__((__nonnull__))
-compute_locbased(const algorithm_t alg, const error_model_t em,
-		 const int num_threads,
+compute_locbased(ls2_context_t *ctx,
+                 const algorithm_t alg, const error_model_t em,
                  const int64_t runs, const float *anchor_x,
                  const float *anchor_y, const int no_anchors,
                  float* results[NUM_VARIANTS], const int width,
                  const int height);
 
 extern void __attribute__((__nonnull__))
-ls2_distribute_work_inverted(const algorithm_t alg, const error_model_t em,
-			     const int num_threads, const int64_t runs,
-                             const long seed, const float tag_x,
+ls2_distribute_work_inverted(ls2_context_t *ctx,
+                             const algorithm_t alg, const error_model_t em,
+			     const int64_t runs, const float tag_x,
                              const float tag_y,
 			     const vector2 *restrict anchors, const size_t no_anchors,
 			     uint64_t *restrict result, const int width, const int height,
 			     float *restrict center_x, float *restrict sdev_x,
                              float *restrict center_y, float *restrict sdev_y);
 
+/*!
+ * Receives the result of tag k of ls2_distribute_work_inverted_tags():
+ * the frequencies of the estimates, a width * height array which is only
+ * valid during the call, and their centroid and standard deviations.
+ */
+typedef void (*ls2_inverted_store_t)(void *arg, size_t k,
+                                     const uint64_t *result,
+                                     float center_x, float sdev_x,
+                                     float center_y, float sdev_y);
+
+/*!
+ * \brief Runs the inverted simulation for several tags.
+ *
+ * \param[in] tags     The positions of the tags.
+ * \param[in] no_tags  The number of tags.
+ * \param[in] store    Called with the results of each tag, in the order
+ *                     of tags, with arg as its first argument.
+ *
+ * All tags get the same random numbers.  With at least as many tags as
+ * threads, each tag is a work item of its own: a worker does all runs of
+ * a tag and then takes the next one.  With fewer tags, the runs of each
+ * tag are split across all threads, as in ls2_distribute_work_inverted().
+ * The other parameters are those of ls2_distribute_work_inverted().
+ */
+extern void __attribute__((__nonnull__(1,5,7,11)))
+ls2_distribute_work_inverted_tags(ls2_context_t *ctx,
+                                  const algorithm_t alg, const error_model_t em,
+                                  const int64_t runs,
+                                  const vector2 *restrict tags,
+                                  const size_t no_tags,
+                                  const vector2 *restrict anchors,
+                                  const size_t no_anchors,
+                                  const int width, const int height,
+                                  ls2_inverted_store_t store, void *arg);
+
 /*!
  * Perform a simulation with a fixed location.
  *
+ * \arg[in] ctx  The context to run the simulation with.
  * \arg[in] alg  The algorithm to use. Use any value of algorithm_t.
  * \arg[in] em   The error model to use. Use any value of error_model_t.
- * \arg[in] num_threads  Number of threads to use.
  * \arg[in] runs      Number of runs per location on the discrete grid.
  * \arg[in] anchor_x  Array of X coordinates of the anchors.
  * \arg[in] anchor_y  Array of Y coordinates of the anchors.
@@ -181,8 +373,8 @@ ls2_distribute_work_inverted(const algorithm_t alg, const error_model_t em,
  * \arg[out] center_y  Y coordinate of the center of mass of all hits.
  */
 extern int __attribute__((__nonnull__))
-compute_inverse(const algorithm_t alg, const error_model_t em,
-		const int num_threads,
+compute_inverse(ls2_context_t *ctx,
+                const algorithm_t alg, const error_model_t em,
 		const int64_t runs, const float *restrict anchor_x,
 		const float *restrict anchor_y, const int no_anchors,
 		const float tag_x, const float tag_y,
@@ -193,6 +385,7 @@ compute_inverse(const algorithm_t alg, const error_model_t em,
 /*!
  * \brief Estimates the position for each place on the playing field.
  *
+ * \param[in] ctx        The context to run the estimation with.
  * \param[in] est        A number that indicates the variance estimation
  *                       algorithm.
  * \param[in] no_anchors The number of anchor nodes to use.
@@ -203,21 +396,16 @@ compute_inverse(const algorithm_t alg, const error_model_t em,
  * \param[in] height     Height of the playing field.
  */
 extern void __attribute__((__nonnull__))
-ls2_distribute_work_estimator(const estimator_t est, const int num_threads,
+ls2_distribute_work_estimator(ls2_context_t *ctx, const estimator_t est,
 			      const vector2* anchors, const size_t no_anchors,
 			      float *results[NUM_VARIANTS],
 			      const int width, const int height);
 
 extern int __attribute__((__nonnull__))
-compute_estimates(const estimator_t est, const int num_threads,
+compute_estimates(ls2_context_t *ctx, const estimator_t est,
 		  const float *anchor_x, const float *anchor_y,
 		  const size_t no_anchors,
 		  float* results[NUM_VARIANTS], const int width,
 		  const int height);
 
-/*! Cancel a computation. */
-extern int
-cancel_running(void);
-
-
 #endif
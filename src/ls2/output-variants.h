@@ -33,3 +33,9 @@ LS2OUT_VARIANT(AVERAGE_X_ERROR, "Average Error in X", "Average_X_Error")
 LS2OUT_VARIANT(AVERAGE_Y_ERROR, "Average Error in Y", "Average_Y_Error")
 LS2OUT_VARIANT(STANDARD_DEVIATION_X_ERROR, "Standard Deviation of X Deviation", "Standard_Deviation_X_Error")
 LS2OUT_VARIANT(STANDARD_DEVIATION_Y_ERROR, "Standard Deviation of Y Deviation", "Standard_Deviation_Y_Error")
+LS2OUT_VARIANT(RUNS_USED, "Runs Used", "Runs_Used")
+LS2OUT_VARIANT(MEDIAN_ERROR, "Median Distance Error", "Median_Error")
+LS2OUT_VARIANT(ERROR_P90, "90th Percentile of Distance Error", "Error_P90")
+LS2OUT_VARIANT(ERROR_P95, "95th Percentile of Distance Error", "Error_P95")
+LS2OUT_VARIANT(ERROR_P99, "99th Percentile of Distance Error", "Error_P99")
+LS2OUT_VARIANT(QUANTILE_ERROR, "Quantile of Distance Error", "Quantile_Error")
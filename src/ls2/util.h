@@ -22,6 +22,23 @@
 #ifndef INCLUDED_LS2_UTIL_H
 #define INCLUDED_LS2_UTIL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*! Whether f is NaN.  It tells NaN by its bits, as -ffast-math assumes
+ *  there are none and folds isnan() to 0. */
+static inline int __attribute__((__always_inline__,__const__))
+ls2_isnan(const float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x7FFFFFFFU) > 0x7F800000U;
+}
+
+/*! The mean, standard deviation, minimum and maximum of the values which
+ *  are not NaN, such as those outside the region of a simulation.  All
+ *  four are NaN if there are no such values. */
 extern void __attribute__((__nonnull__))
 ls2_statistics(const float *values, const size_t size,
 	       float *mu, float *sigma, float *min, float *max);
@@ -0,0 +1,289 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/********************************************************************
+ **
+ **  This file is made only for including in the LS² project
+ **  and not desired for stand alone usage!
+ **
+ ********************************************************************/
+
+/*******************************************************************
+ ***
+ *** Kernel of the location based simulation
+ ***
+ *******************************************************************/
+
+/*
+ * This file is a template of the thread function of the location based
+ * simulation.  It is included once by shooter_run.c for the generic
+ * kernel and once per pair of algorithm and error model by the
+ * generated kernels.c.  The includer defines:
+ *
+ * LS2_KERNEL_NAME       The name of the function.
+ * LS2_KERNEL_ERROR      Called like an error model's _error function.
+ * LS2_KERNEL_ALGORITHM  Called like an algorithm's _run function, with
+ *                       the algorithm as additional first argument and
+ *                       its state of algorithm_thread_init() as an
+ *                       additional last argument.
+ * LS2_KERNEL_ALGORITHMS The number of algorithms run on the same ranges,
+ *                       params->num_algorithms or a constant.
+ *
+ * The macros are undefined at the end of this file.
+ */
+
+#if !defined(LS2_KERNEL_NAME) || !defined(LS2_KERNEL_ERROR) || \
+    !defined(LS2_KERNEL_ALGORITHM) || !defined(LS2_KERNEL_ALGORITHMS)
+#  error "Define LS2_KERNEL_NAME, LS2_KERNEL_ERROR, LS2_KERNEL_ALGORITHM and LS2_KERNEL_ALGORITHMS."
+#endif
+
+/* The following two arrays are used to store the results.
+ * The beginning of the array starts on a cache line, if the cache line
+ * size is 64 bytes large.
+ *
+ * It would be neat if SIZE is divisible by cache line, then each image
+ * line would start on a cache line. Alas, default SIZE is 8 * 125.
+ * SIZE = 1024 might be much better.
+ */
+static void
+__attribute__((__nonnull__(1),__hot__,__flatten__))
+LS2_KERNEL_NAME(locbased_runparams_t *params,
+                void *const *state __attribute__((__unused__)))
+{
+    ls2_context_t *const ctx = params->ctx;
+    VECTOR vx[MAX_ANCHORS];
+    VECTOR vy[MAX_ANCHORS];
+    VECTOR r[MAX_ANCHORS]; 
+    VECTOR distances[MAX_ANCHORS];
+
+    ls2_rng_t seed;
+    ls2_rng_init(&seed, params->seed);
+
+
+    // Precalculate Values
+    for (size_t i = 0; i < params->no_anchors; i++) {
+        vx[i] = VECTOR_BROADCASTF(params->anchors[i].x);
+        vy[i] = VECTOR_BROADCASTF(params->anchors[i].y);
+    }
+
+    // Precalculate whether we are in the common case of running for the
+    // common case.  All algorithms collect the same variants.
+    float *restrict *const results = params->results[0];
+    const long shortcut =
+        (results[AVERAGE_ERROR] || results[STANDARD_DEVIATION]) &&
+          !(results[ROOT_MEAN_SQUARED_ERROR] ||
+            results[AVERAGE_X_ERROR] ||
+            results[STANDARD_DEVIATION_X_ERROR] ||
+            results[AVERAGE_Y_ERROR] ||
+            results[STANDARD_DEVIATION_Y_ERROR]);
+
+    // The distribution of the errors is only collected for quantiles.
+    const int quantiles =
+        results[MEDIAN_ERROR] || results[ERROR_P90] || results[ERROR_P95] ||
+        results[ERROR_P99] || results[QUANTILE_ERROR];
+
+    // In adaptive mode, a pixel is done once the standard error of its
+    // average error, sqrt(S / (cnt - 1) / cnt), is below the tolerance.
+    const int adaptive = params->tolerance > 0.0F;
+    const float tolerance2 = params->tolerance * params->tolerance;
+
+    const ls2_tile_t *tile;
+    const size_t stride = params->scheduler->stride;
+    uint_fast64_t step = 0;  // Number of runs done, for the progress bar.
+
+    clock_gettime(CLOCK_MONOTONIC, &(params->stats->start));
+    while (!ls2_cancelled(ctx) &&
+           (tile = ls2_next_tile(params->scheduler, params->id,
+                                 params->stats)) != NULL) {
+        struct timespec tile_start, tile_end;
+        clock_gettime(CLOCK_MONOTONIC, &tile_start);
+
+        // Calculation for every pixel of the tile
+        for (size_t j = 0; j < (size_t) tile->width * tile->height; j++) {
+            if (__builtin_expect(ls2_cancelled(ctx), 0))
+                break;
+            const uint16_t x = (uint16_t) (tile->x + (j % tile->width) * stride);
+            const uint16_t y = (uint16_t) (tile->y + (j / tile->width) * stride);
+            const size_t pos = (size_t) (x +  y * params->width);
+            const VECTOR tagx = VECTOR_BROADCASTF((float) x);
+            const VECTOR tagy = VECTOR_BROADCASTF((float) y);
+
+            // precalculate real distances
+            for (size_t k = 0; k < params->no_anchors; k++) {
+                distances[k] = distance(vx[k], vy[k], tagx, tagy);
+            }
+
+            ls2_pixel_stats_t px[LS2_KERNEL_ALGORITHMS];
+            ls2_quantile_t qs[LS2_KERNEL_ALGORITHMS];
+            for (size_t a = 0; a < LS2_KERNEL_ALGORITHMS; a++) {
+                ls2_pixel_stats_init(&px[a]);
+                if (__builtin_expect(quantiles, 0))
+                    ls2_quantile_init(&qs[a]);
+            }
+            size_t pending = LS2_KERNEL_ALGORITHMS; // Algorithms not done.
+
+            // Calculate every pixel runs times, or until all algorithms
+            // are done.  Every batch of ranges is given to all algorithms.
+            uint_fast64_t i;
+            for (i = 0; i < params->runs && pending > 0; i += VECTOR_OPS) {
+                // Each batch of runs of a pixel has its own random numbers.
+                ls2_rng_seek(&seed, (uint32_t) pos,
+                             (uint32_t) (i / VECTOR_OPS));
+
+#if !defined(STAND_ALONE)
+                if (__builtin_expect(ctx->progress_total > 0, 0)) {
+                    if (__builtin_expect((step & (DEFAULT_RUNS - 1U)) == 0, 0)) {
+                        ls2_update_progress_bar(ctx, params->id, DEFAULT_RUNS);
+                    }
+                    step += VECTOR_OPS;
+                }
+#endif
+
+                LS2_KERNEL_ERROR(&seed, params->no_anchors, distances,
+                                 vx, vy, tagx, tagy, r);
+
+                for (size_t a = 0; a < LS2_KERNEL_ALGORITHMS; a++) {
+                    ls2_pixel_stats_t *const p = &px[a];
+                    float *restrict *const res = params->results[a];
+                    // The results of the algorithm
+                    VECTOR resx, resy;
+
+                    if (p->done)
+                        continue;
+                    LS2_KERNEL_ALGORITHM(params->algorithms[a],
+                                         vx, vy, r, params->no_anchors,
+                                         params->width, params->height,
+                                         &resx, &resy, state[a]);
+                    p->runs += VECTOR_OPS;
+
+                    // Get Errors
+                    const VECTOR errors = distance(resx, resy, tagx, tagy);
+
+                    p->max_error = VECTOR_MAX(errors, p->max_error);
+                    p->min_error = VECTOR_MIN(errors, p->min_error);
+                    if (__builtin_expect(quantiles, 0))
+                        ls2_quantile_add(&qs[a], errors);
+
+                    if (res[AVERAGE_ERROR] != NULL ||
+                        res[STANDARD_DEVIATION] != NULL ||
+                        res[FAILURES] != NULL || adaptive) {
+                        for (int k = 0; k < VECTOR_OPS; k++) {
+                            if (__builtin_expect(ls2_isnan(errors[k]), 0)) {
+                                p->failures += 1;
+                            } else {
+                                p->cnt += 1.0F;
+                                const float M_old = p->M;
+                                p->M += (errors[k] - p->M) / p->cnt;
+                                if (res[STANDARD_DEVIATION] != NULL ||
+                                    adaptive)
+                                    p->S += (errors[k] - p->M) *
+                                        (errors[k] - M_old);
+                            }
+                        }
+                        if (__builtin_expect(adaptive, 0) &&
+                            p->runs >= params->min_runs && p->cnt > 1.0F &&
+                            p->S <= tolerance2 * p->cnt * (p->cnt - 1.0F)) {
+                            p->done = 1;
+                            pending--;
+                        }
+                    }
+
+                    // The common case is to compute the average error, so we
+                    // optimise for this case by not testing all cases below.
+                    if (__builtin_expect(shortcut, 1))
+                        continue;
+
+                    if (res[ROOT_MEAN_SQUARED_ERROR] != NULL) {
+                        VECTOR sqerror = errors * errors;
+                        for (int k = 0; k < VECTOR_OPS; k++) {
+                            if (__builtin_expect(!ls2_isnan(sqerror[k]), 1)) {
+                                p->C_MSE += 1.0F;
+                                const float MSE_old = p->MSE;
+                                p->MSE += (sqerror[k] - MSE_old) / p->C_MSE;
+                            }
+                        }
+                    }
+
+                    if (res[AVERAGE_X_ERROR] != NULL ||
+                        res[STANDARD_DEVIATION_X_ERROR] != NULL) {
+                        for (int k = 0; k < VECTOR_OPS; k++) {
+                            if (__builtin_expect(!ls2_isnan(resx[k]), 1)) {
+                                p->C_X += 1.0F;
+                                const float M_X_old = p->M_X;
+                                const float dx = resx[k] - x;
+                                p->M_X += (dx - M_X_old) / p->C_X;
+                                if (res[STANDARD_DEVIATION_X_ERROR] != NULL)
+                                    p->S_X += (dx - p->M_X) * (dx - M_X_old);
+                            }
+                        }
+                    }
+                    if (res[AVERAGE_Y_ERROR] != NULL ||
+                        res[STANDARD_DEVIATION_Y_ERROR] != NULL) {
+                        for (int k = 0; k < VECTOR_OPS; k++) {
+                            if (__builtin_expect(!ls2_isnan(resy[k]), 1)) {
+                                p->C_Y += 1.0F;
+                                const float M_Y_old = p->M_Y;
+                                const float dy = resy[k] - y;
+                                p->M_Y += (dy - M_Y_old) / p->C_Y;
+                                if (res[STANDARD_DEVIATION_Y_ERROR] != NULL)
+                                    p->S_Y += (dy - p->M_Y) * (dy - M_Y_old);
+                            }
+                        }
+                    }
+                }
+            }
+
+#if !defined(STAND_ALONE)
+            // Credit the batches an adaptive pixel skipped, such that the
+            // progress bar still reaches its total.  The bar has already
+            // been credited up to the next multiple of DEFAULT_RUNS.
+            if (__builtin_expect(ctx->progress_total > 0 && pending == 0 &&
+                                 i < params->runs, 0)) {
+                const uint_fast64_t skipped = (params->runs - i +
+                                               VECTOR_OPS - 1) / VECTOR_OPS;
+                const uint_fast64_t credited =
+                    (step + DEFAULT_RUNS - 1) / DEFAULT_RUNS;
+                step += skipped * VECTOR_OPS;
+                const uint_fast64_t owed =
+                    (step + DEFAULT_RUNS - 1) / DEFAULT_RUNS - credited;
+                if (owed > 0)
+                    ls2_update_progress_bar(ctx, params->id,
+                                            (size_t) owed * DEFAULT_RUNS);
+            }
+#endif
+
+            for (size_t a = 0; a < LS2_KERNEL_ALGORITHMS; a++)
+                ls2_pixel_stats_store(&px[a], quantiles ? &qs[a] : NULL,
+                                      params->quantile, params->results[a],
+                                      pos, x, y, ctx->verbose);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &tile_end);
+        params->stats->busy += ls2_elapsed(&tile_start, &tile_end);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &(params->stats->end));
+}
+
+#undef LS2_KERNEL_NAME
+#undef LS2_KERNEL_ERROR
+#undef LS2_KERNEL_ALGORITHM
+#undef LS2_KERNEL_ALGORITHMS
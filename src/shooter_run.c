@@ -30,6 +30,8 @@
 #include <immintrin.h>
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,9 +40,9 @@
 #include <inttypes.h>
 #include <float.h>
 #include <math.h>
-#include <signal.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -51,6 +53,7 @@
 #include "ls2/library.h"
 #include "ls2/ls2.h"
 #include "vector_shooter.h"
+#include "ls2/util.h"
 
 
 /*******************************************************************
@@ -71,6 +74,8 @@
 #include "util/util_points.c"
 #include "util/util_misc.c"
 #include "util/util_points_opt.c"
+#include "util/util_quantile.c"
+#include "util/util_histogram.c"
 
 #if defined(STAND_ALONE)
 #  include INCLUDE_ALG(ALGORITHM)
@@ -88,35 +93,105 @@
  *******************************************************************
  *******************************************************************/
 
-/*! Whether the threads have been cancelled. */
-static volatile bool cancelled;
+#if defined(STAND_ALONE)
+/* A STAND_ALONE build has a single algorithm and error model, which keep
+   using their defaults. */
+typedef struct ls2_model_t {
+    int unused;
+} ls2_model_t;
+#  define ls2_model_bind(model) ((void) (model))
+#  define ls2_model_free(model) ((void) (model))
+#endif
+
+typedef struct locbased_runparams_t locbased_runparams_t;
+
+/*!
+ * The job of the workers of a context, which runs on worker t.
+ */
+typedef void (*ls2_work_t)(ls2_context_t *ctx, size_t t, void *arg);
+
+/*!
+ * A context owns the threads, the progress, the seed and the parameters of
+ * the models of the simulations run with it, so that several contexts may
+ * simulate at the same time.  The thread starting a simulation works as
+ * worker 0, the threads of the context are the workers 1 to
+ * num_threads - 1.  The workers keep the states of their algorithms from
+ * one simulation to the next, and the context remembers the inputs of the
+ * last setup of the error model and the algorithms.
+ */
+struct ls2_context_t {
+    size_t num_threads;         /* Number of workers.                  */
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;       /* Signalled when a job is posted.     */
+    pthread_cond_t done;        /* Signalled when the job is done.     */
+    uint64_t job;               /* Number of the last posted job.      */
+    size_t busy;                /* Workers still working on it.        */
+    bool quit;
+    ls2_work_t work;            /* The job and its argument.           */
+    void *arg;
+    size_t running;             /* Number of still running workers.    */
+    bool cancelled;             /* Whether the job has been cancelled. */
+
+    struct ls2_progress_t *progress; /* Runs done by every worker.  */
+    size_t progress_total;      /* Runs of the job, 0 if not counted.  */
+    pthread_t reporter;         /* The thread drawing the progress bar */
+    bool reporting;             /* and whether it runs.                */
+    pthread_mutex_t progress_mutex;
+    pthread_cond_t progress_stop; /* Signalled to stop the reporter.   */
+    size_t progress_last;       /* Only used by the reporter.          */
+    unsigned int spinner;
+    char const *display_name;
+
+    long seed;                  /* Seed of the random numbers.         */
+    int verbose;                /* The settings of the simulations,    */
+    int tile_size;              /* see ls2_context_set_*().            */
+    ls2_region_t roi;
+    int stride;
+    float adaptive_tolerance;
+    int min_runs;
+    float quantile;
+    ls2_normal_sampler_t sampler;
+
+    ls2_model_t options;        /* The parameters of the models.       */
+    ls2_model_t model;          /* Same, with the states of the setup. */
+
+    locbased_runparams_t *params;
+    struct ls2_worker_stats_t *stats;
+    struct ls2_thread_state_t *state; /* Algorithms' states of a worker. */
+    uint64_t *state_setup;      /* The setup these states belong to.   */
+    uint64_t setup;             /* Number of the last setup.           */
+    bool valid;                 /* May the last setup be kept?         */
+    error_model_t em;           /* The inputs of the last setup.       */
+    algorithm_t algorithms[LS2_MAX_ALGORITHMS];
+    size_t num_algorithms;
+    vector2 anchors[MAX_ANCHORS];
+    size_t no_anchors;
+};
 
-/*! The number of still running threads. */
-static volatile size_t running;
 
-/*! An array of thread identifiers. */
-static pthread_t *ls2_thread;
 
-/*! The total number of threads that are running. */
-static volatile size_t ls2_num_threads;
+/*! Whether the job of ctx has been cancelled. */
+static inline bool __attribute__((__always_inline__,__nonnull__))
+ls2_cancelled(ls2_context_t *ctx)
+{
+    return __atomic_load_n(&(ctx->cancelled), __ATOMIC_RELAXED);
+}
 
 
 
 int
-cancel_running(void)
+ls2_context_cancel(ls2_context_t *ctx)
 {
-    if (running <= 0)
+    if (__atomic_load_n(&(ctx->running), __ATOMIC_RELAXED) == 0)
         return 0;
-    for(size_t t = 0; t < ls2_num_threads; t++)
-    	pthread_cancel(ls2_thread[t]);
-    cancelled = true;
+    __atomic_store_n(&(ctx->cancelled), true, __ATOMIC_RELAXED);
     return 1;
 }
 
 
 
 
-
 /*******************************************************************
  *******************************************************************
  ***
@@ -125,15 +200,6 @@ cancel_running(void)
  *******************************************************************
  *******************************************************************/
 
-static volatile size_t progress_total;
-static volatile size_t progress_current;
-static volatile size_t progress_last;
-static volatile unsigned int spinner;
-static char const* display_name;
-
-
-static timer_t timer_id;
-
 #define DEFAULT_WIDTH 80
 
 #define DEFAULT_NAME  24
@@ -142,15 +208,47 @@ static timer_t timer_id;
 
 #define DEFAULT_RUNS  0x8000U
 
-static pthread_mutex_t progress_bar_mutex = PTHREAD_MUTEX_INITIALIZER;
+/*!
+ * The runs done by a worker.  Only the worker writes its counter, and
+ * every counter lives in its own cache line, so the workers count without
+ * locks and without sharing cache lines.  Readers sum the counters.
+ */
+typedef struct ls2_progress_t {
+    size_t runs;
+    char padding[64 - sizeof(size_t)];
+} __attribute__((__aligned__(64))) ls2_progress_t;
 
 static inline void
-__attribute__((__always_inline__,__gnu_inline__))
-ls2_update_progress_bar(size_t value)
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__))
+ls2_update_progress_bar(ls2_context_t *ctx, size_t t, size_t value)
+{
+    size_t *runs = &(ctx->progress[t].runs);
+    __atomic_store_n(runs, __atomic_load_n(runs, __ATOMIC_RELAXED) + value,
+                     __ATOMIC_RELAXED);
+}
+
+
+/*! The runs done by all workers of ctx, at most progress_total. */
+static size_t __attribute__((__nonnull__))
+ls2_progress_current(ls2_context_t *ctx)
 {
-    pthread_mutex_lock(&progress_bar_mutex);
-    progress_current = MIN(progress_current + value, progress_total);
-    pthread_mutex_unlock(&progress_bar_mutex);
+    size_t current = 0;
+    for (size_t t = 0; t < ctx->num_threads; t++)
+        current += __atomic_load_n(&(ctx->progress[t].runs), __ATOMIC_RELAXED);
+    return MIN(current, ctx->progress_total);
+}
+
+
+/*! Start counting the progress of a job of total runs called name. */
+static void __attribute__((__nonnull__(1)))
+ls2_reset_progress(ls2_context_t *ctx, size_t total, const char *name)
+{
+    for (size_t t = 0; t < ctx->num_threads; t++)
+        ctx->progress[t].runs = 0U;
+    ctx->progress_total = total;
+    ctx->progress_last  = 0U;
+    ctx->spinner        = 0U;
+    ctx->display_name   = name;
 }
 
 
@@ -158,13 +256,14 @@ ls2_update_progress_bar(size_t value)
  *
  */
 double
-get_progress(int *threads)
+ls2_context_progress(ls2_context_t *ctx, int *threads)
 {
     double result;
     if (threads != NULL)
-        *threads = (int) running;
-    if (progress_total > 0)
-        result = (double) progress_current / (double) progress_total;
+        *threads = (int) __atomic_load_n(&(ctx->running), __ATOMIC_RELAXED);
+    if (ctx->progress_total > 0)
+        result = (double) ls2_progress_current(ctx) /
+            (double) ctx->progress_total;
     else
         result = 0.0;
     return result;
@@ -173,20 +272,22 @@ get_progress(int *threads)
 
 
 /*
- * Handle a progress event and draw the bar to the console.
+ * Draw the progress bar of ctx to the console.
  */
-static void
-ls2_handle_progress_bar(int signal __attribute__((__unused__)),
-                        siginfo_t *si __attribute__((__unused__)),
-                        void *uc __attribute__((__unused__)))
+static void __attribute__((__nonnull__))
+ls2_draw_progress_bar(ls2_context_t *ctx)
 {
     static const char spinner_char[4] = { '|', '/', '-', '\\' };
+    const size_t running = __atomic_load_n(&(ctx->running), __ATOMIC_RELAXED);
+    const size_t current = ls2_progress_current(ctx);
+    const size_t total = MAX(ctx->progress_total, 1U);
     char buffer [DEFAULT_WIDTH + 1];
     int pos = 0;
 
     if (isatty(STDERR_FILENO)) {
-        if (display_name != NULL) {
-            strncpy(buffer, display_name, (size_t)(DEFAULT_NAME - 1));
+        if (ctx->display_name != NULL) {
+            strncpy(buffer, ctx->display_name, (size_t)(DEFAULT_NAME - 1));
+            buffer[DEFAULT_NAME - 1] = '\0';
             pos = (int) strlen(buffer);
         } else {
             pos = 0;
@@ -195,8 +296,7 @@ ls2_handle_progress_bar(int signal __attribute__((__unused__)),
             buffer[pos++] = ' ';
         buffer[pos++] = '|';
 
-        const int ratio =
-          (int) ((DEFAULT_STEPS * progress_current) / progress_total);
+        const int ratio = (int) ((DEFAULT_STEPS * current) / total);
         while (pos < ratio + DEFAULT_NAME + 2) {
             buffer[pos++] = '=';
         }
@@ -207,20 +307,19 @@ ls2_handle_progress_bar(int signal __attribute__((__unused__)),
         }
 
         // Turn the spinner if not finished
-        if (progress_current < progress_total) {
-            buffer[pos++] = spinner_char[spinner];
-            if (progress_current != progress_last)
-                spinner = (spinner + 1U) & 0x3U;
+        if (current < total) {
+            buffer[pos++] = spinner_char[ctx->spinner];
+            if (current != ctx->progress_last)
+                ctx->spinner = (ctx->spinner + 1U) & 0x3U;
         } else {
             buffer[pos++] = '|';
         }
 
-        float progress =
-            ((float) progress_current) * 100.0f / ((float) progress_total);
-        if (ls2_num_threads < 100) {
+        float progress = ((float) current) * 100.0f / ((float) total);
+        if (ctx->num_threads < 100) {
             pos += snprintf(buffer + pos, (size_t) (DEFAULT_WIDTH - pos),
                             " %5.1f%% %2zu/%2zu thr.", progress,
-                            running, ls2_num_threads);
+                            running, ctx->num_threads);
         } else {
             pos += snprintf(buffer + pos, (size_t) (DEFAULT_WIDTH - pos),
                             " %5.1f%% %4zu thr.", progress, running);
@@ -230,8 +329,7 @@ ls2_handle_progress_bar(int signal __attribute__((__unused__)),
         buffer[pos] = '\0';
         if (write(STDERR_FILENO, buffer, (size_t) pos)) {}
     } else { // Not a tty, just write the percent percentage.
-        float progress =
-            ((float) progress_current) * 100.0f / ((float) progress_total);
+        float progress = ((float) current) * 100.0f / ((float) total);
         int s = snprintf(buffer, sizeof(buffer), " %5.1f%% %4zu\n",
                          progress, running);
         if (s > 0) {
@@ -241,95 +339,317 @@ ls2_handle_progress_bar(int signal __attribute__((__unused__)),
         }
     }
     fdatasync(STDERR_FILENO);
-    progress_last = progress_current;
+    ctx->progress_last = current;
 }
 
 
 
 
 /*
- * Register a handler for updating progress.
+ * The reporter thread of ctx, which draws the progress bar twice a
+ * second until it is stopped.  It runs at the lowest priority and only
+ * reads the counters, so it does not disturb the workers.
  */
-static void
-ls2_setup_progress_handler(void (*handler)(int, siginfo_t *, void*))
-{
-    struct sigevent sev;
-    struct itimerspec its;
-    sigset_t mask;
-    struct sigaction sa;
-
-    sa.sa_flags = SA_SIGINFO;
-    sa.sa_sigaction = handler;
-    sigemptyset(&sa.sa_mask);
-    if (sigaction(SIGRTMIN, &sa, NULL) == -1) {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
-    }
+static void *
+ls2_progress_reporter(void *arg)
+{
+    ls2_context_t *const ctx = (ls2_context_t *) arg;
 
-    sigemptyset(&mask);
-    sigaddset(&mask, SIGRTMIN);
-    if (sigprocmask(SIG_SETMASK, &mask, NULL) == -1) {
-        perror("sigprocmask");
-        exit(EXIT_FAILURE);
+#if defined(__linux__) && defined(SYS_gettid)
+    // On Linux, the nice value of a thread is its own.
+    (void) setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 19);
+#endif
+
+    pthread_mutex_lock(&(ctx->progress_mutex));
+    while (ctx->reporting) {
+        ls2_draw_progress_bar(ctx);
+
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += 500000000;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        while (ctx->reporting &&
+               pthread_cond_timedwait(&(ctx->progress_stop),
+                                      &(ctx->progress_mutex),
+                                      &until) != ETIMEDOUT)
+            ;
     }
+    pthread_mutex_unlock(&(ctx->progress_mutex));
 
-    sev.sigev_notify = SIGEV_SIGNAL;
-    sev.sigev_signo = SIGRTMIN;
-    sev.sigev_value.sival_ptr = &timer_id;
-    if (timer_create(CLOCK_REALTIME, &sev, &timer_id) == -1) {
-        perror("timer_create");
+    return NULL;
+}
+
+
+
+
+/*! Stop the reporter thread of ctx, if it runs. */
+static void __attribute__((__nonnull__))
+ls2_stop_reporter(ls2_context_t *ctx)
+{
+    pthread_mutex_lock(&(ctx->progress_mutex));
+    const bool reporting = ctx->reporting;
+    ctx->reporting = false;
+    pthread_cond_signal(&(ctx->progress_stop));
+    pthread_mutex_unlock(&(ctx->progress_mutex));
+    if (reporting)
+        pthread_join(ctx->reporter, NULL);
+}
+
+
+
+
+void
+ls2_initialize_progress_bar(ls2_context_t *ctx, size_t total,
+                            const char *name)
+{
+    ls2_stop_reporter(ctx);
+    ls2_reset_progress(ctx, total, name);
+
+    ctx->reporting = true;
+    if (pthread_create(&(ctx->reporter), NULL, ls2_progress_reporter, ctx)) {
+        perror("pthread_create()");
         exit(EXIT_FAILURE);
     }
+}
+
+
+void
+ls2_stop_progress_bar(ls2_context_t *ctx)
+{
+    ls2_stop_reporter(ctx);
+    ls2_draw_progress_bar(ctx);
+    if (write(STDERR_FILENO, "\n", 1u)) {}
+    fdatasync(STDERR_FILENO);
+}
+
+
+
+
+/*******************************************************************
+ *******************************************************************
+ ***
+ ***   Work distribution: tiles and work stealing.
+ ***
+ *******************************************************************
+ *******************************************************************/
+
+/*! A rectangular part of the playing field. */
+typedef struct ls2_tile_t {
+    uint16_t x, y;
+    uint16_t width, height;
+} ls2_tile_t;
+
+
+/*!
+ * A work queue of a thread.  The queue is the range of tiles
+ * [top, bottom) of the scheduler's tile array.  Both ends are packed
+ * into one 64 bit word, such that the owner, which takes tiles from
+ * the bottom, and thieves, which take tiles from the top, can claim a
+ * tile with a single compare-and-swap.  Tiles are never added to a
+ * queue after the threads have been started, so top only grows and
+ * bottom only shrinks.  Each queue lives in its own cache line.
+ */
+typedef struct ls2_deque_t {
+    uint64_t bounds;
+    char padding[64 - sizeof(uint64_t)];
+} __attribute__((__aligned__(64))) ls2_deque_t;
+
+#define LS2_DEQUE_TOP(b)       ((uint32_t) ((b) & 0xFFFFFFFFU))
+#define LS2_DEQUE_BOTTOM(b)    ((uint32_t) ((b) >> 32))
+#define LS2_DEQUE_BOUNDS(t, b) ((((uint64_t) (b)) << 32) | (uint64_t) (t))
+
 
-    /* Start the timer */
+/*! Statistics of a worker thread, reported at verbosity level 2. */
+typedef struct ls2_worker_stats_t {
+    struct timespec start;
+    struct timespec end;
+    double busy;
+    size_t tiles;
+    size_t stolen;
+} ls2_worker_stats_t;
 
-    its.it_value.tv_sec = 0;
-    its.it_value.tv_nsec = 500000000;
-    its.it_interval.tv_sec = its.it_value.tv_sec;
-    its.it_interval.tv_nsec = its.it_value.tv_nsec;
 
-    if (timer_settime(timer_id, 0, &its, NULL) == -1) {
-        perror("timer_settime");
+/*!
+ * The tiles count the pixels of the grid with spacing stride, a tile of
+ * width w starting at x covers the pixels x, x + stride, ...,
+ * x + (w - 1) * stride of its rows.
+ */
+typedef struct ls2_scheduler_t {
+    uint16_t stride;
+    ls2_tile_t *tiles;
+    size_t no_tiles;
+    ls2_deque_t *queue;
+    size_t no_queues;
+} ls2_scheduler_t;
+
+
+
+/*!
+ * Cut the pixels of region on the grid with spacing stride into tiles of
+ * tile_size x tile_size pixels and deal them in contiguous blocks to
+ * no_queues work queues.  Every pixel of the grid is part of exactly one
+ * tile.
+ */
+static void __attribute__((__nonnull__))
+ls2_scheduler_init(ls2_scheduler_t *sched, const size_t no_queues,
+                   const ls2_region_t *region, const uint16_t stride,
+                   const uint16_t tile_size)
+{
+    const size_t width = (size_t) ((region->x1 - region->x0 + stride - 1) / stride);
+    const size_t height = (size_t) ((region->y1 - region->y0 + stride - 1) / stride);
+    const size_t tiles_x = (width + tile_size - 1) / tile_size;
+    const size_t tiles_y = (height + tile_size - 1) / tile_size;
+
+    sched->stride = stride;
+    sched->no_tiles = tiles_x * tiles_y;
+    sched->no_queues = no_queues;
+    sched->tiles = calloc(MAX(sched->no_tiles, 1U), sizeof(ls2_tile_t));
+    if (sched->tiles == NULL) {
+        perror("calloc()");
         exit(EXIT_FAILURE);
     }
-
-    if (sigprocmask(SIG_UNBLOCK, &mask, NULL) == -1) {
-        perror("sigprocmask");
+    if (posix_memalign((void **) &(sched->queue), 64,
+                       no_queues * sizeof(ls2_deque_t)) != 0) {
+        perror("posix_memalign()");
         exit(EXIT_FAILURE);
     }
+
+    size_t k = 0;
+    for (size_t ty = 0; ty < tiles_y; ty++) {
+        for (size_t tx = 0; tx < tiles_x; tx++, k++) {
+            const size_t x = tx * tile_size;
+            const size_t y = ty * tile_size;
+            sched->tiles[k].x = (uint16_t) ((size_t) region->x0 + x * stride);
+            sched->tiles[k].y = (uint16_t) ((size_t) region->y0 + y * stride);
+            sched->tiles[k].width = (uint16_t) MIN(tile_size, width - x);
+            sched->tiles[k].height = (uint16_t) MIN(tile_size, height - y);
+        }
+    }
+
+    for (size_t q = 0; q < no_queues; q++) {
+        const size_t top = (q * sched->no_tiles) / no_queues;
+        const size_t bottom = ((q + 1) * sched->no_tiles) / no_queues;
+        sched->queue[q].bounds = LS2_DEQUE_BOUNDS(top, bottom);
+    }
 }
 
 
 
+static void __attribute__((__nonnull__))
+ls2_scheduler_destroy(ls2_scheduler_t *sched)
+{
+    free(sched->tiles);
+    free(sched->queue);
+}
 
-void
-ls2_initialize_progress_bar(size_t total, const char *name)
+
+
+/*! Take a tile from the bottom of queue q.  Returns false if it is empty. */
+static inline bool __attribute__((__always_inline__,__nonnull__))
+ls2_deque_pop(ls2_deque_t *q, size_t *tile)
 {
-    spinner          = 0U;
-    progress_current = 0U;
-    progress_last    = 0U;
-    progress_total   = total;
-    display_name     = name;
+    uint64_t b = __atomic_load_n(&(q->bounds), __ATOMIC_ACQUIRE);
+    for (;;) {
+        const uint32_t top = LS2_DEQUE_TOP(b);
+        const uint32_t bottom = LS2_DEQUE_BOTTOM(b);
+        if (top >= bottom)
+            return false;
+        if (__atomic_compare_exchange_n(&(q->bounds), &b,
+                                        LS2_DEQUE_BOUNDS(top, bottom - 1U),
+                                        true, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            *tile = bottom - 1U;
+            return true;
+        }
+    }
+}
+
+
 
-    ls2_setup_progress_handler(ls2_handle_progress_bar);
-    ls2_handle_progress_bar(SIGRTMIN, NULL, NULL);
+/*! Steal a tile from the top of queue q.  Returns false if it is empty. */
+static inline bool __attribute__((__always_inline__,__nonnull__))
+ls2_deque_steal(ls2_deque_t *q, size_t *tile)
+{
+    uint64_t b = __atomic_load_n(&(q->bounds), __ATOMIC_ACQUIRE);
+    for (;;) {
+        const uint32_t top = LS2_DEQUE_TOP(b);
+        const uint32_t bottom = LS2_DEQUE_BOTTOM(b);
+        if (top >= bottom)
+            return false;
+        if (__atomic_compare_exchange_n(&(q->bounds), &b,
+                                        LS2_DEQUE_BOUNDS(top + 1U, bottom),
+                                        true, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            *tile = top;
+            return true;
+        }
+    }
 }
 
 
-static void
-ls2_teardown_progress_handler(void)
+
+/*!
+ * Fetch the next tile for worker id.  The worker first drains its own
+ * queue and then tries to steal from the other queues, starting with
+ * its neighbour.  Returns NULL if no work is left anywhere.
+ */
+static const ls2_tile_t * __attribute__((__nonnull__))
+ls2_next_tile(ls2_scheduler_t *sched, const size_t id,
+              ls2_worker_stats_t *stats)
 {
-    timer_delete(timer_id);
-    signal(SIGRTMIN, SIG_IGN);
+    size_t t;
+
+    if (ls2_deque_pop(&(sched->queue[id]), &t)) {
+        stats->tiles++;
+        return &(sched->tiles[t]);
+    }
+    for (size_t k = 1; k < sched->no_queues; k++) {
+        const size_t victim = (id + k) % sched->no_queues;
+        if (ls2_deque_steal(&(sched->queue[victim]), &t)) {
+            stats->tiles++;
+            stats->stolen++;
+            return &(sched->tiles[t]);
+        }
+    }
+    return NULL;
 }
 
-void
-ls2_stop_progress_bar(void)
+
+
+static inline double __attribute__((__always_inline__,__nonnull__))
+ls2_elapsed(const struct timespec *from, const struct timespec *to)
 {
-    ls2_teardown_progress_handler();
-    ls2_handle_progress_bar(SIGRTMIN, NULL, NULL);
-    if (write(STDERR_FILENO, "\n", 1u)) {}
-    fdatasync(STDERR_FILENO);
+    return (double) (to->tv_sec - from->tv_sec) +
+        (double) (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+
+
+/*!
+ * Report how long each worker computed and how long it waited for the
+ * others to finish.
+ */
+static void __attribute__((__nonnull__))
+ls2_report_worker_stats(const ls2_worker_stats_t *stats, const size_t n)
+{
+    struct timespec job_start = stats[0].start, job_end = stats[0].end;
+    for (size_t t = 1; t < n; t++) {
+        if (ls2_elapsed(&(stats[t].start), &job_start) > 0.0)
+            job_start = stats[t].start;
+        if (ls2_elapsed(&job_end, &(stats[t].end)) > 0.0)
+            job_end = stats[t].end;
+    }
+    const double total = ls2_elapsed(&job_start, &job_end);
+    for (size_t t = 0; t < n; t++) {
+        fprintf(stderr, "Thread %zu: busy %.6f sec., idle %.6f sec., "
+                "%zu tiles (%zu stolen)\n", t, stats[t].busy,
+                MAX(total - stats[t].busy, 0.0), stats[t].tiles,
+                stats[t].stolen);
+    }
+    fflush(stderr);
 }
 
 
@@ -387,238 +707,654 @@ int ls2_verbose = 0;
 
 
 
+
 /*! Parameters to the location-based simulator. */
 
-typedef struct locbased_runparams_t {
+/*!
+ * The kernel of the location based simulation, which simulates the tiles
+ * of params.  state[a] is the state of the a-th algorithm in this thread.
+ */
+typedef void (*ls2_kernel_t)(locbased_runparams_t *, void *const *state);
+
+struct locbased_runparams_t {
+    ls2_context_t *ctx;
     size_t id;
-    unsigned int seed;
+    uint64_t seed;
     vector2 const *anchors;
     size_t no_anchors;
-    float * restrict * restrict results;
     uint16_t width;
     uint16_t height;
-    size_t from;
-    size_t count;
-    uint_fast64_t runs;
-    algorithm_t algorithm;
+    ls2_scheduler_t *scheduler;
+    ls2_worker_stats_t *stats;
+    uint_fast64_t runs;         /* Maximal number of runs per pixel.   */
+    uint_fast64_t min_runs;     /* Runs before stopping early.         */
+    float tolerance;            /* Standard error to stop at, or 0.    */
+    float quantile;             /* The quantile of QUANTILE_ERROR.     */
+    const algorithm_t *algorithms; /* Algorithms run on the same ranges. */
+    size_t num_algorithms;
+    float **const *results;     /* Result variants of each algorithm.  */
     error_model_t error_model;
-} locbased_runparams_t;
+    ls2_kernel_t kernel;
+};
 
 
-/* The following two arrays are used to store the results.
- * The beginning of the array starts on a cache line, if the cache line
- * size is 64 bytes large.
- *
- * It would be neat if SIZE is divisible by cache line, then each image
- * line would start on a cache line. Alas, default SIZE is 8 * 125.
- * SIZE = 1024 might be much better.
+/*! The statistics of the runs of one algorithm at one pixel. */
+typedef struct ls2_pixel_stats_t {
+    float M, S, cnt;            /* Mean error and its sum of squares.  */
+    float MSE, C_MSE;
+    float M_X, S_X, C_X;
+    float M_Y, S_Y, C_Y;
+    uint_fast64_t failures;     /* How often did it fail (nan)?        */
+    uint_fast64_t runs;         /* Number of runs done.                */
+    VECTOR min_error, max_error;
+    int done;                   /* Is the standard error small enough? */
+} ls2_pixel_stats_t;
+
+
+static inline void __attribute__((__always_inline__,__nonnull__))
+ls2_pixel_stats_init(ls2_pixel_stats_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->min_error = VECTOR_BROADCASTF(FLT_MAX);
+    p->max_error = VECTOR_BROADCASTF(0.0F);
+}
+
+
+/*!
+ * Store the statistics of the pixel (x, y) at pos in results.  q holds the
+ * distribution of the errors if a quantile is wanted, otherwise NULL.
+ */
+static inline void __attribute__((__always_inline__,__nonnull__(1,4)))
+ls2_pixel_stats_store(const ls2_pixel_stats_t *p, const ls2_quantile_t *q,
+                      const float quantile, float *restrict *results,
+                      const size_t pos, const uint16_t x, const uint16_t y,
+                      const int verbose)
+{
+    if (results[AVERAGE_ERROR] != NULL) {
+        results[AVERAGE_ERROR][pos] = p->M;
+    }
+    if (results[STANDARD_DEVIATION] != NULL) {
+        results[STANDARD_DEVIATION][pos] = sqrtf(p->S / (p->cnt - 1.0F));
+    }
+    if (results[MAXIMUM_ERROR] != NULL) {
+        results[MAXIMUM_ERROR][pos] = vector_max_ps(p->max_error, 0.0F);
+    }
+    if (results[MINIMUM_ERROR] != NULL) {
+        results[MINIMUM_ERROR][pos] = vector_min_ps(p->min_error, FLT_MAX);
+    }
+    if (results[FAILURES] != NULL) {
+        results[FAILURES][pos] = ((float) p->failures) / ((float) p->runs);
+        if (__builtin_expect(verbose > 0, 0)) {
+            if (__builtin_expect(results[FAILURES][pos] > 0.0, 0)) {
+                fprintf(stderr, "Warning: %" PRIuFAST64 " of %" PRIuFAST64
+                                " runs failed at (%d, %d)\n",
+                        p->failures, p->runs, x, y);
+                fflush(stderr);
+            }
+        }
+    }
+    if (results[ROOT_MEAN_SQUARED_ERROR] != NULL) {
+        results[ROOT_MEAN_SQUARED_ERROR][pos] = sqrtf(p->MSE);
+    }
+    if (results[AVERAGE_X_ERROR] != NULL) {
+        results[AVERAGE_X_ERROR][pos] = p->M_X;
+    }
+    if (results[STANDARD_DEVIATION_X_ERROR] != NULL) {
+        results[STANDARD_DEVIATION_X_ERROR][pos] =
+            sqrtf(p->S_X / (p->C_X - 1.0F));
+    }
+    if (results[AVERAGE_Y_ERROR] != NULL) {
+        results[AVERAGE_Y_ERROR][pos] = p->M_Y;
+    }
+    if (results[STANDARD_DEVIATION_Y_ERROR] != NULL) {
+        results[STANDARD_DEVIATION_Y_ERROR][pos] =
+            sqrtf(p->S_Y / (p->C_Y - 1.0F));
+    }
+    if (results[RUNS_USED] != NULL) {
+        results[RUNS_USED][pos] = (float) p->runs;
+    }
+    if (q != NULL) {
+        const float min = vector_min_ps(p->min_error, FLT_MAX);
+        const float max = vector_max_ps(p->max_error, 0.0F);
+        if (results[MEDIAN_ERROR] != NULL)
+            results[MEDIAN_ERROR][pos] = ls2_quantile_get(q, 0.5F, min, max);
+        if (results[ERROR_P90] != NULL)
+            results[ERROR_P90][pos] = ls2_quantile_get(q, 0.9F, min, max);
+        if (results[ERROR_P95] != NULL)
+            results[ERROR_P95][pos] = ls2_quantile_get(q, 0.95F, min, max);
+        if (results[ERROR_P99] != NULL)
+            results[ERROR_P99][pos] = ls2_quantile_get(q, 0.99F, min, max);
+        if (results[QUANTILE_ERROR] != NULL)
+            results[QUANTILE_ERROR][pos] =
+                ls2_quantile_get(q, quantile, min, max);
+    }
+}
+
+
+#if defined(STAND_ALONE)
+#  define algorithm_thread_init(alg, anchors, nanchors) NULL
+#  define algorithm_thread_free(alg, state) ((void) (state))
+#endif
+
+/*! The states of the algorithms in a worker thread. */
+typedef struct ls2_thread_state_t {
+    size_t count;
+    algorithm_t algorithm[LS2_MAX_ALGORITHMS];
+    void *state[LS2_MAX_ALGORITHMS];
+} ls2_thread_state_t;
+
+
+static void __attribute__((__nonnull__))
+ls2_thread_state_init(ls2_thread_state_t *s, const algorithm_t *algorithms,
+                      const size_t count, const vector2 *anchors,
+                      const size_t no_anchors)
+{
+    assert(count <= LS2_MAX_ALGORITHMS);
+    s->count = count;
+    for (size_t a = 0; a < count; a++) {
+        s->algorithm[a] = algorithms[a];
+        s->state[a] = algorithm_thread_init(algorithms[a], anchors,
+                                            no_anchors);
+    }
+}
+
+
+/*! Free the states of the algorithms of a worker thread. */
+static void __attribute__((__nonnull__))
+ls2_thread_state_free(ls2_thread_state_t *s)
+{
+    for (size_t a = 0; a < s->count; a++)
+        algorithm_thread_free(s->algorithm[a], s->state[a]);
+    s->count = 0;
+}
+
+/*
+ * The generic kernel dispatches to the algorithms and the error model on
+ * every batch of runs.  It runs all algorithms of the simulation on the
+ * same ranges.
+ */
+#define LS2_KERNEL_NAME ls2_shooter_run
+#if defined(STAND_ALONE)
+#  define LS2_KERNEL_ERROR(seed, n, dist, vx, vy, tagx, tagy, r) \
+    EMFUNCTION(error)(seed, n, dist, vx, vy, tagx, tagy, r)
+#  define LS2_KERNEL_ALGORITHM(alg, vx, vy, r, n, width, height, resx, resy, state) \
+    ALGORITHM_RUN(n, vx, vy, r, resx, resy)
+#  define LS2_KERNEL_ALGORITHMS 1
+#else
+#  define LS2_KERNEL_ERROR(seed, n, dist, vx, vy, tagx, tagy, r) \
+    error_model(params->error_model, seed, dist, vx, vy, n, tagx, tagy, r)
+#  define LS2_KERNEL_ALGORITHM(alg, vx, vy, r, n, width, height, resx, resy, state) \
+    algorithm(alg, vx, vy, r, n, width, height, resx, resy, state)
+#  define LS2_KERNEL_ALGORITHMS params->num_algorithms
+#endif
+#include "shooter_kernel.c"
+
+
+/*
+ * The specialised kernels call one algorithm and one error model
+ * directly, such that the compiler can inline both into the loop over
+ * the runs.  generate.py instantiates them only for the pairs where
+ * this is measurably faster, the other pairs use the generic kernel.
+ * Define LS2_SPECIALISED_KERNELS to 0 to use the generic kernel only.
  */
-static void*
-__attribute__((__nonnull__,__hot__,__flatten__))
-ls2_shooter_run(void *rr)
+#ifndef LS2_SPECIALISED_KERNELS
+#  define LS2_SPECIALISED_KERNELS 1
+#endif
+
+#if LS2_SPECIALISED_KERNELS && !defined(STAND_ALONE)
+#  include "kernels.c"
+#endif
+
+
+
+/************************************************************************
+ *****
+ ***** Contexts
+ *****
+ ************************************************************************/
+
+/*!
+ * Let the models and the normal distribution in the calling thread use
+ * the parameters of ctx, or the defaults if ctx is NULL.
+ */
+static void
+ls2_context_bind(ls2_context_t *ctx)
 {
-    assert(rr != NULL);
-    locbased_runparams_t *params = (locbased_runparams_t *) rr;
+    if (ctx == NULL) {
+        ls2_model_bind(NULL);
+        ls2_normal_sampler_params = &ls2_normal_sampler;
+    } else {
+        ls2_model_bind(&(ctx->model));
+        ls2_normal_sampler_params = &(ctx->sampler);
+    }
+}
 
-    VECTOR vx[MAX_ANCHORS];
-    VECTOR vy[MAX_ANCHORS];
-    VECTOR r[MAX_ANCHORS]; 
-    VECTOR distances[MAX_ANCHORS];
 
-    __m128i seed;
-    do {
-        int seed0 = rand_r(&(params->seed));
-        int seed1 = rand_r(&(params->seed));
-        int seed2 = rand_r(&(params->seed));
-        int seed3 = rand_r(&(params->seed));
-        seed = _mm_set_epi32(seed0, seed1, seed2, seed3);
-    } while (0);
+
+/*!
+ * Set up the error model and the algorithms for a simulation with these
+ * inputs, unless the last setup of ctx was for the same ones.
+ */
+static void __attribute__((__nonnull__))
+ls2_context_setup(ls2_context_t *ctx, const algorithm_t *algs,
+                  const size_t num_algs, const error_model_t em,
+                  const vector2 *anchors, const size_t no_anchors)
+{
+    if (ctx->valid && ctx->em == em &&
+        ctx->num_algorithms == num_algs &&
+        memcmp(ctx->algorithms, algs, num_algs * sizeof(algs[0])) == 0 &&
+        ctx->no_anchors == no_anchors &&
+        memcmp(ctx->anchors, anchors, no_anchors * sizeof(anchors[0])) == 0)
+        return;
+    ctx->setup++;
+    ctx->valid = true;
+    ctx->em = em;
+    ctx->num_algorithms = num_algs;
+    memcpy(ctx->algorithms, algs, num_algs * sizeof(algs[0]));
+    ctx->no_anchors = no_anchors;
+    memcpy(ctx->anchors, anchors, no_anchors * sizeof(anchors[0]));
+
+    ls2_model_free(&(ctx->model));
+    ctx->model = ctx->options;
+    ls2_context_bind(ctx);
+#if defined(STAND_ALONE)
+    EMFUNCTION(setup)(anchors, no_anchors);
+#  if defined(ALGORITHM_HAS_SETUP)
+    ALGORITHM_SETUP(anchors, no_anchors);
+#  endif
+#else
+    error_model_setup(em, anchors, no_anchors);
+    for (size_t a = 0; a < num_algs; a++)
+        algorithm_setup(algs[a], anchors, no_anchors);
+#endif
+    ls2_context_bind(NULL);
+}
+
+
+
+/*!
+ * The states of the algorithms in worker t.  The worker sets them up
+ * again if the error model and the algorithms were.
+ */
+static void *const * __attribute__((__nonnull__))
+ls2_context_thread_state(ls2_context_t *ctx, const size_t t,
+                         const algorithm_t *algs, const size_t num_algs,
+                         const vector2 *anchors, const size_t no_anchors)
+{
+    if (ctx->state_setup[t] != ctx->setup) {
+        ls2_thread_state_free(&(ctx->state[t]));
+        ls2_thread_state_init(&(ctx->state[t]), algs, num_algs, anchors,
+                              no_anchors);
+        ctx->state_setup[t] = ctx->setup;
+    }
+    return ctx->state[t].state;
+}
+
+
+
+/*! Run the job of ctx on worker t. */
+static void
+ls2_context_work(ls2_context_t *ctx, const size_t t)
+{
+    ls2_context_bind(ctx);
+    ctx->work(ctx, t, ctx->arg);
+
+    pthread_mutex_lock(&(ctx->mutex));
+    __atomic_sub_fetch(&(ctx->running), 1, __ATOMIC_RELAXED);
+    if (--ctx->busy == 0)
+        pthread_cond_signal(&(ctx->done));
+    pthread_mutex_unlock(&(ctx->mutex));
+}
+
+
+
+/*! The thread function of the workers 1 to num_threads - 1 of a context. */
+static void *
+ls2_context_thread(void *arg)
+{
+    // The parameters of worker t name it before the first job.
+    const locbased_runparams_t *params = (const locbased_runparams_t *) arg;
+    ls2_context_t *const ctx = params->ctx;
+    const size_t t = params->id;
+    uint64_t job = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&(ctx->mutex));
+        while (ctx->job == job && !ctx->quit)
+            pthread_cond_wait(&(ctx->start), &(ctx->mutex));
+        const bool quit = ctx->quit;
+        job = ctx->job;
+        pthread_mutex_unlock(&(ctx->mutex));
+        if (quit)
+            break;
+        ls2_context_work(ctx, t);
+    }
+
+    return NULL;
+}
+
+
+
+/*! Run work on all workers of ctx and wait for them. */
+static void __attribute__((__nonnull__(1,2)))
+ls2_context_run(ls2_context_t *ctx, ls2_work_t work, void *arg)
+{
+    pthread_mutex_lock(&(ctx->mutex));
+    ctx->work = work;
+    ctx->arg = arg;
+    ctx->job++;
+    ctx->busy = ctx->num_threads;
+    __atomic_store_n(&(ctx->running), ctx->num_threads, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&(ctx->start));
+    pthread_mutex_unlock(&(ctx->mutex));
+
+    ls2_context_work(ctx, 0);
+
+    pthread_mutex_lock(&(ctx->mutex));
+    while (ctx->busy > 0)
+        pthread_cond_wait(&(ctx->done), &(ctx->mutex));
+    pthread_mutex_unlock(&(ctx->mutex));
+    ls2_context_bind(NULL);
+}
+
+
+
+ls2_context_t *
+ls2_context_new(const int num_threads)
+{
+    const size_t n = (size_t) MAX(num_threads, 1);
+    ls2_context_t *ctx;
+
+    // The parameters of the models may hold VECTORs.
+    if (posix_memalign((void **) &ctx, ALIGNMENT, sizeof(ls2_context_t)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    memset(ctx, 0, sizeof(ls2_context_t));
+    ctx->params = (locbased_runparams_t *) calloc(n, sizeof(locbased_runparams_t));
+    ctx->stats = (ls2_worker_stats_t *) calloc(n, sizeof(ls2_worker_stats_t));
+    ctx->state = (ls2_thread_state_t *) calloc(n, sizeof(ls2_thread_state_t));
+    ctx->state_setup = (uint64_t *) calloc(n, sizeof(uint64_t));
+    ctx->threads = (pthread_t *) calloc(n, sizeof(pthread_t));
+    if (ctx->params == NULL || ctx->stats == NULL || ctx->state == NULL ||
+        ctx->state_setup == NULL || ctx->threads == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+    if (posix_memalign((void **) &(ctx->progress), 64,
+                       n * sizeof(ls2_progress_t)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    memset(ctx->progress, 0, n * sizeof(ls2_progress_t));
+    pthread_mutex_init(&(ctx->mutex), NULL);
+    pthread_cond_init(&(ctx->start), NULL);
+    pthread_cond_init(&(ctx->done), NULL);
+    pthread_mutex_init(&(ctx->progress_mutex), NULL);
+    pthread_cond_init(&(ctx->progress_stop), NULL);
+    ctx->num_threads = n;
+    ctx->seed = time(NULL);
+    ctx->tile_size = DEFAULT_TILE_SIZE;
+    ctx->roi = (ls2_region_t) { 0, 0, INT_MAX, INT_MAX };
+    ctx->stride = 1;
+    ctx->min_runs = DEFAULT_MIN_RUNS;
+    ctx->quantile = DEFAULT_QUANTILE;
+    ctx->sampler = LS2_NORMAL_ZIGGURAT;
+    ls2_context_load_options(ctx);
+    ctx->model = ctx->options;
+
+    for (size_t t = 0; t < n; t++) {
+        ctx->params[t].ctx = ctx;
+        ctx->params[t].id = t;
+    }
+    for (size_t t = 1; t < n; t++) {
+        if (pthread_create(&(ctx->threads[t]), NULL, ls2_context_thread,
+                           &(ctx->params[t]))) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return ctx;
+}
+
+
+
+void
+ls2_context_free(ls2_context_t *ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    pthread_mutex_lock(&(ctx->mutex));
+    ctx->quit = true;
+    pthread_cond_broadcast(&(ctx->start));
+    pthread_mutex_unlock(&(ctx->mutex));
+    for (size_t t = 1; t < ctx->num_threads; t++)
+        pthread_join(ctx->threads[t], NULL);
+
+    for (size_t t = 0; t < ctx->num_threads; t++)
+        ls2_thread_state_free(&(ctx->state[t]));
+    ls2_model_free(&(ctx->model));
+    ls2_stop_reporter(ctx);
+
+    pthread_cond_destroy(&(ctx->done));
+    pthread_cond_destroy(&(ctx->start));
+    pthread_mutex_destroy(&(ctx->mutex));
+    pthread_cond_destroy(&(ctx->progress_stop));
+    pthread_mutex_destroy(&(ctx->progress_mutex));
+    free(ctx->progress);
+    free(ctx->threads);
+    free(ctx->state_setup);
+    free(ctx->state);
+    free(ctx->stats);
+    free(ctx->params);
+    free(ctx);
+}
+
+
+
+void
+ls2_context_set_seed(ls2_context_t *ctx, const long seed)
+{
+    ctx->seed = seed;
+}
+
+
+
+void
+ls2_context_set_tile_size(ls2_context_t *ctx, const int tile_size)
+{
+    ctx->tile_size = tile_size;
+}
+
+
+
+void
+ls2_context_set_roi(ls2_context_t *ctx, const ls2_region_t roi)
+{
+    ctx->roi = roi;
+}
+
+
+
+void
+ls2_context_set_stride(ls2_context_t *ctx, const int stride)
+{
+    ctx->stride = stride;
+}
+
+
+
+void
+ls2_context_set_adaptive_tolerance(ls2_context_t *ctx, const float tolerance)
+{
+    ctx->adaptive_tolerance = tolerance;
+}
+
+
+
+void
+ls2_context_set_min_runs(ls2_context_t *ctx, const int min_runs)
+{
+    ctx->min_runs = min_runs;
+}
+
+
+
+void
+ls2_context_set_quantile(ls2_context_t *ctx, const float quantile)
+{
+    ctx->quantile = quantile;
+}
+
 
 
-    // Precalculate Values
-    for (size_t i = 0; i < params->no_anchors; i++) {
-        vx[i] = VECTOR_BROADCASTF(params->anchors[i].x);
-        vy[i] = VECTOR_BROADCASTF(params->anchors[i].y);
-    }
+void
+ls2_context_set_normal_sampler(ls2_context_t *ctx,
+                               const ls2_normal_sampler_t sampler)
+{
+    ctx->sampler = sampler;
+}
 
-    // Precalculate whether we are in the common case of running for the
-    // common case.
-    const long shortcut =
-        (params->results[AVERAGE_ERROR] ||
-          params->results[STANDARD_DEVIATION]) &&
-          !(params->results[ROOT_MEAN_SQUARED_ERROR] ||
-            params->results[AVERAGE_X_ERROR] ||
-            params->results[STANDARD_DEVIATION_X_ERROR] ||
-            params->results[AVERAGE_Y_ERROR] ||
-            params->results[STANDARD_DEVIATION_Y_ERROR]);
 
-    // Calculation for every pixel
-    for (size_t j = params->from; j < params->from + params->count; j++) {
-	const uint16_t x = (uint16_t) (j % params->width);
-	const uint16_t y = (uint16_t) (j / params->width);
-        const VECTOR tagx = VECTOR_BROADCASTF((float) x);
-        const VECTOR tagy = VECTOR_BROADCASTF((float) y);
-
-    	// precalculate real distances
-        for (size_t k = 0; k < params->no_anchors; k++) {
-            distances[k] = distance(vx[k], vy[k], tagx, tagy);
-        }
 
-        float M = 0.0F, M_old, S = 0.0F, cnt = 0.0F;
-        float MSE = 0.0F, MSE_old, C_MSE = 0.0F;
-        float M_X = 0.0F, M_X_old, S_X = 0.0F, C_X = 0.0F;
-        float M_Y = 1.0F, M_Y_old, S_Y = 0.0F, C_Y = 0.0F;
-        uint_fast64_t failures = 0U; // How often did it fail (nan)?
+void
+ls2_context_load_options(ls2_context_t *ctx)
+{
+    ctx->verbose = ls2_verbose;
+#if !defined(STAND_ALONE)
+    for (size_t i = 0; ls2_model_parameters[i].defaults != NULL; i++) {
+        char *options = (char *) &(ctx->options) + ls2_model_parameters[i].offset;
+        if (memcmp(options, ls2_model_parameters[i].defaults,
+                   ls2_model_parameters[i].size) != 0) {
+            memcpy(options, ls2_model_parameters[i].defaults,
+                   ls2_model_parameters[i].size);
+            ctx->valid = false;
+        }
+    }
+#endif
+}
 
-        VECTOR min_error = VECTOR_BROADCASTF(FLT_MAX),
-               max_error = VECTOR_BROADCASTF(0.0F);
 
-    	// Calculate every pixel runs times 
-    	for (uint_fast64_t i = 0; i < params->runs; i += VECTOR_OPS) {
-            // The results of the algorithm
-            VECTOR resx, resy;
-            
-#if defined(STAND_ALONE)
-            EMFUNCTION(error)(&seed, params->no_anchors, distances,
-			      vx, vy, tagx, tagy, r);
-	    ALGORITHM_RUN(params->no_anchors, vx, vy, r, &resx, &resy);
-#else
-	    pthread_testcancel();   // Check whether this thread is cancelled.
-
-            if (__builtin_expect(progress_total > 0, 0)) {
-                const uint_fast64_t step =
-                    (j - params->from) * params->runs + i;
-                if (__builtin_expect((step & (DEFAULT_RUNS - 1U)) == 0, 0)) {
-                    ls2_update_progress_bar(DEFAULT_RUNS);
-                }
-            }
 
-	    error_model(params->error_model, &seed, distances, vx, vy,
-                        params->no_anchors, tagx, tagy, r);
-	    algorithm(params->algorithm, vx, vy, r, params->no_anchors,
-                      params->width, params->height, &resx, &resy);
+#if HAVE_POPT_H && !defined(STAND_ALONE)
+/*! The option called name in table or the tables it includes, or NULL. */
+static const struct poptOption * __attribute__((__nonnull__))
+ls2_find_option(const struct poptOption *table, const char *name)
+{
+    for (; table->longName != NULL || table->shortName != '\0' ||
+             table->arg != NULL; table++) {
+        if ((table->argInfo & POPT_ARG_MASK) == POPT_ARG_INCLUDE_TABLE) {
+            const struct poptOption *o = ls2_find_option(table->arg, name);
+            if (o != NULL)
+                return o;
+        } else if (table->longName != NULL &&
+                   strcmp(table->longName, name) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
 #endif
 
-            // Get Errors
-	    const VECTOR errors = distance(resx, resy, tagx, tagy);
-
-            max_error = VECTOR_MAX(errors, max_error);
-	    min_error = VECTOR_MIN(errors, min_error);
-
-            if (params->results[AVERAGE_ERROR] != NULL ||
-                params->results[STANDARD_DEVIATION] != NULL) {
-                for (int k = 0; k < VECTOR_OPS; k++) {
-                    if (__builtin_expect(isnan(errors[k]), 0)) {
-                        failures += 1;
-                    } else {
-                        cnt += 1.0F;
-                        M_old = M;
-                        M += (errors[k] - M) / cnt;
-                        if (params->results[STANDARD_DEVIATION] != NULL)
-                            S += (errors[k] - M) * (errors[k] - M_old);
-                    }
-                }
-            }
 
-            // The common case is to compute the average error, so we
-            // optimise for this case by not testing all cases below.
-            if (__builtin_expect(shortcut, 1))
-                continue;
-
-            if (params->results[ROOT_MEAN_SQUARED_ERROR] != NULL) {
-                VECTOR sqerror = errors * errors;
-                for (int k = 0; k < VECTOR_OPS; k++) {
-                    if (__builtin_expect(isnan(sqerror[k]) == 0, 1)) {
-                        C_MSE += 1.0F;
-                        MSE_old = MSE;
-                        MSE += (sqerror[k] - MSE_old) / C_MSE;
-                    }
-                }
-            }
 
-            if (params->results[AVERAGE_X_ERROR] != NULL ||
-                params->results[STANDARD_DEVIATION_X_ERROR] != NULL) {
-                for (int k = 0; k < VECTOR_OPS; k++) {
-                    if (__builtin_expect(isnan(resx[k]) == 0, 1)) {
-                        C_X += 1.0F;
-                        M_X_old = M_X;
-			const float dx = resx[k] - x;
-                        M_X += (dx - M_X_old) / C_X;
-                        if (params->results[STANDARD_DEVIATION_X_ERROR] != NULL)
-                            S_X += (dx - M_X) * (dx - M_X_old);
-                     }
-                }
-            }
-            if (params->results[AVERAGE_Y_ERROR] != NULL ||
-                params->results[STANDARD_DEVIATION_Y_ERROR] != NULL) {
-                for (int k = 0; k < VECTOR_OPS; k++) {
-                    if (__builtin_expect(isnan(resy[k]) == 0, 1)) {
-                        C_Y += 1.0F;
-                        M_Y_old = M_Y;
-			const float dy = resy[k] - y;
-                        M_Y += (dy - M_Y_old) / C_Y;
-                        if (params->results[STANDARD_DEVIATION_Y_ERROR] != NULL)
-                            S_Y += (dy - M_Y) * (dy - M_Y_old);
-                     }
-                }
-            }
-	}
+int
+ls2_context_set_option(ls2_context_t *ctx, const char *name,
+                       const char *value)
+{
+#if HAVE_POPT_H && !defined(STAND_ALONE)
+    const struct poptOption *o = ls2_find_option(algorithm_arguments, name);
+    if (o == NULL)
+        o = ls2_find_option(error_model_arguments, name);
+    if (o == NULL)
+        o = ls2_find_option(estimator_arguments, name);
+    if (o == NULL)
+        return -1;
 
-	const size_t pos = (size_t) (x +  y * params->width);
-        if (params->results[AVERAGE_ERROR] != NULL) {
-	    params->results[AVERAGE_ERROR][pos] = M;
+    // The option is stored in the defaults of a model, find the same
+    // place in the options of ctx.
+    const uintptr_t arg = (uintptr_t) o->arg;
+    for (size_t i = 0; ls2_model_parameters[i].defaults != NULL; i++) {
+        const uintptr_t d = (uintptr_t) ls2_model_parameters[i].defaults;
+        if (arg < d || arg >= d + ls2_model_parameters[i].size)
+            continue;
+        void *p = (char *) &(ctx->options) + ls2_model_parameters[i].offset +
+            (arg - d);
+        char *end;
+        errno = 0;
+        switch (o->argInfo & POPT_ARG_MASK) {
+        case POPT_ARG_INT: {
+            const long v = strtol(value, &end, 0);
+            if (errno != 0 || end == value || *end != '\0' ||
+                v < INT_MIN || v > INT_MAX)
+                return -1;
+            *(int *) p = (int) v;
+            break;
         }
-        if (params->results[STANDARD_DEVIATION] != NULL) {
-            params->results[STANDARD_DEVIATION][pos] = sqrtf(S / (cnt - 1.0F));
+        case POPT_ARG_LONG: {
+            const long v = strtol(value, &end, 0);
+            if (errno != 0 || end == value || *end != '\0')
+                return -1;
+            *(long *) p = v;
+            break;
         }
-        if (params->results[MAXIMUM_ERROR] != NULL) {
-	    params->results[MAXIMUM_ERROR][pos] =
-                vector_max_ps(max_error, 0.0F);
+        case POPT_ARG_FLOAT: {
+            const float v = strtof(value, &end);
+            if (errno != 0 || end == value || *end != '\0')
+                return -1;
+            *(float *) p = v;
+            break;
         }
-        if (params->results[MINIMUM_ERROR] != NULL) {
-	    params->results[MINIMUM_ERROR][pos] =
-                vector_min_ps(min_error, FLT_MAX);
+        case POPT_ARG_DOUBLE: {
+            const double v = strtod(value, &end);
+            if (errno != 0 || end == value || *end != '\0')
+                return -1;
+            *(double *) p = v;
+            break;
         }
-        if (params->results[FAILURES] != NULL) {
-	    params->results[FAILURES][pos] =
-                ((float) failures) / ((float) params->runs);
-            if (__builtin_expect(ls2_verbose > 0, 0)) {
-                if (__builtin_expect(params->results[FAILURES][pos] > 0.0, 0)) {
-                    fprintf(stderr, "Warning: %" PRIuFAST64 " of %" PRIuFAST64
-                                    " runs failed at (%d, %d)\n",
-                            failures, params->runs, x, y);
-                    fflush(stderr);
-                }
-            }
-        }
-        if (params->results[ROOT_MEAN_SQUARED_ERROR] != NULL) {
-	    params->results[ROOT_MEAN_SQUARED_ERROR][pos] = sqrtf(MSE);
-        }
-        if (params->results[AVERAGE_X_ERROR] != NULL) {
-	    params->results[AVERAGE_X_ERROR][pos] = M_X;
-        }
-        if (params->results[STANDARD_DEVIATION_X_ERROR] != NULL) {
-	    params->results[STANDARD_DEVIATION_X_ERROR][pos] =
-                sqrtf(S_X / (C_X - 1.0F));
-        }
-        if (params->results[AVERAGE_Y_ERROR] != NULL) {
-	    params->results[AVERAGE_Y_ERROR][pos] = M_Y;
-        }
-        if (params->results[STANDARD_DEVIATION_Y_ERROR] != NULL) {
-	    params->results[STANDARD_DEVIATION_Y_ERROR][pos] =
-                sqrtf(S_Y / (C_Y - 1.0F)); 
+        case POPT_ARG_STRING:
+            *(const char **) p = value;
+            break;
+        default:
+            return -1;
         }
+        ctx->valid = false;
+        return 0;
     }
-    running--;
+    return -1;
+#else
+    (void) ctx;
+    (void) name;
+    (void) value;
+    return -1;
+#endif
+}
 
-    if (__builtin_expect(ls2_verbose >= 2, 0)) {
-        struct rusage resources;
-        getrusage(RUSAGE_THREAD, &resources);
-        fprintf(stderr, "Thread %zu: %d.%06d sec.\n", params->id,
-                (int)resources.ru_utime.tv_sec, (int)resources.ru_utime.tv_usec);
-        fflush(stderr);
-    }
-    return NULL;
+
+
+/*! The region of ctx clipped to a width x height field. */
+static ls2_region_t __attribute__((__nonnull__,__pure__))
+ls2_context_region(const ls2_context_t *ctx, const int width, const int height)
+{
+    ls2_region_t r;
+    r.x0 = CLAMP(0, ctx->roi.x0, width);
+    r.y0 = CLAMP(0, ctx->roi.y0, height);
+    r.x1 = CLAMP(r.x0, ctx->roi.x1, width);
+    r.y1 = CLAMP(r.y0, ctx->roi.y1, height);
+    return r;
+}
+
+
+
+size_t
+ls2_context_pixels(ls2_context_t *ctx, const int width, const int height)
+{
+    const ls2_region_t r = ls2_context_region(ctx, width, height);
+    const int stride = MAX(ctx->stride, 1);
+    return (size_t) ((r.x1 - r.x0 + stride - 1) / stride) *
+        (size_t) ((r.y1 - r.y0 + stride - 1) / stride);
 }
 
 
@@ -629,6 +1365,95 @@ ls2_shooter_run(void *rr)
  *****
  ************************************************************************/
 
+/*! Run the kernel of worker t of the location based simulation. */
+static void
+ls2_locbased_work(ls2_context_t *ctx, const size_t t,
+                  void *arg __attribute__((__unused__)))
+{
+    locbased_runparams_t *params = &(ctx->params[t]);
+
+    params->kernel(params,
+                   ls2_context_thread_state(ctx, t, params->algorithms,
+                                            params->num_algorithms,
+                                            params->anchors,
+                                            params->no_anchors));
+}
+
+
+
+/*!
+ * Run the location based simulation with kernel on the threads of ctx.
+ * The other parameters are those of ls2_distribute_work_shooter_multi().
+ */
+static void __attribute__((__nonnull__))
+ls2_distribute_kernel(ls2_context_t *ctx, ls2_kernel_t kernel,
+                      const algorithm_t *algs, const size_t num_algs,
+                      const error_model_t em, const int64_t runs,
+                      const vector2* anchors, const size_t no_anchors,
+                      float **const results[],
+                      const int width, const int height)
+{
+    locbased_runparams_t *params = ctx->params;
+    ls2_worker_stats_t *stats = ctx->stats;
+    ls2_scheduler_t scheduler;
+
+    ls2_context_setup(ctx, algs, num_algs, em, anchors, no_anchors);
+    memset(stats, 0, ctx->num_threads * sizeof(ls2_worker_stats_t));
+
+    // The pixels which are not simulated are NaN.
+    const ls2_region_t region = ls2_context_region(ctx, width, height);
+    const int stride = CLAMP(1, ctx->stride, MAX(width, height));
+    if (stride > 1 || region.x0 > 0 || region.y0 > 0 ||
+        region.x1 < width || region.y1 < height) {
+        for (size_t a = 0; a < num_algs; a++) {
+            for (ls2_output_variant var = 0; var < NUM_VARIANTS; var++) {
+                float *restrict res = results[a][var];
+                if (res == NULL)
+                    continue;
+                for (size_t i = 0; i < (size_t) width * (size_t) height; i++)
+                    res[i] = NAN;
+            }
+        }
+    }
+
+    const int tile_size = (ctx->tile_size > 0) ? ctx->tile_size : DEFAULT_TILE_SIZE;
+    ls2_scheduler_init(&scheduler, ctx->num_threads, &region,
+                       (uint16_t) stride,
+                       (uint16_t) MIN(tile_size, MAX(width, height)));
+
+    // Set up the parameters.
+    for (size_t t = 0; t < ctx->num_threads; t++) {
+        params[t].ctx = ctx;
+        params[t].id = t;
+        params[t].seed = (uint64_t) ctx->seed;
+        params[t].no_anchors = (size_t)no_anchors;
+        params[t].anchors = anchors;
+        params[t].width = (uint16_t) width;
+        params[t].height = (uint16_t) height;
+        params[t].scheduler = &scheduler;
+        params[t].stats = &(stats[t]);
+        params[t].runs = (uint_fast64_t) runs;
+        params[t].min_runs = (uint_fast64_t) MAX(ctx->min_runs, VECTOR_OPS);
+        params[t].tolerance = MAX(ctx->adaptive_tolerance, 0.0F);
+        params[t].quantile = CLAMP(0.0F, ctx->quantile, 1.0F);
+        params[t].algorithms = algs;
+        params[t].num_algorithms = num_algs;
+        params[t].results = results;
+        params[t].error_model = em;
+        params[t].kernel = kernel;
+    }
+
+    ls2_context_run(ctx, ls2_locbased_work, NULL);
+
+    if (__builtin_expect(ctx->verbose >= 2, 0)) {
+        ls2_report_worker_stats(stats, ctx->num_threads);
+    }
+
+    ls2_scheduler_destroy(&scheduler);
+}
+
+
+
 /*!
  * \brief Estimates the position for each place on the playing field.
  *
@@ -641,80 +1466,49 @@ ls2_shooter_run(void *rr)
  * \param[in] height     Height of the playing field.
  */
 void __attribute__((__nonnull__))
-ls2_distribute_work_shooter(const algorithm_t alg, const error_model_t em,
-                            const int num_threads, const int64_t runs,
-                            const long seed,
+ls2_distribute_work_shooter(ls2_context_t *ctx,
+                            const algorithm_t alg, const error_model_t em,
+                            const int64_t runs,
                             const vector2* anchors, const size_t no_anchors,
 			    float *results[NUM_VARIANTS],
                             const int width, const int height)
 {
-    ls2_num_threads = (size_t) num_threads;
-    const size_t slice = (size_t) (width * height) / ls2_num_threads;
-    locbased_runparams_t *params;
-
-    running = 0;
-
-#if defined(STAND_ALONE)
-    EMFUNCTION(setup)(anchors, no_anchors);
-#else
-    error_model_setup(em, anchors, no_anchors);
-#endif
-
-    params = (locbased_runparams_t *) calloc(ls2_num_threads, sizeof(locbased_runparams_t));
-    if (params == NULL) {
-        perror("calloc()");
-        exit(EXIT_FAILURE);
-    }
-
-    ls2_thread = (pthread_t *) calloc(ls2_num_threads, sizeof(pthread_t));
-    if (ls2_thread == NULL) {
-        perror("calloc()");
-        exit(EXIT_FAILURE);
-    }
+    ls2_distribute_work_shooter_multi(ctx, &alg, 1, em, runs, anchors,
+                                      no_anchors, &results, width, height);
+}
 
-    srand((unsigned int) seed);
 
-    // Set up the parameters.
-    for (size_t t = 0; t < ls2_num_threads; t++) {
-        params[t].id = t;
-        params[t].seed = (unsigned int) rand() + (unsigned int) t;
-        params[t].no_anchors = (size_t)no_anchors;
-        params[t].anchors = anchors;
-        params[t].width = (uint16_t) width;
-        params[t].height = (uint16_t) height;
-        params[t].results = results;
-        params[t].from = (uint32_t) (t * slice);
-        params[t].count = (uint32_t) slice;
-        params[t].runs = (uint_fast64_t) runs;
-        params[t].algorithm = alg;
-        params[t].error_model = em;
-    }
 
-    /* Create the threads. */
-    if (ls2_num_threads > 1) {
-        for (size_t t = 0; t < ls2_num_threads; t++) {
-            if (pthread_create(&ls2_thread[t], NULL, ls2_shooter_run,
-                               &params[t])) {
-                perror("pthread_create()");
-                exit(EXIT_FAILURE);
-            }
-            running++;
-        }
+/*!
+ * \brief Estimates the position for each place on the playing field with
+ * several algorithms on the same ranges.
+ *
+ * The ranges of each batch of runs are drawn once and given to all
+ * algorithms, such that their results differ by the algorithms only.
+ * results[a] are the result variants of algs[a], all algorithms have to
+ * collect the same variants.
+ */
+void __attribute__((__nonnull__))
+ls2_distribute_work_shooter_multi(ls2_context_t *ctx,
+                                  const algorithm_t *algs,
+                                  const size_t num_algs,
+                                  const error_model_t em,
+                                  const int64_t runs,
+                                  const vector2* anchors,
+                                  const size_t no_anchors,
+                                  float **const results[],
+                                  const int width, const int height)
+{
+    assert(num_algs >= 1 && num_algs <= LS2_MAX_ALGORITHMS);
 
+    ls2_kernel_t kernel = ls2_shooter_run;
+#if LS2_SPECIALISED_KERNELS && !defined(STAND_ALONE)
+    if (num_algs == 1 && ls2_shooter_kernel(algs[0], em) != NULL)
+        kernel = ls2_shooter_kernel(algs[0], em);
+#endif
 
-        // Sync Threads if work has been done
-        for(size_t t = 0; t < ls2_num_threads; t++) {
-            pthread_join(ls2_thread[t], NULL);
-        }
-    } else {
-        /* Since there is only one thread, we call the run code directly.
-         * This should make debugging simpler.
-         */
-        running = 1;
-        ls2_shooter_run(&(params[0]));
-    }
-    free(ls2_thread);
-    free(params);
+    ls2_distribute_kernel(ctx, kernel, algs, num_algs, em, runs, anchors,
+                          no_anchors, results, width, height);
 }
 
 
@@ -725,21 +1519,19 @@ ls2_distribute_work_shooter(const algorithm_t alg, const error_model_t em,
  * This function should only be called by tha Java api.
  */
 extern int
-compute_locbased(const algorithm_t alg, const error_model_t em,
-                 const int num_threads, const int64_t runs,
+compute_locbased(ls2_context_t *ctx,
+                 const algorithm_t alg, const error_model_t em,
+                 const int64_t runs,
                  const float *anchor_x, const float *anchor_y,
                  const int no_anchors, float* results[NUM_VARIANTS],
                  const int width, const int height)
 {
     vector2 *anchors;
 
-    cancelled = false;
+    ctx->cancelled = false;
 
-    spinner          = 0U;
-    progress_current = 0U;
-    progress_last    = 0U;
-    progress_total   = (size_t)(runs * width * height);
-    display_name     = NULL;
+    ls2_reset_progress(ctx, (size_t) runs * ls2_context_pixels(ctx, width, height),
+                       NULL);
 
     // parse and normalize arguments
     anchors = calloc((size_t) no_anchors, sizeof(vector2));
@@ -753,13 +1545,12 @@ compute_locbased(const algorithm_t alg, const error_model_t em,
 	    anchors[i].y = anchor_y[i];
     }
 
-    ls2_distribute_work_shooter(alg, em, num_threads, runs, time(NULL),
-                                anchors, (size_t) no_anchors,
-                                results, width, height);
+    ls2_distribute_work_shooter(ctx, alg, em, runs, anchors,
+                                (size_t) no_anchors, results, width, height);
 
     free(anchors);
 
-    if (cancelled)
+    if (ctx->cancelled)
 	return -1;
     else
         return 0;
@@ -779,12 +1570,13 @@ compute_locbased(const algorithm_t alg, const error_model_t em,
 
 typedef struct inverted_runparams_t {
     int id;
-    unsigned int seed;
+    uint64_t seed;
     float tag_x, tag_y;
     vector2 const *anchors;
     size_t no_anchors;
-    int_fast64_t runs;
-    uint_fast64_t *result;
+    int_fast64_t first;         // First batch of runs of this thread.
+    int_fast64_t runs;          // Number of batches of this thread.
+    ls2_histogram_t histogram;  // The estimates of this thread.
     float cx, sx, cy, sy, cn;
     int width, height;
     algorithm_t algorithm;
@@ -792,20 +1584,15 @@ typedef struct inverted_runparams_t {
 } inverted_runparams_t;
 
 
-static void* ls2_inverse_run(void *rr)
+/*! Run the batches of params on worker t of the inverted simulation. */
+static void
+ls2_inverse_run(ls2_context_t *ctx, const size_t t,
+                inverted_runparams_t *params)
 {
-    inverted_runparams_t *params = (inverted_runparams_t *) rr;
-    __m128i seed;
-    const int_fast64_t runs =
-        params->runs / (int_fast64_t) (ls2_num_threads * VECTOR_OPS);
+    ls2_rng_t seed;
+    const int_fast64_t runs = params->runs;
 
-    do { // Limit life time of temporaries.
-        int seed0 = rand_r(&(params->seed));
-        int seed1 = rand_r(&(params->seed));
-        int seed2 = rand_r(&(params->seed));
-        int seed3 = rand_r(&(params->seed));
-        seed = _mm_set_epi32(seed0, seed1, seed2, seed3);
-    } while (0);
+    ls2_rng_init(&seed, params->seed);
 
     VECTOR vx[MAX_ANCHORS];
     VECTOR vy[MAX_ANCHORS];
@@ -823,38 +1610,49 @@ static void* ls2_inverse_run(void *rr)
         distances[i] = distance(vx[i], vy[i], tagx, tagy);
     }
 
+    void *const *state = ls2_context_thread_state(ctx, t, &params->algorithm,
+                                                  1, params->anchors,
+                                                  params->no_anchors);
+
     float M_X = 0.0F, M_X_old, S_X = 0.0F, N = 0.0F,
           M_Y = 0.0F, M_Y_old, S_Y = 0.0F;
 
     // Calculation for every pixel
     for (int_fast64_t j = 0; j < runs; j++) {
         VECTOR resx, resy;
+        const uint64_t batch = (uint64_t) (params->first + j);
+
+        if (__builtin_expect(ls2_cancelled(ctx), 0))
+            break;
+
+        // The random numbers only depend on the index of the batch.
+        ls2_rng_seek(&seed, (uint32_t) (batch >> 32), (uint32_t) batch);
 
 #if defined(STAND_ALONE)
 	EMFUNCTION(error)(&seed, params->no_anchors, distances,
 			  vx, vy, tagx, tagy, r);
 	ALGORITHM_RUN(params->no_anchors, vx, vy, r, &resx, &resy);
+        (void) state;
 #else
-        pthread_testcancel();
-        if (__builtin_expect(progress_total > 0, 0)) {
+        if (__builtin_expect(ctx->progress_total > 0, 0)) {
 	    if (__builtin_expect(((j + 1u) & (DEFAULT_RUNS/VECTOR_OPS-1U)) == 0, 0)) {
-                ls2_update_progress_bar(DEFAULT_RUNS);
+                ls2_update_progress_bar(ctx, t, DEFAULT_RUNS);
             }
         }
 
 	error_model(params->error_model, &seed, distances, vx, vy,
                     params->no_anchors, tagx, tagy, r);
 	algorithm(params->algorithm, vx, vy, r, params->no_anchors,
-                  params->width, params->height, &resx, &resy);
+                  params->width, params->height, &resx, &resy, state[0]);
 #endif
 
         // errors[j] = distance(resx[j], resy[j], tagx, tagy);
         for (int k = 0; k < VECTOR_OPS; ++k) {
-            if (!isnan(resx[k]) && !isnan(resy[k])) {
+            if (!ls2_isnan(resx[k]) && !ls2_isnan(resy[k])) {
                 const int x = (int) roundf(resx[k]);
                 const int y = (int) roundf(resy[k]);		
 		if (0 <= x && x < params->width && 0 <= y && y < params->height) {
-		    params->result[x + params->width * y] += 1;
+		    ls2_histogram_add(&params->histogram, x, y);
 		}
                 N   += 1.0F;
                 M_X_old = M_X;
@@ -872,16 +1670,93 @@ static void* ls2_inverse_run(void *rr)
         params->cy = M_Y;
         params->sy = S_Y / N;
     }
-    running--;
+}
+
+
+/*! Run the batches of worker t of the inverted simulation. */
+static void
+ls2_inverse_work(ls2_context_t *ctx, const size_t t, void *arg)
+{
+    inverted_runparams_t *params = &(((inverted_runparams_t *) arg)[t]);
 
-    if (ls2_verbose >= 2) {
+    ls2_inverse_run(ctx, t, params);
+
+    if (ctx->verbose >= 2) {
         struct rusage resources;
         getrusage(RUSAGE_THREAD, &resources);
         fprintf(stderr, "Thread %d: %d.%06d sec.\n", params->id,
                 (int)resources.ru_utime.tv_sec, (int)resources.ru_utime.tv_usec);
         fflush(stderr);
     }
-    return NULL;
+}
+
+
+
+/*! The tags of an inverted simulation of several tags. */
+typedef struct inverted_tags_t {
+    inverted_runparams_t *params; // One per tag.
+    size_t no_tags;
+    size_t next;                // The next tag to simulate.
+} inverted_tags_t;
+
+
+/*!
+ * Simulate the tags, one after the other, on worker t.  The workers take
+ * the next tag from a shared counter, so each tag is a work item of its
+ * own and all its runs are done by the worker which took it.  This keeps
+ * all workers busy only if there are at least as many tags as workers.
+ */
+static void
+ls2_inverse_tags_work(ls2_context_t *ctx, const size_t t, void *arg)
+{
+    inverted_tags_t *tags = (inverted_tags_t *) arg;
+
+    for (;;) {
+        const size_t k = __atomic_fetch_add(&(tags->next), 1, __ATOMIC_RELAXED);
+        if (k >= tags->no_tags || ls2_cancelled(ctx))
+            break;
+        ls2_inverse_run(ctx, t, &(tags->params[k]));
+    }
+}
+
+
+/*! A round of merging the histograms of the inverted simulation. */
+typedef struct inverted_merge_t {
+    inverted_runparams_t *params;
+    size_t stride;              // Worker t merges t + stride into t.
+    uint64_t *results;          // The field, once all are merged.
+} inverted_merge_t;
+
+
+/*!
+ * Merge the histogram of worker t + stride into the one of worker t, if t
+ * is a multiple of 2 * stride.  After the rounds with the strides 1, 2, 4,
+ * ..., the histogram of worker 0 holds all estimates.
+ */
+static void
+ls2_inverse_merge(ls2_context_t *ctx, const size_t t, void *arg)
+{
+    const inverted_merge_t *merge = (const inverted_merge_t *) arg;
+    const size_t s = merge->stride;
+
+    if (t % (2 * s) == 0 && t + s < ctx->num_threads) {
+        ls2_histogram_merge(&(merge->params[t].histogram),
+                            &(merge->params[t + s].histogram));
+        ls2_histogram_free(&(merge->params[t + s].histogram));
+    }
+}
+
+
+/*! Write the rows of worker t of the merged histogram into the field. */
+static void
+ls2_inverse_store(ls2_context_t *ctx, const size_t t, void *arg)
+{
+    const inverted_merge_t *merge = (const inverted_merge_t *) arg;
+    const ls2_histogram_t *h = &(merge->params[0].histogram);
+    const int n = (int) ctx->num_threads, i = (int) t;
+
+    ls2_histogram_store_rows(h, merge->results, (h->height * i) / n,
+                             (h->height * (i + 1)) / n);
 }
 
 
@@ -892,114 +1767,204 @@ static void* ls2_inverse_run(void *rr)
  *****
  ************************************************************************/
 
-void
-ls2_distribute_work_inverted(const algorithm_t alg, const error_model_t em,
-			     const int num_threads, const int64_t runs,
-                             const long seed,
-                             const float tag_x, const float tag_y,
-			     const vector2 *restrict anchors, const size_t no_anchors,
-			     uint64_t *restrict results, const int width, const int height,
-			     float *restrict center_x, float *restrict sdev_x,
-                             float *center_y, float *restrict sdev_y)
+/*!
+ * Split the batches of the tag at (tag_x, tag_y) across the workers of
+ * ctx, run them and merge the estimates of all workers into results.
+ * Returns the parameters of the workers, which hold their centroids and
+ * which the caller frees.  The models have to be set up.
+ */
+static inverted_runparams_t *
+ls2_inverse_split(ls2_context_t *ctx,
+                  const algorithm_t alg, const error_model_t em,
+                  const int64_t runs, const float tag_x, const float tag_y,
+                  const vector2 *restrict anchors, const size_t no_anchors,
+                  uint64_t *restrict results, const int width, const int height)
 {
-    running = 0;
-
-#if defined(STAND_ALONE)
-    EMFUNCTION(setup)(anchors, no_anchors);
-#else
-    error_model_setup(em, anchors, no_anchors);
-#endif
-
-    // distribute work to threads
+    const int num_threads = (int) ctx->num_threads;
     inverted_runparams_t *params;
-    const size_t sz =
-	((size_t) width) * ((size_t) height) * sizeof(uint_fast64_t);
 
-    ls2_num_threads = (size_t) num_threads;
-
-    params = (inverted_runparams_t *) calloc(ls2_num_threads, sizeof(inverted_runparams_t));
+    params = (inverted_runparams_t *) calloc(ctx->num_threads, sizeof(inverted_runparams_t));
     if (params == NULL) {
         perror("calloc()");
         exit(EXIT_FAILURE);
     }
 
-    srand((unsigned int) seed);
-
+    // Split the batches of runs into contiguous ranges, one per thread.
+    const int_fast64_t batches = runs / VECTOR_OPS;
     for (int t = 0; t < num_threads; t++) {
         params[t].id = t;
-        params[t].seed = (unsigned int) rand() + (unsigned int) t;
+        params[t].seed = (uint64_t) ctx->seed;
+        params[t].first = (batches * t) / num_threads;
+        params[t].runs = (batches * (t + 1)) / num_threads - params[t].first;
 	params[t].tag_x = tag_x;
 	params[t].tag_y = tag_y;
 	params[t].anchors = anchors;
 	params[t].no_anchors = no_anchors;
 	params[t].width = width;
 	params[t].height = height;
-	params[t].runs = runs;
 	params[t].algorithm = alg;
 	params[t].error_model = em;
-        if (posix_memalign((void **) &(params[t].result), ALIGNMENT, sz) != 0) {
-            fprintf(stderr, "allocate result\n");
-            exit(EXIT_FAILURE);
-        }
-        memset(params[t].result, 0, sz);
+        ls2_histogram_init(&(params[t].histogram), width, height,
+                           (int) roundf(tag_x), (int) roundf(tag_y));
     }
 
-    ls2_thread = (pthread_t *) calloc((size_t) num_threads, sizeof(pthread_t));
-    if (ls2_thread == NULL) {
-        perror("calloc()");
-        exit(EXIT_FAILURE);
-    }
+    ls2_context_run(ctx, ls2_inverse_work, params);
 
-    for (int t = 0; t < num_threads; t++) {
-        if (pthread_create(&ls2_thread[t], NULL, ls2_inverse_run, &params[t])) {
-            perror("pthread_create()");
-            free(ls2_thread);
-            exit(EXIT_FAILURE);
+    /* Merge the histograms pairwise into the first thread's one. */
+    inverted_merge_t merge = { .params = params, .results = results };
+    for (merge.stride = 1; merge.stride < ctx->num_threads; merge.stride *= 2)
+        ls2_context_run(ctx, ls2_inverse_merge, &merge);
+    ls2_context_run(ctx, ls2_inverse_store, &merge);
+
+    ls2_histogram_free(&(params[0].histogram));
+    return params;
+}
+
+
+
+/*!
+ * The centroid and the standard deviations of the estimates of the n
+ * workers of ls2_inverse_split(), pooled with the numbers of estimates
+ * of the workers as weights.
+ */
+static void __attribute__((__nonnull__))
+ls2_inverse_pool(const inverted_runparams_t *params, const size_t n,
+                 float *restrict center_x, float *restrict sdev_x,
+                 float *restrict center_y, float *restrict sdev_y)
+{
+    float N = 0.0F, cx = 0.0F, cy = 0.0F, sx = 0.0F, sy = 0.0F;
+
+    for (size_t t = 0; t < n; t++) {
+        N += params[t].cn;
+        cx += params[t].cn * params[t].cx;
+        cy += params[t].cn * params[t].cy;
+    }
+    cx /= N;
+    cy /= N;
+    for (size_t t = 0; t < n; t++) {
+        if (params[t].cn > 0.0F) {
+            const float dx = params[t].cx - cx, dy = params[t].cy - cy;
+            sx += params[t].cn * (params[t].sx + dx * dx);
+            sy += params[t].cn * (params[t].sy + dy * dy);
         }
-        running++;
     }
+    *center_x = cx;
+    *sdev_x = sqrtf(sx / N);
+    *center_y = cy;
+    *sdev_y = sqrtf(sy / N);
+}
+
 
-    // Sync Threads if work has been done
-    for (int t = 0; t < num_threads; t++)
-        pthread_join(ls2_thread[t], NULL);
 
-    free(ls2_thread);
+void
+ls2_distribute_work_inverted(ls2_context_t *ctx,
+                             const algorithm_t alg, const error_model_t em,
+			     const int64_t runs,
+                             const float tag_x, const float tag_y,
+			     const vector2 *restrict anchors, const size_t no_anchors,
+			     uint64_t *restrict results, const int width, const int height,
+			     float *restrict center_x, float *restrict sdev_x,
+                             float *center_y, float *restrict sdev_y)
+{
+    ls2_context_setup(ctx, &alg, 1, em, anchors, no_anchors);
+
+    inverted_runparams_t *params =
+        ls2_inverse_split(ctx, alg, em, runs, tag_x, tag_y, anchors,
+                          no_anchors, results, width, height);
 
     /*
-     * Evaluate the results.
+     * Evaluate the results.  Workers without batches hold no estimates,
+     * so the centroids are weighted by the numbers of estimates.
      */
+    ls2_inverse_pool(params, ctx->num_threads, center_x, sdev_x,
+                     center_y, sdev_y);
+
+    free(params);
+}
+
 
-   *center_x = params[0].cx;
-   *sdev_x   = params[0].sx;
-   *center_y = params[0].cy;
-   *sdev_y   = params[0].sy;
 
-    /* Accumulate all results and store them in the first thread's image. */
-    for (int t = 1; t < num_threads; t++) {
-        for (int i = 0; i < width * height; i++) {
-            params[0].result[i] += params[t].result[i];
+
+
+void
+ls2_distribute_work_inverted_tags(ls2_context_t *ctx,
+                                  const algorithm_t alg, const error_model_t em,
+                                  const int64_t runs,
+                                  const vector2 *restrict tags,
+                                  const size_t no_tags,
+                                  const vector2 *restrict anchors,
+                                  const size_t no_anchors,
+                                  const int width, const int height,
+                                  ls2_inverted_store_t store, void *arg)
+{
+    ls2_context_setup(ctx, &alg, 1, em, anchors, no_anchors);
+
+    uint64_t *result = (uint64_t *) calloc((size_t) width * (size_t) height,
+                                           sizeof(uint64_t));
+    if (result == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+
+    // With fewer tags than workers, split the batches of each tag across
+    // all workers instead, as for a single tag.
+    if (no_tags < ctx->num_threads) {
+        for (size_t k = 0; k < no_tags && !ctx->cancelled; k++) {
+            float cx, sx, cy, sy;
+            inverted_runparams_t *params =
+                ls2_inverse_split(ctx, alg, em, runs, tags[k].x, tags[k].y,
+                                  anchors, no_anchors, result, width, height);
+            ls2_inverse_pool(params, ctx->num_threads, &cx, &sx, &cy, &sy);
+            if (!ctx->cancelled)
+                store(arg, k, result, cx, sx, cy, sy);
+            free(params);
         }
-	*center_x += params[t].cx;
-        *sdev_x   += params[t].sx;
-	*center_y += params[t].cy;
-        *sdev_y   += params[t].sy;
-    }
-    *center_x /= ((float) num_threads);
-    *sdev_x = sqrtf(*sdev_x / (float) num_threads);
-    *center_y /= ((float) num_threads);
-    *sdev_y = sqrtf(*sdev_y / (float) num_threads);
-
-    for (int y = 0; y < params->height; y++) {
-        for (int x = 0; x < params->width; x++) {
-	    const int pos = x + params->width * y;
-            const uint64_t samples = (uint64_t) params[0].result[pos];
-	    results[pos] = samples;
-	}
+        free(result);
+        return;
     }
-    for (int t = 0; t < num_threads; t++) {
-	free(params[t].result);
+
+    inverted_tags_t work = { .no_tags = no_tags, .next = 0 };
+    work.params = (inverted_runparams_t *) calloc(no_tags, sizeof(inverted_runparams_t));
+    if (work.params == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
     }
-    free(params);
+
+    // Every tag runs all batches, with the same random numbers.
+    for (size_t k = 0; k < no_tags; k++) {
+        inverted_runparams_t *params = &(work.params[k]);
+        params->id = (int) k;
+        params->seed = (uint64_t) ctx->seed;
+        params->first = 0;
+        params->runs = runs / VECTOR_OPS;
+	params->tag_x = tags[k].x;
+	params->tag_y = tags[k].y;
+	params->anchors = anchors;
+	params->no_anchors = no_anchors;
+	params->width = width;
+	params->height = height;
+	params->algorithm = alg;
+	params->error_model = em;
+        ls2_histogram_init(&(params->histogram), width, height,
+                           (int) roundf(tags[k].x), (int) roundf(tags[k].y));
+    }
+
+    ls2_context_run(ctx, ls2_inverse_tags_work, &work);
+
+    // Hand the tags to store one after the other, each densified in parallel.
+    for (size_t k = 0; k < no_tags; k++) {
+        inverted_runparams_t *params = &(work.params[k]);
+        inverted_merge_t merge = { .params = params, .results = result };
+        if (!ctx->cancelled) {
+            ls2_context_run(ctx, ls2_inverse_store, &merge);
+            store(arg, k, result, params->cx, sqrtf(params->sx),
+                  params->cy, sqrtf(params->sy));
+        }
+        ls2_histogram_free(&(params->histogram));
+    }
+
+    free(result);
+    free(work.params);
 }
 
 
@@ -1007,8 +1972,8 @@ ls2_distribute_work_inverted(const algorithm_t alg, const error_model_t em,
 
 
 extern int
-compute_inverse(const algorithm_t alg, const error_model_t em,
-		const int num_threads,
+compute_inverse(ls2_context_t *ctx,
+                const algorithm_t alg, const error_model_t em,
                 const int64_t runs, const float *restrict anchor_x,
                 const float *restrict anchor_y, const int no_anchors,
                 const float tag_x, const float tag_y,
@@ -1018,7 +1983,7 @@ compute_inverse(const algorithm_t alg, const error_model_t em,
 {
     vector2 *anchors;
 
-    cancelled = false;
+    ctx->cancelled = false;
 
     // parse and normalize arguments
     anchors = calloc((size_t) no_anchors, sizeof(vector2));
@@ -1032,14 +1997,13 @@ compute_inverse(const algorithm_t alg, const error_model_t em,
 	    anchors[i].y = anchor_y[i];
     }
 
-    ls2_distribute_work_inverted(alg, em, num_threads, runs, time(NULL),
-				 tag_x, tag_y, anchors, (size_t) no_anchors,
-                                 result, width, height,
+    ls2_distribute_work_inverted(ctx, alg, em, runs, tag_x, tag_y, anchors,
+                                 (size_t) no_anchors, result, width, height,
                                  center_x, sdev_x, center_y, sdev_y);
 
     free(anchors);
 
-    if (cancelled)
+    if (ctx->cancelled)
 	return -1;
     else
         return 0;
@@ -1076,11 +2040,10 @@ typedef struct estimator_runparams_t {
  * The beginning of the array starts on a cache line, if the cache line
  * size is 64 bytes large.
  */
-static void*
-ls2_estimator_run(void *rr)
+static void
+ls2_estimator_work(ls2_context_t *ctx, const size_t t, void *arg)
 {
-    estimator_runparams_t *params = (estimator_runparams_t *) rr;
-    assert(params != NULL);
+    estimator_runparams_t *params = &(((estimator_runparams_t *) arg)[t]);
 
     // Calculation for every pixel
     for (size_t pos = params->from; pos < params->from + params->count; pos++) {
@@ -1090,7 +2053,8 @@ ls2_estimator_run(void *rr)
         location.x = (float) (pos % params->width);
         location.y = (float) (pos / params->width);
 
-	pthread_testcancel();   // Check whether this thread is cancelled.
+        if (__builtin_expect(ls2_cancelled(ctx), 0))
+            break;
 
 	result = estimate(params->estimator, params->anchors,
                           params->no_anchors, &location);
@@ -1099,16 +2063,14 @@ ls2_estimator_run(void *rr)
 	    params->results[ROOT_MEAN_SQUARED_ERROR][pos] = sqrtf(result);
         }
     }
-    running--;
 
-    if (ls2_verbose >= 2) {
+    if (ctx->verbose >= 2) {
         struct rusage resources;
         getrusage(RUSAGE_THREAD, &resources);
         fprintf(stderr, "Thread %zu: %d.%06d sec.\n", params->id,
                 (int)resources.ru_utime.tv_sec, (int)resources.ru_utime.tv_usec);
         fflush(stderr);
     }
-    return NULL;
 }
 
 
@@ -1133,31 +2095,27 @@ ls2_estimator_run(void *rr)
  * \param[in] height     Height of the playing field.
  */
 void
-ls2_distribute_work_estimator(const estimator_t est, const int num_threads,
+ls2_distribute_work_estimator(ls2_context_t *ctx, const estimator_t est,
 			      const vector2* anchors, const size_t no_anchors,
 			      float *results[NUM_VARIANTS],
 			      const int width, const int height)
 {
-    ls2_num_threads = (size_t) num_threads;
-    const size_t slice = (size_t) (width * height) / ls2_num_threads;
+    const size_t slice = (size_t) (width * height) / ctx->num_threads;
     estimator_runparams_t *params;
 
-    running = 0;
+    // The estimators have no setup, they only use the options.
+    ls2_model_free(&(ctx->model));
+    ctx->model = ctx->options;
+    ctx->valid = false;
 
-    params = (estimator_runparams_t *) calloc(ls2_num_threads, sizeof(estimator_runparams_t));
+    params = (estimator_runparams_t *) calloc(ctx->num_threads, sizeof(estimator_runparams_t));
     if (params == NULL) {
         perror("calloc()");
         exit(EXIT_FAILURE);
     }
 
-    ls2_thread = (pthread_t *) calloc(ls2_num_threads, sizeof(pthread_t));
-    if (ls2_thread == NULL) {
-        perror("calloc()");
-        exit(EXIT_FAILURE);
-    }
-
     // distribute work to threads
-    for (size_t t = 0; t < ls2_num_threads; t++) {
+    for (size_t t = 0; t < ctx->num_threads; t++) {
         params[t].id = t;
         params[t].anchors = anchors;
         params[t].no_anchors = (size_t)no_anchors;
@@ -1167,21 +2125,10 @@ ls2_distribute_work_estimator(const estimator_t est, const int num_threads,
         params[t].from = (uint32_t) (t * slice);
         params[t].count = (uint32_t) slice;
         params[t].estimator = est;
-
-        if (pthread_create(&ls2_thread[t], NULL, ls2_estimator_run, &params[t])) {
-            perror("pthread_create()");
-            free(ls2_thread);
-            exit(EXIT_FAILURE);
-        }
-        running++;
     }
 
+    ls2_context_run(ctx, ls2_estimator_work, params);
 
-    // Sync Threads if work has been done
-    for(size_t t = 0; t < ls2_num_threads; t++)
-        pthread_join(ls2_thread[t], NULL);
-
-    free(ls2_thread);
     free(params);
 }
 
@@ -1190,7 +2137,7 @@ ls2_distribute_work_estimator(const estimator_t est, const int num_threads,
 
 
 int
-compute_estimates(const estimator_t est, const int num_threads,
+compute_estimates(ls2_context_t *ctx, const estimator_t est,
 		  const float *anchor_x, const float *anchor_y,
 		  const size_t no_anchors,
 		  float* results[NUM_VARIANTS], const int width,
@@ -1198,7 +2145,7 @@ compute_estimates(const estimator_t est, const int num_threads,
 {
     vector2 *anchors;
 
-    cancelled = false;
+    ctx->cancelled = false;
 
     // parse and normalize arguments
     anchors = calloc(no_anchors, sizeof(vector2));
@@ -1212,13 +2159,12 @@ compute_estimates(const estimator_t est, const int num_threads,
 	    anchors[i].y = anchor_y[i];
     }
 
-    ls2_distribute_work_estimator(est, num_threads,
-				  anchors, no_anchors,
+    ls2_distribute_work_estimator(ctx, est, anchors, no_anchors,
 				  results, width, height);
 
     free(anchors);
 
-    if (cancelled)
+    if (ctx->cancelled)
 	return -1;
     else
         return 0;
@@ -60,8 +60,8 @@
 int
 main(int argc, const char* argv[])
 {
-    srand((unsigned int) time(NULL));
-    __m128i seed = _mm_set_epi32(rand(), rand(), rand(), rand());
+    ls2_rng_t seed;
+    ls2_rng_init(&seed, (uint64_t) time(NULL));
     VECTOR tagx = VECTOR_BROADCASTF(500.0F), tagy = VECTOR_BROADCASTF(500.0F);
     vector2 anchors[4] = { { 300.0, 300.0 }, { 300, 700 }, { 700, 300 }, { 700, 700 } };
     VECTOR vx[4] = { VECTOR_BROADCASTF(300), VECTOR_BROADCASTF(300), VECTOR_BROADCASTF(700), VECTOR_BROADCASTF(700) };
@@ -70,8 +70,9 @@ main(int argc, const char* argv[])
     VECTOR result[4];
     memset(distances, 0, sizeof(distances));
 
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <error-model> <samples>.\n", argv[0]);
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: %s <error-model> <samples> [normal-sampler].\n",
+                argv[0]);
         exit(EXIT_FAILURE);
     }
     const int em = get_error_model_by_name(argv[1]);
@@ -87,13 +88,30 @@ main(int argc, const char* argv[])
         exit(EXIT_FAILURE);
     }
 
+    if (argc == 4) {
+        ls2_normal_sampler = ls2_get_normal_sampler_by_name(argv[3]);
+        if ((int) ls2_normal_sampler < 0) {
+            fprintf(stderr, "Unknown normal sampler %s.\nTry one of "
+                    "ziggurat, box-muller\n", argv[3]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct timespec start, end;
+    double elapsed = 0.0;
     error_model_setup(em, anchors, 4);
     for (int i = 0; i < samples; i += VECTOR_OPS) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
 	error_model(em, &seed, distances, vx, vy, 4, tagx, tagy, result);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed += (double) (end.tv_sec - start.tv_sec) +
+            (double) (end.tv_nsec - start.tv_nsec) / 1e9;
 	for (int ii = 0; ii < VECTOR_OPS; ii++) {
 	    printf("%f\n", result[0][ii]);
 	}
     }
+    fprintf(stderr, "%ld samples in %f sec. (%f ns per sample)\n",
+            samples, elapsed, elapsed * 1e9 / (double) samples);
     exit(EXIT_SUCCESS);
 }
 
@@ -0,0 +1,209 @@
+/*
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/********************************************************************
+ **
+ **  This file is made only for including in the lib_lat project
+ **  and not intended for stand alone usage!
+ **
+ ********************************************************************/
+
+#ifndef UTIL_HISTOGRAM_C_INCLUDED
+#define UTIL_HISTOGRAM_C_INCLUDED 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*******************************************************************
+ ***
+ ***   Sparse histograms of the estimated positions on a field.
+ ***
+ *******************************************************************/
+
+/*
+ * Almost all estimates of a tag land close to it.  A histogram counts
+ * the pixels in a square window around the tag densely and the pixels
+ * outside of it in a hash table with open addressing, which grows when
+ * it is half full.  The window is clipped to the field, so histograms of
+ * the same tag and field have the same window and merge by adding it.
+ */
+#ifndef LS2_HISTOGRAM_WINDOW
+#  define LS2_HISTOGRAM_WINDOW 128
+#endif
+
+#define LS2_HISTOGRAM_EMPTY UINT64_MAX
+
+typedef struct ls2_histogram_cell_t {
+    uint64_t pos;               /* x + width * y, or LS2_HISTOGRAM_EMPTY. */
+    uint64_t count;
+} ls2_histogram_cell_t;
+
+typedef struct ls2_histogram_t {
+    int width, height;          /* Size of the field.                  */
+    int x0, y0, x1, y1;         /* The window is [x0, x1) x [y0, y1).  */
+    uint64_t *window;
+    ls2_histogram_cell_t *cells;
+    size_t size;                /* Number of cells, a power of two.    */
+    size_t used;                /* Number of cells in use.             */
+} ls2_histogram_t;
+
+
+static ls2_histogram_cell_t *
+ls2_histogram_cells(const size_t size)
+{
+    ls2_histogram_cell_t *cells = malloc(size * sizeof(ls2_histogram_cell_t));
+    if (cells == NULL) {
+        perror("malloc()");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < size; i++)
+        cells[i].pos = LS2_HISTOGRAM_EMPTY;
+    return cells;
+}
+
+
+/*! An empty histogram of a width x height field with its window at (cx, cy). */
+static void __attribute__((__nonnull__))
+ls2_histogram_init(ls2_histogram_t *h, const int width, const int height,
+                   const int cx, const int cy)
+{
+    h->width = width;
+    h->height = height;
+    h->x0 = CLAMP(0, cx - LS2_HISTOGRAM_WINDOW / 2, width);
+    h->y0 = CLAMP(0, cy - LS2_HISTOGRAM_WINDOW / 2, height);
+    h->x1 = CLAMP(0, cx + LS2_HISTOGRAM_WINDOW / 2, width);
+    h->y1 = CLAMP(0, cy + LS2_HISTOGRAM_WINDOW / 2, height);
+    const size_t sz = (size_t) (h->x1 - h->x0) * (size_t) (h->y1 - h->y0);
+    h->window = calloc(MAX(sz, 1), sizeof(uint64_t));
+    if (h->window == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+    h->size = 64;
+    h->used = 0;
+    h->cells = ls2_histogram_cells(h->size);
+}
+
+
+static void __attribute__((__nonnull__))
+ls2_histogram_free(ls2_histogram_t *h)
+{
+    free(h->window);
+    free(h->cells);
+    h->window = NULL;
+    h->cells = NULL;
+}
+
+
+/*! The cell of pos in the hash table, or the empty cell to put it in. */
+static inline ls2_histogram_cell_t * __attribute__((__always_inline__,__nonnull__))
+ls2_histogram_find(const ls2_histogram_t *h, const uint64_t pos)
+{
+    const size_t mask = h->size - 1;
+    size_t i = (size_t) ((pos * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (h->cells[i].pos != pos && h->cells[i].pos != LS2_HISTOGRAM_EMPTY)
+        i = (i + 1) & mask;
+    return &(h->cells[i]);
+}
+
+
+/*! Count pos outside of the window count times. */
+static void __attribute__((__nonnull__))
+ls2_histogram_add_sparse(ls2_histogram_t *h, const uint64_t pos,
+                         const uint64_t count)
+{
+    ls2_histogram_cell_t *cell = ls2_histogram_find(h, pos);
+    if (cell->pos == pos) {
+        cell->count += count;
+        return;
+    }
+    if (2 * (h->used + 1) > h->size) {
+        ls2_histogram_cell_t *old = h->cells;
+        const size_t size = h->size;
+        h->size *= 2;
+        h->cells = ls2_histogram_cells(h->size);
+        for (size_t i = 0; i < size; i++)
+            if (old[i].pos != LS2_HISTOGRAM_EMPTY)
+                *ls2_histogram_find(h, old[i].pos) = old[i];
+        free(old);
+        cell = ls2_histogram_find(h, pos);
+    }
+    cell->pos = pos;
+    cell->count = count;
+    h->used++;
+}
+
+
+/*! Count the pixel (x, y), which has to be in the field. */
+static inline void __attribute__((__always_inline__,__nonnull__))
+ls2_histogram_add(ls2_histogram_t *h, const int x, const int y)
+{
+    if (__builtin_expect(h->x0 <= x && x < h->x1 && h->y0 <= y && y < h->y1, 1)) {
+        h->window[(size_t) (x - h->x0) + (size_t) (h->x1 - h->x0) *
+                  (size_t) (y - h->y0)]++;
+    } else {
+        ls2_histogram_add_sparse(h, (uint64_t) x + (uint64_t) h->width *
+                                 (uint64_t) y, 1);
+    }
+}
+
+
+/*! Add the counts of src, which has the same window, to dst. */
+static void __attribute__((__nonnull__))
+ls2_histogram_merge(ls2_histogram_t *restrict dst,
+                    const ls2_histogram_t *restrict src)
+{
+    const size_t sz = (size_t) (dst->x1 - dst->x0) * (size_t) (dst->y1 - dst->y0);
+    for (size_t i = 0; i < sz; i++)
+        dst->window[i] += src->window[i];
+    for (size_t i = 0; i < src->size; i++)
+        if (src->cells[i].pos != LS2_HISTOGRAM_EMPTY)
+            ls2_histogram_add_sparse(dst, src->cells[i].pos, src->cells[i].count);
+}
+
+
+/*! Write the rows y0 to y1 - 1 of the histogram into the dense field. */
+static void __attribute__((__nonnull__))
+ls2_histogram_store_rows(const ls2_histogram_t *restrict h,
+                         uint64_t *restrict field, const int y0, const int y1)
+{
+    const size_t width = (size_t) h->width;
+    const size_t w = (size_t) (h->x1 - h->x0);
+
+    memset(field + width * (size_t) y0, 0,
+           width * (size_t) (y1 - y0) * sizeof(uint64_t));
+    for (int y = MAX(y0, h->y0); y < MIN(y1, h->y1); y++) {
+        memcpy(field + (size_t) h->x0 + width * (size_t) y,
+               h->window + w * (size_t) (y - h->y0), w * sizeof(uint64_t));
+    }
+    const uint64_t first = width * (uint64_t) y0;
+    const uint64_t last = width * (uint64_t) y1;
+    for (size_t i = 0; i < h->size; i++) {
+        const uint64_t pos = h->cells[i].pos;
+        if (pos != LS2_HISTOGRAM_EMPTY && first <= pos && pos < last)
+            field[pos] = h->cells[i].count;
+    }
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013  Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/********************************************************************
+ **
+ **  This file is made only for including in the lib_lat project
+ **  and not intended for stand alone usage!
+ **
+ ********************************************************************/
+
+#ifndef UTIL_LM_C_INCLUDED
+#define UTIL_LM_C_INCLUDED 1
+
+#include <float.h>
+
+#include "util/util_vector.c"
+
+/*******************************************************************
+ ***
+ ***   Levenberg-Marquardt minimisation of a function of a point,
+ ***   for every lane separately.
+ ***
+ *******************************************************************/
+
+/*
+ * Every iteration solves (H + lambda I) delta = -g with the gradient g
+ * and the Hessian H of the objective at the current point.  A step that
+ * decreases the objective is taken and lambda is divided by ten,
+ * otherwise lambda is multiplied by ten, which turns the step towards
+ * the steepest descent and shortens it.  Steps where H + lambda I is not
+ * positive definite are rejected in the same way.
+ *
+ * A lane stops once the norm of its gradient drops below epsilon, once
+ * its step gets shorter than LM2_TINY, which is below the resolution of
+ * single precision coordinates, or after the given number of iterations.
+ * The objective returns FLT_MAX where it is not defined; such points are
+ * never accepted, and lanes starting on one are left alone.
+ */
+
+#define LM2_TINY 1e-4f
+#define LM2_LAMBDA 1e-3f
+
+
+/*! The objective, its gradient, and its Hessian at a point. */
+struct lm2_point {
+    VECTOR f;
+    VECTOR gx, gy;
+    VECTOR hxx, hxy, hyy;
+};
+
+
+/*! Evaluates the objective at (x, y). */
+typedef void (*lm2_eval_t)(const VECTOR x, const VECTOR y,
+                           const void *restrict params,
+                           struct lm2_point *restrict p);
+
+
+/*!
+ * Minimise the objective starting from (*x, *y) in the lanes selected
+ * by active.  The minimiser is stored in (*x, *y), the objective at it
+ * is returned.
+ */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+lm2_minimise(const lm2_eval_t eval, const void *restrict params,
+             VECTOR *restrict x, VECTOR *restrict y, VECTOR active,
+             const float epsilon, const int iterations)
+{
+    const VECTOR ones = VECTOR_ONES();
+    const VECTOR eps2 = VECTOR_BROADCASTF(epsilon * epsilon);
+    const VECTOR tiny2 = VECTOR_BROADCASTF(LM2_TINY * LM2_TINY);
+    struct lm2_point p, q;
+    VECTOR px = *x, py = *y;
+
+    eval(px, py, params, &p);
+    VECTOR lambda = VECTOR_BROADCASTF(LM2_LAMBDA) *
+        VECTOR_MAX(VECTOR_ABS(p.hxx), VECTOR_ABS(p.hyy));
+    lambda = VECTOR_MAX(lambda, VECTOR_BROADCASTF(LM2_TINY));
+    active = VECTOR_AND(active, VECTOR_LT(p.f, VECTOR_BROADCASTF(FLT_MAX)));
+    active = VECTOR_AND(active, VECTOR_GE(p.gx * p.gx + p.gy * p.gy, eps2));
+
+    for (int i = 0; i < iterations; i++) {
+        if (VECTOR_TEST_ALL_ONES(VECTOR_ANDNOT(active, ones)))
+            break;
+        const VECTOR a = p.hxx + lambda, c = p.hyy + lambda;
+        const VECTOR det = a * c - p.hxy * p.hxy;
+        const VECTOR definite = VECTOR_AND(VECTOR_GT(a, zero),
+                                           VECTOR_GT(det, zero));
+        const VECTOR dx = VECTOR_AND((p.hxy * p.gy - c * p.gx) / det, definite);
+        const VECTOR dy = VECTOR_AND((p.hxy * p.gx - a * p.gy) / det, definite);
+        const VECTOR tx = px + VECTOR_AND(dx, active);
+        const VECTOR ty = py + VECTOR_AND(dy, active);
+
+        eval(tx, ty, params, &q);
+        const VECTOR better = VECTOR_AND(VECTOR_AND(active, definite),
+                                         VECTOR_LT(q.f, p.f));
+        px = VECTOR_BLENDV(px, tx, better);
+        py = VECTOR_BLENDV(py, ty, better);
+        p.f = VECTOR_BLENDV(p.f, q.f, better);
+        p.gx = VECTOR_BLENDV(p.gx, q.gx, better);
+        p.gy = VECTOR_BLENDV(p.gy, q.gy, better);
+        p.hxx = VECTOR_BLENDV(p.hxx, q.hxx, better);
+        p.hxy = VECTOR_BLENDV(p.hxy, q.hxy, better);
+        p.hyy = VECTOR_BLENDV(p.hyy, q.hyy, better);
+        lambda = VECTOR_BLENDV(lambda * VECTOR_BROADCASTF(10.0f),
+                               lambda * VECTOR_BROADCASTF(0.1f), better);
+
+        const VECTOR converged = VECTOR_LT(p.gx * p.gx + p.gy * p.gy, eps2);
+        const VECTOR stalled = VECTOR_AND(definite,
+                                          VECTOR_LT(dx * dx + dy * dy, tiny2));
+        active = VECTOR_ANDNOT(VECTOR_OR(converged, stalled), active);
+    }
+    *x = px;
+    *y = py;
+    return p.f;
+}
+
+#endif
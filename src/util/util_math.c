@@ -29,6 +29,12 @@
 #ifndef UTIL_MATH_C_INCLUDED
 #define UTIL_MATH_C_INCLUDED 1
 
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 /** All long-representable factorials */
 static const long long factorials[] =  {
     1LL, 1LL, 2LL,
@@ -76,4 +82,84 @@ static inline int incCounter(int v[], int i, int n, int k) {
     return (v[i] == n - ((k - 1) - i)); // return overflow information
 }
 
+
+/*!
+ * The subsets of the anchors with kmin to kmax elements, in ascending
+ * order of their sizes and lexicographically among those of one size.
+ * Algorithms which try subsets of the anchors build the table once per
+ * simulation in their setup, since it only depends on the number of
+ * anchors.
+ */
+typedef struct ls2_subsets_t {
+    size_t n;                           /*!< Number of anchors. */
+    int kmin, kmax;                     /*!< Sizes of the subsets. */
+    size_t count;                       /*!< Number of subsets. */
+    uint8_t *size;                      /*!< Size of each subset. */
+    uint8_t (*anchor)[MAX_ANCHORS];     /*!< Anchors of each subset. */
+} ls2_subsets_t;
+
+
+/*! Release the memory of the table subsets. */
+static void
+__attribute__((__unused__,__nonnull__))
+ls2_subsets_free(ls2_subsets_t *subsets)
+{
+    free(subsets->size);
+    free(subsets->anchor);
+    memset(subsets, 0, sizeof(ls2_subsets_t));
+}
+
+
+/*!
+ * Fill the table subsets with the subsets of n anchors which have kmin
+ * to kmax elements, replacing its former contents.
+ */
+static void
+__attribute__((__unused__,__nonnull__))
+ls2_subsets_init(ls2_subsets_t *subsets, const size_t n, const int kmin,
+                 const int kmax)
+{
+    assert(n <= MAX_ANCHORS);
+    ls2_subsets_free(subsets);
+    subsets->n = n;
+    subsets->kmin = kmin;
+    subsets->kmax = kmax;
+    for (int k = kmin; k <= kmax; k++)
+        subsets->count += (size_t) binom((int) n, k);
+    if (subsets->count == 0)
+        return;
+
+    subsets->size = malloc(subsets->count * sizeof(uint8_t));
+    subsets->anchor = malloc(subsets->count * sizeof(*subsets->anchor));
+    if (subsets->size == NULL || subsets->anchor == NULL) {
+        perror("malloc()");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t c = 0;
+    for (int k = kmin; k <= kmax && k <= (int) n; k++) {
+        int v[k];
+        for (int i = 0; i < k; i++)
+            v[i] = i;
+        for (;;) {
+            subsets->size[c] = (uint8_t) k;
+            for (int i = 0; i < k; i++)
+                subsets->anchor[c][i] = (uint8_t) v[i];
+            c++;
+
+            // The next subset increments the last element that can be
+            // incremented and resets those after it.
+            int j = k - 1;
+            while (j >= 0 && v[j] == (int) n - k + j)
+                j--;
+            if (j < 0)
+                break;
+            v[j]++;
+            for (int l = j + 1; l < k; l++)
+                v[l] = v[l - 1] + 1;
+        }
+    }
+    assert(c == subsets->count);
+}
+
 #endif
@@ -64,6 +64,19 @@ invert_2x2(const VECTOR * restrict a, VECTOR * restrict ret)
     ret[3] = det * a[0];   
 }
 
+// Solve the normal equations (A^T A) x = A^T b of a system in two
+// unknowns, given A^T A = (sxx sxy, sxy syy) and A^T b = (bx, by).
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+solve_normal_2x2(const VECTOR sxx, const VECTOR sxy, const VECTOR syy,
+                 const VECTOR bx, const VECTOR by,
+                 VECTOR *restrict x, VECTOR *restrict y)
+{
+    const VECTOR det = one / (sxx * syy - sxy * sxy);
+    *x = det * (syy * bx - sxy * by);
+    *y = det * (sxx * by - sxy * bx);
+}
+
 // Multiply a Matrix
 static inline void
 __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
@@ -0,0 +1,215 @@
+/*
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013  Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/********************************************************************
+ **
+ **  This file is made only for including in the lib_lat project
+ **  and not intended for stand alone usage!
+ **
+ ********************************************************************/
+
+#ifndef UTIL_MINRES_C_INCLUDED
+#define UTIL_MINRES_C_INCLUDED 1
+
+#include <float.h>
+
+#include "util/util_vector.c"
+
+/*******************************************************************
+ ***
+ ***   Branch and bound search for the grid point minimising the
+ ***   residuals.
+ ***
+ *******************************************************************/
+
+/*
+ * The grid is covered by a square, which is split into quarters until
+ * squares of MINRES_LEAF x MINRES_LEAF points are scanned.  For every
+ * square, the distance to an anchor lies between the distances to the
+ * nearest and the farthest point of the square, which bounds the
+ * residual of that anchor from below.  A square is skipped if its bound
+ * exceeds the best residual found so far in every lane; the quarters
+ * are visited in the order of their bounds.
+ *
+ * The bound is reduced by MINRES_SLACK relative to the magnitude of the
+ * distances, which covers the rounding errors of single precision, so
+ * no square holding a minimiser is skipped.  Equal residuals are
+ * resolved in favour of the point scanned first by a row-wise scan, so
+ * the result is exactly the one of the brute force search.
+ */
+
+#define MINRES_LEAF 4
+#define MINRES_SLACK 1e-5f
+#define MINRES_STACK 100
+
+
+/*! The residual of the grid point (vx, vy), in norm 1 or 2. */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+minres_residual(const VECTOR vx, const VECTOR vy, const VECTOR *ax,
+                const VECTOR *ay, const VECTOR *restrict r,
+                const size_t num_anchors, const int norm)
+{
+    VECTOR res = VECTOR_ZERO();
+    for (size_t a = 0; a < num_anchors; a++) {
+        const VECTOR d = distance(vx, vy, ax[a], ay[a]) - r[a];
+        if (norm == 1)
+            res += VECTOR_ABS(d);
+        else
+            res += d * d;
+    }
+    return res;
+}
+
+
+/*! A lower bound of the residuals of the points x0..x1 by y0..y1. */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+minres_bound(const int x0, const int y0, const int x1, const int y1,
+             const VECTOR *ax, const VECTOR *ay, const VECTOR *restrict r,
+             const size_t num_anchors, const int norm)
+{
+    const VECTOR lx = VECTOR_BROADCASTF((float) x0);
+    const VECTOR ly = VECTOR_BROADCASTF((float) y0);
+    const VECTOR hx = VECTOR_BROADCASTF((float) x1);
+    const VECTOR hy = VECTOR_BROADCASTF((float) y1);
+    VECTOR bound = VECTOR_ZERO();
+    for (size_t a = 0; a < num_anchors; a++) {
+        const VECTOR nx = VECTOR_MAX(lx, VECTOR_MIN(ax[a], hx));
+        const VECTOR ny = VECTOR_MAX(ly, VECTOR_MIN(ay[a], hy));
+        const VECTOR fx = VECTOR_MAX(VECTOR_ABS(ax[a] - lx),
+                                     VECTOR_ABS(ax[a] - hx));
+        const VECTOR fy = VECTOR_MAX(VECTOR_ABS(ay[a] - ly),
+                                     VECTOR_ABS(ay[a] - hy));
+        const VECTOR dmin = distance(nx, ny, ax[a], ay[a]);
+        const VECTOR dmax = VECTOR_SQRT(fx * fx + fy * fy);
+        const VECTOR g = VECTOR_MAX(VECTOR_MAX(dmin - r[a], r[a] - dmax),
+                                    VECTOR_ZERO());
+        if (norm == 1)
+            bound += g;
+        else
+            bound += g * g;
+    }
+    return bound;
+}
+
+
+/*!
+ * Find the grid point minimising the residuals in norm 1 or 2, for
+ * every lane separately.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+minres_search(const VECTOR *ax, const VECTOR *ay, const VECTOR *restrict r,
+              const size_t num_anchors, const int width, const int height,
+              const int norm, VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    struct {
+        VECTOR bound;
+        int x, y, size;
+    } stack[MINRES_STACK];
+    VECTOR min_res = VECTOR_BROADCASTF(FLT_MAX),
+           rx = VECTOR_BROADCASTF(0.0f),
+           ry = VECTOR_BROADCASTF(0.0f);
+    int top = 0, size = MINRES_LEAF;
+
+    // The magnitude of the residuals, for the rounding errors.
+    const float diagonal = sqrtf((float) width * (float) width +
+                                 (float) height * (float) height);
+    VECTOR scale = VECTOR_ZERO();
+    for (size_t a = 0; a < num_anchors; a++) {
+        const VECTOR m = VECTOR_BROADCASTF(diagonal) + VECTOR_ABS(r[a]);
+        if (norm == 1)
+            scale += m;
+        else
+            scale += m * m;
+    }
+    const VECTOR slack = VECTOR_BROADCASTF(MINRES_SLACK);
+
+    while (size < width || size < height)
+        size *= 2;
+    stack[0].bound = VECTOR_ZERO();
+    stack[0].x = stack[0].y = 0;
+    stack[0].size = size;
+    top = 1;
+    while (top > 0) {
+        top--;
+        const VECTOR bound = stack[top].bound;
+        const int x0 = stack[top].x, y0 = stack[top].y, s = stack[top].size;
+        if (VECTOR_TEST_ALL_ONES(VECTOR_GT(bound - slack * (bound + scale),
+                                           min_res)))
+            continue;
+        const int x1 = MIN(x0 + s, width) - 1, y1 = MIN(y0 + s, height) - 1;
+
+        if (s <= MINRES_LEAF) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    const VECTOR vx = VECTOR_BROADCASTF((float) x),
+                                 vy = VECTOR_BROADCASTF((float) y);
+                    const VECTOR res = minres_residual(vx, vy, ax, ay, r,
+                                                       num_anchors, norm);
+                    const VECTOR first =
+                        VECTOR_OR(VECTOR_LT(vy, ry),
+                                  VECTOR_AND(VECTOR_EQ(vy, ry),
+                                             VECTOR_LT(vx, rx)));
+                    const VECTOR m =
+                        VECTOR_OR(VECTOR_GT(min_res, res),
+                                  VECTOR_AND(VECTOR_EQ(min_res, res), first));
+                    rx = VECTOR_BLENDV(rx, vx, m);
+                    ry = VECTOR_BLENDV(ry, vy, m);
+                    min_res = VECTOR_MIN(min_res, res);
+                }
+            }
+            continue;
+        }
+
+        // Push the quarters, the one with the smallest bound last.
+        const int h = s / 2;
+        int n = 0;
+        float key[4];
+        for (int q = 0; q < 4; q++) {
+            const int qx = x0 + (q & 1) * h, qy = y0 + (q >> 1) * h;
+            if (qx >= width || qy >= height)
+                continue;
+            const VECTOR b = minres_bound(qx, qy, MIN(qx + h, width) - 1,
+                                          MIN(qy + h, height) - 1, ax, ay, r,
+                                          num_anchors, norm);
+            int i = n++;
+            key[i] = VECTOR_SUM(b);
+            while (i > 0 && key[i - 1] < key[i]) {
+                const float k = key[i - 1];
+                key[i - 1] = key[i];
+                key[i] = k;
+                stack[top + i] = stack[top + i - 1];
+                i--;
+            }
+            stack[top + i].bound = b;
+            stack[top + i].x = qx;
+            stack[top + i].y = qy;
+            stack[top + i].size = h;
+        }
+        top += n;
+    }
+    *resx = rx;
+    *resy = ry;
+}
+
+#endif
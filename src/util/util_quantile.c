@@ -0,0 +1,139 @@
+/*
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/********************************************************************
+ **
+ **  This file is made only for including in the lib_lat project
+ **  and not intended for stand alone usage!
+ **
+ ********************************************************************/
+
+#ifndef UTIL_QUANTILE_C_INCLUDED
+#define UTIL_QUANTILE_C_INCLUDED 1
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*******************************************************************
+ ***
+ ***   Quantiles of a stream of non-negative values in fixed memory.
+ ***
+ *******************************************************************/
+
+/*
+ * A histogram with logarithmic bins.  Non-negative floats are ordered
+ * like their bit patterns, so the exponent and the upper mantissa bits of
+ * a value are its bin.  With LS2_QUANTILE_BITS mantissa bits, every
+ * power of two is split into 2^LS2_QUANTILE_BITS bins, and the width of
+ * a bin is at most 1/2^LS2_QUANTILE_BITS of its values.  Values below
+ * LS2_QUANTILE_MIN share the first bin, values from LS2_QUANTILE_MAX on
+ * the last one.  Two histograms merge by adding their bins.
+ */
+#ifndef LS2_QUANTILE_BITS
+#  define LS2_QUANTILE_BITS 4
+#endif
+
+#define LS2_QUANTILE_MIN 0x1p-6F
+#define LS2_QUANTILE_MAX 0x1p16F
+#define LS2_QUANTILE_SHIFT (23 - LS2_QUANTILE_BITS)
+
+/* The bit pattern of LS2_QUANTILE_MIN, shifted to its bin. */
+#define LS2_QUANTILE_FIRST ((uint32_t) (127 - 6) << LS2_QUANTILE_BITS)
+
+#define LS2_QUANTILE_BINS ((6 + 16) << LS2_QUANTILE_BITS)
+
+typedef struct ls2_quantile_t {
+    uint32_t count;             /* Number of values.                   */
+    uint32_t bin[LS2_QUANTILE_BINS];
+} ls2_quantile_t;
+
+
+static inline void __attribute__((__always_inline__,__nonnull__))
+ls2_quantile_init(ls2_quantile_t *q)
+{
+    memset(q, 0, sizeof(*q));
+}
+
+
+/*!
+ * Add the values which are not NaN.  The bins of all lanes are computed
+ * at once, only the counting is done lane by lane.  NaNs are told apart
+ * by a comparison, as isnan() does not survive -ffast-math.
+ */
+static inline void __attribute__((__always_inline__,__nonnull__))
+ls2_quantile_add(ls2_quantile_t *q, const VECTOR values)
+{
+    // The largest float below LS2_QUANTILE_MAX is in the last bin.
+    const VECTOR v = VECTOR_CLAMP(values, VECTOR_BROADCASTF(LS2_QUANTILE_MIN),
+                                  VECTOR_BROADCASTF(0x1.fffffep15F));
+    const VECTOR number = VECTOR_EQ(values, values);
+    uint32_t bits[VECTOR_OPS], valid[VECTOR_OPS];
+    memcpy(bits, &v, sizeof(bits));
+    memcpy(valid, &number, sizeof(valid));
+    for (int k = 0; k < VECTOR_OPS; k++) {
+        if (__builtin_expect(valid[k] == 0, 0))
+            continue;
+        q->bin[(bits[k] >> LS2_QUANTILE_SHIFT) - LS2_QUANTILE_FIRST]++;
+        q->count++;
+    }
+}
+
+
+/*! The smallest value of bin b. */
+static inline float __attribute__((__always_inline__,__const__))
+ls2_quantile_lower(const size_t b)
+{
+    const uint32_t bits = (uint32_t) (b + LS2_QUANTILE_FIRST) << LS2_QUANTILE_SHIFT;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+
+/*!
+ * The p-quantile of the values, 0 <= p <= 1, interpolated linearly within
+ * its bin.  All values lie within [min, max], which bounds the first and
+ * the last bin.  Returns NaN if there are no values.
+ */
+static inline float __attribute__((__nonnull__,__pure__))
+ls2_quantile_get(const ls2_quantile_t *q, const float p, const float min,
+                 const float max)
+{
+    if (q->count == 0)
+        return NAN;
+
+    // The rank of the quantile among the sorted values, counting from 0.
+    const float rank = p * (float) (q->count - 1U);
+    uint32_t below = 0;
+    size_t b = 0;
+    while (b + 1 < LS2_QUANTILE_BINS && (float) (below + q->bin[b]) <= rank)
+        below += q->bin[b++];
+
+    // The first and the last bin are open to one side.
+    const float lower = (b == 0) ? min : MAX(ls2_quantile_lower(b), min);
+    const float upper = (b + 1 == LS2_QUANTILE_BINS) ?
+        max : MIN(ls2_quantile_lower(b + 1), max);
+    const float f = (rank - (float) below + 0.5F) / (float) q->bin[b];
+    return CLAMP(lower, lower + f * (upper - lower), upper);
+}
+
+#endif
@@ -37,42 +37,141 @@
 #define INCLUDED_UTIL_RANDOM_H
 
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 #include <immintrin.h>
 
 #include "vector_shooter.h"
 
-// calculate four 32 bit random integer between -RAN_DMAX and RAN_DMAX in a vector
-// based on http://software.intel.com/en-us/articles/fast-random-number-generator-on-the-intel-pentiumr-4-processor/
-static inline __m128
-__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__hot__,__artificial__))
-rand_sse(__m128i* cur_seed)
+/*
+ * The random number generator is Philox4x32-10 of Salmon et al.,
+ * "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011.  It is a
+ * counter based generator: the n-th block of random numbers is a keyed
+ * bijection of n, so any part of a stream can be computed without
+ * computing what precedes it.
+ *
+ * The key is the seed of the simulation.  The counter consists of a
+ * stream number, which is the index of the pixel, a run number, which
+ * is the index of the batch of VECTOR_OPS runs, and a block number,
+ * which counts the blocks drawn in this run.  Every batch of runs of a
+ * pixel therefore gets the same random numbers no matter which thread
+ * computes it and in which order.
+ *
+ * Four blocks are computed at once, one in each lane of an SSE vector,
+ * and the fourth counter word holds the lane number.  The resulting 16
+ * words are buffered and handed out four at a time.
+ */
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+/*! The state of a random number generator. */
+typedef struct ls2_rng_t {
+    __m128i buffer[4];          /*!< Random numbers not handed out yet. */
+    uint32_t key[2];            /*!< The seed. */
+    uint32_t stream;            /*!< Usually the index of the pixel. */
+    uint32_t run;               /*!< Index of the batch of runs. */
+    uint32_t block;             /*!< Next block of the run. */
+    uint32_t next;              /*!< Next element of buffer to hand out. */
+} ls2_rng_t;
+
+
+
+// Multiply the four lanes of a by m and return the upper and lower
+// halves of the 64 bit products.
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+philox_mulhilo(const __m128i a, const __m128i m, __m128i *hi, __m128i *lo)
+{
+    const __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+    const __m128i p02 = _mm_mul_epu32(a, m);
+    const __m128i p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+
+    *lo = _mm_or_si128(_mm_and_si128(p02, mask), _mm_slli_epi64(p13, 32));
+    *hi = _mm_or_si128(_mm_srli_epi64(p02, 32), _mm_andnot_si128(mask, p13));
+}
+
+
+
+// Compute the next four blocks of rng into its buffer.
+static void
+__attribute__((__nonnull__,__hot__,__noinline__))
+philox_refill(ls2_rng_t *rng)
+{
+    const __m128i m0 = _mm_set1_epi32((int) PHILOX_M0);
+    const __m128i m1 = _mm_set1_epi32((int) PHILOX_M1);
+    __m128i c0 = _mm_set1_epi32((int) rng->stream);
+    __m128i c1 = _mm_set1_epi32((int) rng->run);
+    __m128i c2 = _mm_set1_epi32((int) rng->block);
+    __m128i c3 = _mm_set_epi32(3, 2, 1, 0);
+    uint32_t k0 = rng->key[0], k1 = rng->key[1];
+
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        __m128i hi0, lo0, hi1, lo1;
+
+        philox_mulhilo(c0, m0, &hi0, &lo0);
+        philox_mulhilo(c2, m1, &hi1, &lo1);
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int) k0));
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int) k1));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    rng->buffer[0] = c0;
+    rng->buffer[1] = c1;
+    rng->buffer[2] = c2;
+    rng->buffer[3] = c3;
+    rng->block++;
+    rng->next = 0;
+}
+
+
+
+// Start the random number stream of run in stream of the generator.
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__))
+ls2_rng_seek(ls2_rng_t *rng, const uint32_t stream, const uint32_t run)
 {
-    __m128i cur_seed_split;
-    __m128i multiplier;
-    __m128i adder;
-    __m128i mod_mask;
+    rng->stream = stream;
+    rng->run = run;
+    rng->block = 0;
+    rng->next = 4;
+}
 
-    static const unsigned int __attribute__((__aligned__(ALIGNMENT),__may_alias__))
-        gadd[4] = { 2531011, 10395331, 13737667, 1 };
-    static const unsigned int __attribute__((__aligned__(ALIGNMENT),__may_alias__))
-        mult[4] = { 214013, 17405, 214013, 69069 };
-    static const unsigned int __attribute__((__aligned__(ALIGNMENT),__may_alias__))
-        mask[4] = { 0xFFFFFFFF, 0, 0xFFFFFFFF, 0 };
 
-    adder = _mm_load_si128( (__m128i*) gadd);
-    multiplier = _mm_load_si128( (__m128i*) mult);
-    mod_mask = _mm_load_si128( (__m128i*) mask);
 
-    cur_seed_split = _mm_shuffle_epi32(*cur_seed, _MM_SHUFFLE(2, 3, 0, 1));
-    *cur_seed = _mm_mul_epu32(*cur_seed, multiplier);
-    multiplier = _mm_shuffle_epi32(multiplier, _MM_SHUFFLE(2, 3, 0, 1));
-    cur_seed_split = _mm_mul_epu32(cur_seed_split, multiplier);
-    *cur_seed = _mm_and_si128(*cur_seed, mod_mask);
-    cur_seed_split = _mm_and_si128(cur_seed_split, mod_mask);
-    cur_seed_split = _mm_shuffle_epi32(cur_seed_split, _MM_SHUFFLE(2, 3, 0, 1));
-    *cur_seed = _mm_or_si128(*cur_seed, cur_seed_split );
-    *cur_seed = _mm_add_epi32(*cur_seed, adder);
-    return _mm_cvtepi32_ps(*cur_seed);
+// Key the generator with seed and seek to the start of stream 0.
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__))
+ls2_rng_init(ls2_rng_t *rng, const uint64_t seed)
+{
+    rng->key[0] = (uint32_t) seed;
+    rng->key[1] = (uint32_t) (seed >> 32);
+    ls2_rng_seek(rng, 0, 0);
+}
+
+
+
+// Returns four uniformly distributed 32 bit integers in a vector.
+static inline __m128i
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__hot__,__artificial__))
+rand_sse_epi32(ls2_rng_t *rng)
+{
+    if (__builtin_expect(rng->next >= 4, 0))
+        philox_refill(rng);
+    return rng->buffer[rng->next++];
+}
+
+// Returns four random numbers between -2^31 and 2^31 in a vector.
+static inline __m128
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__hot__,__artificial__))
+rand_sse(ls2_rng_t *rng)
+{
+    return _mm_cvtepi32_ps(rand_sse_epi32(rng));
 }
 
 
@@ -81,7 +180,7 @@ rand_sse(__m128i* cur_seed)
 #  if defined(__AVX__)
 static inline VECTOR
 __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__,__hot__,__flatten__))
-rnd(__m128i *seed)
+rnd(ls2_rng_t *seed)
 {
     __m128 tmp[2];
     tmp[0] = rand_sse(seed);
@@ -96,7 +195,7 @@ rnd(__m128i *seed)
 
 static inline VECTOR
 __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__,__hot__,__flatten__))
-rnd(__m128i *seed)
+rnd(ls2_rng_t *seed)
 {
     VECTOR ret = rand_sse(seed);
     ret = ret / rmax;
@@ -104,6 +203,16 @@ rnd(__m128i *seed)
     return ret;
 }
 #  endif
+
+// Returns VECTOR_OPS uniformly distributed 32 bit integers
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__,__hot__))
+rnd_bits(ls2_rng_t *seed, __m128i bits[VECTOR_OPS / 4])
+{
+    for (int i = 0; i < VECTOR_OPS / 4; i++) {
+        bits[i] = rand_sse_epi32(seed);
+    }
+}
 #else /* defined(__RDRAND__) */
 
 static inline void
@@ -119,7 +228,7 @@ rand64(unsigned long long *result)
 
 static inline VECTOR
 __attribute__((__always_inline__,__gnu_inline__,__artificial__,__hot__,__flatten__,__nonnull__))
-rnd(__m128i *seed __attribute__((__unused__)))
+rnd(ls2_rng_t *seed __attribute__((__unused__)))
 {
     static const VECTOR rnd_divisor = VECTOR_CONST_BROADCAST((float) UINT_MAX);
     union {
@@ -143,26 +252,59 @@ rnd(__m128i *seed __attribute__((__unused__)))
 
     return v / rnd_divisor;
 }
+
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__hot__,__nonnull__))
+rnd_bits(ls2_rng_t *seed __attribute__((__unused__)),
+         __m128i bits[VECTOR_OPS / 4])
+{
+    unsigned long long *t = (unsigned long long *) bits;
+
+    for (int i = 0; i < VECTOR_OPS / 2; i++) {
+        rand64(&(t[i]));
+    }
+}
 #endif
 
 
 
 
-#ifndef NSUM
-#  define NSUM 25
-#endif
+/*******************************************************************
+ ***
+ *** Normal distribution
+ ***
+ *******************************************************************/
+
+/*! The sampler normal_rand() uses, see ls2_normal_sampler_t. */
+ls2_normal_sampler_t ls2_normal_sampler = LS2_NORMAL_ZIGGURAT;
+
+/*! The sampler of the calling thread, ls2_normal_sampler unless a context
+ *  bound its own. */
+static __thread const ls2_normal_sampler_t *ls2_normal_sampler_params =
+    &ls2_normal_sampler;
+
+static const char * const ls2_normal_sampler_names[] = {
+    [LS2_NORMAL_ZIGGURAT] = "ziggurat",
+    [LS2_NORMAL_BOX_MULLER] = "box-muller",
+    NULL
+};
+
+ls2_normal_sampler_t
+ls2_get_normal_sampler_by_name(const char *name)
+{
+    for (int i = 0; ls2_normal_sampler_names[i] != NULL; i++) {
+        if (strcmp(name, ls2_normal_sampler_names[i]) == 0)
+            return (ls2_normal_sampler_t) i;
+    }
+    return (ls2_normal_sampler_t) -1;
+}
+
 
-#ifndef BOX_MULLER
-#  define BOX_MULLER 0
-#endif
 
 static inline VECTOR
 __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__flatten__))
-normal_rand(__m128i* seed)
+normal_rand_box_muller(ls2_rng_t *seed)
 {
-    VECTOR result;
-
-#if BOX_MULLER
     // This method actually generates a pair of independent normal distributed
     // pseudo-random numbers. 
     VECTOR u = rnd(seed);
@@ -172,26 +314,174 @@ normal_rand(__m128i* seed)
     VECTOR_SINCOS(VECTOR_BROADCASTF(((float)(M_PI + M_PI))) * v, &s, &c);
     VECTOR t = VECTOR_SQRT(VECTOR_BROADCASTF(-2.0f) * VECTOR_LOG(u));
 
-    result = t * s;
     // second number would be t * c;
+    return t * s;
+}
+
+
+
+/*
+ * The Ziggurat method of Marsaglia and Tsang, "The Ziggurat Method for
+ * Generating Random Variables", Journal of Statistical Software 5(8),
+ * 2000, in the formulation of Doornik, "An Improved Ziggurat Method to
+ * Generate Normal Random Samples", 2005.
+ *
+ * The density is covered by ZIGGURAT_LAYERS layers of equal area.  A
+ * sample takes one signed uniform number u and a layer index i, and
+ * u * x[i] is accepted if |u| < x[i + 1] / x[i], which happens for
+ * about 99% of all samples.  This test is done for all lanes of a
+ * vector at once.  The few lanes that fail it are resampled one by one
+ * in ziggurat_reject().  Both u and i are taken from one random
+ * integer: the upper 24 bits give u, the lowest 7 bits give i.
+ */
+#define ZIGGURAT_LAYERS 128
+#define ZIGGURAT_R 3.442619855899          // Start of the tail
+#define ZIGGURAT_V 9.91256303526217e-3     // Area of each layer
+
+/*! x[i] is the right edge of layer i, x[0] that of the base strip. */
+static float ziggurat_x[ZIGGURAT_LAYERS + 1];
+
+/*! The fraction of layer i that lies completely below the density. */
+static float ziggurat_ratio[ZIGGURAT_LAYERS];
 
-#else
+static void __attribute__((__constructor__))
+ziggurat_setup(void)
+{
+    double f = exp(-0.5 * ZIGGURAT_R * ZIGGURAT_R);
+    double x[ZIGGURAT_LAYERS + 1];
+
+    x[0] = ZIGGURAT_V / f;
+    x[1] = ZIGGURAT_R;
+    x[ZIGGURAT_LAYERS] = 0.0;
+    for (int i = 2; i < ZIGGURAT_LAYERS; i++) {
+        x[i] = sqrt(-2.0 * log(ZIGGURAT_V / x[i - 1] + f));
+        f = exp(-0.5 * x[i] * x[i]);
+    }
+    for (int i = 0; i < ZIGGURAT_LAYERS; i++) {
+        ziggurat_x[i] = (float) x[i];
+        ziggurat_ratio[i] = (float) (x[i + 1] / x[i]);
+    }
+    ziggurat_x[ZIGGURAT_LAYERS] = 0.0F;
+}
 
-    result = VECTOR_ZERO();
-    for(register int i = 0; i < NSUM; i++) {
-        result += rnd(seed);
+
+
+// Draws a signed uniform number in u and a layer index in layer for
+// each lane.
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__))
+ziggurat_draw(ls2_rng_t *seed, VECTOR *u, uint32_t layer[VECTOR_OPS])
+{
+    union {
+        __m128i v[VECTOR_OPS / 4];
+        int32_t i[VECTOR_OPS];
+    } bits;
+
+    rnd_bits(seed, bits.v);
+    for (int k = 0; k < VECTOR_OPS; k++) {
+        (*u)[k] = (float) (bits.i[k] >> 8) * 0x1p-23F;
+        layer[k] = (uint32_t) bits.i[k] & (ZIGGURAT_LAYERS - 1);
     }
-    result -= VECTOR_BROADCASTF(NSUM / 2.0f);
-    result /= VECTOR_SQRT(VECTOR_BROADCASTF(NSUM / 12.0f));
+}
 
-#endif
 
-    return result;
+
+// A uniform number in (0, 1), suitable for a logarithm.
+static inline float
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__))
+ziggurat_uniform(ls2_rng_t *seed)
+{
+    float u;
+    do {
+        u = rnd(seed)[0];
+    } while (u <= 0.0F || u >= 1.0F);
+    return u;
+}
+
+
+
+// Resample one lane whose first sample u in layer was not accepted by
+// the rectangle test.
+static float
+__attribute__((__noinline__,__cold__,__nonnull__))
+ziggurat_reject(ls2_rng_t *seed, float u, uint32_t layer)
+{
+    for (;;) {
+        if (fabsf(u) < ziggurat_ratio[layer])
+            return u * ziggurat_x[layer];
+
+        if (layer == 0) {
+            // Sample from the tail beyond ZIGGURAT_R.
+            float x, y;
+            do {
+                x = logf(ziggurat_uniform(seed)) / (float) ZIGGURAT_R;
+                y = logf(ziggurat_uniform(seed));
+            } while (-2.0F * y < x * x);
+            return (u < 0.0F) ? x - (float) ZIGGURAT_R
+                              : (float) ZIGGURAT_R - x;
+        }
+
+        // The wedge between the layer and the density.
+        const float x = u * ziggurat_x[layer];
+        const float x0 = ziggurat_x[layer], x1 = ziggurat_x[layer + 1];
+        const float f0 = expf(-0.5F * (x0 * x0 - x * x));
+        const float f1 = expf(-0.5F * (x1 * x1 - x * x));
+        if (f1 + ziggurat_uniform(seed) * (f0 - f1) < 1.0F)
+            return x;
+
+        VECTOR v;
+        uint32_t l[VECTOR_OPS];
+        ziggurat_draw(seed, &v, l);
+        u = v[0];
+        layer = l[0];
+    }
+}
+
+
+
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__flatten__))
+normal_rand_ziggurat(ls2_rng_t *seed)
+{
+    VECTOR u, x, ratio;
+    uint32_t layer[VECTOR_OPS];
+
+    ziggurat_draw(seed, &u, layer);
+    for (int k = 0; k < VECTOR_OPS; k++) {
+        x[k] = ziggurat_x[layer[k]];
+        ratio[k] = ziggurat_ratio[layer[k]];
+    }
+    const VECTOR accept = VECTOR_LT(VECTOR_ABS(u), ratio);
+    x *= u;
+    if (__builtin_expect(VECTOR_TEST_ALL_ONES(accept), 1))
+        return x;
+
+    for (int k = 0; k < VECTOR_OPS; k++) {
+        if (!(fabsf(u[k]) < ratio[k]))
+            x[k] = ziggurat_reject(seed, u[k], layer[k]);
+    }
+    return x;
+}
+
+
+
+// Returns a vector of standard normal distributed random numbers.
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__flatten__))
+normal_rand(ls2_rng_t *seed)
+{
+    switch (*ls2_normal_sampler_params) {
+    case LS2_NORMAL_BOX_MULLER:
+        return normal_rand_box_muller(seed);
+    case LS2_NORMAL_ZIGGURAT:
+    default:
+        return normal_rand_ziggurat(seed);
+    }
 }
 
 static inline VECTOR
 __attribute__((__always_inline__,__gnu_inline__,__flatten__,__nonnull__))
-gaussrand(__m128i* seed, float mean, float sdev)
+gaussrand(ls2_rng_t *seed, float mean, float sdev)
 {
     VECTOR gauss = normal_rand(seed);
 
@@ -209,7 +499,7 @@ gaussrand(__m128i* seed, float mean, float sdev)
 // also shifts the rate, see parameter help
 static inline VECTOR
 __attribute__((__always_inline__,__gnu_inline__,__nonnull__))
-exp_rand(__m128i* seed, VECTOR rate)
+exp_rand(ls2_rng_t *seed, VECTOR rate)
 {
     VECTOR result = rnd(seed);
     result = - VECTOR_LOG(result) / rate;
@@ -31,12 +31,12 @@ ls2_statistics(const float * restrict values, const size_t size,
                float * restrict min, float * restrict max)
 {
      float cnt = 1.0F, M_old, M = 0.0F, S = 0.0F;
-     *min = values[0];
-     *max = values[0];
+     *min = FLT_MAX;
+     *max = -FLT_MAX;
 
      for (size_t i = 0; i < size; i++) {
 	  const float tmp = values[i];
-	  if(isnan(tmp)) continue;
+	  if(ls2_isnan(tmp)) continue;
 	  M_old = M;
 	  M += (tmp - M_old) / cnt;
 	  S += (tmp - M_old) * (tmp - M);
@@ -44,6 +44,10 @@ ls2_statistics(const float * restrict values, const size_t size,
 	  *min = (*min < tmp) ? *min : tmp;
 	  *max = (*max > tmp) ? *max : tmp;
      }
+     if (cnt == 1.0F) {
+	  *mu = *sigma = *min = *max = NAN;
+	  return;
+     }
      *mu = M;
      *sigma = sqrtf(S/(cnt - 1.0f));
 }
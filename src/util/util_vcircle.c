@@ -87,6 +87,63 @@ vcircle_intersections(const VECTOR p1x, const VECTOR p1y, const VECTOR p2x,
 }
 
 
+/*
+ * Compute an approximated intersection of two circles, vector version of
+ * circle_get_approx_intersection().
+ *
+ * The result is the middle of the nearest pair of the points where the
+ * line through both centers crosses the circles.  The returned mask is
+ * zero in components where both centers are equal, and rx and ry are 0.0
+ * there.
+ */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+vcircle_approx_intersection(const VECTOR p1x, const VECTOR p1y,
+                            const VECTOR p2x, const VECTOR p2y,
+                            const VECTOR r1, const VECTOR r2,
+                            VECTOR *restrict rx, VECTOR *restrict ry)
+{
+    const VECTOR d = distance(p1x, p1y, p2x, p2y);
+    const VECTOR dr1 = r1 / d;
+    const VECTOR dr2 = r2 / d;
+    const VECTOR dx = p2x - p1x;
+    const VECTOR dy = p2y - p1y;
+
+    const VECTOR p11x = p1x + dr1 * dx, p11y = p1y + dr1 * dy;
+    const VECTOR p12x = p1x - dr1 * dx, p12y = p1y - dr1 * dy;
+    const VECTOR p21x = p2x + dr2 * dx, p21y = p2y + dr2 * dy;
+    const VECTOR p22x = p2x - dr2 * dx, p22y = p2y - dr2 * dy;
+
+    // The nearest pair of points on different circles, the first one on
+    // ties.
+    VECTOR dist = distance(p11x, p11y, p21x, p21y);
+    VECTOR n1x = p11x, n1y = p11y, n2x = p21x, n2y = p21y;
+    VECTOR dt = distance(p11x, p11y, p22x, p22y);
+    VECTOR m = VECTOR_LT(dt, dist);
+    dist = VECTOR_BLENDV(dist, dt, m);
+    n2x = VECTOR_BLENDV(n2x, p22x, m);
+    n2y = VECTOR_BLENDV(n2y, p22y, m);
+    dt = distance(p12x, p12y, p21x, p21y);
+    m = VECTOR_LT(dt, dist);
+    dist = VECTOR_BLENDV(dist, dt, m);
+    n1x = VECTOR_BLENDV(n1x, p12x, m);
+    n1y = VECTOR_BLENDV(n1y, p12y, m);
+    n2x = VECTOR_BLENDV(n2x, p21x, m);
+    n2y = VECTOR_BLENDV(n2y, p21y, m);
+    dt = distance(p12x, p12y, p22x, p22y);
+    m = VECTOR_LT(dt, dist);
+    n1x = VECTOR_BLENDV(n1x, p12x, m);
+    n1y = VECTOR_BLENDV(n1y, p12y, m);
+    n2x = VECTOR_BLENDV(n2x, p22x, m);
+    n2y = VECTOR_BLENDV(n2y, p22y, m);
+
+    const VECTOR mask = VECTOR_NE(d, zero);
+    *rx = VECTOR_AND((n1x + n2x) / two, mask);
+    *ry = VECTOR_AND((n1y + n2y) / two, mask);
+    return mask;
+}
+
+
 #if (UNITTEST == 1)
 int test_vcircle_intersections(){
     VECTOR num;
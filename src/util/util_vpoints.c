@@ -0,0 +1,274 @@
+/*
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013  Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/********************************************************************
+ **
+ **  This file is made only for including in the lib_lat project
+ **  and not intended for stand alone usage!
+ **
+ ********************************************************************/
+
+#ifndef UTIL_VPOINTS_C_INCLUDED
+#define UTIL_VPOINTS_C_INCLUDED 1
+
+#include <stdint.h>
+#include <string.h>
+
+#include "util/util_vector.c"
+
+/*******************************************************************
+ ***
+ ***   Operations on sets of points, for all lanes at once.
+ ***
+ *******************************************************************/
+
+/*
+ * Every lane holds a set of its own.  The sets are stored slot by slot,
+ * one VECTOR per slot, and a mask tells which slots of a lane belong to
+ * its set.  The results equal those of the scalar versions applied to
+ * the compacted set of every lane, up to the order of some sums.
+ */
+
+/*! The longest sets whose median vmedian() finds by vselect_rank(). */
+#define VSELECT_RANK_MAX 16
+
+/*! The float with only the given bit set. */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__const__,__artificial__))
+vselect_bit(const int bit)
+{
+    const uint32_t u = 1U << bit;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return VECTOR_BROADCASTF(f);
+}
+
+
+/*!
+ * The k-th smallest of the non-negative values selected by mask, counting
+ * from zero, and zero for lanes where k is negative.
+ *
+ * Non-negative floats are ordered like their bit patterns, so the result
+ * is built bit by bit from the most significant one: a bit is kept if
+ * there are at most k values smaller than the pattern with the bit set.
+ * Thus it is exactly one of the values, without moving any of them.
+ */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+vselect(const VECTOR *restrict values, const VECTOR *restrict mask,
+        const size_t length, const VECTOR k)
+{
+    VECTOR t = VECTOR_ZERO();
+    for (int bit = 30; bit >= 0; bit--) {
+        const VECTOR c = VECTOR_OR(t, vselect_bit(bit));
+        VECTOR count = VECTOR_ZERO();
+        for (size_t i = 0; i < length; i++)
+            count += VECTOR_AND(one, VECTOR_AND(mask[i],
+                                                VECTOR_LT(values[i], c)));
+        t = VECTOR_BLENDV(t, c, VECTOR_LE(count, k));
+    }
+    return t;
+}
+
+
+/*!
+ * The k-th smallest of the values selected by mask, as vselect(), but
+ * found by the rank of every value, the number of values before it with
+ * ties broken by position.  This takes length^2 comparisons instead of
+ * 31 length ones, so it is faster for a few values, such as one for
+ * every anchor.
+ */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+vselect_rank(const VECTOR *restrict values, const VECTOR *restrict mask,
+             const size_t length, const VECTOR k)
+{
+    VECTOR t = VECTOR_ZERO();
+    for (size_t i = 0; i < length; i++) {
+        VECTOR rank = VECTOR_ZERO();
+        for (size_t j = 0; j < length; j++) {
+            const VECTOR before = (j < i) ? VECTOR_LE(values[j], values[i])
+                                          : VECTOR_LT(values[j], values[i]);
+            rank += VECTOR_AND(one, VECTOR_AND(mask[j], before));
+        }
+        const VECTOR hit = VECTOR_AND(VECTOR_LE(rank, k),
+                                      VECTOR_GT(rank + one, k));
+        t = VECTOR_BLENDV(t, values[i], VECTOR_AND(mask[i], hit));
+    }
+    return t;
+}
+
+
+/*!
+ * The median of the non-negative values selected by mask, the lower one
+ * of the two middle values for an even count, as fmedian_s().
+ */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+vmedian(const VECTOR *restrict values, const VECTOR *restrict mask,
+        const size_t length)
+{
+    VECTOR count = VECTOR_ZERO();
+    for (size_t i = 0; i < length; i++)
+        count += VECTOR_AND(one, mask[i]);
+    // The counts are integers, so a fraction of k does not matter.
+    const VECTOR k = (count - one) * half;
+    if (length <= VSELECT_RANK_MAX)
+        return vselect_rank(values, mask, length, k);
+    return vselect(values, mask, length, k);
+}
+
+
+/*!
+ * The median of the distances between all pairs of the points selected
+ * by mask, as fmedian_s() of the distances.  The distances are computed
+ * in every pass instead of being stored, as there are too many of them.
+ */
+static inline VECTOR
+__attribute__((__always_inline__,__gnu_inline__,__pure__,__nonnull__,__artificial__))
+vmedian_pair_distance(const VECTOR *restrict ptsx, const VECTOR *restrict ptsy,
+                      const VECTOR *restrict mask, const size_t length)
+{
+    VECTOR n = VECTOR_ZERO();
+    for (size_t i = 0; i < length; i++)
+        n += VECTOR_AND(one, mask[i]);
+    const VECTOR k = (n * (n - one) * half - one) * half;
+
+    // Select the squared distance, whose root is the distance.
+    VECTOR t = VECTOR_ZERO();
+    for (int bit = 30; bit >= 0; bit--) {
+        const VECTOR c = VECTOR_OR(t, vselect_bit(bit));
+        VECTOR count = VECTOR_ZERO();
+        for (size_t i = 0; i + 1 < length; i++) {
+            for (size_t j = i + 1; j < length; j++) {
+                const VECTOR a = ptsx[i] - ptsx[j];
+                const VECTOR b = ptsy[i] - ptsy[j];
+                const VECTOR m = VECTOR_AND(mask[i], mask[j]);
+                count += VECTOR_AND(one, VECTOR_AND(m,
+                                                    VECTOR_LT(a*a + b*b, c)));
+            }
+        }
+        t = VECTOR_BLENDV(t, c, VECTOR_LE(count, k));
+    }
+    return VECTOR_SQRT(t);
+}
+
+
+/*!
+ * The center of mass of the points, as center_of_mass().  Points outside
+ * the sets have to have zero mass.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+vcenter_of_mass(const size_t count, const VECTOR *restrict ptsx,
+                const VECTOR *restrict ptsy, const VECTOR *restrict mass,
+                VECTOR *restrict retx, VECTOR *restrict rety)
+{
+    VECTOR m = VECTOR_ZERO(), x = VECTOR_ZERO(), y = VECTOR_ZERO();
+    for (size_t i = 0; i < count; i++) {
+        const VECTOR in = VECTOR_NE(mass[i], zero);
+        x = VECTOR_BLENDV(x, x + ptsx[i] * mass[i], in);
+        y = VECTOR_BLENDV(y, y + ptsy[i] * mass[i], in);
+        m += mass[i];
+    }
+    *retx = x / m;
+    *rety = y / m;
+}
+
+
+/*!
+ * The geometric median of the points with positive weights, by the
+ * iteration of Weiszfeld, as point_geometric_median().  Every lane
+ * iterates until it stops itself.
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+vgeometric_median(const size_t count, const VECTOR *restrict ptsx,
+                  const VECTOR *restrict ptsy, const VECTOR *restrict weights,
+                  VECTOR *restrict retx, VECTOR *restrict rety)
+{
+    const VECTOR epsilon = VECTOR_BROADCASTF(0.000001f);
+    const VECTOR hyperbolaE = VECTOR_BROADCASTF(0.001f);
+    VECTOR found = VECTOR_ZERO();
+    VECTOR fx = VECTOR_ZERO(), fy = VECTOR_ZERO();
+
+    // Step 1: the first point which is the optimum.
+    for (size_t i = 0; i < count; i++) {
+        VECTOR sumx = VECTOR_ZERO(), sumy = VECTOR_ZERO();
+        for (size_t m = 0; m < count; m++) {
+            if (m == i)
+                continue;
+            const VECTOR dist = distance(ptsx[i], ptsy[i], ptsx[m], ptsy[m]);
+            const VECTOR in = VECTOR_AND(VECTOR_GT(weights[m], zero),
+                                         VECTOR_NE(dist, zero));
+            const VECTOR ux = (ptsx[i] - ptsx[m]) / dist;
+            const VECTOR uy = (ptsy[i] - ptsy[m]) / dist;
+            sumx = VECTOR_BLENDV(sumx, sumx + weights[m] * ux, in);
+            sumy = VECTOR_BLENDV(sumy, sumy + weights[m] * uy, in);
+        }
+        const VECTOR result = VECTOR_SQRT(sumx * sumx + sumy * sumy);
+        const VECTOR optimum =
+            VECTOR_ANDNOT(found, VECTOR_AND(VECTOR_GT(weights[i], zero),
+                                            VECTOR_LE(result, weights[i])));
+        fx = VECTOR_BLENDV(fx, ptsx[i], optimum);
+        fy = VECTOR_BLENDV(fy, ptsy[i], optimum);
+        found = VECTOR_OR(found, optimum);
+    }
+
+    // Step 2: start at the center of mass.
+    VECTOR xx, xy;
+    vcenter_of_mass(count, ptsx, ptsy, weights, &xx, &xy);
+
+    // Step 3+4: lanes which have not found the optimum iterate.
+    VECTOR active = VECTOR_NOT(found);
+    for (int iterations = 0; iterations <= 100; iterations++) {
+        if (VECTOR_TEST_ALL_ONES(VECTOR_NOT(active)))
+            break;
+        VECTOR xt = VECTOR_ZERO(), yt = VECTOR_ZERO(), id = VECTOR_ZERO();
+        for (size_t i = 0; i < count; i++) {
+            const VECTOR dist = distance(xx, xy, ptsx[i], ptsy[i]);
+            const VECTOR in = VECTOR_GT(weights[i], zero);
+            xt = VECTOR_BLENDV(xt, xt + weights[i] * (ptsx[i] / dist), in);
+            yt = VECTOR_BLENDV(yt, yt + weights[i] * (ptsy[i] / dist), in);
+            id = VECTOR_BLENDV(id, id + weights[i] * (one / dist), in);
+        }
+        const VECTOR xnewx = xt / id;
+        const VECTOR xnewy = yt / id;
+
+        VECTOR e0 = VECTOR_ZERO(), e1 = VECTOR_ZERO();
+        for (size_t i = 0; i < count; i++) {
+            const VECTOR in = VECTOR_GT(weights[i], zero);
+            const VECTOR a0 = xx - ptsx[i], b0 = xy - ptsy[i];
+            const VECTOR a1 = xnewx - ptsx[i], b1 = xnewy - ptsy[i];
+            e0 += VECTOR_AND(VECTOR_SQRT(a0 * a0 + b0 * b0 + hyperbolaE), in);
+            e1 += VECTOR_AND(VECTOR_SQRT(a1 * a1 + b1 * b1 + hyperbolaE), in);
+        }
+        const VECTOR stop = VECTOR_OR(VECTOR_GE(e1, e0),
+                                      VECTOR_LT((e0 - e1) / e0, epsilon));
+        active = VECTOR_ANDNOT(stop, active);
+        xx = VECTOR_BLENDV(xx, xnewx, active);
+        xy = VECTOR_BLENDV(xy, xnewy, active);
+    }
+    *retx = VECTOR_BLENDV(xx, fx, found);
+    *rety = VECTOR_BLENDV(xy, fy, found);
+}
+
+#endif
@@ -118,6 +118,8 @@ extern "C" {
 #  define VECTOR_CMPGT(x,y)       _mm256_cmp_ps(x,y,_CMP_NLE_US)
 #  define VECTOR_CMPEQ(x,y)       _mm256_cmp_ps(x,y,_CMP_EQ_US)
 #  define VECTOR_ZERO()           _mm256_setzero_ps()
+#  define VECTOR_CEIL(x)          _mm256_round_ps(x, _MM_FROUND_TO_POS_INF)
+#  define VECTOR_TRUNCATE(x)      _mm256_round_ps(x, _MM_FROUND_TO_ZERO)
 #  define VECTOR_EXP(x)            exp256_ps(x)
 #  define VECTOR_LOG(x)            log256_ps(x)
 #  define VECTOR_POW(x,y)          exp256_ps((y) * log256_ps(x))
@@ -261,6 +263,11 @@ static const VECTOR eps =  VECTOR_CONST_BROADCAST(FLT_EPSILON);
 #define LFU(func) LF(func)
 #define ALGORITHM_RUN LFU(ALGORITHM)
 
+// Algorithms with a setup function define ALGORITHM_HAS_SETUP
+#define LS(func) func##_##setup
+#define LSU(func) LS(func)
+#define ALGORITHM_SETUP LSU(ALGORITHM)
+
 // Include helper for errormodel
 #define QUOTEME(M) #M
 #define IEM(M) QUOTEME(error_model/M##_em.c)
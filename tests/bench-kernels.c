@@ -0,0 +1,122 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares the generic kernel of the location based simulation with
+ * the specialised kernel of each pair of algorithm and error model which
+ * has one.
+ *
+ * Usage: bench-kernels [algorithm [error-model [runs [size]]]]
+ *
+ * Without arguments, all pairs are measured, except for ray-noise,
+ * which needs a file describing the walls.  "all" selects every
+ * algorithm or error model.  The last column tells whether both kernels
+ * computed the same average errors.  With -ffast-math the compiler may
+ * contract the inlined arithmetic differently, so the last bits can
+ * differ.
+ */
+
+#include "shooter_run.c"
+
+#if !LS2_SPECIALISED_KERNELS
+#  error "bench-kernels needs the specialised kernels."
+#endif
+
+static double
+bench(ls2_context_t *ctx, ls2_kernel_t kernel, algorithm_t alg,
+      error_model_t em, int64_t runs, int size, float *results[NUM_VARIANTS])
+{
+    float **res[1] = { results };
+    const vector2 anchors[4] = {
+        { 0.1F * (float) size, 0.1F * (float) size },
+        { 0.9F * (float) size, 0.1F * (float) size },
+        { 0.1F * (float) size, 0.9F * (float) size },
+        { 0.9F * (float) size, 0.9F * (float) size }
+    };
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ls2_distribute_kernel(ctx, kernel, &alg, 1, em, runs, anchors, 4, res,
+                          size, size);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ls2_elapsed(&start, &end);
+}
+
+
+int
+main(int argc, const char *argv[])
+{
+    const char *alg_name = (argc > 1) ? argv[1] : "all";
+    const char *em_name = (argc > 2) ? argv[2] : "all";
+    const int64_t runs = (argc > 3) ? atol(argv[3]) : 64;
+    const int size = (argc > 4) ? atoi(argv[4]) : 48;
+    const size_t n = (size_t) (size * size);
+    float *generic[NUM_VARIANTS] = { NULL }, *special[NUM_VARIANTS] = { NULL };
+
+    if (runs <= 0 || runs % VECTOR_OPS != 0 || size <= 0) {
+        fprintf(stderr, "Usage: %s [algorithm [error-model [runs [size]]]]\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    generic[AVERAGE_ERROR] = calloc(n, sizeof(float));
+    special[AVERAGE_ERROR] = calloc(n, sizeof(float));
+    if (generic[AVERAGE_ERROR] == NULL || special[AVERAGE_ERROR] == NULL) {
+        perror("calloc()");
+        exit(EXIT_FAILURE);
+    }
+
+    ls2_context_t *ctx = ls2_context_new(1);
+    ls2_context_set_seed(ctx, 4711);
+
+    printf("%-18s %-14s %10s %10s %8s %s\n", "algorithm", "error model",
+           "generic", "special", "speedup", "same");
+    for (int alg = 0; algorithm_short_name[alg] != NULL; alg++) {
+        if (strcmp(alg_name, "all") != 0 &&
+            strcmp(alg_name, algorithm_short_name[alg]) != 0)
+            continue;
+        for (int em = 0; error_model_short_name[em] != NULL; em++) {
+            if (strcmp(em_name, "all") == 0 ? em == EM_RAY_NOISE :
+                strcmp(em_name, error_model_short_name[em]) != 0)
+                continue;
+            const ls2_kernel_t kernel =
+                ls2_shooter_kernel((algorithm_t) alg, (error_model_t) em);
+            if (kernel == NULL)
+                continue;
+            const double tg = bench(ctx, ls2_shooter_run, (algorithm_t) alg,
+                                    (error_model_t) em, runs, size, generic);
+            const double ts = bench(ctx, kernel, (algorithm_t) alg,
+                                    (error_model_t) em, runs, size, special);
+            const int same = memcmp(generic[AVERAGE_ERROR],
+                                    special[AVERAGE_ERROR],
+                                    n * sizeof(float)) == 0;
+            printf("%-18s %-14s %10.4f %10.4f %8.2f %s\n",
+                   algorithm_short_name[alg], error_model_short_name[em],
+                   tg, ts, tg / ts, same ? "yes" : "no");
+            fflush(stdout);
+        }
+    }
+
+    ls2_context_free(ctx);
+    free(generic[AVERAGE_ERROR]);
+    free(special[AVERAGE_ERROR]);
+    return EXIT_SUCCESS;
+}
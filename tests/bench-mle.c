@@ -0,0 +1,317 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares the maximum likelihood estimators, which minimise the
+ * likelihood in all lanes at once, with the BFGS minimiser of the GSL,
+ * which they used in the past, one lane at a time.
+ *
+ * Usage: bench-mle [problems [anchors]]
+ *
+ * The anchors lie on a circle around a square of SIZE x SIZE, the
+ * positions are uniformly distributed in it, and the ranges are
+ * disturbed by the default gauss distribution.  Both minimise the same
+ * likelihood from the same initial guess, with the same termination
+ * criterion.  The columns tell the estimates per second, the mean error
+ * of the estimates, and the largest distance between the estimates of
+ * both minimisers.
+ */
+
+#include "shooter_run.c"
+
+#include <gsl/gsl_multimin.h>
+
+/* Tests for NaN by its bits, since -ffast-math assumes there are none. */
+static int
+undefined(const float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x7FFFFFFFU) > 0x7F800000U;
+}
+
+
+struct gsl_params {
+    const double *ax, *ay, *r;
+    size_t no_anchors;
+};
+
+
+static double
+gauss_f(const gsl_vector *X, void *params)
+{
+    const struct gsl_params *const p = params;
+    const double x = gsl_vector_get(X, 0), y = gsl_vector_get(X, 1);
+    const double variance =
+        mle_gauss_params->deviation * mle_gauss_params->deviation;
+    double f = 0.0;
+
+    for (size_t j = 0; j < p->no_anchors; j++) {
+        const double d = hypot(x - p->ax[j], y - p->ay[j]);
+        const double e = d + mle_gauss_params->mean - p->r[j];
+        f += e * e / (2.0 * variance);
+    }
+    return f;
+}
+
+
+static void
+gauss_df(const gsl_vector *X, void *params, gsl_vector *g)
+{
+    const struct gsl_params *const p = params;
+    const double x = gsl_vector_get(X, 0), y = gsl_vector_get(X, 1);
+    const double variance =
+        mle_gauss_params->deviation * mle_gauss_params->deviation;
+    double gx = 0.0, gy = 0.0;
+
+    for (size_t j = 0; j < p->no_anchors; j++) {
+        const double d = fmax(hypot(x - p->ax[j], y - p->ay[j]), 1e-6);
+        const double e = d + mle_gauss_params->mean - p->r[j];
+        gx += e * (x - p->ax[j]) / (d * variance);
+        gy += e * (y - p->ay[j]) / (d * variance);
+    }
+    gsl_vector_set(g, 0, gx);
+    gsl_vector_set(g, 1, gy);
+}
+
+
+static double
+gamma_f(const gsl_vector *X, void *params)
+{
+    const struct gsl_params *const p = params;
+    const double x = gsl_vector_get(X, 0), y = gsl_vector_get(X, 1);
+    double f = 0.0;
+
+    for (size_t j = 0; j < p->no_anchors; j++) {
+        const double d = hypot(x - p->ax[j], y - p->ay[j]);
+        const double Z = p->r[j] + mle_gamma_params->offset - d;
+        if (Z <= 0.0)
+            return INFINITY;
+        f += mle_gamma_params->rate * Z -
+            (mle_gamma_params->shape - 1.0) * log(Z);
+    }
+    return f;
+}
+
+
+static void
+gamma_df(const gsl_vector *X, void *params, gsl_vector *g)
+{
+    const struct gsl_params *const p = params;
+    const double x = gsl_vector_get(X, 0), y = gsl_vector_get(X, 1);
+    double gx = 0.0, gy = 0.0;
+
+    for (size_t j = 0; j < p->no_anchors; j++) {
+        const double d = fmax(hypot(x - p->ax[j], y - p->ay[j]), 1e-6);
+        const double Z = p->r[j] + mle_gamma_params->offset - d;
+        const double c =
+            (mle_gamma_params->shape - 1.0) / Z - mle_gamma_params->rate;
+        gx += c * (x - p->ax[j]) / d;
+        gy += c * (y - p->ay[j]) / d;
+    }
+    gsl_vector_set(g, 0, gx);
+    gsl_vector_set(g, 1, gy);
+}
+
+
+static void
+gauss_fdf(const gsl_vector *X, void *params, double *f, gsl_vector *g)
+{
+    *f = gauss_f(X, params);
+    gauss_df(X, params, g);
+}
+
+
+static void
+gamma_fdf(const gsl_vector *X, void *params, double *f, gsl_vector *g)
+{
+    *f = gamma_f(X, params);
+    gamma_df(X, params, g);
+}
+
+
+/* The minimisation as the estimators did it with the GSL, lane by lane. */
+static void
+gsl_run(const int gamma, const VECTOR *vx, const VECTOR *vy,
+        const VECTOR *restrict r, const size_t no_anchors,
+        VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    double ax[no_anchors], ay[no_anchors], ranges[no_anchors];
+    struct gsl_params p = { ax, ay, ranges, no_anchors };
+    gsl_multimin_function_fdf fdf;
+    VECTOR sx, sy;
+
+    fdf.n = 2u;
+    fdf.f = gamma ? gamma_f : gauss_f;
+    fdf.df = gamma ? gamma_df : gauss_df;
+    fdf.fdf = gamma ? gamma_fdf : gauss_fdf;
+    fdf.params = &p;
+    const double epsilon =
+        gamma ? mle_gamma_params->epsilon : mle_gauss_params->epsilon;
+    const int iterations =
+        gamma ? mle_gamma_params->iterations : mle_gauss_params->iterations;
+
+    nllsq_run(vx, vy, r, no_anchors, SIZE, SIZE, &sx, &sy);
+    gsl_multimin_fdfminimizer *s =
+        gsl_multimin_fdfminimizer_alloc(gsl_multimin_fdfminimizer_vector_bfgs2,
+                                        2);
+    gsl_vector *x = gsl_vector_alloc(2);
+    for (int i = 0; i < VECTOR_OPS; i++) {
+        for (size_t j = 0; j < no_anchors; j++) {
+            ax[j] = vx[j][i];
+            ay[j] = vy[j][i];
+            ranges[j] = r[j][i];
+        }
+        gsl_vector_set(x, 0, sx[i]);
+        gsl_vector_set(x, 1, sy[i]);
+        if (undefined(sx[i]) || undefined(sy[i]) || fdf.f(x, &p) >= DBL_MAX) {
+            (*resx)[i] = NAN;
+            (*resy)[i] = NAN;
+            continue;
+        }
+        gsl_multimin_fdfminimizer_set(s, &fdf, x, 1e-2, 1e-4);
+        int iter = 0, status;
+        do {
+            iter++;
+            status = gsl_multimin_fdfminimizer_iterate(s);
+            if (status)
+                break;
+            status = gsl_multimin_test_gradient(s->gradient, epsilon);
+        } while (status == GSL_CONTINUE && iter < iterations);
+        (*resx)[i] = (float) gsl_vector_get(s->x, 0);
+        (*resy)[i] = (float) gsl_vector_get(s->x, 1);
+    }
+    gsl_multimin_fdfminimizer_free(s);
+    gsl_vector_free(x);
+}
+
+
+static void
+lm_run(const int gamma, const VECTOR *vx, const VECTOR *vy,
+       const VECTOR *restrict r, const size_t no_anchors,
+       VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    if (gamma)
+        mle_gamma_run(vx, vy, r, no_anchors, SIZE, SIZE, resx, resy);
+    else
+        mle_gauss_run(vx, vy, r, no_anchors, SIZE, SIZE, resx, resy);
+}
+
+
+/* The mean distance of the defined estimates to the true positions. */
+static double
+mean_error(const VECTOR *ex, const VECTOR *ey, const VECTOR *tx,
+           const VECTOR *ty, const size_t n)
+{
+    double sum = 0.0;
+    size_t defined = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        for (int i = 0; i < VECTOR_OPS; i++) {
+            if (undefined(ex[k][i]) || undefined(ey[k][i]))
+                continue;
+            sum += hypot(ex[k][i] - tx[k][i], ey[k][i] - ty[k][i]);
+            defined++;
+        }
+    }
+    return sum / (double) defined;
+}
+
+
+int
+main(int argc, const char *argv[])
+{
+    static const char *names[] = { "mle-gauss", "mle-gamma" };
+    const long problems = (argc > 1) ? atol(argv[1]) : 100000;
+    const int num = (argc > 2) ? atoi(argv[2]) : 5;
+
+    if (problems <= 0 || num < 3) {
+        fprintf(stderr, "Usage: %s [problems [anchors]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const size_t n = (size_t) (problems + VECTOR_OPS - 1) / VECTOR_OPS;
+    const size_t anchors = (size_t) num;
+    VECTOR vx[anchors], vy[anchors];
+    VECTOR *r, *tx, *ty, *lx, *ly, *gx, *gy;
+    struct timespec start, end;
+    ls2_rng_t rng;
+
+    if (posix_memalign((void **) &r, ALIGNMENT,
+                       n * anchors * sizeof(VECTOR)) != 0 ||
+        posix_memalign((void **) &tx, ALIGNMENT, 6 * n * sizeof(VECTOR)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    ty = tx + n;
+    lx = ty + n;
+    ly = lx + n;
+    gx = ly + n;
+    gy = gx + n;
+
+    for (size_t j = 0; j < anchors; j++) {
+        const float phi = 2.0F * (float) M_PI * (float) j / (float) anchors;
+        vx[j] = VECTOR_BROADCASTF(SIZE * (0.5F + 0.6F * cosf(phi)));
+        vy[j] = VECTOR_BROADCASTF(SIZE * (0.5F + 0.6F * sinf(phi)));
+    }
+    ls2_rng_init(&rng, 0x5DEECE66DULL);
+    for (size_t k = 0; k < n; k++) {
+        tx[k] = rnd(&rng) * VECTOR_BROADCASTF(SIZE);
+        ty[k] = rnd(&rng) * VECTOR_BROADCASTF(SIZE);
+        for (size_t j = 0; j < anchors; j++)
+            r[k * anchors + j] = distance(tx[k], ty[k], vx[j], vy[j]) +
+                gaussrand(&rng, (float) mle_gauss_params->mean,
+                          (float) mle_gauss_params->deviation);
+    }
+
+    printf("%-10s %12s %12s %8s %9s %9s %9s\n", "algorithm", "lm/s", "gsl/s",
+           "speedup", "lm err", "gsl err", "max diff");
+    for (int gamma = 0; gamma < 2; gamma++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t k = 0; k < n; k++)
+            lm_run(gamma, vx, vy, &r[k * anchors], anchors, &lx[k], &ly[k]);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        const double tl = ls2_elapsed(&start, &end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t k = 0; k < n; k++)
+            gsl_run(gamma, vx, vy, &r[k * anchors], anchors, &gx[k], &gy[k]);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        const double tg = ls2_elapsed(&start, &end);
+
+        double diff = 0.0;
+        for (size_t k = 0; k < n; k++)
+            for (int i = 0; i < VECTOR_OPS; i++)
+                if (!undefined(lx[k][i]) && !undefined(gx[k][i]))
+                    diff = fmax(diff, hypot(lx[k][i] - gx[k][i],
+                                            ly[k][i] - gy[k][i]));
+        const double estimates = (double) (n * VECTOR_OPS);
+        printf("%-10s %12.0f %12.0f %8.2f %9.4f %9.4f %9.4f\n", names[gamma],
+               estimates / tl, estimates / tg, tg / tl,
+               mean_error(lx, ly, tx, ty, n), mean_error(gx, gy, tx, ty, n),
+               diff);
+        fflush(stdout);
+    }
+
+    free(r);
+    free(tx);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,261 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares llsq and nllsq, which accumulate the normal equations while
+ * streaming over the anchors, with the chains of matrix operations they
+ * used in the past.
+ *
+ * Usage: bench-nllsq [problems [anchors]]
+ *
+ * The anchors lie on a circle around a square of SIZE x SIZE, the
+ * positions are uniformly distributed in it, and the ranges are
+ * disturbed by a gauss distribution.  The columns tell the estimates per
+ * second and the largest distance between the estimates of both.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ls2/library.h"
+#include "ls2/ls2.h"
+#include "vector_shooter.h"
+#include "util/util_misc.c"
+#include "util/util_random.c"
+#include "util/util_vector.c"
+#include "util/util_points.c"
+#include "algorithm/llsq_algorithm.c"
+#include "algorithm/nllsq_algorithm.c"
+
+/* The linear least squares as a chain of matrix operations. */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+llsq_chain(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+           size_t num_anchors, VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    const size_t m = num_anchors-1U;
+    VECTOR b[m*1];
+    VECTOR a[m*2];
+    VECTOR mAT[2*m];
+    VECTOR tmp[2*m];
+    VECTOR tmp2[2*2];
+    VECTOR tmp3[2*2];
+    VECTOR tmp4[2*1];
+
+    for (size_t i = 0; i < m; i++) {
+        a[i*2+0] = (vx[i] - vx[m]);
+        a[i*2+1] = (vy[i] - vy[m]);
+        b[i*1+0] = half * (vx[i] * vx[i] - vx[m] * vx[m] +
+                    vy[i] * vy[i] - vy[m] * vy[m] +
+                    r[m] * r[m] - r[i] * r[i]);
+    }
+    transpose(a,mAT,m,2);
+    times(mAT,2,m,a,2,tmp2);
+    invert_2x2(tmp2,tmp3);
+    times(tmp3,2,2,mAT,m,tmp);
+    times(tmp,2,m,b,1,tmp4);
+    *resx = tmp4[0];
+    *resy = tmp4[1];
+}
+
+
+/* The Gauss-Newton iteration with a chain of matrix operations per step. */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+nllsq_chain(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+            size_t num_anchors, VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    float load = -1.0F;
+    *resx = VECTOR_BROADCAST(&load);
+    *resy = VECTOR_BROADCAST(&load);
+    VECTOR s0x;
+    VECTOR s0y;
+
+    llsq_chain(vx, vy, r, num_anchors, &s0x, &s0y);
+
+    VECTOR e0, e1;
+    int iterations = 0;
+    float epsilon = 0.000001F;
+    VECTOR r0x;
+    VECTOR r0y;
+
+    do {
+        e0 = calculate_residual_error(num_anchors, vx,vy,r,s0x,s0y);
+        VECTOR b[num_anchors*1];
+        VECTOR a[num_anchors*2];
+        for (size_t i = 0; i < num_anchors; i++) {
+            VECTOR dist = distance(s0x,s0y,vx[i],vy[i]);
+            a[i*2+0] = (s0x - vx[i]) / dist;
+            a[i*2+1] = (s0y - vy[i]) / dist;
+            b[i*1+0] = (r[i] - dist) + (a[i*2+0] * s0x + a[i*2+1] * s0y);
+        }
+        VECTOR mAT[2*num_anchors];
+        VECTOR tmp[2*num_anchors];
+        VECTOR tmp2[2*2];
+        VECTOR tmp3[2*2];
+        VECTOR tmp4[2*1];
+        transpose(a,mAT,num_anchors,2);
+        times(mAT,2,num_anchors,a,2,tmp2);
+        invert_2x2(tmp2,tmp3);
+        times(tmp3,2,2,mAT,num_anchors,tmp);
+        times(tmp,2,num_anchors,b,1,tmp4);
+        r0x = tmp4[0];
+        r0y = tmp4[1];
+
+        e1 = calculate_residual_error(num_anchors, vx,vy,r,r0x,r0y);
+        VECTOR temp = e0 - e1;
+
+        int br=1;
+        for (int i=0; i < VECTOR_OPS; i++){
+            if ((*resx)[i] == -1.0f) {
+                br = 0;
+                if (temp[i] < epsilon){
+                    (*resx)[i] = r0x[i];
+                    (*resy)[i] = r0y[i];
+                }
+            }
+        }
+        if (br) break;
+        s0x = r0x;
+        s0y = r0y;
+        iterations++;
+    } while (iterations <= 100);
+    for (int i=0; i < VECTOR_OPS; i++){
+        if ((*resx)[i] == -1.0F) {
+            (*resx)[i] = s0x[i];
+            (*resy)[i] = s0y[i];
+        }
+    }
+}
+
+
+static double
+elapsed(const struct timespec *from, const struct timespec *to)
+{
+    return (double) (to->tv_sec - from->tv_sec) +
+        (double) (to->tv_nsec - from->tv_nsec) * 1e-9;
+}
+
+
+static double
+largest_distance(const VECTOR *ax, const VECTOR *ay, const VECTOR *bx,
+                 const VECTOR *by, const size_t n)
+{
+    double d = 0.0;
+
+    for (size_t k = 0; k < n; k++)
+        for (int i = 0; i < VECTOR_OPS; i++)
+            d = fmax(d, hypot(ax[k][i] - bx[k][i], ay[k][i] - by[k][i]));
+    return d;
+}
+
+
+int
+main(int argc, const char *argv[])
+{
+    const long problems = (argc > 1) ? atol(argv[1]) : 1000000;
+    const int num = (argc > 2) ? atoi(argv[2]) : 5;
+
+    if (problems <= 0 || num < 3) {
+        fprintf(stderr, "Usage: %s [problems [anchors]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const size_t n = (size_t) (problems + VECTOR_OPS - 1) / VECTOR_OPS;
+    const size_t anchors = (size_t) num;
+    VECTOR vx[anchors], vy[anchors];
+    VECTOR *r, *ax, *ay, *bx, *by;
+    struct timespec start, end;
+    ls2_rng_t rng;
+
+    if (posix_memalign((void **) &r, ALIGNMENT,
+                       n * anchors * sizeof(VECTOR)) != 0 ||
+        posix_memalign((void **) &ax, ALIGNMENT, 4 * n * sizeof(VECTOR)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    ay = ax + n;
+    bx = ay + n;
+    by = bx + n;
+
+    for (size_t j = 0; j < anchors; j++) {
+        const float phi = 2.0F * (float) M_PI * (float) j / (float) anchors;
+        vx[j] = VECTOR_BROADCASTF(SIZE * (0.5F + 0.6F * cosf(phi)));
+        vy[j] = VECTOR_BROADCASTF(SIZE * (0.5F + 0.6F * sinf(phi)));
+    }
+    ls2_rng_init(&rng, 0x5DEECE66DULL);
+    for (size_t k = 0; k < n; k++) {
+        const VECTOR tx = rnd(&rng) * VECTOR_BROADCASTF(SIZE);
+        const VECTOR ty = rnd(&rng) * VECTOR_BROADCASTF(SIZE);
+        for (size_t j = 0; j < anchors; j++)
+            r[k * anchors + j] = distance(tx, ty, vx[j], vy[j]) +
+                gaussrand(&rng, 0.0F, 20.0F);
+    }
+
+    printf("%-10s %12s %12s %8s %9s\n", "algorithm", "chain/s", "stream/s",
+           "speedup", "max diff");
+    for (int nl = 0; nl < 2; nl++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t k = 0; k < n; k++) {
+            if (nl)
+                nllsq_chain(vx, vy, &r[k * anchors], anchors, &ax[k], &ay[k]);
+            else
+                llsq_chain(vx, vy, &r[k * anchors], anchors, &ax[k], &ay[k]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        const double tc = elapsed(&start, &end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t k = 0; k < n; k++) {
+            if (nl)
+                nllsq_run(vx, vy, &r[k * anchors], anchors, SIZE, SIZE,
+                          &bx[k], &by[k]);
+            else
+                llsq_run(vx, vy, &r[k * anchors], anchors, SIZE, SIZE,
+                         &bx[k], &by[k]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        const double ts = elapsed(&start, &end);
+
+        const double estimates = (double) (n * VECTOR_OPS);
+        printf("%-10s %12.0f %12.0f %8.2f %9.6f\n", nl ? "nllsq" : "llsq",
+               estimates / tc, estimates / ts, tc / ts,
+               largest_distance(ax, ay, bx, by, n));
+        fflush(stdout);
+    }
+
+    free(r);
+    free(ax);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares the ray tracing of the ray-noise error model on a synthetic
+ * office floor with and without the grid over the walls.
+ *
+ * Usage: bench-walls [rooms [anchors]]
+ *
+ * The floor consists of rooms x rooms offices, every inner wall has a
+ * door, so there are 4 * rooms * (rooms + 1) walls.  Without the grid,
+ * every ray is tested against every wall, as in the past.  The last
+ * column tells whether both traced the same fields.
+ */
+
+#include "shooter_run.c"
+
+#include <fcntl.h>
+
+/* Write the floor plan to a temporary file, returns the number of walls. */
+static int
+write_floor(char *path, int rooms)
+{
+    const int fd = mkstemp(path);
+    FILE *fp = (fd < 0) ? NULL : fdopen(fd, "w");
+    const int lo = 50, hi = SIZE - 50, door = 12;
+    int walls = 0;
+
+    if (fp == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k <= rooms; k++) {
+        const int p = lo + k * (hi - lo) / rooms;
+        for (int r = 0; r < rooms; r++) {
+            const int a = lo + r * (hi - lo) / rooms;
+            const int b = lo + (r + 1) * (hi - lo) / rooms;
+            const int m = (a + b) / 2;
+            // The outer walls are of concrete and have no doors.
+            if (k == 0 || k == rooms) {
+                fprintf(fp, "%d;%d;%d;%d;300;2;\n", a, p, m, p);
+                fprintf(fp, "%d;%d;%d;%d;300;2;\n", m, p, b, p);
+                fprintf(fp, "%d;%d;%d;%d;300;2;\n", p, a, p, m);
+                fprintf(fp, "%d;%d;%d;%d;300;2;\n", p, m, p, b);
+            } else {
+                fprintf(fp, "%d;%d;%d;%d;100;1;\n", a, p, m - door, p);
+                fprintf(fp, "%d;%d;%d;%d;100;1;\n", m + door, p, b, p);
+                fprintf(fp, "%d;%d;%d;%d;100;1;\n", p, a, p, m - door);
+                fprintf(fp, "%d;%d;%d;%d;100;1;\n", p, m + door, p, b);
+            }
+            walls += 4;
+        }
+    }
+    if (fclose(fp) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    return walls;
+}
+
+
+/* Silence the diagnostic output of the error model. */
+static int
+quiet(int fd)
+{
+    fflush(stdout);
+    if (fd < 0) {
+        fd = dup(STDOUT_FILENO);
+        const int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+        return fd;
+    }
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+    return -1;
+}
+
+
+int
+main(int argc, const char *argv[])
+{
+    const int rooms = (argc > 1) ? atoi(argv[1]) : 15;
+    const int num = (argc > 2) ? atoi(argv[2]) : 1;
+    char path[] = "/tmp/ls2-walls-XXXXXX";
+    vector2 anchors[num > 0 ? num : 1];
+    struct timespec start, end;
+
+    if (rooms <= 0 || num <= 0) {
+        fprintf(stderr, "Usage: %s [rooms [anchors]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const int walls = write_floor(path, rooms);
+    for (int i = 0; i < num; i++) {
+        // Anchors in the middle of rooms along the diagonal.
+        const float p = 50.0F + ((float) (i % rooms) + 0.5F) *
+            (float) (SIZE - 100) / (float) rooms;
+        anchors[i].x = p;
+        anchors[i].y = p;
+    }
+    ray_noise_defaults.walls = path;
+    ray_noise_defaults.cache = "none";
+
+    int fd = quiet(-1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ray_noise_setup(anchors, (size_t) num);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double tg = ls2_elapsed(&start, &end);
+    const size_t n = (size_t) SIZE * SIZE * (size_t) num;
+    float *length = malloc(n * sizeof(float));
+    float *strength = malloc(n * sizeof(float));
+    if (length == NULL || strength == NULL) {
+        perror("malloc()");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(length, ray_noise_params->length, n * sizeof(float));
+    memcpy(strength, ray_noise_params->strength, n * sizeof(float));
+
+    // A single cell holding all walls tests every wall for every ray.
+    wall_grid_build((float) (2 * SIZE));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ray_noise_anchors(anchors, (size_t) num, 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double ts = ls2_elapsed(&start, &end);
+    fd = quiet(fd);
+    unlink(path);
+
+    const int same =
+        memcmp(length, ray_noise_params->length, n * sizeof(float)) == 0 &&
+        memcmp(strength, ray_noise_params->strength, n * sizeof(float)) == 0;
+    printf("%6s %8s %10s %10s %8s %s\n", "walls", "anchors", "scan", "grid",
+           "speedup", "same");
+    printf("%6d %8d %10.4f %10.4f %8.2f %s\n", walls, num, ts, tg, ts / tg,
+           same ? "yes" : "no");
+    free(length);
+    free(strength);
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Checks the adaptive sampling of the location based kernel when some
+ * runs fail.  The kernel of shooter_kernel.c is instantiated with an
+ * algorithm which estimates the position of the first anchor, except
+ * for one lane of every third batch, which is NaN.  The error of the
+ * other runs is exact, so every pixel has to stop after --min-runs runs
+ * and count its failures.  It is built with -ffast-math like the
+ * library, where isnan() is always false.
+ */
+
+#include "shooter_run.c"
+
+#define WIDTH 16
+#define HEIGHT 12
+#define MAX_RUNS 4096
+#define MIN_RUNS 64
+#define TOLERANCE 1e-4F
+
+
+/*! The ranges are the distances, the failures are made by the algorithm. */
+static inline void
+__attribute__((__always_inline__,__nonnull__))
+exact_error(ls2_rng_t *seed __attribute__((__unused__)), const size_t n,
+            const VECTOR *distances, VECTOR *r)
+{
+    for (size_t i = 0; i < n; i++)
+        r[i] = distances[i];
+}
+
+
+/*! The calls of failing_algorithm() on this thread. */
+static __thread unsigned int calls;
+
+/*! Estimates the first anchor, and NaN in lane 0 of every third batch. */
+static inline void
+__attribute__((__always_inline__,__nonnull__))
+failing_algorithm(const VECTOR *vx, const VECTOR *vy, VECTOR *resx,
+                  VECTOR *resy)
+{
+    *resx = vx[0];
+    *resy = vy[0];
+    if (++calls % 3 == 0)
+        (*resx)[0] = NAN;
+}
+
+#define LS2_KERNEL_NAME failing_kernel
+#define LS2_KERNEL_ERROR(seed, n, dist, vx, vy, tagx, tagy, r) \
+    exact_error(seed, n, dist, r)
+#define LS2_KERNEL_ALGORITHM(alg, vx, vy, r, n, width, height, resx, resy, state) \
+    failing_algorithm(vx, vy, resx, resy)
+#define LS2_KERNEL_ALGORITHMS 1
+#include "shooter_kernel.c"
+
+
+/* Compares a statistic of a pixel with the exact value, returns 1 if it
+ * differs. */
+static int
+check(const char *statistic, const int x, const int y, const float got,
+      const float expected)
+{
+    const int ok = !ls2_isnan(got) &&
+        fabsf(got - expected) <= TOLERANCE * fmaxf(1.0F, fabsf(expected));
+    if (!ok)
+        fprintf(stderr, "(%d, %d): %s is %f, expected %f\n", x, y, statistic,
+                got, expected);
+    return !ok;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    const vector2 anchors[4] = {
+        { 2.0F, 3.0F }, { 14.0F, 1.0F }, { 1.0F, 10.0F }, { 13.0F, 11.0F }
+    };
+    static const int variants[] = {
+        AVERAGE_ERROR, FAILURES, ROOT_MEAN_SQUARED_ERROR, AVERAGE_X_ERROR,
+        AVERAGE_Y_ERROR, RUNS_USED
+    };
+    float *results[NUM_VARIANTS] = { NULL };
+    float **res[1] = { results };
+    const algorithm_t alg = ALG_LLSQ;
+    int failures = 0;
+
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        results[variants[v]] = calloc(WIDTH * HEIGHT, sizeof(float));
+        if (results[variants[v]] == NULL) {
+            perror("calloc()");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ls2_context_t *ctx = ls2_context_new(1);
+    ls2_context_set_seed(ctx, 4711);
+    ls2_context_set_adaptive_tolerance(ctx, 0.5F);
+    ls2_context_set_min_runs(ctx, MIN_RUNS);
+    ls2_distribute_kernel(ctx, failing_kernel, &alg, 1, EM_ND_NOISE, MAX_RUNS,
+                          anchors, 4, res, WIDTH, HEIGHT);
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            const size_t pos = (size_t) (x + y * WIDTH);
+            const float dx = anchors[0].x - (float) x;
+            const float dy = anchors[0].y - (float) y;
+            const float error = sqrtf(dx * dx + dy * dy);
+            failures += check("runs used", x, y, results[RUNS_USED][pos],
+                              (float) MIN_RUNS);
+            failures += check("average error", x, y,
+                              results[AVERAGE_ERROR][pos], error);
+            failures += check("root mean squared error", x, y,
+                              results[ROOT_MEAN_SQUARED_ERROR][pos], error);
+            failures += check("average x error", x, y,
+                              results[AVERAGE_X_ERROR][pos], dx);
+            failures += check("average y error", x, y,
+                              results[AVERAGE_Y_ERROR][pos], dy);
+            // Two or three of the eight batches have a failed run.
+            const float failed = results[FAILURES][pos] * (float) MIN_RUNS;
+            if (!(failed == 2.0F || failed == 3.0F)) {
+                fprintf(stderr, "(%d, %d): %f runs failed, expected 2 or 3\n",
+                        x, y, failed);
+                failures++;
+            }
+        }
+    }
+
+    ls2_context_free(ctx);
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++)
+        free(results[variants[v]]);
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Checks the sparse histograms of util_histogram.c against a dense one:
+ * points near the window of the tag and far from it are counted in
+ * several histograms, which are merged pairwise and stored in bands of
+ * rows, as the inverted simulation does.  Tags near the border clip the
+ * window to the field.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+#include "ls2/library.h"
+#include "ls2/ls2.h"
+#include "util/util_histogram.c"
+
+#define WIDTH 500
+#define HEIGHT 300
+#define PARTS 5
+#define SAMPLES 200000
+
+
+/* Count the samples of a tag at (cx, cy) and compare with a dense field. */
+static int
+test_tag(const int cx, const int cy)
+{
+    static uint64_t dense[WIDTH * HEIGHT], field[WIDTH * HEIGHT];
+    ls2_histogram_t h[PARTS];
+    unsigned int seed = 4711U + (unsigned int) (cx + cy);
+    int failures = 0;
+
+    memset(dense, 0, sizeof(dense));
+    memset(field, 0xff, sizeof(field));
+    for (int p = 0; p < PARTS; p++)
+        ls2_histogram_init(&h[p], WIDTH, HEIGHT, cx, cy);
+    for (int i = 0; i < SAMPLES; i++) {
+        int x, y;
+        if (rand_r(&seed) % 10 == 0) {
+            x = rand_r(&seed) % WIDTH;
+            y = rand_r(&seed) % HEIGHT;
+        } else {
+            x = cx + rand_r(&seed) % 161 - 80;
+            y = cy + rand_r(&seed) % 161 - 80;
+            x = CLAMP(0, x, WIDTH - 1);
+            y = CLAMP(0, y, HEIGHT - 1);
+        }
+        dense[x + WIDTH * y]++;
+        ls2_histogram_add(&h[i % PARTS], x, y);
+    }
+    for (int s = 1; s < PARTS; s *= 2) {
+        for (int p = 0; p + s < PARTS; p += 2 * s) {
+            ls2_histogram_merge(&h[p], &h[p + s]);
+            ls2_histogram_free(&h[p + s]);
+        }
+    }
+    for (int p = 0; p < PARTS; p++)
+        ls2_histogram_store_rows(&h[0], field, (HEIGHT * p) / PARTS,
+                                 (HEIGHT * (p + 1)) / PARTS);
+    ls2_histogram_free(&h[0]);
+
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        if (field[i] != dense[i]) {
+            fprintf(stderr, "Tag (%d, %d): pixel (%d, %d) counted %llu "
+                    "instead of %llu times\n", cx, cy, i % WIDTH, i / WIDTH,
+                    (unsigned long long) field[i],
+                    (unsigned long long) dense[i]);
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    int failures = 0;
+
+    failures += test_tag(WIDTH / 2, HEIGHT / 2);
+    failures += test_tag(10, 20);
+    failures += test_tag(WIDTH - 1, HEIGHT - 5);
+    failures += test_tag(-100, 400);
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
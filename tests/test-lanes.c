@@ -0,0 +1,723 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares the algorithms which localise all lanes at once with their
+ * scalar versions, which localise one lane after the other.
+ *
+ * Every lane gets its own anchors, position and ranges; some ranges are
+ * too long, as with NLOS, so the filters of the algorithms drop points.
+ *
+ * test-lanes is built without -ffast-math and without contraction: both
+ * versions compute the same operations in the same order then, and the
+ * iterations of Weiszfeld and Gauss-Newton stop at the same step.
+ * test-lanes-fast is built with the flags of the library.  With
+ * reassociation, a rounding difference in the last place may shift the
+ * stop by a step or flip a filter of RLSM, which moves the result by a
+ * fraction of a pixel, so every lane has to agree up to TOLERANCE pixels
+ * then.  CluRoL localises with the same NLLS for both, as the anchors
+ * which are not taken only add zeros.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <assert.h>
+#include <float.h>
+#include <immintrin.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ls2/library.h"
+#include "ls2/ls2.h"
+#include "ls2/util.h"
+#include "vector_shooter.h"
+#include "util/util_median.c"
+#include "util/util_misc.c"
+#include "util/util_vector.c"
+#include "util/util_matrix.c"
+#include "util/util_circle.c"
+#include "util/util_vcircle.c"
+#include "util/util_points.c"
+#include "util/util_math.c"
+#include "util/util_sort.c"
+#include "util/util_vpoints.c"
+#include "algorithm/llsq_algorithm.c"
+#include "algorithm/nllsq_algorithm.c"
+#include "algorithm/geon_algorithm.c"
+#include "algorithm/lms_algorithm.c"
+#include "algorithm/rlsm_algorithm.c"
+#include "algorithm/clurol_algorithm.c"
+
+
+/*
+ * The scalar versions of the algorithms, the reference for the versions
+ * of the library.  Each localises one lane after the other.
+ */
+
+/*!
+ * \arg \c mcount 
+ * \arg \c mx     
+ * \arg \c my     
+ * \arg \c r
+ * \arg \c ptscount Number of circle intersections.
+ * \arg \c ptsy     X coordinate of circle intersections.
+ * \arg \c ptsy     Y coordinate of circle intersections.
+ * \arg \c min
+ */
+static inline size_t
+circle_minimum_circle_containment(size_t mcount, float *mx, float *my,
+                                  float *r, size_t ptscount, float *ptsx,
+				  float *ptsy, float *ptsw, size_t min)
+{
+    float vx [ptscount];
+    float vy [ptscount];
+    float vw [ptscount];
+    size_t icount = 0;
+    for (size_t i = 0; i < ptscount; i++) {
+        size_t min_c = 0;
+        for (size_t j = 0; j < mcount; j++) {
+            if (distance_s(mx[j],my[j],ptsx[i],ptsy[i]) <= r[j] + 0.01F) {
+                min_c ++;
+            }
+        }
+        if (min_c >= min || ptsw[i] == 0.5F) {
+            vx[icount] = ptsx[i];
+            vy[icount] = ptsy[i];
+            vw[icount] = ptsw[i];
+            icount ++;
+        }
+    }
+    memcpy (ptsx, vx, sizeof(float) * icount);
+    memcpy (ptsy, vy, sizeof(float) * icount);
+    memcpy (ptsw, vw, sizeof(float) * icount);
+    return icount;
+}
+
+
+/*!
+ * Geolateration of one lane after the other; the reference for geon_run().
+ */
+static inline void __attribute__((__always_inline__,__gnu_inline__,__nonnull__,__artificial__))
+geon_run_scalar (const VECTOR* vx, const VECTOR* vy,
+          const VECTOR *restrict r, size_t num_anchors, int width __attribute__((__unused__)), int height __attribute__((__unused__)), VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    if (num_anchors < 3) return;
+
+    // step 1: calculate circle intersections
+    size_t bin = num_anchors * (num_anchors - 1);
+
+    for (int ii = 0 ; ii < VECTOR_OPS; ii++) {
+        float intersectionsx[bin];
+        float intersectionsy[bin];
+        float intersectionsw[bin];
+        size_t icount = 0;
+        size_t tmp = 0;
+        
+        // build all k-permutations
+        for (size_t i = 0; i < num_anchors-1; i++) {
+            for (size_t j = i+1; j < num_anchors; j++) {
+                // set weight for intersection
+                float weight = 1;
+                // Berechne Schnittpunkte mit aktueller Permutation
+                tmp = circle_get_intersection(vx[i][ii], vy[i][ii], vx[j][ii],
+                                              vy[j][ii], r[i][ii], r[j][ii],
+					      &intersectionsx[icount],
+                                              &intersectionsy[icount]);
+                intersectionsw[icount] = weight;
+                intersectionsw[icount+1] = weight;
+                
+                if (tmp == 0) {
+                    // no intersection => try to get approximated intersection
+                    tmp = circle_get_approx_intersection(
+                            vx[i][ii], vy[i][ii], vx[j][ii], vy[j][ii],
+                            r[i][ii], r[j][ii], &intersectionsx[icount],
+                            &intersectionsy[icount]);
+                    weight = 0.5F;
+                    intersectionsw[icount] = weight;
+                }
+                icount += tmp;                
+            }
+        }
+
+        // step 2: copy intersections into one array
+
+        // done in step 1
+
+        // step 3: filter intersections points: only keep points which are
+        //         contained in anchor length - 2 circles.
+        float ax[num_anchors];
+        float ay[num_anchors];
+        float ar[num_anchors];
+        for (size_t i = 0; i <num_anchors; i++) {
+            ax[i] = vx[i][ii];   
+            ay[i] = vy[i][ii];   
+            ar[i] = r[i][ii];        
+        }
+        icount = circle_minimum_circle_containment(num_anchors, ax, ay, ar, icount, intersectionsx, intersectionsy, intersectionsw, num_anchors - 2);
+       
+        // step 4: if there are n*(n-1)/2 points which are very close together
+        //          => no ranging error, take one of them as result
+        size_t close_num_anchors = (num_anchors * (num_anchors - 1)) / 2;
+        int wasbreak = 0;
+        for (size_t i = 0; i < icount; i++) {
+            size_t current_close_num_anchors = 1;
+            for (size_t j = 0; j < icount; j++) {
+                if (i != j && distance_s(intersectionsx[i],intersectionsy[i],intersectionsx[j],intersectionsy[j]) < 0.1F) {
+                    current_close_num_anchors++;
+                }
+            }
+            if (current_close_num_anchors >= close_num_anchors) {
+                (*resx)[ii] = intersectionsx[i];
+                (*resy)[ii] = intersectionsy[i];
+                wasbreak = 1;
+                break;
+            }
+        }
+        if (wasbreak) continue;
+
+        // step 5: apply median filter on remaining points
+        float distances[icount];
+        memset(distances, 0, icount * sizeof(float));
+        for (size_t i = 0; i < icount; i++) {
+            for (size_t j = 0; j < icount; j++) {
+                if (i != j) {
+                    distances[i] += distance_s(intersectionsx[i],intersectionsy[i],intersectionsx[j],intersectionsy[j]);
+                }
+            }
+        }
+
+        const float median = fmedian_s(icount, distances);
+        
+        float vvx[icount];
+        float vvy[icount];
+        float vvw[icount];
+        int vvcount = 0;
+        
+        for (size_t i = 0; i < icount; i++) {
+	    if (icount >=3) {
+		    if (distances[i] <= median * 1.0F) { // Median factor
+		        vvx[vvcount] = intersectionsx[i];
+		        vvy[vvcount] = intersectionsy[i];
+		        vvw[vvcount] = intersectionsw[i];
+		        vvcount++;
+		    } 
+	    } else {
+		    vvx[vvcount] = intersectionsx[i];
+		    vvy[vvcount] = intersectionsy[i];
+		    vvw[vvcount] = intersectionsw[i];
+		    vvcount++;
+	    }
+		
+        }
+
+        
+        // step 6: calculate final position estimation with given algorithm
+        float masses[vvcount];
+        for (int i = 0; i < vvcount; i++) {
+            if (vvw[i] == 1.0F) {
+                masses[i] = 3.0F * vvw[i];
+            } else {
+                masses[i] = 1.0F;
+            }
+        }
+        center_of_mass(vvcount, vvx, vvy, masses, &((*resx)[ii]), &((*resy)[ii]))    ;    
+     }
+}
+
+
+/*!
+ * LMS of one lane after the other; the reference for lms_run().
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+lms_run_scalar(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+              size_t no_anchors, int width, int height,
+              VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    // 1. Set number of subsets, subset size and threshold
+    int k = 4;
+    int N = (int)no_anchors;
+    int M = N > 6 ? 20 : binom(N, k);
+    float threshold = 2.5f;
+
+    if (N < k) {
+        llsq_run(vx, vy, r, no_anchors, width, height, resx, resy);
+        return;
+    }
+
+    if (lms_params->subsets.n != no_anchors) {
+        lms_setup(NULL, no_anchors);
+    }
+
+    // 2. Randomly draw M k-permutations
+    VECTOR ran[M];
+    lms_draw(r, no_anchors, binom(N, k), M, ran);
+
+    for (int ii = 0; ii < VECTOR_OPS; ii++) {
+
+        // calculate intermediate position and median of residues
+        float iPos_x[M];
+        float iPos_y[M];
+        float medians[M];
+        VECTOR tmpAnchors_x[k];
+        VECTOR tmpAnchors_y[k];
+        VECTOR tmpRanges[k];
+        float tmpMedian[N];
+                                
+        for (int j = 0; j < M; j++) {
+            const uint8_t *subset = lms_params->subsets.anchor[(int) ran[j][ii]];
+	    for (int i = 0; i < k; i++) {               
+		tmpAnchors_x[i] = vx[subset[i]];
+                tmpAnchors_y[i] = vy[subset[i]];
+                tmpRanges[i] = r[subset[i]];
+            }
+            VECTOR pex, pey;
+            llsq_run(tmpAnchors_x, tmpAnchors_y, tmpRanges, (size_t) k,
+                     width, height, &pex, &pey);
+            
+            iPos_x[j] = (!ls2_isnan(pex[ii])) ? pex[ii] : FLT_MAX;
+            iPos_y[j] = (!ls2_isnan(pey[ii])) ? pey[ii] : FLT_MAX;
+
+            // calculate residue for all points and find median
+            for (int i = 0; i < N; i++) {
+                float residue = distance_s(iPos_x[j], iPos_y[j], vx[i][ii], vy[i][ii]) - r[i][ii];
+                tmpMedian[i] = residue * residue;
+            }
+            medians[j] = fmedian_s((size_t) N, tmpMedian);
+        }
+
+        // 3. Find index of least median
+        int m = 0;
+        for (int i = 1; i < M; i++) {
+            if (medians[i] < medians[m]) {
+                m = i;
+            }
+        }
+        
+        // 4. Calculate s0
+        float s0 = 1.4826f * (1.0f + 5.0f / ((float)N - 2.0f)) * sqrtf(medians[m]);
+        // 5. Assign weights to samples
+        int wei[N];
+        int count = 0;
+        for (int i = 0; i < N; i++) {
+            float ri = distance_s(iPos_x[m], iPos_y[m], vx[i][ii], vy[i][ii]) - r[i][ii];
+            if (fabs(ri/s0) <= threshold) {
+                wei[i] = 1;
+                count++;
+            } else {
+                wei[i] = 0;
+            }
+        }
+
+        assert(count > 0);
+        VECTOR anchors_x[count], anchors_y[count], ranges[count];
+        int c=0;
+        for (int i=0; i < N; i++) {
+            if (wei[i]==1) {
+                anchors_x[c] = vx[i];
+                anchors_y[c] = vy[i];
+                ranges[c] = r[i];
+                c++;
+            }
+        }
+        
+        // 6. Calculate weighted LS and return result as final position
+        VECTOR pex, pey;
+        llsq_run(anchors_x, anchors_y, ranges, (size_t)count,
+                 width, height, &pex, &pey);
+        
+        (*resx)[ii] = pex[ii];
+        (*resy)[ii] = pey[ii];
+    }
+
+
+}
+
+
+static inline int
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+toIndex(int row, int col, size_t N)
+{
+    assert(row != col);
+    int idx = -1;
+    if (row < col) {
+        idx = row * ((int)N-1) - (row-1) * ((row-1) + 1)/2 + col - row - 1;
+    } else if (col < row) {
+        idx = col * ((int)N-1) - (col-1) * ((col-1) + 1)/2 + row - col - 1;
+    }
+    return idx;
+}
+
+static inline size_t
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+robust_filter(size_t const count ,float *restrict resx,float *restrict resy)
+{
+    assert (count > 1);
+    const size_t N = count * (count - 1) / 2;
+    assert (N < INT_MAX);
+    float v[N];
+    for (int i = 0; i < (int)count - 1; i++) {
+        for (int j = i+1; j < (int)count; j++) {
+            const int idx = toIndex(i, j, count);
+            v[idx] = distance_s(resx[i], resy[i], resx[j], resy[j]);
+        }
+    }
+
+    const float MEDV = 2.0f * fmedian_s(N, v);
+    float filtered_x[count];
+    float filtered_y[count];
+    size_t filtered_count = 0;
+    for (int i = 0; i < (int) count; i++) {
+        size_t dropCounter = 0;
+        for (int j = 0; j < (int) count; j++) {
+            if (i == j) {
+                continue;
+            }
+            float const dist = v[toIndex(i, j, count)];
+            if (dist >= MEDV) {
+                dropCounter++;
+            }
+        }
+        if (dropCounter <= count/2) {
+            filtered_x[filtered_count] = resx[i];
+            filtered_y[filtered_count] = resy[i];
+            filtered_count++;
+        }
+    }
+    assert(filtered_count > 0);
+    memcpy(resx,filtered_x,sizeof(float) * filtered_count);
+    memcpy(resy,filtered_y,sizeof(float) * filtered_count);
+    return filtered_count;
+}    
+
+
+/*!
+ * RLSM of one lane after the other, with the combinations of a lane spread
+ * over the lanes of llsq_run(); the reference for rlsm_run().
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+rlsm_run_scalar(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+         size_t no_anchors,
+         int width __attribute__((__unused__)),
+         int height __attribute__((__unused__)),
+         VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    const int s = 3;
+    const int M = (int)no_anchors;
+
+    // rlsm_run() needs the subsets of these anchors.
+    if (rlsm_params->subsets.n != no_anchors) {
+        rlsm_setup(NULL, no_anchors);
+    }
+    
+    for (int ii = 0; ii < VECTOR_OPS; ii++) {
+        // calculate all k-permutations for k = s to 
+        size_t int_count = 0;
+        int ccount = 0;
+        for (int k = s; k <= M; k++) {
+            ccount += binom(M, k);
+        }
+
+        float intermediatePositions_x[ccount];
+        float intermediatePositions_y[ccount];
+   
+        for (int k = s; k <= M; k++) {
+            int bino = binom(M, k);
+            int permutations[k];
+            VECTOR tmpRanges[k];
+            VECTOR tmpAnchors_x[k];
+            VECTOR tmpAnchors_y[k];
+            VECTOR tresx, tresy;
+            // initialisation for calculating k-permutations
+            for (int i = 0; i < k; i++) {
+                permutations[i] = i;
+            }
+
+            // build all k-permutations
+            for (int i = 0; i < bino; i++) {
+
+                // calculate intermediate position estimate using non-linear
+                // least squares multilateration
+                for (int h = 0; h < k; h++) {
+                    tmpAnchors_x[h][i%VECTOR_OPS] = vx[permutations[h]][ii];
+                    tmpAnchors_y[h][i%VECTOR_OPS] = vy[permutations[h]][ii];
+                    tmpRanges[h][i%VECTOR_OPS] = r[permutations[h]][ii];
+                }
+
+                if ((i%VECTOR_OPS)==VECTOR_OPS-1 || i == bino - 1){
+                    llsq_run(tmpAnchors_x, tmpAnchors_y, tmpRanges, (size_t)k, width, height, &tresx, &tresy);
+                    for (int jj=0; jj <= i%VECTOR_OPS; jj++){
+                        if (!ls2_isnan(tresy[jj]) && !ls2_isnan(tresx[jj])){
+                            intermediatePositions_x[int_count] = tresx[jj];
+                            intermediatePositions_y[int_count] = tresy[jj];
+                            int_count++;
+                        }
+                    }
+                }                
+
+                
+                // build next permutation
+                if (i == bino - 1) {
+                    break;
+                }
+                int j = k - 1;
+                while (j >= 0) {
+                    if (!incCounter(permutations, j, M, k)) {
+                        break;
+                    }
+                    j--;
+                }
+                for (int l = j+1; l < k; l++) {
+                    permutations[l] = permutations[l-1] + 1;
+                }
+            }
+        }
+
+        float x_x = NAN;
+        float x_y = NAN;
+
+        // apply robust median filter to this array of intermediate
+        // position estimates
+        if (int_count > 1u) {
+            int_count = robust_filter(int_count, intermediatePositions_x, intermediatePositions_y);
+        }
+        
+        float weights[int_count];
+        for (size_t jj = 0; jj < int_count; jj++) {
+	    weights[jj] = 1.0f;
+	}
+        // return geometric median as result
+        point_geometric_median((int) int_count, intermediatePositions_x,
+                       intermediatePositions_y,
+                       weights,
+                       &x_x, &x_y);
+     
+        (*resx)[ii] = x_x;
+        (*resy)[ii] = x_y;
+    }
+}
+
+
+/*!
+ * CluRoL of one lane after the other; the reference for clurol_run().
+ */
+static inline void
+__attribute__((__always_inline__,__gnu_inline__,__artificial__,__nonnull__))
+clurol_run_scalar(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+              size_t no_anchors, int width, int height,
+              VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    const int n = (int)no_anchors;
+    int ancStatus[n];
+    VECTOR rsx,rsy;
+
+    // Devectorized Part
+    for (int ii = 0; ii < VECTOR_OPS; ii++) {
+        int num = 0;
+        int ancStatusTaken = clurol_select(vx, vy, r, n, ii, ancStatus);
+
+        if (ancStatusTaken < 0) {
+            // no sense to do CluRoL, return NLLS here
+            nllsq_run(vx, vy, r, no_anchors, width, height, &rsx, &rsy);
+            (*resx)[ii]=rsx[ii];
+            (*resy)[ii]=rsy[ii];
+            continue;
+        }
+
+        // step 9: copy anchors and ranges into new array and localize
+        VECTOR anchorsTaken_x[ancStatusTaken],anchorsTaken_y[ancStatusTaken];
+        VECTOR rangesTaken[ancStatusTaken];
+        VECTOR retx, rety;
+        for (int i = 0; i < n; i++) {
+            if (ancStatus[i]) {
+                anchorsTaken_x[num][ii] = vx[i][ii];
+                anchorsTaken_y[num][ii] = vy[i][ii];
+                rangesTaken[num][ii] = r[i][ii];
+                num++;
+            }
+        }
+        if (num<3) {
+            (*resx)[ii]=NAN;
+            (*resy)[ii]=NAN;
+        } else {
+            nllsq_run(anchorsTaken_x,anchorsTaken_y,rangesTaken,(size_t)num,width,height,&retx,&rety);
+            (*resx)[ii]=retx[ii];
+            (*resy)[ii]=rety[ii];
+        }
+    }
+}
+
+
+#define SIDE 1000.0f
+#ifdef __FAST_MATH__
+#  define TOLERANCE 1.0
+#else
+#  define TOLERANCE 1e-3
+#endif
+
+typedef void (*run_t)(const VECTOR *, const VECTOR *, const VECTOR *restrict,
+                      size_t, int, int, VECTOR *restrict, VECTOR *restrict);
+
+static const struct {
+    const char *name;
+    run_t scalar, lanes;
+} algorithms[] = {
+    { "GeoN", geon_run_scalar, geon_run },
+    { "LMS", lms_run_scalar, lms_run },
+    { "RLSM", rlsm_run_scalar, rlsm_run },
+    { "CluRoL", clurol_run_scalar, clurol_run },
+};
+
+
+/* Tests for NaN by its bits, since -ffast-math assumes there are none. */
+static int
+undefined(const float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x7FFFFFFFU) > 0x7F800000U;
+}
+
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+    return (double) (end->tv_sec - start->tv_sec) +
+        (double) (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+static float
+uniform(unsigned int *seed, const float max)
+{
+    return max * (float) rand_r(seed) / (float) RAND_MAX;
+}
+
+
+/* Runs one algorithm on the cases both ways, returns the failures. */
+static int
+compare(const int a, const VECTOR *vx, const VECTOR *vy, const VECTOR *r,
+        const size_t *num, const int cases)
+{
+    struct timespec t0, t1;
+    double tscalar = 0.0, tlanes = 0.0, diff = 0.0;
+    int differ = 0;
+
+    for (int c = 0; c < cases; c++) {
+        const size_t o = (size_t) c * MAX_ANCHORS;
+        VECTOR sx = zero, sy = zero, lx = zero, ly = zero;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        algorithms[a].scalar(&vx[o], &vy[o], &r[o], num[c], (int) SIDE,
+                             (int) SIDE, &sx, &sy);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        tscalar += elapsed(&t0, &t1);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        algorithms[a].lanes(&vx[o], &vy[o], &r[o], num[c], (int) SIDE,
+                            (int) SIDE, &lx, &ly);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        tlanes += elapsed(&t0, &t1);
+
+        for (int i = 0; i < VECTOR_OPS; i++) {
+            const int us = undefined(sx[i]) || undefined(sy[i]);
+            const int ul = undefined(lx[i]) || undefined(ly[i]);
+            if (us || ul) {
+                differ += us != ul;
+                continue;
+            }
+            const double d = hypot(sx[i] - lx[i], sy[i] - ly[i]);
+            diff = fmax(diff, d);
+            if (d > TOLERANCE)
+                differ++;
+        }
+    }
+
+    const double lanes = (double) cases * VECTOR_OPS;
+    const int failed = differ > 0;
+    printf("%-8s scalar %8.3f s, lanes %8.3f s, speedup %5.1f, "
+           "%5d of %d lanes differ, max diff %g%s\n", algorithms[a].name,
+           tscalar, tlanes, tscalar / tlanes, differ, (int) lanes, diff,
+           failed ? " FAILED" : "");
+    return failed;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    const int cases = 500;
+    VECTOR *vx, *vy, *r;
+    size_t num[cases];
+    unsigned int seed = 4711;
+    int failures = 0;
+
+    if (posix_memalign((void **) &vx, ALIGNMENT,
+                       3 * (size_t) cases * MAX_ANCHORS * sizeof(VECTOR)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+    vy = vx + cases * MAX_ANCHORS;
+    r = vy + cases * MAX_ANCHORS;
+
+    for (int c = 0; c < cases; c++) {
+        const size_t o = (size_t) c * MAX_ANCHORS;
+        num[c] = 3 + (size_t) (rand_r(&seed) % 6);
+        for (int i = 0; i < VECTOR_OPS; i++) {
+            const float tx = uniform(&seed, SIDE), ty = uniform(&seed, SIDE);
+            for (size_t a = 0; a < num[c]; a++) {
+                const float px = uniform(&seed, SIDE);
+                const float py = uniform(&seed, SIDE);
+                float noise = 0.0f;
+                for (int k = 0; k < 4; k++)
+                    noise += uniform(&seed, 20.0f) - 10.0f;
+                if (rand_r(&seed) % 5 == 0)
+                    noise += uniform(&seed, 200.0f);
+                vx[o + a][i] = px;
+                vy[o + a][i] = py;
+                r[o + a][i] = sqrtf((px - tx) * (px - tx) +
+                                    (py - ty) * (py - ty)) + noise;
+            }
+        }
+    }
+
+    for (int a = 0; a < (int) (sizeof(algorithms) / sizeof(algorithms[0])); a++)
+        failures += compare(a, vx, vy, r, num, cases);
+
+    free(vx);
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
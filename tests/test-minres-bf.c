@@ -31,16 +31,153 @@
 #include <stdint.h>
 
 #include <immintrin.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "ls2/library.h"
+#include "ls2/ls2.h"
 #include "vector_shooter.h"
 #include "util/util_misc.c"
 #include "util/util_vector.c"
 #include "algorithm/min_res1_bf_algorithm.h"
 #include "algorithm/min_res1_bf_algorithm.c"
+#include "algorithm/min_res2_bf_algorithm.h"
+#include "algorithm/min_res2_bf_algorithm.c"
+#include "algorithm/res_bruteforce_algorithm.h"
+#include "algorithm/res_bruteforce_algorithm.c"
 
+/* The scan of every grid point, which the search has to reproduce. */
 static void
+scan(const VECTOR* ax, const VECTOR* ay, const VECTOR *restrict r,
+     const size_t num_anchors, const int width, const int height,
+     const int norm, VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    VECTOR min_res = VECTOR_BROADCASTF(FLT_MAX),
+           rx = VECTOR_BROADCASTF(0.0f),
+           ry = VECTOR_BROADCASTF(0.0f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            VECTOR res = VECTOR_ZERO();
+            const VECTOR vx = VECTOR_BROADCASTF((float) x),
+                         vy = VECTOR_BROADCASTF((float) y);
+            for (size_t a = 0; a < num_anchors; a++) {
+                const VECTOR d =  distance(vx, vy, ax[a], ay[a]) - r[a];
+                if (norm == 1)
+                    res += VECTOR_ABS(d);
+                else
+                    res += d * d;
+            }
+            const VECTOR m = VECTOR_GT(min_res, res);
+            rx = VECTOR_BLENDV(rx, vx, m);
+            ry = VECTOR_BLENDV(ry, vy, m);
+            min_res = VECTOR_MIN(min_res, res);
+        }
+    }
+    *resx = rx;
+    *resy = ry;
+}
+
+
+/* The scalar scan of res_bruteforce, lane by lane, over the whole field. */
+static void
+scan_scalar(const VECTOR* vx, const VECTOR* vy, const VECTOR *restrict r,
+            size_t num_anchors, int width, int height,
+            VECTOR *restrict resx, VECTOR *restrict resy)
+{
+    for (int i = 0; i < VECTOR_OPS; i++) {
+        float min_res = FLT_MAX;
+        int minres_x = 0, minres_y = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float res = 0;
+                for (size_t a = 0; a < num_anchors; a++) {
+                    const float d = sqrtf(((float)x-vx[a][i])*((float)x-vx[a][i])+((float)y-vy[a][i])*((float)y-vy[a][i])) - r[a][i];
+                    res += d*d;
+                }
+                if (res < min_res) {
+                    min_res = res;
+                    minres_x = x;
+                    minres_y = y;
+                }
+            }
+        }
+        (*resx)[i] = (float)minres_x;
+        (*resy)[i] = (float)minres_y;
+    }
+}
+
+
+static double tscalar, tvector;
+
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+    return (double) (end->tv_sec - start->tv_sec) +
+        (double) (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+/* Compare the search with the scan, and res_bruteforce with the scalar
+ * scan, returns the number of mismatches. */
+static int
+compare(const VECTOR *ax, const VECTOR *ay, const VECTOR *r, size_t num,
+        int width, int height, double *tscan, double *tsearch)
+{
+    struct timespec t0, t1, t2;
+    int failures = 0;
+
+    for (int norm = 1; norm <= 2; norm++) {
+        VECTOR sx, sy, bx, by;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        scan(ax, ay, r, num, width, height, norm, &sx, &sy);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (norm == 1)
+            min_res1_bf_run(ax, ay, r, num, width, height, &bx, &by);
+        else
+            min_res2_bf_run(ax, ay, r, num, width, height, &bx, &by);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        *tscan += elapsed(&t0, &t1);
+        *tsearch += elapsed(&t1, &t2);
+        if (memcmp(&sx, &bx, sizeof(VECTOR)) != 0 ||
+            memcmp(&sy, &by, sizeof(VECTOR)) != 0) {
+            char b1[255], b2[255], b3[255], b4[255];
+            fprintf(stderr, "norm %d, %dx%d: scan (%s, %s), search (%s, %s)\n",
+                    norm, width, height, vector_to_nstring(b1, 255, sx),
+                    vector_to_nstring(b2, 255, sy),
+                    vector_to_nstring(b3, 255, bx),
+                    vector_to_nstring(b4, 255, by));
+            failures++;
+        }
+    }
+    {
+        VECTOR sx, sy, bx, by;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        scan_scalar(ax, ay, r, num, width, height, &sx, &sy);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        res_bruteforce_run(ax, ay, r, num, width, height, &bx, &by);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        tscalar += elapsed(&t0, &t1);
+        tvector += elapsed(&t1, &t2);
+        if (memcmp(&sx, &bx, sizeof(VECTOR)) != 0 ||
+            memcmp(&sy, &by, sizeof(VECTOR)) != 0) {
+            char b1[255], b2[255], b3[255], b4[255];
+            fprintf(stderr, "res_bruteforce, %dx%d: scalar (%s, %s), "
+                    "vector (%s, %s)\n", width, height,
+                    vector_to_nstring(b1, 255, sx),
+                    vector_to_nstring(b2, 255, sy),
+                    vector_to_nstring(b3, 255, bx),
+                    vector_to_nstring(b4, 255, by));
+            failures++;
+        }
+    }
+    return failures;
+}
+
+
+static int
 test1(void)
 {
      const int width = 250;
@@ -57,21 +194,71 @@ test1(void)
                            { 106.06f, 106.06f, 156.06f, 126.06f, },
                            { 106.06f, 126.06f, 156.06f, 106.06f, },
                            { 106.06f, 106.06f, 156.06f, 126.06f, }, };
-     const VECTOR tagx = VECTOR_CONST_BROADCAST(125);
-     const VECTOR tagy = VECTOR_CONST_BROADCAST(125);
 
      VECTOR resx, resy;
      char b1[255], b2[255];
+     double tscan = 0.0, tsearch = 0.0;
 
      min_res1_bf_run(ax, ay, r, 4, width, height, &resx, &resy);
      printf("resx = %s\nresy = %s\n", vector_to_nstring(b1, 255, resx),
 	    vector_to_nstring(b2, 255, resy));
+     return compare(ax, ay, r, 4, width, height, &tscan, &tsearch);
 }
 
+
+/* Random anchors with noisy distances, and symmetric ones with ties. */
+static int
+test_random(int cases, int width, int height)
+{
+    unsigned int seed = 4711;
+    double tscan = 0.0, tsearch = 0.0;
+    int failures = 0;
+
+    for (int c = 0; c < cases; c++) {
+        const size_t num = 3 + (size_t) (rand_r(&seed) % 6);
+        VECTOR ax[8], ay[8], r[8];
+        const float tx = (float) (rand_r(&seed) % width);
+        const float ty = (float) (rand_r(&seed) % height);
+        for (size_t a = 0; a < num; a++) {
+            float px, py;
+            if (c % 4 == 0) {
+                // Anchors in the corners, ranges without noise.
+                px = (a & 1) ? (float) (width - 1) : 0.0f;
+                py = (a & 2) ? (float) (height - 1) : 0.0f;
+            } else {
+                px = (float) (rand_r(&seed) % width);
+                py = (float) (rand_r(&seed) % height);
+            }
+            ax[a] = VECTOR_BROADCASTF(px);
+            ay[a] = VECTOR_BROADCASTF(py);
+            for (int l = 0; l < VECTOR_OPS; l++) {
+                float noise = 0.0f;
+                if (c % 4 != 0) {
+                    for (int k = 0; k < 4; k++)
+                        noise += (float) (rand_r(&seed) % 2001 - 1000) / 50.0f;
+                }
+                r[a][l] = sqrtf((px - tx) * (px - tx) + (py - ty) * (py - ty))
+                    + noise;
+            }
+        }
+        failures += compare(ax, ay, r, num, width, height, &tscan, &tsearch);
+    }
+    printf("%d cases of %dx%d: scan %.3f s, search %.3f s, speedup %.1f\n",
+           cases, width, height, tscan, tsearch, tscan / tsearch);
+    printf("%d cases of %dx%d: res_bruteforce scalar %.3f s, vector %.3f s\n",
+           cases, width, height, tscalar, tvector);
+    tscalar = tvector = 0.0;
+    return failures;
+}
+
+
 int
 main(const int argc __attribute__((__unused__)),
-     const char *argv __attribute__((__unused__)))
+     const char *argv[] __attribute__((__unused__)))
 {
-     test1();
-     return 0;
+     const int failures = test1() + test_random(200, 250, 250) +
+         test_random(200, 97, 311) + test_random(4, 1000, 1000);
+
+     printf("%d failures\n", failures);
+     return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,270 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares the maximum likelihood estimators with the minimum of their
+ * likelihood, which is searched in double precision on a grid over the
+ * whole field and then refined by a compass search.
+ *
+ * The anchors lie on a circle around the field, so that every likelihood
+ * has a single minimum, and the ranges are disturbed by the distribution
+ * the estimator assumes.  An estimate passes if its likelihood is at
+ * most TOLERANCE above the minimum.  Some lanes have no likelihood at
+ * all: their ranges are NaN, or for mle-gamma too short for any point.
+ * Their estimates must be NaN, and so must those of mle-gamma whose
+ * initial guess has no likelihood.
+ *
+ * The test is built with -ffast-math like the library, so it tells NaN
+ * by its bits.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <float.h>
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ls2/library.h"
+#include "ls2/ls2.h"
+#include "vector_shooter.h"
+#include "util/util_misc.c"
+#include "util/util_vector.c"
+#include "algorithm/mle_gauss_algorithm.c"
+#include "algorithm/mle_gamma_algorithm.c"
+
+#define FIELD 200
+#define ANCHORS 5
+#define TOLERANCE 1e-3
+#define EPSILON 1e-4
+
+/* Tests for NaN by its bits, since -ffast-math assumes there are none. */
+static int
+undefined(const float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x7FFFFFFFU) > 0x7F800000U;
+}
+
+
+/* A uniform random number in (0, 1). */
+static double
+uniform(unsigned int *seed)
+{
+    return ((double) rand_r(seed) + 1.0) / ((double) RAND_MAX + 2.0);
+}
+
+
+/* The likelihood of lane i at (x, y) in double precision, or DBL_MAX. */
+static double
+likelihood(const int gamma, const VECTOR *ax, const VECTOR *ay,
+           const VECTOR *r, const int i, const double x, const double y)
+{
+    double f = 0.0;
+
+    for (size_t j = 0; j < ANCHORS; j++) {
+        if (undefined(r[j][i]))
+            return DBL_MAX;
+        const double d = hypot(x - ax[j][i], y - ay[j][i]);
+        if (gamma) {
+            const double Z = r[j][i] + mle_gamma_params->offset - d;
+            if (Z <= 0.0)
+                return DBL_MAX;
+            f += mle_gamma_params->rate * Z -
+                (mle_gamma_params->shape - 1.0) * log(Z);
+        } else {
+            const double e = d + mle_gauss_params->mean - r[j][i];
+            f += e * e / (2.0 * mle_gauss_params->deviation *
+                          mle_gauss_params->deviation);
+        }
+    }
+    return f;
+}
+
+
+/*
+ * The minimum of the likelihood of lane i, searched on a grid of two
+ * units over the field and its surroundings and refined by a compass
+ * search.  Returns DBL_MAX if no grid point has a likelihood.
+ */
+static double
+minimum(const int gamma, const VECTOR *ax, const VECTOR *ay,
+        const VECTOR *r, const int i)
+{
+    double fmin = DBL_MAX, mx = 0.0, my = 0.0;
+
+    for (int y = -FIELD / 2; y <= 3 * FIELD / 2; y += 2) {
+        for (int x = -FIELD / 2; x <= 3 * FIELD / 2; x += 2) {
+            const double f = likelihood(gamma, ax, ay, r, i, x, y);
+            if (f < fmin) {
+                fmin = f;
+                mx = x;
+                my = y;
+            }
+        }
+    }
+    if (fmin == DBL_MAX)
+        return fmin;
+    for (double step = 1.0; step > 1e-9; ) {
+        static const double dirs[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+        int moved = 0;
+        for (int k = 0; k < 4; k++) {
+            const double x = mx + step * dirs[k][0];
+            const double y = my + step * dirs[k][1];
+            const double f = likelihood(gamma, ax, ay, r, i, x, y);
+            if (f < fmin) {
+                fmin = f;
+                mx = x;
+                my = y;
+                moved = 1;
+            }
+        }
+        if (!moved)
+            step /= 2.0;
+    }
+    return fmin;
+}
+
+
+/* Checks every lane of one estimate, returns the number of failures. */
+static int
+check(const int gamma, const VECTOR *ax, const VECTOR *ay, const VECTOR *r,
+      const VECTOR ex, const VECTOR ey, double *excess, int *none)
+{
+    static const char *names[] = { "mle-gauss", "mle-gamma" };
+    VECTOR sx, sy;
+    int failures = 0;
+
+    nllsq_run(ax, ay, r, ANCHORS, FIELD, FIELD, &sx, &sy);
+    for (int i = 0; i < VECTOR_OPS; i++) {
+        const double fmin = minimum(gamma, ax, ay, r, i);
+        const int estimated = !undefined(ex[i]) && !undefined(ey[i]);
+        const double start = (undefined(sx[i]) || undefined(sy[i])) ?
+            DBL_MAX : likelihood(gamma, ax, ay, r, i, sx[i], sy[i]);
+
+        if (fmin == DBL_MAX || start == DBL_MAX) {
+            *none += 1;
+            if (estimated) {
+                fprintf(stderr, "%s, lane %d: no likelihood, but (%f, %f)\n",
+                        names[gamma], i, ex[i], ey[i]);
+                failures++;
+            }
+            continue;
+        }
+        if (!estimated) {
+            fprintf(stderr, "%s, lane %d: no estimate, minimum %f\n",
+                    names[gamma], i, fmin);
+            failures++;
+            continue;
+        }
+        const double f = likelihood(gamma, ax, ay, r, i, ex[i], ey[i]);
+        *excess = fmax(*excess, f - fmin);
+        if (f > fmin + TOLERANCE) {
+            fprintf(stderr, "%s, lane %d: likelihood %f at (%f, %f), "
+                    "minimum %f\n", names[gamma], i, f, ex[i], ey[i], fmin);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+
+/*
+ * Random positions with ranges disturbed by the assumed distribution.
+ * The last lane of every case has NaN ranges, and for mle-gamma every
+ * fourth case has a lane whose ranges are too short for any point.
+ */
+static int
+test_random(const int gamma, const int cases)
+{
+    unsigned int seed = 4711;
+    double excess = 0.0;
+    int failures = 0, none = 0;
+    VECTOR ax[ANCHORS], ay[ANCHORS];
+
+    for (size_t j = 0; j < ANCHORS; j++) {
+        const double phi = 2.0 * M_PI * (double) j / ANCHORS;
+        ax[j] = VECTOR_BROADCASTF((float) (FIELD * (0.5 + 0.6 * cos(phi))));
+        ay[j] = VECTOR_BROADCASTF((float) (FIELD * (0.5 + 0.6 * sin(phi))));
+    }
+    for (int c = 0; c < cases; c++) {
+        VECTOR r[ANCHORS], ex, ey;
+        for (int i = 0; i < VECTOR_OPS; i++) {
+            const double tx = FIELD * uniform(&seed);
+            const double ty = FIELD * uniform(&seed);
+            for (size_t j = 0; j < ANCHORS; j++) {
+                const double d = hypot(tx - ax[j][i], ty - ay[j][i]);
+                double noise;
+                if (gamma) {
+                    noise = -mle_gamma_params->offset;
+                    for (int k = 0; k < (int) mle_gamma_params->shape; k++)
+                        noise -= log(uniform(&seed)) / mle_gamma_params->rate;
+                } else {
+                    noise = mle_gauss_params->mean +
+                        mle_gauss_params->deviation *
+                        sqrt(-2.0 * log(uniform(&seed))) *
+                        cos(2.0 * M_PI * uniform(&seed));
+                }
+                r[j][i] = (float) (d + noise);
+            }
+        }
+        for (size_t j = 0; j < ANCHORS; j++) {
+            r[j][VECTOR_OPS - 1] = NAN;
+            if (gamma && c % 4 == 0)
+                r[j][0] = (float) (-FIELD - mle_gamma_params->offset);
+        }
+        if (gamma)
+            mle_gamma_run(ax, ay, r, ANCHORS, FIELD, FIELD, &ex, &ey);
+        else
+            mle_gauss_run(ax, ay, r, ANCHORS, FIELD, FIELD, &ex, &ey);
+        failures += check(gamma, ax, ay, r, ex, ey, &excess, &none);
+    }
+    printf("%s: %d cases, %d lanes without likelihood, largest excess "
+           "likelihood %g, %d failures\n", gamma ? "mle-gamma" : "mle-gauss",
+           cases, none, excess, failures);
+    return failures;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    // The default termination criteria leave the estimates of mle-gamma,
+    // whose likelihood is flat near the minimum, up to 0.1 above it.
+    mle_gauss_defaults.epsilon = EPSILON;
+    mle_gamma_defaults.epsilon = EPSILON;
+    const int failures = test_random(0, 64) + test_random(1, 64);
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,159 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Compares the samplers of the normal distribution in util_random.c.
+ * For each sampler, the moments, the tail mass, and the Kolmogorov-
+ * Smirnov distance to the standard normal distribution are printed,
+ * together with the time per sample.  The program fails if the
+ * Ziggurat sampler is not at least as close to the normal distribution
+ * as the Box-Muller transform, or the critical value of the test.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ls2/library.h"
+#include "vector_shooter.h"
+#include "util/util_random.c"
+
+#ifndef SAMPLES
+#  define SAMPLES (1 << 22)
+#endif
+
+struct normal_stats {
+    double mean, variance, skewness, kurtosis;
+    double tail;                /* Fraction of samples with |x| > 3. */
+    double ks;                  /* Kolmogorov-Smirnov distance.      */
+    double ns;                  /* Nano seconds per sample.          */
+};
+
+
+static int
+compare_floats(const void *a, const void *b)
+{
+    const float x = *(const float *) a, y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+
+static void
+sample(ls2_normal_sampler_t sampler, float *x, const size_t n,
+       struct normal_stats *s)
+{
+    ls2_rng_t seed;
+    struct timespec start, end;
+
+    ls2_rng_init(&seed, 0x2545F4914F6CDD1DULL);
+    ls2_normal_sampler = sampler;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < n; i += VECTOR_OPS) {
+        const VECTOR v = normal_rand(&seed);
+        memcpy(&(x[i]), &v, sizeof(VECTOR));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    s->ns = ((double) (end.tv_sec - start.tv_sec) * 1e9 +
+             (double) (end.tv_nsec - start.tv_nsec)) / (double) n;
+
+    double m1 = 0.0, m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    size_t tail = 0;
+    for (size_t i = 0; i < n; i++) {
+        m1 += x[i];
+    }
+    m1 /= (double) n;
+    for (size_t i = 0; i < n; i++) {
+        const double d = x[i] - m1;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+        if (fabs(x[i]) > 3.0)
+            tail++;
+    }
+    m2 /= (double) n;
+    m3 /= (double) n;
+    m4 /= (double) n;
+    s->mean = m1;
+    s->variance = m2;
+    s->skewness = m3 / pow(m2, 1.5);
+    s->kurtosis = m4 / (m2 * m2) - 3.0;
+    s->tail = (double) tail / (double) n;
+
+    qsort(x, n, sizeof(float), compare_floats);
+    double d = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double cdf = 0.5 * erfc(-x[i] / M_SQRT2);
+        d = fmax(d, fmax(fabs(cdf - (double) i / (double) n),
+                         fabs((double) (i + 1) / (double) n - cdf)));
+    }
+    s->ks = d;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    static const char *names[] = { "ziggurat", "box-muller" };
+    struct normal_stats s[2];
+    float *x;
+
+    if (posix_memalign((void **) &x, ALIGNMENT, SAMPLES * sizeof(float)) != 0) {
+        perror("posix_memalign()");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-10s %9s %9s %9s %9s %9s %9s %9s\n", "sampler", "mean",
+           "variance", "skewness", "kurtosis", "P(|x|>3)", "KS", "ns");
+    for (int i = 0; i < 2; i++) {
+        sample(ls2_get_normal_sampler_by_name(names[i]), x, SAMPLES, &s[i]);
+        printf("%-10s %9.5f %9.5f %9.5f %9.5f %9.6f %9.6f %9.3f\n",
+               names[i], s[i].mean, s[i].variance, s[i].skewness,
+               s[i].kurtosis, s[i].tail, s[i].ks, s[i].ns);
+    }
+    printf("%-10s %9.5f %9.5f %9.5f %9.5f %9.6f\n", "expected",
+           0.0, 1.0, 0.0, 0.0, erfc(3.0 / M_SQRT2));
+
+    free(x);
+
+    // The critical value of the KS test at a level of 0.001.
+    const double critical = 1.95 / sqrt((double) SAMPLES);
+    if (s[LS2_NORMAL_ZIGGURAT].ks > fmax(critical, s[LS2_NORMAL_BOX_MULLER].ks) ||
+        fabs(s[LS2_NORMAL_ZIGGURAT].variance - 1.0) > 0.01) {
+        fprintf(stderr, "Ziggurat sampler does not match the normal "
+                "distribution.\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Checks the quantiles of the histograms of util_quantile.c against the
+ * exact quantiles of the sorted values, for a few distributions of
+ * errors, including values below the first and above the last bin.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <float.h>
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ls2/library.h"
+#include "ls2/ls2.h"
+#include "ls2/util.h"
+#include "vector_shooter.h"
+#include "util/util_quantile.c"
+
+#define SAMPLES (VECTOR_OPS * 4096)
+
+static const float levels[] = { 0.0F, 0.01F, 0.25F, 0.5F, 0.9F, 0.95F,
+                                0.99F, 0.999F, 1.0F };
+
+
+static int
+compare_floats(const void *a, const void *b)
+{
+    const float x = *(const float *) a, y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+
+static float
+uniform(unsigned int *seed)
+{
+    return ((float) rand_r(seed) + 0.5F) / ((float) RAND_MAX + 1.0F);
+}
+
+
+/* The errors of the distribution d. */
+static float
+sample(const int d, unsigned int *seed)
+{
+    switch (d) {
+    case 0:                     /* Uniform between 0 and 100. */
+        return 100.0F * uniform(seed);
+    case 1:                     /* Exponential with mean 30. */
+        return -30.0F * logf(uniform(seed));
+    case 2:                     /* Mostly tiny, some huge. */
+        return (rand_r(seed) % 10 == 0) ? 1e6F * uniform(seed) :
+            0.001F * uniform(seed);
+    default:                    /* Half of the runs fail. */
+        return (rand_r(seed) % 2 == 0) ? NAN : 50.0F + uniform(seed);
+    }
+}
+
+
+/* Compare the histogram of distribution d with the sorted values. */
+static int
+test_distribution(const int d)
+{
+    static float values[SAMPLES], sorted[SAMPLES];
+    unsigned int seed = 4711U + (unsigned int) d;
+    float min = FLT_MAX, max = 0.0F;
+    size_t n = 0;
+    ls2_quantile_t q;
+    int failures = 0;
+
+    ls2_quantile_init(&q);
+    for (size_t i = 0; i < SAMPLES; i++) {
+        values[i] = sample(d, &seed);
+        if (!ls2_isnan(values[i])) {
+            sorted[n++] = values[i];
+            min = fminf(min, values[i]);
+            max = fmaxf(max, values[i]);
+        }
+    }
+    for (size_t i = 0; i < SAMPLES; i += VECTOR_OPS) {
+        VECTOR v;
+        memcpy(&v, &values[i], sizeof(v));
+        ls2_quantile_add(&q, v);
+    }
+    qsort(sorted, n, sizeof(float), compare_floats);
+
+    if (q.count != n) {
+        fprintf(stderr, "Distribution %d: %u values instead of %zu\n", d,
+                q.count, n);
+        failures++;
+    }
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        // The exact quantile lies between these values.
+        const float rank = levels[l] * (float) (n - 1);
+        const float a = sorted[(size_t) floorf(rank)];
+        const float b = sorted[(size_t) ceilf(rank)];
+        const float got = ls2_quantile_get(&q, levels[l], min, max);
+        // Two bins, as the values around the rank may be in two of them.
+        const float slack = 2.0F * (0x1p-4F * b + LS2_QUANTILE_MIN);
+        if (!(a - slack <= got && got <= b + slack) || got < min ||
+            got > max) {
+            fprintf(stderr, "Distribution %d: quantile %g is %g instead "
+                    "of %g\n", d, levels[l], got, a);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    int failures = 0;
+    ls2_quantile_t empty;
+
+    for (int d = 0; d < 4; d++)
+        failures += test_distribution(d);
+
+    ls2_quantile_init(&empty);
+    if (!ls2_isnan(ls2_quantile_get(&empty, 0.5F, 0.0F, 0.0F))) {
+        fprintf(stderr, "The quantile of no values is a number\n");
+        failures++;
+    }
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
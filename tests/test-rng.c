@@ -0,0 +1,172 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Checks the Philox4x32-10 generator of util_random.c against the known
+ * answers of the Random123 distribution and checks that a stream does
+ * not depend on what was drawn before seeking to it.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ls2/library.h"
+#include "vector_shooter.h"
+#include "util/util_random.c"
+
+/* A straightforward scalar Philox4x32-10. */
+static void
+philox_reference(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c[4] = { ctr[0], ctr[1], ctr[2], ctr[3] };
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        const uint64_t p0 = (uint64_t) PHILOX_M0 * c[0];
+        const uint64_t p1 = (uint64_t) PHILOX_M1 * c[2];
+        const uint32_t n0 = (uint32_t) (p1 >> 32) ^ c[1] ^ k0;
+        const uint32_t n2 = (uint32_t) (p0 >> 32) ^ c[3] ^ k1;
+        c[1] = (uint32_t) p1;
+        c[3] = (uint32_t) p0;
+        c[0] = n0;
+        c[2] = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    memcpy(out, c, sizeof(c));
+}
+
+
+static int
+test_known_answers(void)
+{
+    static const struct {
+        uint32_t ctr[4], key[2], out[4];
+    } kat[] = {
+        { { 0, 0, 0, 0 }, { 0, 0 },
+          { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+        { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+          { 0xffffffff, 0xffffffff },
+          { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+        { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+          { 0xa4093822, 0x299f31d0 },
+          { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+    };
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+        uint32_t out[4];
+        philox_reference(kat[i].ctr, kat[i].key, out);
+        if (memcmp(out, kat[i].out, sizeof(out)) != 0) {
+            fprintf(stderr, "Reference Philox fails known answer %zu\n", i);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+
+/* Compare the vectorised generator with the reference, lane by lane. */
+static int
+test_lanes(void)
+{
+    const uint64_t seed = 0x0123456789ABCDEFULL;
+    const uint32_t key[2] = { (uint32_t) seed, (uint32_t) (seed >> 32) };
+    int failures = 0;
+    ls2_rng_t rng;
+
+    ls2_rng_init(&rng, seed);
+    for (uint32_t stream = 0; stream < 1000000; stream += 99991) {
+        for (uint32_t run = 0; run < 4; run++) {
+            ls2_rng_seek(&rng, stream, run);
+            for (uint32_t block = 0; block < 3; block++) {
+                union {
+                    __m128i v[4];
+                    uint32_t u[4][4];
+                } got;
+                for (int j = 0; j < 4; j++)
+                    got.v[j] = rand_sse_epi32(&rng);
+                for (uint32_t lane = 0; lane < 4; lane++) {
+                    const uint32_t ctr[4] = { stream, run, block, lane };
+                    uint32_t out[4];
+                    philox_reference(ctr, key, out);
+                    for (int j = 0; j < 4; j++) {
+                        if (got.u[j][lane] != out[j]) {
+                            fprintf(stderr, "Mismatch at stream %u, run %u, "
+                                    "block %u, lane %u\n", stream, run,
+                                    block, lane);
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+
+/* A seeked stream must not depend on earlier draws. */
+static int
+test_seek(void)
+{
+    ls2_rng_t a, b;
+    VECTOR x[16], y[16];
+
+    ls2_rng_init(&a, 42);
+    ls2_rng_init(&b, 42);
+    for (int i = 0; i < 7; i++)
+        (void) rnd(&b);
+    ls2_rng_seek(&a, 17, 5);
+    ls2_rng_seek(&b, 17, 5);
+    for (int i = 0; i < 16; i++) {
+        x[i] = gaussrand(&a, 0.0F, 1.0F);
+        y[i] = gaussrand(&b, 0.0F, 1.0F);
+    }
+    if (memcmp(x, y, sizeof(x)) != 0) {
+        fprintf(stderr, "Stream depends on earlier draws\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    const int failures = test_known_answers() + test_lanes() + test_seek();
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
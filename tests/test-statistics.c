@@ -0,0 +1,123 @@
+/*
+
+  This file is part of LS² - the Localization Simulation Engine of FU Berlin.
+
+  Copyright 2011-2013   Heiko Will, Marcel Kyas, Thomas Hillebrandt,
+  Stefan Adler, Malte Rohde, Jonathan Gunthermann
+
+  LS² is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LS² is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LS².  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Checks ls2_statistics() of util_statistics.c on fields whose pixels
+ * outside a region are NaN, as those of --roi and --stride.  It is built
+ * with -ffast-math like the library, where isnan() is always false.
+ */
+
+#if HAVE_CONFIG_H
+#  include "ls2/ls2-config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ls2/util.h"
+#include "util/util_statistics.c"
+
+#define WIDTH 64
+#define HEIGHT 48
+#define TOLERANCE 1e-4
+
+
+/* Compares one statistic with the exact value, or with NaN if there is
+ * none, returns 1 if it differs. */
+static int
+check(const char *name, const char *statistic, const float got,
+      const int defined, const double expected)
+{
+    const int ok = defined ?
+        !ls2_isnan(got) && fabs(got - expected) <= TOLERANCE * fabs(expected) :
+        ls2_isnan(got);
+    if (!ok)
+        fprintf(stderr, "%s: %s is %f, expected %f\n", name, statistic, got,
+                expected);
+    return !ok;
+}
+
+
+/*
+ * The statistics of a field, which is NaN outside of [x0, x1) x [y0, y1)
+ * and on the pixels off the grid of the stride, computed in double
+ * precision as well.
+ */
+static int
+test_region(const char *name, const int x0, const int y0, const int x1,
+            const int y1, const int stride)
+{
+    static float field[WIDTH * HEIGHT];
+    double n = 0.0, sum = 0.0, sum2 = 0.0, min = DBL_MAX, max = -DBL_MAX;
+    float mu, sigma, lo, hi;
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            const int inside = x0 <= x && x < x1 && y0 <= y && y < y1 &&
+                (x - x0) % stride == 0 && (y - y0) % stride == 0;
+            const float v = (float) ((x * 7 + y * 13) % 101) + 0.25F;
+            field[x + WIDTH * y] = inside ? v : NAN;
+            if (inside) {
+                n += 1.0;
+                sum += v;
+                sum2 += (double) v * v;
+                min = fmin(min, v);
+                max = fmax(max, v);
+            }
+        }
+    }
+    const int defined = n > 0.0;
+    const double mean = defined ? sum / n : 0.0;
+    const double sdev = defined ? sqrt(sum2 / n - mean * mean) : 0.0;
+
+    ls2_statistics(field, WIDTH * HEIGHT, &mu, &sigma, &lo, &hi);
+    const int failures = check(name, "mean", mu, defined, mean) +
+        check(name, "standard deviation", sigma, defined, sdev) +
+        check(name, "minimum", lo, defined, min) +
+        check(name, "maximum", hi, defined, max);
+    printf("%-10s %6.0f pixels: mean %f, sdev %f, min %f, max %f%s\n", name,
+           n, mu, sigma, lo, hi, failures ? " FAILED" : "");
+    return failures;
+}
+
+
+int
+main(const int argc __attribute__((__unused__)),
+     const char *argv[] __attribute__((__unused__)))
+{
+    int failures = 0;
+
+    failures += test_region("field", 0, 0, WIDTH, HEIGHT, 1);
+    failures += test_region("roi", 10, 5, 40, 30, 1);
+    failures += test_region("stride", 0, 0, WIDTH, HEIGHT, 3);
+    failures += test_region("both", 7, 9, 50, 41, 4);
+    failures += test_region("pixel", WIDTH - 1, HEIGHT - 1, WIDTH, HEIGHT, 1);
+    failures += test_region("empty", 0, 0, 0, 0, 1);
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}